@@ -0,0 +1,84 @@
+#!/bin/sh
+
+set -o errexit
+set -o nounset
+
+if [ "$#" -ne 2 ]
+then
+  echo "Usage: $0 <path/to/sourcemeta-one-index> <schema-count>" 1>&2
+  exit 1
+fi
+
+INDEX="$1"
+COUNT="$2"
+
+if [ "$(uname -s)" = "Darwin" ]
+then
+  IS_DARWIN=1
+else
+  IS_DARWIN=0
+fi
+
+nanoseconds() {
+  if [ "$IS_DARWIN" = "1" ]
+  then
+    perl -MTime::HiRes=time -e 'printf "%d\n", time * 1000000000'
+  else
+    date +%s%N
+  fi
+}
+
+TMP="$(mktemp -d)"
+clean() { rm -rf "$TMP"; }
+trap clean EXIT
+
+cat << EOF > "$TMP/one.json"
+{
+  "url": "https://sourcemeta.com",
+  "contents": {
+    "schemas": {
+      "baseUri": "https://example.com/",
+      "path": "./schemas"
+    }
+  }
+}
+EOF
+
+mkdir "$TMP/schemas"
+
+echo "Filling registry to ${COUNT} schemas..." >&2
+index=0
+while [ "$index" -lt "$COUNT" ]
+do
+  cat << EOF > "$TMP/schemas/schema-$index.json"
+{
+  "\$schema": "https://json-schema.org/draft/2020-12/schema",
+  "\$id": "https://example.com/schema-$index"
+}
+EOF
+  index=$((index + 1))
+done
+
+# The first build only sets the scene. What is measured is a rebuild over a
+# catalog where nothing moved, which is all planning and no building
+echo "Indexing ${COUNT} schemas once..." >&2
+"$INDEX" --skip-banner --maximum-direct-directory-entries 0 \
+  "$TMP/one.json" "$TMP/output" >/dev/null 2>&1
+
+echo "Measuring: rebuild ${COUNT} unchanged schemas..." >&2
+START="$(nanoseconds)"
+"$INDEX" --skip-banner --maximum-direct-directory-entries 0 \
+  "$TMP/one.json" "$TMP/output" --time >&2 2>/dev/null
+END="$(nanoseconds)"
+RESULT="$(( (END - START) / 1000000 ))"
+echo "  Result: ${RESULT}ms" >&2
+
+cat << EOF
+[
+  {
+    "name": "Rebuild ${COUNT} unchanged schemas",
+    "unit": "ms",
+    "value": ${RESULT}
+  }
+]
+EOF
@@ -24,6 +24,7 @@ trap clean EXIT
   "$HERE/index-n.sh" "$INDEX" 100
   "$HERE/index-n.sh" "$INDEX" 1000
   "$HERE/index-n.sh" "$INDEX" 10000
+  "$HERE/index-noop-rebuild.sh" "$INDEX" 10000
   "$HERE/index-custom-meta-schema.sh" "$INDEX" 10000
   "$HERE/index-ref-fanout.sh" "$INDEX" 10000
 } >> "$RESULTS"
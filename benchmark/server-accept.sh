@@ -0,0 +1,111 @@
+#!/bin/sh
+
+set -o errexit
+set -o nounset
+
+if [ "$#" -ne 2 ]
+then
+  echo "Usage: $0 <path/to/sourcemeta-one-server> <path/to/sourcemeta-one-index>" 1>&2
+  exit 1
+fi
+
+SERVER="$1"
+INDEX="$2"
+
+if ! command -v wrk > /dev/null
+then
+  echo "error: This benchmark needs wrk (https://github.com/wg/wrk)" 1>&2
+  exit 1
+fi
+
+TMP="$(mktemp -d)"
+clean() {
+  if [ -n "${SERVER_PID:-}" ] && kill -0 "$SERVER_PID" 2>/dev/null
+  then
+    kill -KILL "$SERVER_PID" 2>/dev/null || true
+  fi
+  rm -rf "$TMP"
+}
+trap clean EXIT
+
+echo '{ "url": "http://localhost:8000" }' > "$TMP/one.json"
+echo "Indexing an empty registry..." >&2
+"$INDEX" --skip-banner "$TMP/one.json" "$TMP/output" > /dev/null 2>&1
+
+PORT="$(awk 'BEGIN { srand('"$$"'); print 49152 + int(rand() * 16383) }')"
+CONNECTIONS="${CONNECTIONS:-256}"
+DURATION="${DURATION:-10s}"
+
+# wrk prints latencies with whatever unit reads best, so every one of them is
+# brought down to milliseconds before it is compared
+milliseconds() {
+  echo "$1" | awk '
+    /us$/ { sub(/us$/, ""); printf "%.3f\n", $0 / 1000; next }
+    /ms$/ { sub(/ms$/, ""); printf "%.3f\n", $0; next }
+    /s$/ { sub(/s$/, ""); printf "%.3f\n", $0 * 1000; next }'
+}
+
+# Every request comes on a connection of its own, so what is measured is how
+# fast the server takes new connections in and how long the slowest of them
+# wait, rather than how fast it answers on one it already has
+measure() {
+  NAME="$1"
+  shift
+  "$SERVER" "$@" "$TMP/output" "$PORT" > "$TMP/server.txt" 2>&1 &
+  SERVER_PID="$!"
+  WAITED=0
+  until grep -q "Listening on port" "$TMP/server.txt" 2>/dev/null
+  do
+    WAITED=$((WAITED + 1))
+    if [ "$WAITED" -gt 50 ]
+    then
+      cat "$TMP/server.txt" >&2
+      exit 1
+    fi
+    sleep 0.1
+  done
+
+  echo "Measuring: accept with ${NAME}..." >&2
+  wrk --threads 4 --connections "$CONNECTIONS" --duration "$DURATION" \
+    --latency --header "Connection: close" \
+    "http://127.0.0.1:$PORT/self/v1/health" > "$TMP/wrk.txt"
+  kill -TERM "$SERVER_PID"
+  wait "$SERVER_PID" || true
+  SERVER_PID=""
+
+  RATE="$(awk '/^Requests\/sec:/ { print $2 }' "$TMP/wrk.txt")"
+  P50="$(milliseconds "$(awk '$1 == "50%" { print $2 }' "$TMP/wrk.txt")")"
+  P99="$(milliseconds "$(awk '$1 == "99%" { print $2 }' "$TMP/wrk.txt")")"
+  # As time per connection, so that smaller is better like everywhere else
+  COST="$(awk "BEGIN { printf \"%.3f\", 1000000 / $RATE }")"
+  echo "  Result: ${RATE} connections/s, p50 ${P50}ms, p99 ${P99}ms" >&2
+
+  cat << EOF
+  {
+    "name": "Accept a connection (${NAME})",
+    "unit": "us",
+    "value": ${COST}
+  },
+  {
+    "name": "Median latency on a new connection (${NAME})",
+    "unit": "ms",
+    "value": ${P50}
+  },
+  {
+    "name": "99th percentile latency on a new connection (${NAME})",
+    "unit": "ms",
+    "value": ${P99}
+  },
+EOF
+}
+
+{
+  echo "["
+  measure "1 worker" --workers 1
+  measure "default workers"
+  measure "default workers, pinned" --pin
+} > "$TMP/results.txt"
+
+# The last entry is followed by a comma like every other, which JSON refuses
+sed '$ s/},$/}/' "$TMP/results.txt"
+echo "]"
@@ -9,13 +9,14 @@
 #include <sourcemeta/core/oidc.h>
 #include <sourcemeta/core/uri.h>
 
+#include "authentication_cache.h"
 #include "authentication_claims.h"
 #include "authentication_format.h"
 #include "authentication_provider.h"
 #include "authentication_session.h"
 #include "authentication_table.h"
 
-#include <algorithm>     // std::ranges::all_of
+#include <algorithm>     // std::ranges::all_of, std::min
 #include <bit>           // std::countr_zero
 #include <chrono>        // std::chrono::system_clock, std::chrono::seconds
 #include <cstddef>       // std::byte, std::size_t
@@ -821,13 +822,78 @@ auto Authentication::logout(const Credentials &credentials,
   return result;
 }
 
+namespace {
+
+// How long a placement may be remembered: never past the lifetime of the
+// cache, and never past what the token or any session presented says of
+// itself, whichever of them did the admitting
+auto placement_expiry(const Authentication::Credentials &credentials,
+                      const CredentialCache::Clock::time_point now)
+    -> CredentialCache::Clock::time_point {
+  auto result{now + CredentialCache::LIFETIME};
+  const auto token{sourcemeta::core::JWT::from(credentials.bearer)};
+  if (token.has_value()) {
+    const auto expires{token.value().expires_at()};
+    if (expires.has_value()) {
+      result = std::min(result, expires.value());
+    }
+  }
+
+  std::vector<std::string_view> sessions;
+  for (const auto field : credentials.cookies) {
+    sourcemeta::core::http_cookie_values(field, SESSION_COOKIE, sessions);
+  }
+
+  for (const auto sealed : sessions) {
+    const auto expiry{sealed_expiry(sealed)};
+    if (expiry.has_value()) {
+      result = std::min(result,
+                        CredentialCache::Clock::time_point{expiry.value()});
+    }
+  }
+
+  return result;
+}
+
+} // namespace
+
 auto Authentication::caller(const Credentials &credentials) const
     -> Authentication::Caller {
+  const auto &impl{*this->table_.impl_};
   Authentication::Caller result;
-  result.policies_ =
-      this->table_.impl_->classify(credentials.bearer, credentials.cookies);
-  result.view_ = this->table_.impl_->view_name(result.policies_);
   result.bearer_ = credentials.bearer;
+  // Presenting nothing is the common request, and placing it reads no policy
+  // at all, so there is nothing to gain from remembering it
+  if (credentials.bearer.empty() && credentials.cookies.empty()) {
+    result.view_ = impl.view_name(result.policies_);
+    return result;
+  }
+
+  const auto key{
+      CredentialCache::digest(credentials.bearer, credentials.cookies)};
+  const auto now{CredentialCache::Clock::now()};
+  const auto cached{impl.credentials_.find(key, now)};
+  if (cached.has_value()) {
+    result.policies_ = cached.value().policies;
+    result.view_ = cached.value().view;
+    return result;
+  }
+
+  result.policies_ = impl.classify(credentials.bearer, credentials.cookies);
+  result.view_ = impl.view_name(result.policies_);
+
+  // Only a placement is remembered. A credential placing nobody may do so
+  // because a provider could not be reached just then, which should not
+  // outlast the request that found it so
+  if (result.policies_ != 0) {
+    const auto expiry{placement_expiry(credentials, now)};
+    if (expiry > now) {
+      impl.credentials_.insert(key, {.policies = result.policies_,
+                                     .view = result.view_,
+                                     .expiry = expiry});
+    }
+  }
+
   return result;
 }
 
@@ -837,6 +903,22 @@ auto Authentication::permits(const Authentication::Path &path,
   return this->table_.impl_->permits(path.value(), caller.policies_);
 }
 
+auto Authentication::reach(const Authentication::Path &path,
+                           const Authentication::Caller &caller) const
+    -> Authentication::Reach {
+  // An unreadable table shows nothing to anybody, as `permits` has it
+  const auto governing{this->table_.impl_->governing_mask(path.value())};
+  if (!governing.has_value()) {
+    return {.permitted = false, .everybody = false};
+  }
+
+  // Nobody presenting nothing satisfies any policy, so everybody reaches
+  // exactly what nobody governs
+  return {.permitted = governing.value() == 0 ||
+                       (governing.value() & caller.policies_) != 0,
+          .everybody = governing.value() == 0};
+}
+
 auto Authentication::permits(const RouteTarget &target,
                              const Authentication::Caller &caller,
                              const std::string_view required_audience) const
@@ -905,6 +987,24 @@ auto Authentication::Table::visible(
   return this->impl_->permits(path.value(), view.policies_);
 }
 
+auto Authentication::Table::visibility(
+    const Authentication::Path &path,
+    const std::span<const Authentication::RecordedView> views) const
+    -> std::vector<bool> {
+  std::vector<bool> result(views.size(), false);
+  const auto governing{this->impl_->governing_mask(path.value())};
+  if (!governing.has_value()) {
+    return result;
+  }
+
+  for (std::size_t index{0}; index < views.size(); index += 1) {
+    result[index] = governing.value() == 0 ||
+                    (governing.value() & views[index].policies_) != 0;
+  }
+
+  return result;
+}
+
 auto Authentication::Table::governing(const Authentication::Path &path) const
     -> std::optional<std::vector<std::string_view>> {
   const auto governing{this->impl_->governing_mask(path.value())};
@@ -0,0 +1,157 @@
+#ifndef SOURCEMETA_ONE_ENTERPRISE_AUTHENTICATION_CACHE_H_
+#define SOURCEMETA_ONE_ENTERPRISE_AUTHENTICATION_CACHE_H_
+
+#include <sourcemeta/core/crypto.h>
+
+#include <array>         // std::array
+#include <chrono>        // std::chrono::system_clock, std::chrono::seconds
+#include <cstddef>       // std::size_t
+#include <cstdint>       // std::uint8_t, std::uint64_t
+#include <cstring>       // std::memcpy
+#include <list>          // std::list
+#include <mutex>         // std::mutex, std::scoped_lock
+#include <optional>      // std::optional, std::nullopt
+#include <span>          // std::span
+#include <string>        // std::string, std::to_string
+#include <string_view>   // std::string_view
+#include <unordered_map> // std::unordered_map
+#include <utility>       // std::pair
+
+// Who a credential was found to be, remembered so that presenting it again is
+// one lookup rather than a signature verification, a session unsealing or a
+// key hash per policy. Most requests present one of a few credentials over and
+// over, which is what makes this worth holding
+namespace sourcemeta::one {
+
+class CredentialCache {
+public:
+  // Keyed by a digest of everything a request presented rather than by the
+  // credentials themselves, so that nothing held here could be presented in
+  // their place, and two presentations sharing an entry would take a collision
+  // in SHA-256
+  using Digest = std::array<std::uint8_t, 32>;
+  using Clock = std::chrono::system_clock;
+
+  struct Entry {
+    // The policies the caller satisfies, and the view they are served, which
+    // points into the table that owns this cache
+    std::uint64_t policies;
+    std::string_view view;
+    Clock::time_point expiry;
+  };
+
+  // How long a placement is trusted without reading the credential again,
+  // whatever the credential says about itself. A key withdrawn from a key set
+  // or a secret dropped from a policy is honoured for at most this long
+  // without a reload
+  static constexpr std::chrono::seconds LIFETIME{60};
+
+  // Every presentation carries its own entry, so this bounds the memory a
+  // stream of distinct credentials can take
+  static constexpr std::size_t CAPACITY{16384};
+
+  CredentialCache() = default;
+
+  // To avoid mistakes
+  CredentialCache(const CredentialCache &) = delete;
+  CredentialCache(CredentialCache &&) = delete;
+  auto operator=(const CredentialCache &) -> CredentialCache & = delete;
+  auto operator=(CredentialCache &&) -> CredentialCache & = delete;
+
+  // Each part is prefixed with its length, so that a bearer value and a cookie
+  // carrying the same bytes, or two fields split differently, never read as
+  // the same presentation
+  [[nodiscard]] static auto
+  digest(const std::string_view bearer,
+         const std::span<const std::string_view> cookies) -> Digest {
+    std::string material;
+    const auto append{[&material](const std::string_view part) -> void {
+      material += std::to_string(part.size());
+      material += ':';
+      material += part;
+    }};
+
+    append(bearer);
+    for (const auto cookie : cookies) {
+      append(cookie);
+    }
+
+    return sourcemeta::core::sha256_digest(material);
+  }
+
+  [[nodiscard]] auto find(const Digest &key, const Clock::time_point now)
+      -> std::optional<Entry> {
+    auto &shard{this->shard(key)};
+    const std::scoped_lock lock{shard.mutex};
+    const auto match{shard.index.find(key)};
+    if (match == shard.index.end()) {
+      return std::nullopt;
+    }
+
+    if (match->second->second.expiry <= now) {
+      shard.entries.erase(match->second);
+      shard.index.erase(match);
+      return std::nullopt;
+    }
+
+    shard.entries.splice(shard.entries.begin(), shard.entries, match->second);
+    return match->second->second;
+  }
+
+  auto insert(const Digest &key, const Entry &entry) -> void {
+    auto &shard{this->shard(key)};
+    const std::scoped_lock lock{shard.mutex};
+    const auto match{shard.index.find(key)};
+    if (match != shard.index.end()) {
+      match->second->second = entry;
+      shard.entries.splice(shard.entries.begin(), shard.entries, match->second);
+      return;
+    }
+
+    shard.entries.emplace_front(key, entry);
+    try {
+      shard.index.emplace(key, shard.entries.begin());
+    } catch (...) {
+      shard.entries.pop_front();
+      throw;
+    }
+
+    if (shard.entries.size() > CAPACITY / SHARDS) {
+      shard.index.erase(shard.entries.back().first);
+      shard.entries.pop_back();
+    }
+  }
+
+private:
+  // Placing callers happens on every worker at once, so the entries are split
+  // by digest and each part is locked on its own
+  static constexpr std::size_t SHARDS{16};
+
+  // The digest is already uniform, so its leading bytes are as good a hash as
+  // any
+  struct DigestHash {
+    auto operator()(const Digest &value) const noexcept -> std::size_t {
+      std::size_t result{0};
+      std::memcpy(&result, value.data(), sizeof(result));
+      return result;
+    }
+  };
+
+  using EntryList = std::list<std::pair<Digest, Entry>>;
+
+  struct Shard {
+    std::mutex mutex;
+    EntryList entries;
+    std::unordered_map<Digest, EntryList::iterator, DigestHash> index;
+  };
+
+  auto shard(const Digest &key) noexcept -> Shard & {
+    return this->shards_[key.back() % SHARDS];
+  }
+
+  std::array<Shard, SHARDS> shards_;
+};
+
+} // namespace sourcemeta::one
+
+#endif
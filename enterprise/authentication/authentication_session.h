@@ -298,6 +298,20 @@ inline auto open_value(const std::string_view value, const SealPurpose purpose,
   return sourcemeta::core::base64url_decode(payload);
 }
 
+// When a sealed value stops being honoured, read without opening it. This is
+// only asked of values presented alongside one that opened, to bound how long
+// what they admitted may be remembered, so a forged expiry can only ever make
+// that shorter
+inline auto sealed_expiry(const std::string_view value)
+    -> std::optional<std::chrono::sys_seconds> {
+  const auto segments{sourcemeta::core::jose_compact_segments<5>(value)};
+  if (!segments.has_value()) {
+    return std::nullopt;
+  }
+
+  return parse_expiry(segments.value()[2]);
+}
+
 } // namespace sourcemeta::one
 
 #endif
@@ -10,6 +10,7 @@
 #include <sourcemeta/core/oauth.h>
 #include <sourcemeta/core/oidc.h>
 
+#include "authentication_cache.h"
 #include "authentication_claims.h"
 #include "authentication_format.h"
 #include "authentication_provider.h"
@@ -1300,6 +1301,10 @@ struct Authentication::Table::Impl {
                    std::unique_ptr<sourcemeta::core::OAuthMetadataProvider>>
       metadata_providers_;
   mutable std::map<std::string, ResolvedEndpoints> endpoints_;
+
+  // Held by the table rather than by whoever serves it, so that reloading the
+  // policies forgets every placement made under the ones before
+  mutable CredentialCache credentials_;
 };
 
 } // namespace sourcemeta::one
@@ -290,6 +290,54 @@ TEST(a_session_places_its_caller_in_the_policy_that_established_it) {
       sourcemeta::one::VIEW_PUBLIC);
 }
 
+// A placement is remembered by what was presented rather than by the value
+// that did the admitting, so the same bytes presented somewhere else, or a
+// credential presented again beside something it was not presented with
+// before, is read afresh rather than taken for what was remembered
+TEST(a_placement_is_remembered_for_exactly_what_was_presented) {
+  setenv(SESSION_SECRET_VARIABLE, "session-secret", 1);
+  setenv("ONE_TEST_REMEMBERED_SECRET", "confidential", 1);
+  setenv("ONE_TEST_REMEMBERED_KEY", "machine-secret", 1);
+  const std::array<std::string_view, 1> portal_paths{{"/portal"}};
+  const std::array<std::string_view, 1> machine_paths{{"/machine"}};
+  const std::array<std::string_view, 1> machine_keys{
+      {"ONE_TEST_REMEMBERED_KEY"}};
+  const std::array<sourcemeta::one::Authentication::Policy, 2> policies{
+      {{.paths = portal_paths,
+        .name = "okta",
+        .credential =
+            sourcemeta::one::Authentication::Policy::Interactive{
+                .issuer = "acme",
+                .client_id = "client",
+                .client_secret_variable = "ONE_TEST_REMEMBERED_SECRET",
+                .session_secrets = SESSION_SECRETS}},
+       {.paths = machine_paths,
+        .name = "machine",
+        .credential = sourcemeta::one::Authentication::Policy::ApiKey{
+            .keys = machine_keys}}}};
+  const sourcemeta::one::Authentication authentication{
+      TABLE(policies), STUB_FETCHER({}, nullptr)};
+  const auto sealed{SESSION_FOR("okta", SESSION_SECRETS, "jane@acme.test")};
+  const std::string cookies{"sourcemeta_one_session=" + sealed};
+
+  for (std::size_t attempt{0}; attempt < 2; attempt += 1) {
+    EXPECT_EQ(authentication.caller({.bearer = "machine-secret"}).view(),
+              "machine");
+    EXPECT_EQ(authentication.caller({.cookies = FIELDS(cookies)}).view(),
+              "okta");
+  }
+
+  EXPECT_EQ(authentication.caller({.cookies = FIELDS("machine-secret")}).view(),
+            sourcemeta::one::VIEW_PUBLIC);
+  EXPECT_EQ(
+      authentication
+          .caller({.bearer = "retired-secret", .cookies = FIELDS(cookies)})
+          .view(),
+      sourcemeta::one::VIEW_PUBLIC);
+  EXPECT_EQ(authentication.caller({.bearer = "machine-secret"}).view(),
+            "machine");
+}
+
 TEST(save_writes_the_largest_table_a_configuration_can_declare) {
   constexpr std::size_t groups{4};
   constexpr auto per_group{COMBINABLE_CEILING};
@@ -25,6 +25,12 @@ TEST(missing_artifact_denies_everything) {
                                       authentication.caller({.bearer = ""})));
   EXPECT_FALSE(
       authentication.permits(AT(""), authentication.caller({.bearer = ""})));
+  // Nor is anything read as open to everybody, which would let a response be
+  // stored and handed to whoever asks next
+  const auto reach{
+      authentication.reach(AT("/acme/foo"), authentication.caller({}))};
+  EXPECT_FALSE(reach.permitted);
+  EXPECT_FALSE(reach.everybody);
 }
 
 TEST(malformed_artifact_denies_everything) {
@@ -32,6 +32,34 @@ TEST(uncovered_paths_are_public_around_a_gated_scope) {
                                      authentication.caller({.bearer = ""})));
 }
 
+// What a caller reaches and what everybody reaches come from one walk, and
+// each is what asking it separately would have answered
+TEST(reach_answers_the_caller_and_everybody_together) {
+  setenv("ONE_TEST_KEY_REACH", "reach-secret", 1);
+  const std::array<std::string_view, 1> paths{{"/internal"}};
+  const std::array<std::string_view, 1> keys{{"ONE_TEST_KEY_REACH"}};
+  const std::array<sourcemeta::one::Authentication::Policy, 1> policies{
+      {{.paths = paths,
+        .name = "policy",
+        .credential =
+            sourcemeta::one::Authentication::Policy::ApiKey{.keys = keys}}}};
+  const sourcemeta::one::Authentication authentication{
+      TABLE(policies), STUB_FETCHER({}, nullptr)};
+  const auto anonymous{authentication.caller({})};
+  const auto holder{authentication.caller({.bearer = "reach-secret"})};
+
+  const auto governed_anonymous{
+      authentication.reach(AT("/internal/foo"), anonymous)};
+  EXPECT_FALSE(governed_anonymous.permitted);
+  EXPECT_FALSE(governed_anonymous.everybody);
+  const auto governed_holder{authentication.reach(AT("/internal/foo"), holder)};
+  EXPECT_TRUE(governed_holder.permitted);
+  EXPECT_FALSE(governed_holder.everybody);
+  const auto open_holder{authentication.reach(AT("/vendor/foo"), holder)};
+  EXPECT_TRUE(open_holder.permitted);
+  EXPECT_TRUE(open_holder.everybody);
+}
+
 TEST(scope_matches_whole_segments_only) {
   const std::array<std::string_view, 1> paths{{"/internal"}};
   const std::array<std::string_view, 1> keys{{"ONE_TEST_KEY_SEGMENT"}};
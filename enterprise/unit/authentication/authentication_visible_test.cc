@@ -46,6 +46,48 @@ TEST(the_recorded_table_names_every_view_it_serves) {
   EXPECT_TRUE(gate.visible(AT("/platform/x"), table.at(3)));
 }
 
+// Asking every view at once answers what asking each in turn does, which is
+// what lets a build read a leaf against the table once rather than per view
+TEST(visibility_answers_every_view_as_visible_does) {
+  const std::array<std::string_view, 1> platform_paths{{"/platform"}};
+  const std::array<std::string_view, 1> oncall_paths{{"/oncall"}};
+  const std::array<sourcemeta::core::JWSAlgorithm, 1> algorithms{
+      {sourcemeta::core::JWSAlgorithm::ES256}};
+  const std::array<sourcemeta::one::Authentication::Policy, 2> policies{
+      {{.paths = platform_paths,
+        .name = "platform",
+        .credential =
+            sourcemeta::one::Authentication::Policy::Token{
+                .issuer = "acme",
+                .audience = "client",
+                .jwks_uri = "https://idp.test/jwks",
+                .algorithms = algorithms}},
+       {.paths = oncall_paths,
+        .name = "oncall",
+        .credential = sourcemeta::one::Authentication::Policy::Token{
+            .issuer = "acme",
+            .audience = "client",
+            .jwks_uri = "https://idp.test/jwks",
+            .algorithms = algorithms}}}};
+  const auto gate{TABLE(policies)};
+  const auto table{gate.views()};
+  for (const auto location :
+       {"/", "/vendor/x", "/oncall", "/oncall/x", "/platform/x.json"}) {
+    const auto answers{gate.visibility(AT(location), table)};
+    EXPECT_EQ(answers.size(), table.size());
+    for (std::size_t view{0}; view < table.size(); view++) {
+      EXPECT_EQ(answers.at(view), gate.visible(AT(location), table.at(view)));
+    }
+  }
+
+  // A table that could not be read shows nothing to any view
+  const sourcemeta::one::Authentication::Table missing{
+      std::filesystem::path{"/no/such/authentication.bin"}};
+  for (const auto answer : missing.visibility(AT("/vendor/x"), table)) {
+    EXPECT_FALSE(answer);
+  }
+}
+
 TEST(a_view_shows_what_it_governs_and_whatever_nobody_governs) {
   const std::array<std::string_view, 1> platform_paths{{"/platform"}};
   const std::array<std::string_view, 1> oncall_paths{{"/oncall"}};
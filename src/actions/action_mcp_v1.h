@@ -392,6 +392,9 @@ private:
           sourcemeta::core::jsonrpc_request_id(request_json));
     }
 
+    // One per call, as a batch makes several under the same request
+    const sourcemeta::one::TraceSpan trace{"mcp", method};
+
     const auto *id{sourcemeta::core::jsonrpc_request_id(request_json)};
     if (id == nullptr) {
       return this->enterprise_required(nullptr);
@@ -0,0 +1,101 @@
+#ifndef SOURCEMETA_ONE_ACTIONS_METRICS_V1_H
+#define SOURCEMETA_ONE_ACTIONS_METRICS_V1_H
+
+#include <sourcemeta/core/json.h>
+#include <sourcemeta/core/jsonrpc.h>
+#include <sourcemeta/core/mcp.h>
+#include <sourcemeta/core/uritemplate.h>
+
+#include <sourcemeta/one/http.h>
+#include <sourcemeta/one/router.h>
+
+#include <filesystem>  // std::filesystem
+#include <format>      // std::format_to
+#include <iterator>    // std::back_inserter
+#include <span>        // std::span
+#include <string>      // std::string
+#include <string_view> // std::string_view
+
+class ActionMetrics_v1 : public sourcemeta::one::RouterAction {
+public:
+  static constexpr std::string_view DESCRIPTION{
+      "Report the server's metrics in the Prometheus text format"};
+  static constexpr bool READ_ONLY{true};
+  static constexpr bool DESTRUCTIVE{false};
+  static constexpr bool IDEMPOTENT{true};
+  static constexpr bool OPEN_WORLD{false};
+
+  ActionMetrics_v1(const std::filesystem::path &base,
+                   const sourcemeta::core::URITemplateRouterView &router,
+                   const sourcemeta::core::URITemplateRouter::Identifier
+                       identifier,
+                   sourcemeta::one::Router &dispatcher)
+      : sourcemeta::one::RouterAction{base, router.base_url(), dispatcher} {
+    router.arguments(
+        identifier, [this](const auto &key, const auto &value) -> void {
+          if (key == "errorSchema") {
+            this->error_schema_ = std::get<std::string_view>(value);
+          }
+        });
+  }
+
+  auto rest(const std::span<std::string_view>,
+            const sourcemeta::one::Authentication::Caller &,
+            sourcemeta::one::HTTPRequest &request,
+            sourcemeta::one::HTTPResponse &response) -> void override {
+    if (request.method() == "options") {
+      sourcemeta::one::cors_preflight(request, response, "GET, HEAD, OPTIONS",
+                                      "Accept, Accept-Encoding");
+      return;
+    }
+    if (request.method() != "get" && request.method() != "head") {
+      sourcemeta::one::json_error(
+          request, response, sourcemeta::core::HTTP_STATUS_METHOD_NOT_ALLOWED,
+          "urn:sourcemeta:one:method-not-allowed",
+          "This HTTP method is invalid for this URL", this->error_schema_, "*",
+          "GET, HEAD, OPTIONS");
+      return;
+    }
+
+    // Summed from what every worker counted on its own, so that a scrape never
+    // holds up a request, at the price of each series being read at a slightly
+    // different moment
+    std::string output;
+    sourcemeta::one::HTTPMetrics::expose(output);
+    // Since the server started, as every reload carries the counts over
+    const auto templates{this->dispatcher().template_cache_statistics()};
+    std::format_to(
+        std::back_inserter(output),
+        "# HELP sourcemeta_one_template_cache_total Lookups of compiled "
+        "schema templates, by outcome, and templates evicted to make room\n"
+        "# TYPE sourcemeta_one_template_cache_total counter\n"
+        "sourcemeta_one_template_cache_total{{outcome=\"hit\"}} {}\n"
+        "sourcemeta_one_template_cache_total{{outcome=\"miss\"}} {}\n"
+        "sourcemeta_one_template_cache_total{{outcome=\"eviction\"}} {}\n",
+        templates.hits, templates.misses, templates.evictions);
+
+    response.write_status(sourcemeta::core::HTTP_STATUS_OK);
+    response.write_header("Content-Type",
+                          "text/plain; version=0.0.4; charset=utf-8");
+    response.write_header("Access-Control-Allow-Origin", "*");
+    response.write_header("Access-Control-Expose-Headers", "Link, ETag");
+    // Like the health probe, a scrape has to observe the live state
+    response.write_header("Cache-Control",
+                          sourcemeta::one::cache_control_no_store());
+    sourcemeta::one::send_response(sourcemeta::core::HTTP_STATUS_OK, request,
+                                   response, output,
+                                   sourcemeta::one::Encoding::Identity);
+  }
+
+  auto mcp(const sourcemeta::core::MCPProtocolVersion,
+           const sourcemeta::core::JSON &id, const sourcemeta::core::JSON &,
+           const sourcemeta::one::Authentication::Caller &)
+      -> sourcemeta::core::JSON override {
+    return sourcemeta::core::jsonrpc_make_error_method_not_found(id);
+  }
+
+private:
+  std::string_view error_schema_;
+};
+
+#endif
@@ -2,21 +2,29 @@
 #define SOURCEMETA_ONE_ACTIONS_SCHEMA_SEARCH_V1_H
 
 #include <sourcemeta/blaze/evaluator.h>
+#include <sourcemeta/core/crypto.h>
+#include <sourcemeta/core/gzip.h>
 #include <sourcemeta/core/json.h>
 #include <sourcemeta/core/jsonrpc.h>
 #include <sourcemeta/core/mcp.h>
 #include <sourcemeta/core/numeric.h>
+#include <sourcemeta/core/text.h>
 #include <sourcemeta/core/uritemplate.h>
 
 #include <sourcemeta/one/http.h>
 #include <sourcemeta/one/router.h>
 #include <sourcemeta/one/search.h>
 
+#include <sys/stat.h> // ::stat
+
+#include <atomic>        // std::atomic
 #include <charconv>      // std::from_chars
 #include <cstddef>       // std::size_t
-#include <cstdint>       // std::uint8_t
+#include <cstdint>       // std::int64_t, std::uint8_t, std::uint64_t
 #include <filesystem>    // std::filesystem
-#include <memory>        // std::make_unique, std::unique_ptr
+#include <format>        // std::format
+#include <memory>        // std::make_shared, std::make_unique, std::unique_ptr
+#include <mutex>         // std::once_flag, std::call_once
 #include <span>          // std::span
 #include <sstream>       // std::ostringstream
 #include <string>        // std::string
@@ -44,8 +52,8 @@ public:
     for (const auto &recorded : authentication.table().views()) {
       this->search_views_.emplace(
           recorded.name(),
-          std::make_unique<sourcemeta::one::SearchView>(
-              base / "explorer" / recorded.name() / "%" / "search.metapack"));
+          std::make_unique<IndexedView>(base / "explorer" / recorded.name() /
+                                        "%" / "search.metapack"));
     }
 
     // The anonymous view is among the recorded ones, so this is a lookup
@@ -56,7 +64,7 @@ public:
       fallback =
           this->search_views_
               .emplace(sourcemeta::one::VIEW_PUBLIC,
-                       std::make_unique<sourcemeta::one::SearchView>(
+                       std::make_unique<IndexedView>(
                            base / "explorer" / sourcemeta::one::VIEW_PUBLIC /
                            "%" / "search.metapack"))
               .first;
@@ -202,33 +210,78 @@ public:
       }
     }
 
-    auto result{
-        this->search_view_for(caller.view()).search(query, limit, scope)};
-    response.write_status(sourcemeta::core::HTTP_STATUS_OK);
-    response.write_header("Access-Control-Allow-Origin", "*");
-    response.write_header("Access-Control-Expose-Headers", "Link, ETag");
-    response.write_header("Content-Type", "application/json");
+    // Matching ignores case, so searches that only differ by it are the same
+    // search and share one answer
+    std::string key{std::format("{}:{}:", scope, limit)};
+    key.append(query);
+    sourcemeta::core::to_lowercase(key);
+    const auto indexed{this->search_view_for(caller.view()).current()};
+    auto answer{indexed->answers.try_get(key)};
+    if (answer) {
+      request.annotate_cached();
+    } else {
+      answer = indexed->answers.insert(
+          key, std::make_shared<const CachedSearch>(
+                   indexed->index.search(query, limit, scope)));
+    }
+
     // Search results are query-dependent and the corpus shifts as
     // the catalog grows; 60 seconds is a freshness window that
     // amortises full-text cost across typing-into-a-search-box
     // bursts without serving stale ranking long-term. What comes back
     // is whatever the caller's view holds, so only the anonymous one
     // answers the same to everybody and may enter a shared cache
-    response.write_header("Cache-Control",
-                          sourcemeta::one::cache_control_search(
-                              caller.view() == sourcemeta::one::VIEW_PUBLIC));
+    const auto cache_control{sourcemeta::one::cache_control_search(
+        caller.view() == sourcemeta::one::VIEW_PUBLIC)};
+    const auto &etag{request.response_encoding() ==
+                             sourcemeta::one::Encoding::GZIP
+                         ? answer->etag_weak
+                         : answer->etag_strong};
+
+    // RFC 9110 §13.1.2: once the freshness window lapses, a client or a shared
+    // cache asks again with the validator it holds, and an unchanged answer
+    // costs it nothing more than the headers. RFC 9110 §15.4.5 asks for the
+    // same Cache-Control, ETag and Vary the 200 would have carried
+    // https://datatracker.ietf.org/doc/html/rfc9110#section-13.1.2
+    if (request.header_exists("if-none-match") &&
+        sourcemeta::core::http_field_list_contains_any(
+            request.header("if-none-match"),
+            {"*", answer->etag_strong, answer->etag_weak})) {
+      response.write_status(sourcemeta::core::HTTP_STATUS_NOT_MODIFIED);
+      response.write_header("Access-Control-Allow-Origin", "*");
+      response.write_header("Access-Control-Expose-Headers", "Link, ETag");
+      response.write_header("Cache-Control", cache_control);
+      response.write_header("Vary",
+                            sourcemeta::one::vary_caller_and_encoding());
+      response.write_header("ETag", etag);
+      request.annotate_cached();
+      sourcemeta::one::send_response(sourcemeta::core::HTTP_STATUS_NOT_MODIFIED,
+                                     request, response);
+      return;
+    }
+
+    response.write_status(sourcemeta::core::HTTP_STATUS_OK);
+    response.write_header("Access-Control-Allow-Origin", "*");
+    response.write_header("Access-Control-Expose-Headers", "Link, ETag");
+    response.write_header("Content-Type", "application/json");
+    response.write_header("Cache-Control", cache_control);
     // RFC 9110 §12.5.5: the gzip negotiation axis applies, and so does whatever
     // places a caller in a view, since one URL answers differently per view.
     // Every other content surface revalidates on each hit, which re-resolves
     // the view at the origin. This one may be stored without revalidating, so
     // the axes that select the representation have to be named here instead
     response.write_header("Vary", sourcemeta::one::vary_caller_and_encoding());
+    response.write_header("ETag", etag);
     sourcemeta::one::write_link_header(response, this->response_schema_);
-    std::ostringstream output;
-    sourcemeta::core::prettify(result, output);
-    sourcemeta::one::send_response(sourcemeta::core::HTTP_STATUS_OK, request,
-                                   response, output.str(),
-                                   sourcemeta::one::Encoding::Identity);
+    if (request.response_encoding() == sourcemeta::one::Encoding::GZIP) {
+      sourcemeta::one::send_response(sourcemeta::core::HTTP_STATUS_OK, request,
+                                     response, answer->gzip(),
+                                     sourcemeta::one::Encoding::GZIP);
+    } else {
+      sourcemeta::one::send_response(sourcemeta::core::HTTP_STATUS_OK, request,
+                                     response, answer->identity,
+                                     sourcemeta::one::Encoding::Identity);
+    }
   }
 
   auto mcp(const sourcemeta::core::MCPProtocolVersion version,
@@ -306,8 +359,10 @@ public:
       }
     }
 
-    auto results{this->search_view_for(caller.view())
-                     .search(arguments.at("q").to_string(), limit, scope)};
+    auto results{
+        this->search_view_for(caller.view())
+            .current()
+            ->index.search(arguments.at("q").to_string(), limit, scope)};
     auto envelope{sourcemeta::core::JSON::make_object()};
     envelope.assign_assume_new("results", std::move(results));
 
@@ -331,19 +386,137 @@ public:
   }
 
 private:
+  // A search answer as it goes out, so that asking the same again neither
+  // walks the index nor serialises anything. It is only compressed once a
+  // caller first asks for it compressed, as many answers are never asked twice
+  class CachedSearch {
+  public:
+    explicit CachedSearch(const sourcemeta::core::JSON &result) {
+      std::ostringstream output;
+      sourcemeta::core::prettify(result, output);
+      this->identity = std::move(output).str();
+      const auto checksum{sourcemeta::core::sha256(this->identity)};
+      this->etag_strong = std::format("\"{}\"", checksum);
+      this->etag_weak = std::format("W/\"{}\"", checksum);
+    }
+
+    // To avoid mistakes
+    CachedSearch(const CachedSearch &) = delete;
+    CachedSearch(CachedSearch &&) = delete;
+    auto operator=(const CachedSearch &) -> CachedSearch & = delete;
+    auto operator=(CachedSearch &&) -> CachedSearch & = delete;
+
+    [[nodiscard]] auto gzip() const -> const std::string & {
+      std::call_once(this->compressed_once_, [this]() -> void {
+        const sourcemeta::one::HTTPTimingScope scope{
+            sourcemeta::one::HTTPTiming::Stage::Compression};
+        this->compressed_ = sourcemeta::core::gzip(
+            // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+            reinterpret_cast<const std::uint8_t *>(this->identity.data()),
+            this->identity.size());
+      });
+
+      return this->compressed_;
+    }
+
+    std::string identity;
+    // Over the identity bytes, like the checksum of every other artifact, so
+    // it is only strong where those are the bytes sent (RFC 9110 §8.8.1), and
+    // an index rebuilt with the same matches still answers 304
+    std::string etag_strong;
+    std::string etag_weak;
+
+  private:
+    mutable std::once_flag compressed_once_;
+    mutable std::string compressed_;
+  };
+
+  // Which file an index was read from, down to when it was last written, so
+  // that one rewritten in place or replaced under the same name reads as
+  // another index
+  struct IndexIdentity {
+    std::uint64_t device;
+    std::uint64_t inode;
+    std::uint64_t size;
+    std::int64_t modified_seconds;
+    std::int64_t modified_nanoseconds;
+    auto operator==(const IndexIdentity &) const -> bool = default;
+
+    static auto of(const std::filesystem::path &path) -> IndexIdentity {
+      struct stat status{};
+      if (::stat(path.c_str(), &status) != 0) {
+        return {};
+      }
+
+#if defined(__APPLE__)
+      const auto &modified{status.st_mtimespec};
+#else
+      const auto &modified{status.st_mtim};
+#endif
+      return {.device = static_cast<std::uint64_t>(status.st_dev),
+              .inode = static_cast<std::uint64_t>(status.st_ino),
+              .size = static_cast<std::uint64_t>(status.st_size),
+              .modified_seconds = static_cast<std::int64_t>(modified.tv_sec),
+              .modified_nanoseconds =
+                  static_cast<std::int64_t>(modified.tv_nsec)};
+    }
+  };
+
+  // The answers to the searches asked most recently of an index are kept
+  // beside it, so they go whenever the index they came out of does. Typing
+  // into a search box asks a handful of prefixes over and over, so a few
+  // suffice per view
+  static constexpr std::size_t ANSWERS_PER_VIEW{64};
+  struct SearchIndex {
+    SearchIndex(const std::filesystem::path &path, const IndexIdentity &read)
+        : identity{read}, index{path} {}
+    const IndexIdentity identity;
+    sourcemeta::one::SearchView index;
+    sourcemeta::one::RouterLRU<std::string, CachedSearch> answers{
+        ANSWERS_PER_VIEW};
+  };
+
+  // The index of a view is read again, and whatever was answered out of it
+  // dropped, whenever the file it was read from is no longer the one there.
+  // Costs a stat per search, which is nothing next to walking the index
+  struct IndexedView {
+    explicit IndexedView(std::filesystem::path index_path)
+        : path{std::move(index_path)} {}
+
+    [[nodiscard]] auto current() -> std::shared_ptr<SearchIndex> {
+      const auto identity{IndexIdentity::of(this->path)};
+      auto held{this->loaded.load(std::memory_order_acquire)};
+      if (held != nullptr && held->identity == identity) {
+        return held;
+      }
+
+      // Whichever worker notices first reads it, and a worker that lost that
+      // race answers out of what the winner read
+      auto next{std::make_shared<SearchIndex>(this->path, identity)};
+      if (this->loaded.compare_exchange_strong(held, next,
+                                               std::memory_order_acq_rel)) {
+        return next;
+      }
+
+      return held;
+    }
+
+    const std::filesystem::path path;
+    std::atomic<std::shared_ptr<SearchIndex>> loaded;
+  };
+
   // A caller is answered out of the index their view holds, so what a search
   // can name is what the caller could have reached by looking
   [[nodiscard]] auto search_view_for(const std::string_view view)
-      -> sourcemeta::one::SearchView & {
+      -> IndexedView & {
     const auto match{this->search_views_.find(view)};
     return match == this->search_views_.cend() ? *this->default_search_view_
                                                : *match->second;
   }
 
-  std::unordered_map<std::string_view,
-                     std::unique_ptr<sourcemeta::one::SearchView>>
+  std::unordered_map<std::string_view, std::unique_ptr<IndexedView>>
       search_views_;
-  sourcemeta::one::SearchView *default_search_view_{nullptr};
+  IndexedView *default_search_view_{nullptr};
   std::string_view response_schema_;
   std::string_view rpc_request_schema_;
   std::string_view rpc_response_schema_;
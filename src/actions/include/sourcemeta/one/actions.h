@@ -34,7 +34,8 @@ namespace sourcemeta::one {
   X(AUTH_LOGIN_V1, ActionAuthLogin_v1)                                         \
   X(AUTH_LOGIN_PAGE_V1, ActionAuthLoginPage_v1)                                \
   X(AUTH_CALLBACK_V1, ActionAuthCallback_v1)                                   \
-  X(MCP_PROTECTED_RESOURCE_METADATA_V1, ActionMCPProtectedResourceMetadata_v1)
+  X(MCP_PROTECTED_RESOURCE_METADATA_V1, ActionMCPProtectedResourceMetadata_v1) \
+  X(METRICS_V1, ActionMetrics_v1)
 
 #define SOURCEMETA_ONE_DEFINE_ACTION_TYPE(Name, Class) ACTION_TYPE_##Name,
 
@@ -46,7 +46,9 @@ auto Authentication::Table::compile(
 auto Authentication::Table::write(const std::span<const std::byte> bytes,
                                   const std::filesystem::path &destination)
     -> void {
-  sourcemeta::core::write_file(destination, bytes);
+  // Replaced as a whole like every other artifact, as a published generation
+  // may well share this very file with the output
+  sourcemeta::core::atomic_write_file(destination, bytes);
 }
 
 Authentication::Table::Table(const std::filesystem::path &) {}
@@ -116,6 +118,12 @@ auto Authentication::permits(const Authentication::Path &,
   return true;
 }
 
+auto Authentication::reach(const Authentication::Path &,
+                           const Authentication::Caller &) const
+    -> Authentication::Reach {
+  return {.permitted = true, .everybody = true};
+}
+
 auto Authentication::permits(const RouteTarget &,
                              const Authentication::Caller &,
                              const std::string_view) const -> bool {
@@ -142,6 +150,13 @@ auto Authentication::Table::visible(const Authentication::Path &,
   return true;
 }
 
+auto Authentication::Table::visibility(
+    const Authentication::Path &,
+    const std::span<const Authentication::RecordedView> views) const
+    -> std::vector<bool> {
+  return std::vector<bool>(views.size(), true);
+}
+
 auto Authentication::Table::governing(const Authentication::Path &) const
     -> std::optional<std::vector<std::string_view>> {
   return std::vector<std::string_view>{};
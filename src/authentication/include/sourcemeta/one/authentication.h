@@ -344,6 +344,14 @@ public:
     [[nodiscard]] auto visible(const Path &path, const RecordedView &view) const
         -> bool;
 
+    /// Which of a set of views show a path, in the order they were given. The
+    /// table is walked once for the path rather than once per view, so asking
+    /// this of every view a build writes costs what asking one view did, and
+    /// each answer is the one `visible` would give.
+    [[nodiscard]] auto visibility(const Path &path,
+                                  const std::span<const RecordedView> views)
+        const -> std::vector<bool>;
+
     /// The names of the policies that govern a path, in the order they were
     /// declared. A name is what a configuration and the artifact built from it
     /// agree on, so a caller holding the configuration can find what it
@@ -454,6 +462,21 @@ public:
   [[nodiscard]] auto permits(const Path &path, const Caller &caller) const
       -> bool;
 
+  /// What the gate says of a path, for one caller and for everybody.
+  struct Reach {
+    // Whether the caller is shown the path, which is what `permits` answers
+    bool permitted{false};
+    // Whether a caller presenting nothing would be, which is what decides
+    // whether an answer may be stored for whoever asks next
+    bool everybody{false};
+  };
+
+  /// Both answers from one walk of the table, for a surface that needs both
+  /// about the same path, where asking each separately walks it twice and
+  /// places an anonymous caller in between.
+  [[nodiscard]] auto reach(const Path &path, const Caller &caller) const
+      -> Reach;
+
   /// The same question asked of an explicit route, which the router matched on
   /// the request target literally rather than on the location that target
   /// resolves to. The spelling is taken as matched, so a target reaching past a
@@ -0,0 +1,114 @@
+#include <sourcemeta/one/build_cache.h>
+
+#include <cassert>      // assert
+#include <fstream>      // std::ofstream
+#include <ios>          // std::ios, std::streamsize
+#include <memory>       // std::make_unique
+#include <optional>     // std::optional, std::nullopt
+#include <string>       // std::string
+#include <string_view>  // std::string_view
+#include <system_error> // std::error_code
+
+namespace {
+
+// Place a file at a new name without copying it where the filesystem allows,
+// which is what makes taking an artifact over cheaper than building it. A
+// cache on another filesystem, like a mounted one, is the case that cannot
+auto link_or_copy(const std::filesystem::path &source,
+                  const std::filesystem::path &destination) -> void {
+  std::error_code error;
+  std::filesystem::create_hard_link(source, destination, error);
+  if (error) {
+    std::filesystem::copy_file(source, destination,
+                               std::filesystem::copy_options::overwrite_existing);
+  }
+}
+
+} // namespace
+
+namespace sourcemeta::one {
+
+BuildCacheDirectory::BuildCacheDirectory(const std::filesystem::path &path)
+    : root{path} {
+  std::filesystem::create_directories(this->root);
+  this->staging = std::make_unique<sourcemeta::core::TemporaryDirectory>(
+      this->root, ".staging-");
+}
+
+// Spread across directories by the first characters of the key, so that no
+// single directory ends up holding every entry a registry ever produced
+auto BuildCacheDirectory::locate(const std::string_view directory,
+                                 const std::string_view key) const
+    -> std::filesystem::path {
+  assert(key.size() > 2);
+  assert(!key.contains('/'));
+  return this->root / directory / key.substr(0, 2) / key.substr(2);
+}
+
+auto BuildCacheDirectory::fetch(const std::string_view key,
+                                const std::filesystem::path &destination)
+    -> bool {
+  const auto source{this->locate("objects", key)};
+  if (!std::filesystem::is_regular_file(source)) {
+    return false;
+  }
+
+  // Beside the destination rather than in the staging area, as the cache may
+  // well live on another filesystem than the output does
+  std::filesystem::create_directories(destination.parent_path());
+  auto incoming{destination};
+  incoming += ".cached";
+  std::filesystem::remove(incoming);
+  link_or_copy(source, incoming);
+  std::filesystem::rename(incoming, destination);
+  return true;
+}
+
+auto BuildCacheDirectory::store(const std::string_view key,
+                                const std::filesystem::path &source) -> void {
+  const auto destination{this->locate("objects", key)};
+  // The same key names the same contents, so whoever stored it first is as
+  // good as anybody storing it again
+  if (std::filesystem::exists(destination)) {
+    return;
+  }
+
+  // Copied rather than linked, as the artifact just built stays in the output
+  // of a build that will go on to produce it again. Were the two one file,
+  // anything writing over that artifact rather than replacing it would also
+  // change what the key names, and with it every output that ever took the
+  // entry over. What is fetched can be linked, since every artifact write
+  // replaces its file, so nothing is ever written through a fetched link
+  const auto incoming{this->staging->path() / key};
+  std::filesystem::remove(incoming);
+  std::filesystem::copy_file(source, incoming);
+  std::filesystem::create_directories(destination.parent_path());
+  std::filesystem::rename(incoming, destination);
+}
+
+auto BuildCacheDirectory::read(const std::string_view key)
+    -> std::optional<std::string> {
+  const auto path{this->locate("records", key)};
+  if (!std::filesystem::is_regular_file(path)) {
+    return std::nullopt;
+  }
+
+  return sourcemeta::core::read_file_to_string(path);
+}
+
+auto BuildCacheDirectory::write(const std::string_view key,
+                                const std::string_view contents) -> void {
+  const auto destination{this->locate("records", key)};
+  auto incoming{this->staging->path() / key};
+  incoming += ".record";
+  {
+    std::ofstream stream{incoming, std::ios::binary | std::ios::trunc};
+    stream.write(contents.data(), static_cast<std::streamsize>(contents.size()));
+    stream.flush();
+  }
+
+  std::filesystem::create_directories(destination.parent_path());
+  std::filesystem::rename(incoming, destination);
+}
+
+} // namespace sourcemeta::one
@@ -1,9 +1,12 @@
 #include <sourcemeta/one/build.h>
 
-#include <algorithm>     // std::ranges::sort, std::ranges::all_of
+#include <sourcemeta/core/parallel.h>
+
+#include <algorithm>     // std::ranges::sort, std::clamp, std::max, etc.
 #include <cassert>       // assert
-#include <cstdint>       // std::size_t
+#include <cstdint>       // std::size_t, std::int64_t, std::uint64_t
 #include <filesystem>    // std::filesystem::path, std::filesystem::exists
+#include <optional>      // std::optional
 #include <span>          // std::span
 #include <string>        // std::string
 #include <string_view>   // std::string_view
@@ -345,6 +348,40 @@ static auto collect_affected_directories(
   return result;
 }
 
+// A finaliser in the style of SplitMix64. The fingerprint of a leaf is not
+// spread well enough over its bits to be summed as it comes, and summing is
+// what keeps the order of the leaves out of the digest of the set
+static constexpr auto mix_digest(std::uint64_t value) -> std::uint64_t {
+  value += 0x9e3779b97f4a7c15ULL;
+  value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  value = (value ^ (value >> 27)) * 0x94d049bb133111ebULL;
+  return value ^ (value >> 31);
+}
+
+auto leaf_set_digest(const LeafSet &leaves, const BuildPlan::Type build_type)
+    -> std::uint64_t {
+  std::uint64_t result{0};
+  std::string buffer;
+  for (const auto &[uri, info] : leaves) {
+    buffer.clear();
+    buffer += uri;
+    buffer += '\0';
+    buffer += info.relative_path->native();
+    buffer += '\0';
+    buffer += info.path->native();
+    buffer += '\0';
+    const auto mtime{
+        static_cast<std::int64_t>(info.mtime.time_since_epoch().count())};
+    buffer.append(reinterpret_cast<const char *>(&mtime), sizeof(mtime));
+    buffer += info.evaluate ? '\1' : '\0';
+    result += mix_digest(BuildState::fingerprint(buffer));
+  }
+
+  result = mix_digest(result ^ mix_digest(leaves.size() ^
+                                           (std::uint64_t{build_type} << 56)));
+  return result == 0 ? 1 : result;
+}
+
 auto delta_engine(const BuildPhase phase, const BuildPlan::Type build_type,
                   const BuildState &entries,
                   const std::filesystem::path &output, const LeafSet &leaves,
@@ -359,7 +396,8 @@ auto delta_engine(const BuildPhase phase, const BuildPlan::Type build_type,
                   const ViewFilter &visible, const std::string_view sentinel,
                   const BuildPlan::Action::Type remove_action,
                   const BuildPlan::Type full_mode,
-                  const DeltaRuleIndices &indices) -> BuildPlan {
+                  const DeltaRuleIndices &indices,
+                  const std::size_t concurrency) -> BuildPlan {
   assert(output.is_absolute());
   assert(std::ranges::all_of(leaves, [](const auto &entry) -> bool {
     return entry.second.path->is_absolute() &&
@@ -385,55 +423,79 @@ auto delta_engine(const BuildPhase phase, const BuildPlan::Type build_type,
   const std::string dependencies_suffix{
       sentinel_separator + leaf_rules[indices.dependencies].filename};
 
+  // A state that recorded these very leaves once it had built them, from the
+  // same inputs, already answers for every one of them, so proving that again
+  // one leaf at a time is work a rebuild with nothing to do can skip. Digesting
+  // the set is a pass over memory, while proving each leaf is a lookup into a
+  // state that might be mostly on disk
+  const auto leaves_recorded{incremental && entries.built_from_these_inputs() &&
+                             entries.recorded_leaves() ==
+                                 leaf_set_digest(leaves, build_type)};
+
   if (phase == BuildPhase::Combine) {
     const auto &output_string{output.native()};
     const auto primary_prefix{output_string + "/" +
                               std::string{primary_directory} + "/"};
 
-    auto extract_cross_leaf_references{[&primary_prefix, &sentinel_separator](
-                                           const BuildState::Entry *state_entry,
-                                           std::string_view owner_base)
-                                           -> std::unordered_set<std::string> {
-      std::unordered_set<std::string> result;
-      if (state_entry == nullptr) {
-        return result;
-      }
-
-      for (const auto &dependency : state_entry->dependencies) {
-        const auto &dependency_path{dependency.native()};
-        if (!dependency_path.starts_with(primary_prefix)) {
-          continue;
-        }
+    const auto owner_start{primary_prefix.size()};
 
-        const auto sentinel_position{dependency_path.find(sentinel_separator)};
-        if (sentinel_position == std::string::npos) {
-          continue;
-        }
+    // Many entries depend on the same artifacts, and a path is numbered the
+    // same wherever it appears, so which leaf it belongs to is worked out once
+    // per path rather than once per dependency. Empty for a path that is not
+    // an artifact of any leaf
+    std::vector<std::optional<std::string_view>> referenced_leaves;
+    auto referenced_leaf{[&](const BuildState::PathId identifier)
+                             -> std::string_view {
+      if (identifier >= referenced_leaves.size()) {
+        referenced_leaves.resize(identifier + 1);
+      }
+
+      auto &cached{referenced_leaves[identifier]};
+      if (!cached.has_value()) {
+        const auto dependency_path{entries.path(identifier)};
+        const auto sentinel_position{
+            dependency_path.starts_with(primary_prefix)
+                ? dependency_path.find(sentinel_separator, owner_start)
+                : std::string_view::npos};
+        cached = sentinel_position == std::string_view::npos
+                     ? std::string_view{}
+                     : dependency_path.substr(owner_start,
+                                              sentinel_position - owner_start);
+      }
+
+      return cached.value();
+    }};
 
-        const auto relative{dependency_path.substr(
-            primary_prefix.size(), sentinel_position - primary_prefix.size())};
-        if (relative != owner_base) {
-          result.insert(std::string{relative});
-        }
-      }
+    auto extract_cross_leaf_references{
+        [&referenced_leaf](
+            const std::optional<std::vector<BuildState::PathId>> &identifiers,
+            std::string_view owner_base)
+            -> std::unordered_set<std::string_view> {
+          std::unordered_set<std::string_view> result;
+          if (!identifiers.has_value()) {
+            return result;
+          }
 
-      return result;
-    }};
+          for (const auto identifier : identifiers.value()) {
+            const auto relative{referenced_leaf(identifier)};
+            if (!relative.empty() && relative != owner_base) {
+              result.insert(relative);
+            }
+          }
 
-    const auto owner_start{primary_prefix.size()};
+          return result;
+        }};
 
-    std::unordered_set<std::string> affected_leaves;
-    for (const auto key : entries.keys()) {
+    std::unordered_set<std::string, BuildState::TransparentHash,
+                       BuildState::TransparentEqual>
+        affected_leaves;
+    for (const auto key : entries.committed_keys()) {
       if (!key.ends_with(dependencies_suffix)) {
         continue;
       }
 
-      if (!entries.in_overlay(std::string{key})) {
-        continue;
-      }
-
-      const auto *new_entry{entries.entry(key)};
-      const auto *old_entry{entries.disk_entry(key)};
+      const auto new_entry{entries.dependency_ids(key)};
+      const auto old_entry{entries.disk_dependency_ids(key)};
 
       const auto owner_sentinel{key.find(sentinel_separator, owner_start)};
       if (owner_sentinel == std::string_view::npos) {
@@ -447,19 +509,19 @@ auto delta_engine(const BuildPhase phase, const BuildPlan::Type build_type,
       const auto new_references{
           extract_cross_leaf_references(new_entry, owner_base)};
 
-      for (const auto &reference : new_references) {
+      for (const auto reference : new_references) {
         if (!old_references.contains(reference)) {
-          affected_leaves.insert(reference);
+          affected_leaves.emplace(reference);
         }
       }
 
-      for (const auto &reference : old_references) {
+      for (const auto reference : old_references) {
         if (!new_references.contains(reference)) {
-          affected_leaves.insert(reference);
+          affected_leaves.emplace(reference);
         }
       }
 
-      if (old_entry == nullptr) {
+      if (!old_entry.has_value()) {
         affected_leaves.insert(std::string{owner_base});
       }
     }
@@ -473,8 +535,8 @@ auto delta_engine(const BuildPhase phase, const BuildPlan::Type build_type,
         continue;
       }
 
-      const auto *old_entry{entries.raw_disk_entry(deleted_key)};
-      if (old_entry == nullptr) {
+      const auto old_entry{entries.raw_disk_dependency_ids(deleted_key)};
+      if (!old_entry.has_value()) {
         continue;
       }
 
@@ -486,9 +548,9 @@ auto delta_engine(const BuildPhase phase, const BuildPlan::Type build_type,
 
       const auto owner_base{
           deleted_key.substr(owner_start, owner_sentinel - owner_start)};
-      for (const auto &reference :
+      for (const auto reference :
            extract_cross_leaf_references(old_entry, owner_base)) {
-        affected_leaves.insert(reference);
+        affected_leaves.emplace(reference);
       }
     }
 
@@ -503,7 +565,7 @@ auto delta_engine(const BuildPhase phase, const BuildPlan::Type build_type,
       // widens, since a leaf it could not reach before arrives with no
       // artifact behind it either
       const auto &missing_rule{leaf_rules[indices.dependents]};
-      if (missing_rule.base != 0) {
+      if (missing_rule.base != 0 && !leaves_recorded) {
         for (const auto &[uri, info] : leaves) {
           const auto &relative_string{info.relative_path->native()};
           if (affected_leaves.contains(relative_string)) {
@@ -533,27 +595,15 @@ auto delta_engine(const BuildPhase phase, const BuildPlan::Type build_type,
           continue;
         }
 
-        const auto *dependency_entry{entries.entry(dependency_key)};
-        if (dependency_entry == nullptr) {
+        const auto identifiers{entries.dependency_ids(dependency_key)};
+        if (!identifiers.has_value()) {
           continue;
         }
 
-        for (const auto &dependency : dependency_entry->dependencies) {
-          const auto &dependency_path{dependency.native()};
-          if (!dependency_path.starts_with(primary_prefix)) {
-            continue;
-          }
-
-          const auto sentinel_position{
-              dependency_path.find(sentinel_separator, owner_start)};
-          if (sentinel_position == std::string::npos) {
-            continue;
-          }
-
-          auto referenced_leaf{dependency_path.substr(
-              owner_start, sentinel_position - owner_start)};
-          if (affected_leaves.contains(referenced_leaf)) {
-            reverse_dependency_index[std::move(referenced_leaf)].emplace_back(
+        for (const auto identifier : identifiers.value()) {
+          const auto relative{referenced_leaf(identifier)};
+          if (!relative.empty() && affected_leaves.contains(relative)) {
+            reverse_dependency_index[std::string{relative}].emplace_back(
                 dependency_key);
           }
         }
@@ -715,7 +765,7 @@ auto delta_engine(const BuildPhase phase, const BuildPlan::Type build_type,
     std::vector<std::string> current_bases;
     current_bases.reserve(leaves.size());
 
-    if (!fast_path_dirty) {
+    if (!fast_path_dirty && !leaves_recorded) {
       for (const auto &[uri, info] : leaves) {
         const auto &relative_string{info.relative_path->native()};
 
@@ -765,7 +815,7 @@ auto delta_engine(const BuildPhase phase, const BuildPlan::Type build_type,
       }
     }
 
-    if (!fast_path_dirty) {
+    if (!fast_path_dirty && !leaves_recorded) {
       std::unordered_set<std::string_view> base_set;
       base_set.reserve(current_bases.size());
       for (const auto &base : current_bases) {
@@ -861,15 +911,40 @@ auto delta_engine(const BuildPhase phase, const BuildPlan::Type build_type,
     std::string root_path;
   };
 
-  std::vector<ActiveLeaf> active_leaves;
-  active_leaves.reserve(leaves.size());
-  std::vector<std::filesystem::path> all_relative_paths;
-  all_relative_paths.reserve(leaves.size());
+  // Each leaf is planned on its own, so the leaves are split into contiguous
+  // runs planned side by side and stitched back together in order, which
+  // leaves the result exactly what planning them one after another would be.
+  // Only worth the threads past a few hundred leaves a run
+  struct LeafRun {
+    std::size_t begin;
+    std::size_t end;
+    std::vector<ActiveLeaf> active_leaves;
+    TargetMap targets;
+    std::vector<std::string> dirty_relative_paths;
+    std::vector<std::pair<std::string_view, BuildPlan::Reason>> reasons;
+  };
 
-  std::unordered_set<std::string> dirty_relative_paths;
-  for (const auto &[uri, info] : leaves) {
+  constexpr std::size_t MINIMUM_LEAVES_PER_RUN{256};
+  const auto run_count{std::clamp(leaves.size() / MINIMUM_LEAVES_PER_RUN,
+                                  std::size_t{1},
+                                  std::max(concurrency, std::size_t{1}))};
+  std::vector<LeafRun> runs(run_count);
+  for (std::size_t run{0}; run < run_count; run++) {
+    runs[run].begin = leaves.size() * run / run_count;
+    runs[run].end = leaves.size() * (run + 1) / run_count;
+  }
+
+  // The state indexes its leaves the first time it is asked about one, which
+  // has to happen before anything asks from more than one thread
+  if (!is_full && !leaves.empty()) {
+    static_cast<void>(entries.leaf_state(
+        output_string, leaves.front().second.relative_path->native(),
+        leaves.front().second.evaluate, build_type == full_mode));
+  }
+
+  auto plan_leaf{[&](const std::string_view uri, const LeafView &info,
+                     LeafRun &into) -> void {
     const auto &relative_string{info.relative_path->native()};
-    all_relative_paths.emplace_back(*info.relative_path);
 
     auto primary_base{make_base_string(output_string, primary_directory, {},
                                        relative_string, sentinel)};
@@ -924,7 +999,15 @@ auto delta_engine(const BuildPhase phase, const BuildPlan::Type build_type,
                               cached_leaf_state->has_cross_leaf_deps)};
 
     if (leaf_dirty) {
-      dirty_relative_paths.insert(relative_string);
+      into.dirty_relative_paths.push_back(relative_string);
+    }
+
+    if (leaf_dirty || has_missing_targets) {
+      into.reasons.emplace_back(
+          uri, is_full                       ? BuildPlan::Reason::Full
+               : cached_leaf_state == nullptr ? BuildPlan::Reason::New
+               : leaf_dirty                   ? BuildPlan::Reason::Modified
+                                              : BuildPlan::Reason::MissingTargets);
     }
 
     if (needs_targets) {
@@ -936,10 +1019,11 @@ auto delta_engine(const BuildPhase phase, const BuildPlan::Type build_type,
 
         const std::array<std::string, 2> bases{
             {primary_base, secondary_bases[view]}};
-        declare_leaf_targets(targets, bases, output_string, info.path->native(),
-                             info.evaluate, build_type, full_mode,
-                             configuration_string, uri, phase, leaf_rules,
-                             secondary_views[view], declared_primary);
+        declare_leaf_targets(into.targets, bases, output_string,
+                             info.path->native(), info.evaluate, build_type,
+                             full_mode, configuration_string, uri, phase,
+                             leaf_rules, secondary_views[view],
+                             declared_primary);
         declared_primary = true;
       }
 
@@ -947,18 +1031,53 @@ auto delta_engine(const BuildPhase phase, const BuildPlan::Type build_type,
       // the unit tree is declared on its own rather than left undeclared
       if (!declared_primary) {
         const std::array<std::string, 2> bases{{primary_base, std::string{}}};
-        declare_leaf_targets(targets, bases, output_string, info.path->native(),
-                             info.evaluate, build_type, full_mode,
-                             configuration_string, uri, phase, leaf_rules, {},
-                             false, true);
-      }
+        declare_leaf_targets(into.targets, bases, output_string,
+                             info.path->native(), info.evaluate, build_type,
+                             full_mode, configuration_string, uri, phase,
+                             leaf_rules, {}, false, true);
+      }
+    }
+
+    into.active_leaves.push_back({.uri = uri,
+                                  .info = &info,
+                                  .primary_base = std::move(primary_base),
+                                  .secondary_bases = std::move(secondary_bases),
+                                  .root_path = std::move(root_path)});
+  }};
+
+  sourcemeta::core::parallel_for_each(
+      runs.begin(), runs.end(),
+      [&leaves, &plan_leaf, &leaf_rules](LeafRun &run, const std::size_t,
+                                         const std::size_t) -> void {
+        run.active_leaves.reserve(run.end - run.begin);
+        run.targets.reserve((run.end - run.begin) * leaf_rules.size());
+        for (std::size_t index{run.begin}; index < run.end; index++) {
+          plan_leaf(leaves[index].first, leaves[index].second, run);
+        }
+      },
+      run_count);
+
+  std::vector<ActiveLeaf> active_leaves;
+  active_leaves.reserve(leaves.size());
+  std::vector<std::filesystem::path> all_relative_paths;
+  all_relative_paths.reserve(leaves.size());
+  std::unordered_set<std::string> dirty_relative_paths;
+  std::vector<std::pair<std::string_view, BuildPlan::Reason>> reasons;
+  for (auto &run : runs) {
+    for (auto &leaf : run.active_leaves) {
+      all_relative_paths.emplace_back(*leaf.info->relative_path);
+      active_leaves.push_back(std::move(leaf));
     }
 
-    active_leaves.push_back({.uri = uri,
-                             .info = &info,
-                             .primary_base = std::move(primary_base),
-                             .secondary_bases = std::move(secondary_bases),
-                             .root_path = std::move(root_path)});
+    // Every leaf declares under its own bases, so no two runs ever declare the
+    // same target and the maps splice together without a collision
+    targets.merge(run.targets);
+    assert(run.targets.empty());
+    for (auto &relative_path : run.dirty_relative_paths) {
+      dirty_relative_paths.insert(std::move(relative_path));
+    }
+
+    reasons.insert(reasons.end(), run.reasons.cbegin(), run.reasons.cend());
   }
 
   std::unordered_set<std::string_view> force_dirty;
@@ -1032,7 +1151,9 @@ auto delta_engine(const BuildPhase phase, const BuildPlan::Type build_type,
     const auto &secondary_prefix_string{secondary_tree_prefix};
     std::unordered_map<std::string_view, std::vector<std::string_view>>
         reverse_adjacency;
-    std::unordered_map<std::string, std::vector<std::string>>
+    // Keyed by the number the state gives each path rather than by the path,
+    // so that filling it never spells out what the entries depend on
+    std::unordered_map<BuildState::PathId, std::vector<std::string>>
         reverse_state_dependencies;
     for (const auto &[target_path, target] : targets) {
       for (const auto &dependency : target.dependencies) {
@@ -1094,14 +1215,14 @@ auto delta_engine(const BuildPhase phase, const BuildPlan::Type build_type,
         }
       }
 
-      const auto *state_entry{entries.entry(target_path)};
-      if (state_entry == nullptr) {
+      const auto identifiers{entries.dependency_ids(target_path)};
+      if (!identifiers.has_value()) {
         dirty_set.insert(target_path);
         continue;
       }
 
-      for (const auto &dependency : state_entry->dependencies) {
-        reverse_state_dependencies[dependency.native()].push_back(target_path);
+      for (const auto identifier : identifiers.value()) {
+        reverse_state_dependencies[identifier].push_back(target_path);
       }
     }
 
@@ -1113,7 +1234,12 @@ auto delta_engine(const BuildPhase phase, const BuildPlan::Type build_type,
     const std::vector<std::string> dirty_snapshot{dirty_set.begin(),
                                                   dirty_set.end()};
     for (const auto &dirty_path : dirty_snapshot) {
-      const auto match{reverse_state_dependencies.find(dirty_path)};
+      const auto identifier{entries.path_id(dirty_path)};
+      if (!identifier.has_value()) {
+        continue;
+      }
+
+      const auto match{reverse_state_dependencies.find(identifier.value())};
       if (match != reverse_state_dependencies.end()) {
         for (const auto &dependent : match->second) {
           dirty_set.insert(dependent);
@@ -1122,7 +1248,12 @@ auto delta_engine(const BuildPhase phase, const BuildPlan::Type build_type,
     }
 
     for (const auto &removed_path : removed_entries) {
-      const auto match{reverse_state_dependencies.find(removed_path)};
+      const auto identifier{entries.path_id(removed_path)};
+      if (!identifier.has_value()) {
+        continue;
+      }
+
+      const auto match{reverse_state_dependencies.find(identifier.value())};
       if (match != reverse_state_dependencies.end()) {
         for (const auto &dependent : match->second) {
           dirty_set.insert(dependent);
@@ -1255,7 +1386,8 @@ auto delta_engine(const BuildPhase phase, const BuildPlan::Type build_type,
       return plan;
     }
 
-    return {.output = output, .type = build_type, .waves = {}, .size = 0};
+    return {.output = output, .type = build_type, .waves = {}, .size = 0,
+            .reasons = {}};
   }
 
   const auto has_leaf_work{is_full || !dirty_set.empty() ||
@@ -1726,6 +1858,7 @@ auto delta_engine(const BuildPhase phase, const BuildPlan::Type build_type,
   BuildPlan plan;
   plan.output = output;
   plan.type = build_type;
+  plan.reasons = std::move(reasons);
 
   if (is_full) {
     std::vector<BuildPlan::Action> initialization_wave;
@@ -7,6 +7,7 @@
 
 #include <sourcemeta/core/json.h>
 
+#include <sourcemeta/one/build_cache.h>
 #include <sourcemeta/one/build_error.h>
 #include <sourcemeta/one/build_state.h>
 
@@ -39,6 +40,14 @@ struct LeafView {
 
 using LeafSet = std::span<const std::pair<std::string_view, LeafView>>;
 
+// Everything about a set of leaves that planning reads, folded into what a
+// state records once a build over them is done. The order the leaves come in
+// does not count, since nothing planned depends on it either. Never zero, as
+// that is what a state that recorded nothing reads as
+SOURCEMETA_ONE_BUILD_EXPORT
+auto leaf_set_digest(const LeafSet &leaves, BuildPlan::Type build_type)
+    -> std::uint64_t;
+
 template <std::size_t S, std::size_t D, std::size_t G, std::size_t B>
 struct DeltaRuleSet {
   // Each leaf rule's index is shifted into a std::uint16_t target bitmap, so
@@ -229,7 +238,8 @@ struct DeltaRuleIndices {
 // where this says so, which is what makes every count derived from them true of
 // that view without anything downstream knowing why. It is answered by whoever
 // asks for a build rather than worked out here, since what decides it is known
-// where the policies are read and nowhere else
+// where the policies are read and nowhere else. Planning asks it from several
+// threads at once, so it must be safe to
 using ViewFilter = std::function<bool(std::size_t, std::string_view)>;
 
 SOURCEMETA_ONE_BUILD_EXPORT
@@ -244,7 +254,8 @@ auto delta_engine(
     std::span<const DirectoryRule> directories,
     std::span<const std::string_view> views, const ViewFilter &visible,
     std::string_view sentinel, BuildPlan::Action::Type remove_action,
-    BuildPlan::Type full_mode, const DeltaRuleIndices &indices) -> BuildPlan;
+    BuildPlan::Type full_mode, const DeltaRuleIndices &indices,
+    std::size_t concurrency) -> BuildPlan;
 
 template <const auto &RuleSet>
 auto delta(const BuildPhase phase, const BuildPlan::Type build_type,
@@ -253,7 +264,8 @@ auto delta(const BuildPhase phase, const BuildPlan::Type build_type,
            const bool incremental, const std::string_view comment,
            const std::string_view mode_label, const BuildLimits &limits,
            const std::span<const std::string_view> views,
-           const ViewFilter &visible) -> BuildPlan {
+           const ViewFilter &visible, const std::size_t concurrency = 1)
+    -> BuildPlan {
   constexpr DeltaRuleIndices INDICES{
       .root = find_root_leaf_index<RuleSet>(),
       .metadata = find_container_target_leaf_index<RuleSet>(),
@@ -273,7 +285,7 @@ auto delta(const BuildPhase phase, const BuildPlan::Type build_type,
                       incremental, comment, mode_label, limits, RuleSet.leaves,
                       RuleSet.containers, RuleSet.globals, RuleSet.directories,
                       views, visible, RuleSet.sentinel, RuleSet.remove_action,
-                      RuleSet.full_mode, INDICES);
+                      RuleSet.full_mode, INDICES, concurrency);
 }
 
 } // namespace sourcemeta::one
@@ -0,0 +1,79 @@
+#ifndef SOURCEMETA_ONE_BUILD_CACHE_H_
+#define SOURCEMETA_ONE_BUILD_CACHE_H_
+
+#ifndef SOURCEMETA_ONE_BUILD_EXPORT
+#include <sourcemeta/one/build_export.h>
+#endif
+
+#include <sourcemeta/core/io.h>
+
+#include <filesystem>  // std::filesystem::path
+#include <memory>      // std::unique_ptr
+#include <optional>    // std::optional
+#include <string>      // std::string
+#include <string_view> // std::string_view
+
+namespace sourcemeta::one {
+
+// Artifacts kept beyond the output they were built into, addressed by a digest
+// of everything that went into them rather than by where they landed, so that
+// a build starting from nothing can take over what another build already did.
+// What goes into a key is for the caller to decide, since only the caller
+// knows what an artifact was made from. Keys are never reused for different
+// contents, which is what lets anything stored under one be left in place for
+// good rather than invalidated
+class SOURCEMETA_ONE_BUILD_EXPORT BuildCache {
+public:
+  BuildCache() = default;
+  virtual ~BuildCache() = default;
+  BuildCache(BuildCache &&) = delete;
+  auto operator=(BuildCache &&) -> BuildCache & = delete;
+  BuildCache(const BuildCache &) = delete;
+  auto operator=(const BuildCache &) -> BuildCache & = delete;
+
+  // Place the artifact stored under a key at the destination, replacing
+  // whatever was there, and answer whether there was one to place
+  [[nodiscard]] virtual auto fetch(std::string_view key,
+                                   const std::filesystem::path &destination)
+      -> bool = 0;
+  virtual auto store(std::string_view key, const std::filesystem::path &source)
+      -> void = 0;
+
+  // A small record kept under a key, for what has to be known before the key
+  // of an artifact can be worked out at all
+  [[nodiscard]] virtual auto read(std::string_view key)
+      -> std::optional<std::string> = 0;
+  virtual auto write(std::string_view key, std::string_view contents)
+      -> void = 0;
+};
+
+// A cache in a directory, which can as well be one many machines mount. Every
+// write lands under a name nobody else reads and is renamed into place, so
+// processes sharing the directory only ever see an entry whole or not at all
+class SOURCEMETA_ONE_BUILD_EXPORT BuildCacheDirectory : public BuildCache {
+public:
+  explicit BuildCacheDirectory(const std::filesystem::path &path);
+
+  [[nodiscard]] auto fetch(std::string_view key,
+                           const std::filesystem::path &destination)
+      -> bool override;
+  auto store(std::string_view key, const std::filesystem::path &source)
+      -> void override;
+  [[nodiscard]] auto read(std::string_view key)
+      -> std::optional<std::string> override;
+  auto write(std::string_view key, std::string_view contents) -> void override;
+
+private:
+  [[nodiscard]] auto locate(std::string_view directory,
+                            std::string_view key) const
+      -> std::filesystem::path;
+
+  std::filesystem::path root;
+  // Where this process stages what it stores, unique to it and on the same
+  // filesystem as the entries, so that a rename is all it takes to publish one
+  std::unique_ptr<sourcemeta::core::TemporaryDirectory> staging;
+};
+
+} // namespace sourcemeta::one
+
+#endif // SOURCEMETA_ONE_BUILD_CACHE_H_
@@ -8,16 +8,23 @@
 #include <sourcemeta/core/io.h>
 
 #include <array>       // std::array
+#include <chrono>      // std::chrono::steady_clock
 #include <cstddef>     // std::size_t
 #include <cstdint>     // std::uint8_t, std::uint16_t, std::uint32_t
+#include <deque>       // std::deque
 #include <filesystem>  // std::filesystem::path, std::filesystem::file_time_type
+#include <fstream>     // std::ofstream
+#include <functional>  // std::function, std::less
+#include <map>         // std::map
 #include <memory>      // std::unique_ptr
 #include <mutex>       // std::mutex, std::unique_lock
+#include <optional>    // std::optional
 #include <span>        // std::span
 #include <string>      // std::string
 #include <string_view> // std::string_view
 #include <unordered_map> // std::unordered_map
 #include <unordered_set> // std::unordered_set
+#include <utility>       // std::pair
 #include <vector>        // std::vector
 
 namespace sourcemeta::one {
@@ -39,10 +46,15 @@ struct BuildPlan {
     std::string_view view{};
   };
 
+  // Why the plan rebuilds a leaf, as only the leaf itself can tell. A leaf
+  // rebuilt only because of what it depends on is not listed
+  enum class Reason : std::uint8_t { Full, New, Modified, MissingTargets };
+
   std::filesystem::path output;
   Type type;
   std::vector<std::vector<Action>> waves;
   std::size_t size{0};
+  std::vector<std::pair<std::string_view, Reason>> reasons;
 };
 
 enum class TargetGate : std::uint8_t { Always, OnlyInFullMode, IfEvaluate };
@@ -174,7 +186,9 @@ public:
   };
 
   BuildState() = default;
-  ~BuildState() = default;
+  // Whatever the journal still buffers is written out, so that a build that
+  // fails rather than dies keeps everything it finished
+  ~BuildState();
   BuildState(BuildState &&) = delete;
   auto operator=(BuildState &&) -> BuildState & = delete;
   BuildState(const BuildState &) = delete;
@@ -195,6 +209,24 @@ public:
             std::string_view sentinel) -> void;
   auto save(const std::filesystem::path &path) const -> void;
 
+  // Append every change from here on to a journal at the given path, after
+  // replaying whatever a build over the same inputs left there without ever
+  // saving the state. A build killed halfway then resumes from everything it
+  // committed rather than from what the last finished build knew, and only
+  // redoes what was in flight. A journal is only replayed over a state built
+  // from the same inputs, or over none at all, as its entries say nothing
+  // about anything else. Returns how many changes were replayed
+  auto journal(const std::filesystem::path &path) -> std::size_t;
+  // Make what the journal buffers durable
+  auto checkpoint() -> void;
+  // The same, but only once enough piled up or enough time went by since the
+  // last time, which bounds how much work a build that dies can lose. Meant to
+  // be called without holding the lock, as waiting for the disk under it would
+  // stall every other worker that commits
+  auto checkpoint_if_due() -> void;
+  // Once the state is saved it answers for everything the journal does
+  auto settle_journal() -> void;
+
   [[nodiscard]] auto empty() const -> bool { return this->entry_count == 0; }
 
   // Whether the state on disk was built from the same inputs this build is
@@ -205,27 +237,115 @@ public:
   }
   [[nodiscard]] auto size() const -> std::size_t { return this->entry_count; }
 
+  // A digest of the leaves a build planned over, recorded once everything it
+  // planned is done. A later build over leaves with the same digest, from the
+  // same inputs, is looking at exactly what this state answers for, which is
+  // what lets a planner skip proving it leaf by leaf. Zero if none was recorded
+  [[nodiscard]] auto recorded_leaves() const -> std::uint64_t {
+    return this->leaves_digest;
+  }
+  auto record_leaves(std::uint64_t digest) -> void;
+
+  // What version control said a source directory was at when a build last
+  // looked at it, so that a later build can ask it what changed since rather
+  // than look at every file. Empty where nothing was recorded, and recording
+  // an empty revision forgets it
+  [[nodiscard]] auto source_revision(std::string_view directory) const
+      -> std::string_view;
+  auto record_source_revision(std::string_view directory,
+                              std::string_view revision) -> void;
+
   [[nodiscard]] auto contains(std::string_view key) const -> bool;
   [[nodiscard]] auto entry(std::string_view key) const -> const Entry *;
   [[nodiscard]] auto
   is_stale(std::string_view key,
            std::filesystem::file_time_type source_mtime) const -> bool;
+
+  // An artifact is not made durable before the record that commits it is, so a
+  // build that dies may leave it missing, cut short or as it was before. Only
+  // comparing it with what was committed tells those apart from a finished one
+  struct ArtifactSeal {
+    std::uint64_t size;
+    std::uint64_t checksum;
+    auto operator==(const ArtifactSeal &) const -> bool = default;
+  };
+
+  // A metapack is renamed into place only once all of it is on disk, and its
+  // header carries the checksum of its payload, so the header stands for the
+  // rest of it. Anything else is read in full, which is why a worker takes
+  // the seal before it takes the lock to commit. Nothing where there is no
+  // file
+  [[nodiscard]] static auto seal(const std::filesystem::path &path)
+      -> std::optional<ArtifactSeal>;
+
   auto commit(const std::filesystem::path &path,
               std::vector<std::filesystem::path> dependencies) -> void;
+  auto commit(const std::filesystem::path &path,
+              std::vector<std::filesystem::path> dependencies,
+              const std::optional<ArtifactSeal> &seal) -> void;
   auto commit(const std::string &source_path, ResolverEntry entry) -> void;
   auto forget(const std::string &key) -> void;
   auto emplace(const std::filesystem::path &path, Entry entry) -> void;
+  auto emplace(const std::filesystem::path &path, Entry entry,
+               const std::optional<ArtifactSeal> &seal) -> void;
   [[nodiscard]] auto keys() const -> const std::vector<std::string_view> &;
+  // Only what this build committed, whether or not it was spilled since, which
+  // is all a planner looking for what moved has to walk
+  [[nodiscard]] auto committed_keys() const -> std::vector<std::string_view>;
 
   [[nodiscard]] auto resolve(const std::string &source_path,
                              std::filesystem::file_time_type mtime) const
       -> const ResolverEntry *;
 
+  // Take over what another state holds, as one process of a build split across
+  // several recorded it. Each entry keeps the mark it was committed with, since
+  // that is what a later build compares sources against, and lands in the
+  // overlay, so that combining reads it as work this build did
+  auto absorb(const BuildState &other) -> void;
+  // Only what another state committed since it was loaded, which is all a
+  // process building part of the catalog can answer for, rather than the whole
+  // output it planned against
+  auto absorb_committed(const BuildState &other) -> void;
+
+  // Move what this build committed so far out of memory and into a file in the
+  // given directory, from where it keeps being read as if it had never left.
+  // For catalogs whose state would not otherwise fit in memory, at the cost of
+  // a write and of decoding entries again whenever they are read. Every spill
+  // rewrites what was spilled before it, so until what is in memory outgrows
+  // that, this does nothing, which keeps what a build writes to spill linear
+  // in what it commits. Nobody may hold an entry or a key across it
+  auto spill(const std::filesystem::path &directory) -> void;
+  [[nodiscard]] auto spills() const -> std::size_t {
+    return this->spill_generation;
+  }
+  // Let go of what was decoded from disk on demand, which is only kept to save
+  // decoding it again. Nobody may hold an entry or a key across it either
+  auto trim() -> void;
+
   [[nodiscard]] auto in_overlay(std::string_view key) const -> bool;
   [[nodiscard]] auto disk_entry(std::string_view key) const -> const Entry *;
   [[nodiscard]] auto raw_disk_entry(std::string_view key) const
       -> const Entry *;
 
+  // Every path anything depends on is stored once and numbered, and the
+  // dependencies of an entry are a list of those numbers. Two identifiers are
+  // the same path if and only if they are equal, so a planner that only has to
+  // tell paths apart or group by them never has to spell one out, nor decode
+  // the entries it walks into paths. Identifiers hold until the next trim
+  using PathId = std::uint32_t;
+  [[nodiscard]] auto path(PathId identifier) const -> std::string_view;
+  // Without assigning one, as a path nothing depends on has none
+  [[nodiscard]] auto path_id(std::string_view path) const
+      -> std::optional<PathId>;
+  // The same lookups as the entries themselves, in the order the dependencies
+  // were committed. Nothing where there is no entry
+  [[nodiscard]] auto dependency_ids(std::string_view key) const
+      -> std::optional<std::vector<PathId>>;
+  [[nodiscard]] auto disk_dependency_ids(std::string_view key) const
+      -> std::optional<std::vector<PathId>>;
+  [[nodiscard]] auto raw_disk_dependency_ids(std::string_view key) const
+      -> std::optional<std::vector<PathId>>;
+
   struct TransparentHash {
     using is_transparent = void;
     auto operator()(std::string_view value) const noexcept -> std::size_t {
@@ -270,9 +390,24 @@ private:
   auto build_leaf_index(const std::string &output) const -> void;
   auto probe_slot(std::string_view key, std::uint8_t kind) const
       -> const std::uint8_t *;
+  auto decode_slot_entry(const std::uint8_t *slot) const -> Entry;
+  auto decode_slot_dependencies(const std::uint8_t *slot) const
+      -> std::vector<PathId>;
+  auto intern(std::string_view path) const -> PathId;
+  auto replay_journal(const std::filesystem::path &path) -> std::size_t;
+  auto journal_append(std::string_view record) -> void;
+  auto journal_write(const std::string &pending) -> void;
+  auto index_paths() const -> void;
   auto parse_slot_entry(const std::uint8_t *slot) const -> const Entry &;
   auto parse_slot_resolver_entry(const std::uint8_t *slot) const
       -> const ResolverEntry &;
+  auto spilled_slot(std::string_view key) const -> const std::uint8_t *;
+  // Whether this build committed an entry, whether it is still in memory or
+  // was spilled since
+  auto overlaid(std::string_view key) const -> bool;
+  auto for_each_committed(
+      const std::function<void(std::string_view, const Entry &)> &callback)
+      const -> void;
 
   std::unique_ptr<sourcemeta::core::FileView> view;
   const std::uint8_t *view_data{nullptr};
@@ -280,10 +415,22 @@ private:
   std::uint32_t table_capacity{0};
   const std::uint8_t *table_slots{nullptr};
   const std::uint8_t *string_pool{nullptr};
+  std::uint32_t pool_size{0};
+  const std::uint8_t *path_offsets{nullptr};
+  const std::uint8_t *path_bytes{nullptr};
+  std::uint32_t path_count{0};
+  // Paths that only this build depends on, numbered after the ones on disk.
+  // A deque, so that the views indexing them survive it growing
+  mutable std::deque<std::string> interned_paths;
+  mutable std::unordered_map<std::string_view, PathId> path_ids;
 
   std::unordered_map<std::string, Entry, TransparentHash, TransparentEqual>
       overlay;
   std::unordered_set<std::string, TransparentHash, TransparentEqual> deleted;
+  // What this build committed and then spilled, read behind the overlay and
+  // the deletions just like the state loaded from disk is
+  std::unique_ptr<BuildState> spilled;
+  std::size_t spill_generation{0};
   mutable std::unordered_map<std::string, Entry, TransparentHash,
                              TransparentEqual>
       lazy_cache;
@@ -325,7 +472,19 @@ private:
   // partway leaves outputs derived from inputs it never finished applying,
   // while its state still describes the ones before
   bool inputs_match{false};
+  std::uint64_t leaves_digest{0};
+  std::map<std::string, std::string, std::less<>> source_revisions;
   std::string sentinel_separator{};
+
+  // Empty unless journaling. The stream is only opened once there is a record
+  // to write, and records wait in the buffer until the next checkpoint. The
+  // buffer is guarded by the lock like the rest, while the stream is only
+  // written holding the journal mutex, so that records leave in order
+  std::mutex journal_mutex;
+  std::filesystem::path journal_path;
+  std::ofstream journal_stream;
+  std::string journal_buffer;
+  std::chrono::steady_clock::time_point journal_flushed;
 };
 
 } // namespace sourcemeta::one
@@ -1,4 +1,5 @@
 #include <sourcemeta/one/build_state.h>
+#include <sourcemeta/one/metapack.h>
 
 #include <sourcemeta/core/io.h>
 
@@ -7,18 +8,45 @@
 #include <chrono>  // std::chrono::nanoseconds, std::chrono::duration_cast
 #include <cstdint> // std::int64_t, std::uint16_t, std::uint32_t, std::uint64_t
 #include <cstring> // std::memcpy, std::memcmp
+#include <filesystem> // std::filesystem
+#include <fstream>    // std::ifstream
+#include <ios>        // std::ios, std::streamsize
+#include <memory>     // std::make_unique
+#include <mutex>      // std::mutex, std::lock_guard, std::unique_lock
+#include <optional>   // std::optional, std::nullopt
 #include <ostream> // std::ostream
+#include <stdexcept> // std::out_of_range
 #include <string>  // std::string
-#include <string_view> // std::string_view
-#include <utility>     // std::pair
+#include <string_view>   // std::string_view
+#include <system_error>  // std::error_code
+#include <unordered_map> // std::unordered_map
+#include <utility>       // std::pair
 #include <vector>      // std::vector
 
 namespace {
 
 constexpr std::uint32_t STATE_MAGIC{0x44455053};
-constexpr std::uint32_t STATE_VERSION{4};
+constexpr std::uint32_t STATE_VERSION{7};
 constexpr std::uint32_t LEAF_INDEX_MAGIC{0x58444953};
-constexpr std::size_t HEADER_SIZE{36};
+constexpr std::size_t HEADER_SIZE{52};
+
+// A journal is a header naming the rules and inputs its changes were made
+// under, followed by records. Each record is its length as a u32, the FNV-1a
+// hash of its payload as a u64 and then the payload, so a record cut short by
+// a process that died while writing it reads as the end of the journal rather
+// than as a change
+constexpr std::uint32_t JOURNAL_MAGIC{0x4C4E524A};
+constexpr std::uint32_t JOURNAL_VERSION{3};
+constexpr std::size_t JOURNAL_HEADER_SIZE{20};
+constexpr std::size_t JOURNAL_FRAME_SIZE{12};
+constexpr std::uint8_t JOURNAL_COMMIT{0};
+constexpr std::uint8_t JOURNAL_FORGET{1};
+constexpr std::uint8_t JOURNAL_RESOLVE{2};
+// Whichever comes first. A second of work is what a build that dies loses at
+// most, and making the journal durable once a second costs nothing next to
+// what a build writes in the meantime
+constexpr std::size_t JOURNAL_FLUSH_BYTES{1024 * 1024};
+constexpr std::chrono::seconds JOURNAL_FLUSH_INTERVAL{1};
 
 #pragma pack(push, 1)
 struct LeafIndexRecord {
@@ -41,6 +69,13 @@ static_assert(sizeof(LeafIndexRecord) == 18);
 //   28: data_count   u16  (dep count for output, string count for resolver)
 //   30: occupied     u8
 //   31: kind         u8   (0=output, 1=resolver_cache)
+//
+// The dependencies of an output are identifiers into the path dictionary that
+// follows the string pool, which is an array of path_count + 1 offsets into
+// the bytes after it, so that path N spans offsets N to N + 1. Each identifier
+// is stored as the zigzag encoded difference from the one before it, as a
+// varint. An entry mostly depends on artifacts of its own leaf, which were
+// numbered together, so most of them take a byte
 constexpr std::size_t SLOT_SIZE{32};
 constexpr std::size_t SLOT_HASH{0};
 constexpr std::size_t SLOT_KEY_OFFSET{8};
@@ -61,8 +96,8 @@ auto read_field(const std::uint8_t *base, std::size_t offset) -> T {
   return value;
 }
 
-auto fnv1a(const char *data, std::size_t length) -> std::uint64_t {
-  std::uint64_t hash{14695981039346656037ULL};
+auto fnv1a(const char *data, std::size_t length,
+           std::uint64_t hash = 14695981039346656037ULL) -> std::uint64_t {
   for (std::size_t index = 0; index < length; ++index) {
     hash ^= static_cast<std::uint64_t>(static_cast<std::uint8_t>(data[index]));
     hash *= 1099511628211ULL;
@@ -93,6 +128,228 @@ auto append_pool_string(std::string &pool, const std::string &value) -> void {
   pool.append(value);
 }
 
+auto append_varint(std::string &buffer, std::uint64_t value) -> void {
+  while (value >= 0x80) {
+    buffer.push_back(static_cast<char>((value & 0x7F) | 0x80));
+    value >>= 7;
+  }
+
+  buffer.push_back(static_cast<char>(value));
+}
+
+// Never reads at or past the end, nor more than the ten bytes any 64-bit value
+// takes, so that a corrupted pool throws rather than reads out of bounds
+auto read_varint(const std::uint8_t *data, std::size_t &offset,
+                 const std::size_t end) -> std::uint64_t {
+  std::uint64_t result{0};
+  for (std::uint32_t shift = 0; shift < 64; shift += 7) {
+    if (offset >= end) {
+      throw std::out_of_range{"Truncated varint"};
+    }
+
+    const auto byte{data[offset++]};
+    result |= static_cast<std::uint64_t>(byte & 0x7F) << shift;
+    if ((byte & 0x80) == 0) {
+      return result;
+    }
+  }
+
+  throw std::out_of_range{"Overlong varint"};
+}
+
+auto append_journal_string(std::string &buffer, const std::string_view value)
+    -> void {
+  append_varint(buffer, value.size());
+  buffer.append(value);
+}
+
+auto append_journal_mark(std::string &buffer,
+                         const std::filesystem::file_time_type mark) -> void {
+  const auto timestamp{static_cast<std::int64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          mark.time_since_epoch())
+          .count())};
+  buffer.append(reinterpret_cast<const char *>(&timestamp), sizeof(timestamp));
+}
+
+auto append_journal_qword(std::string &buffer, const std::uint64_t value)
+    -> void {
+  buffer.append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+// Whatever was not a file when it was committed is only expected to exist
+auto journal_commit_record(const std::string_view key,
+                           const sourcemeta::one::BuildState::Entry &entry,
+                           const std::optional<
+                               sourcemeta::one::BuildState::ArtifactSeal> &seal)
+    -> std::string {
+  std::string record;
+  record.push_back(static_cast<char>(JOURNAL_COMMIT));
+  append_journal_string(record, key);
+  append_journal_mark(record, entry.file_mark);
+  record.push_back(static_cast<char>(seal.has_value() ? 1 : 0));
+  if (seal.has_value()) {
+    append_journal_qword(record, seal->size);
+    append_journal_qword(record, seal->checksum);
+  }
+
+  append_varint(record, entry.dependencies.size());
+  for (const auto &dependency : entry.dependencies) {
+    append_journal_string(record, dependency.native());
+  }
+
+  return record;
+}
+
+// Reads a payload whose hash already matched, so running out of bytes means
+// the journal was written by something else entirely, which ends it too
+class JournalReader {
+public:
+  explicit JournalReader(const std::string_view payload) : data{payload} {}
+
+  auto byte() -> std::uint8_t {
+    this->require(1);
+    return static_cast<std::uint8_t>(this->data[this->offset++]);
+  }
+
+  auto varint() -> std::uint64_t {
+    const auto *bytes{
+        reinterpret_cast<const std::uint8_t *>(this->data.data())};
+    return read_varint(bytes, this->offset, this->data.size());
+  }
+
+  auto string() -> std::string_view {
+    const auto length{this->varint()};
+    this->require(length);
+    const auto result{this->data.substr(this->offset, length)};
+    this->offset += length;
+    return result;
+  }
+
+  auto qword() -> std::uint64_t {
+    this->require(sizeof(std::uint64_t));
+    std::uint64_t result;
+    std::memcpy(&result, this->data.data() + this->offset, sizeof(result));
+    this->offset += sizeof(result);
+    return result;
+  }
+
+  auto mark() -> std::filesystem::file_time_type {
+    this->require(sizeof(std::int64_t));
+    std::int64_t nanoseconds;
+    std::memcpy(&nanoseconds, this->data.data() + this->offset,
+                sizeof(nanoseconds));
+    this->offset += sizeof(nanoseconds);
+    return std::filesystem::file_time_type{
+        std::chrono::duration_cast<std::filesystem::file_time_type::duration>(
+            std::chrono::nanoseconds{nanoseconds})};
+  }
+
+private:
+  auto require(const std::uint64_t size) const -> void {
+    if (size > this->data.size() - this->offset) {
+      throw std::out_of_range{"Truncated journal record"};
+    }
+  }
+
+  std::string_view data;
+  std::size_t offset{0};
+};
+
+auto append_identifiers(std::string &pool,
+                        const std::vector<std::uint32_t> &identifiers)
+    -> void {
+  std::int64_t previous{0};
+  for (const auto identifier : identifiers) {
+    const auto delta{static_cast<std::int64_t>(identifier) - previous};
+    append_varint(pool, (static_cast<std::uint64_t>(delta) << 1) ^
+                            static_cast<std::uint64_t>(delta >> 63));
+    previous = identifier;
+  }
+}
+
+// Every identifier has to name a path of the dictionary, which holds as many
+// as the given limit, and throws otherwise
+template <typename Callback>
+auto walk_identifiers(const std::uint8_t *pool, std::size_t offset,
+                      const std::size_t end, const std::uint16_t count,
+                      const std::uint32_t limit, const Callback &callback)
+    -> void {
+  std::int64_t previous{0};
+  for (std::uint16_t index = 0; index < count; ++index) {
+    const auto encoded{read_varint(pool, offset, end)};
+    const auto delta{static_cast<std::int64_t>(encoded >> 1) ^
+                     -static_cast<std::int64_t>(encoded & 1)};
+    previous += delta;
+    if (previous < 0 || previous >= static_cast<std::int64_t>(limit)) {
+      throw std::out_of_range{"Unknown path identifier"};
+    }
+
+    callback(static_cast<std::uint32_t>(previous));
+  }
+}
+
+auto read_identifiers(const std::uint8_t *pool, const std::size_t offset,
+                      const std::size_t end, const std::uint16_t count,
+                      const std::uint32_t limit) -> std::vector<std::uint32_t> {
+  std::vector<std::uint32_t> result;
+  result.reserve(count);
+  walk_identifiers(pool, offset, end, count, limit,
+                   [&result](const std::uint32_t identifier) -> void {
+                     result.push_back(identifier);
+                   });
+  return result;
+}
+
+// The dictionary a state is written with. Seeded with the one on disk when the
+// pool is carried over as it is, since what the pool holds is numbered by it
+class PathTable {
+public:
+  auto seed(const std::uint8_t *disk_offsets, const std::uint8_t *disk_bytes,
+            const std::uint32_t count) -> void {
+    for (std::uint32_t identifier = 0; identifier < count; ++identifier) {
+      const auto start{read_field<std::uint32_t>(
+          disk_offsets, identifier * sizeof(std::uint32_t))};
+      const auto end{read_field<std::uint32_t>(
+          disk_offsets, (identifier + 1) * sizeof(std::uint32_t))};
+      this->intern(
+          {reinterpret_cast<const char *>(disk_bytes + start), end - start});
+    }
+  }
+
+  auto intern(const std::string_view path) -> std::uint32_t {
+    const auto match{this->identifiers.find(path)};
+    if (match != this->identifiers.end()) {
+      return match->second;
+    }
+
+    const auto identifier{static_cast<std::uint32_t>(this->identifiers.size())};
+    this->bytes.append(path);
+    this->offsets.push_back(static_cast<std::uint32_t>(this->bytes.size()));
+    this->identifiers.emplace(path, identifier);
+    return identifier;
+  }
+
+  [[nodiscard]] auto at(const std::uint32_t identifier) const
+      -> std::string_view {
+    return {this->bytes.data() + this->offsets[identifier],
+            this->offsets[identifier + 1] - this->offsets[identifier]};
+  }
+
+  [[nodiscard]] auto size() const -> std::uint32_t {
+    return static_cast<std::uint32_t>(this->identifiers.size());
+  }
+
+  std::vector<std::uint32_t> offsets{0};
+  std::string bytes;
+
+private:
+  std::unordered_map<std::string, std::uint32_t,
+                     sourcemeta::one::BuildState::TransparentHash,
+                     sourcemeta::one::BuildState::TransparentEqual>
+      identifiers;
+};
+
 auto is_key_or_descendant(std::string_view candidate, std::string_view key,
                           std::string_view child_prefix) -> bool {
   return candidate == key || candidate.starts_with(child_prefix);
@@ -147,6 +404,15 @@ auto BuildState::fingerprint(const std::string_view inputs)
   return fnv1a(inputs.data(), inputs.size());
 }
 
+BuildState::~BuildState() {
+  // A destructor cannot report anything, and a journal that could not be
+  // written only costs a resumed build the work it would have skipped
+  try {
+    this->checkpoint();
+  } catch (...) {
+  }
+}
+
 auto BuildState::take_lock() const -> std::unique_lock<std::mutex> {
   return std::unique_lock<std::mutex>{this->mutex_};
 }
@@ -169,10 +435,18 @@ auto BuildState::reset_loaded_state() -> void {
   this->table_capacity = 0;
   this->table_slots = nullptr;
   this->string_pool = nullptr;
+  this->pool_size = 0;
+  this->path_offsets = nullptr;
+  this->path_bytes = nullptr;
+  this->path_count = 0;
+  this->interned_paths.clear();
+  this->path_ids.clear();
   this->view.reset();
   this->view_data = nullptr;
   this->entry_count = 0;
   this->resolver_entry_count = 0;
+  this->leaves_digest = 0;
+  this->source_revisions.clear();
 }
 
 auto BuildState::load(const std::filesystem::path &path,
@@ -225,15 +499,24 @@ auto BuildState::load(const std::filesystem::path &path,
     const auto entries{header_reader.get_dword()};
     const auto pool_size_value{header_reader.get_dword()};
     const auto resolver_entries{header_reader.get_dword()};
+    const auto paths{header_reader.get_dword()};
+    const auto path_bytes_size{header_reader.get_dword()};
+    const auto leaves{header_reader.get_qword()};
 
     // A truncated or corrupted body can leave the header intact while its
     // sizes point past the end of the file or break the power-of-two probe
     // mask. Recompute the layout and require it to fit before trusting any
     // offset, otherwise treat the whole file as a cache miss
     const auto slots_bytes{static_cast<std::size_t>(capacity) * SLOT_SIZE};
+    const auto offsets_bytes{(static_cast<std::size_t>(paths) + 1) *
+                             sizeof(std::uint32_t)};
+    const auto dictionary_start{HEADER_SIZE + slots_bytes + pool_size_value};
     if (!std::has_single_bit(capacity) ||
         static_cast<std::size_t>(entries) + resolver_entries > capacity ||
-        HEADER_SIZE + slots_bytes + pool_size_value > file_size) {
+        dictionary_start + offsets_bytes + path_bytes_size > file_size ||
+        read_field<std::uint32_t>(this->view_data + dictionary_start,
+                                  offsets_bytes - sizeof(std::uint32_t)) !=
+            path_bytes_size) {
       this->reset_loaded_state();
       return;
     }
@@ -243,8 +526,75 @@ auto BuildState::load(const std::filesystem::path &path,
     this->resolver_entry_count = resolver_entries;
     this->table_slots = this->view_data + HEADER_SIZE;
     this->string_pool = this->table_slots + slots_bytes;
+    this->pool_size = pool_size_value;
+    this->path_offsets = this->view_data + dictionary_start;
+    this->path_bytes = this->path_offsets + offsets_bytes;
+    this->path_count = paths;
+    this->leaves_digest = leaves;
+
+    // Whatever is decoded out of the state is decoded long after it is loaded,
+    // where nothing could start afresh anymore, so all of it is proven to stay
+    // within its bounds here, like the header is, and a state that does not is
+    // as unreadable as one of another version
+    std::uint32_t previous_offset{0};
+    for (std::uint32_t identifier = 0; identifier <= paths; ++identifier) {
+      const auto offset{read_field<std::uint32_t>(
+          this->path_offsets, identifier * sizeof(std::uint32_t))};
+      if (offset < previous_offset || offset > path_bytes_size) {
+        this->reset_loaded_state();
+        return;
+      }
+
+      previous_offset = offset;
+    }
+
+    for (std::uint32_t slot_index = 0; slot_index < capacity; ++slot_index) {
+      const auto *slot{this->table_slots + slot_index * SLOT_SIZE};
+      if (slot[SLOT_OCCUPIED] != 0 && slot[SLOT_KIND] == KIND_OUTPUT) {
+        walk_identifiers(this->string_pool,
+                         read_field<std::uint32_t>(slot, SLOT_DATA_OFFSET),
+                         pool_size_value,
+                         read_field<std::uint16_t>(slot, SLOT_DATA_COUNT),
+                         paths, [](const std::uint32_t) -> void {});
+      }
+    }
+
+    // The source revisions follow the path dictionary, as a count and then
+    // every directory and its revision, each prefixed by its length
+    auto leaf_table_start{dictionary_start + offsets_bytes + path_bytes_size};
+    if (leaf_table_start + sizeof(std::uint32_t) > file_size) {
+      this->reset_loaded_state();
+      return;
+    }
+
+    const auto revisions{
+        read_field<std::uint32_t>(this->view_data, leaf_table_start)};
+    leaf_table_start += sizeof(std::uint32_t);
+    const auto read_string{[&]() -> std::string {
+      if (leaf_table_start + sizeof(std::uint32_t) > file_size) {
+        throw std::out_of_range{"Truncated source revision"};
+      }
+
+      const auto length{
+          read_field<std::uint32_t>(this->view_data, leaf_table_start)};
+      leaf_table_start += sizeof(std::uint32_t);
+      if (leaf_table_start + length > file_size) {
+        throw std::out_of_range{"Truncated source revision"};
+      }
+
+      std::string result{
+          reinterpret_cast<const char *>(this->view_data + leaf_table_start),
+          length};
+      leaf_table_start += length;
+      return result;
+    }};
+
+    for (std::uint32_t index{0}; index < revisions; index++) {
+      auto directory{read_string()};
+      this->source_revisions.insert_or_assign(std::move(directory),
+                                              read_string());
+    }
 
-    const auto leaf_table_start{HEADER_SIZE + slots_bytes + pool_size_value};
     if (leaf_table_start + sizeof(std::uint32_t) * 2 <= file_size &&
         read_field<std::uint32_t>(this->view_data, leaf_table_start) ==
             LEAF_INDEX_MAGIC) {
@@ -291,6 +641,133 @@ auto BuildState::probe_slot(std::string_view key, std::uint8_t kind) const
   return nullptr;
 }
 
+auto BuildState::decode_slot_entry(const std::uint8_t *slot) const -> Entry {
+  Entry result;
+  const auto nanoseconds{read_field<std::int64_t>(slot, SLOT_TIMESTAMP)};
+  result.file_mark = mark_type{std::chrono::duration_cast<mark_type::duration>(
+      std::chrono::nanoseconds{nanoseconds})};
+
+  const auto identifiers{this->decode_slot_dependencies(slot)};
+  result.dependencies.reserve(identifiers.size());
+  for (const auto identifier : identifiers) {
+    result.dependencies.emplace_back(this->path(identifier));
+  }
+
+  return result;
+}
+
+auto BuildState::decode_slot_dependencies(const std::uint8_t *slot) const
+    -> std::vector<PathId> {
+  return read_identifiers(this->string_pool,
+                          read_field<std::uint32_t>(slot, SLOT_DATA_OFFSET),
+                          this->pool_size,
+                          read_field<std::uint16_t>(slot, SLOT_DATA_COUNT),
+                          this->path_count);
+}
+
+auto BuildState::path(const PathId identifier) const -> std::string_view {
+  if (identifier < this->path_count) {
+    const auto start{read_field<std::uint32_t>(
+        this->path_offsets, identifier * sizeof(std::uint32_t))};
+    const auto end{read_field<std::uint32_t>(
+        this->path_offsets, (identifier + 1) * sizeof(std::uint32_t))};
+    return {reinterpret_cast<const char *>(this->path_bytes + start),
+            end - start};
+  }
+
+  assert(identifier - this->path_count < this->interned_paths.size());
+  return this->interned_paths[identifier - this->path_count];
+}
+
+// Only once something asks by path, as a planner that only compares the
+// identifiers on disk never needs to look one up
+auto BuildState::index_paths() const -> void {
+  if (!this->path_ids.empty() || this->path_count == 0) {
+    return;
+  }
+
+  this->path_ids.reserve(this->path_count);
+  for (PathId identifier = 0; identifier < this->path_count; ++identifier) {
+    this->path_ids.emplace(this->path(identifier), identifier);
+  }
+}
+
+auto BuildState::intern(const std::string_view path) const -> PathId {
+  this->index_paths();
+  const auto match{this->path_ids.find(path)};
+  if (match != this->path_ids.end()) {
+    return match->second;
+  }
+
+  const auto &stored{this->interned_paths.emplace_back(path)};
+  const auto identifier{static_cast<PathId>(this->path_count +
+                                            this->interned_paths.size() - 1)};
+  this->path_ids.emplace(stored, identifier);
+  return identifier;
+}
+
+auto BuildState::path_id(const std::string_view path) const
+    -> std::optional<PathId> {
+  this->index_paths();
+  const auto match{this->path_ids.find(path)};
+  if (match == this->path_ids.end()) {
+    return std::nullopt;
+  }
+
+  return match->second;
+}
+
+auto BuildState::dependency_ids(std::string_view key) const
+    -> std::optional<std::vector<PathId>> {
+  const auto overlay_match{this->overlay.find(key)};
+  if (overlay_match != this->overlay.end()) {
+    std::vector<PathId> result;
+    result.reserve(overlay_match->second.dependencies.size());
+    for (const auto &dependency : overlay_match->second.dependencies) {
+      result.push_back(this->intern(dependency.native()));
+    }
+
+    return result;
+  }
+
+  if (this->deleted.contains(key)) {
+    return std::nullopt;
+  }
+
+  // The spill numbers its paths on its own, so its identifiers only mean
+  // something once spelled out
+  const auto *spilled_match{this->spilled_slot(key)};
+  if (spilled_match != nullptr) {
+    auto result{this->spilled->decode_slot_dependencies(spilled_match)};
+    for (auto &identifier : result) {
+      identifier = this->intern(this->spilled->path(identifier));
+    }
+
+    return result;
+  }
+
+  return this->disk_dependency_ids(key);
+}
+
+auto BuildState::disk_dependency_ids(std::string_view key) const
+    -> std::optional<std::vector<PathId>> {
+  if (this->deleted.contains(key)) {
+    return std::nullopt;
+  }
+
+  return this->raw_disk_dependency_ids(key);
+}
+
+auto BuildState::raw_disk_dependency_ids(std::string_view key) const
+    -> std::optional<std::vector<PathId>> {
+  const auto *slot{this->probe_slot(key, KIND_OUTPUT)};
+  if (slot == nullptr) {
+    return std::nullopt;
+  }
+
+  return this->decode_slot_dependencies(slot);
+}
+
 auto BuildState::parse_slot_entry(const std::uint8_t *slot) const
     -> const Entry & {
   const auto key{slot_key(slot, this->string_pool)};
@@ -301,22 +778,7 @@ auto BuildState::parse_slot_entry(const std::uint8_t *slot) const
   }
 
   auto &cached{this->lazy_cache[std::string{key}]};
-
-  const auto nanoseconds{read_field<std::int64_t>(slot, SLOT_TIMESTAMP)};
-  cached.file_mark = mark_type{std::chrono::duration_cast<mark_type::duration>(
-      std::chrono::nanoseconds{nanoseconds})};
-
-  const auto data_count{read_field<std::uint16_t>(slot, SLOT_DATA_COUNT)};
-  if (data_count > 0) {
-    cached.dependencies.reserve(data_count);
-    auto offset{static_cast<std::size_t>(
-        read_field<std::uint32_t>(slot, SLOT_DATA_OFFSET))};
-    for (std::uint16_t dep_index = 0; dep_index < data_count; ++dep_index) {
-      cached.dependencies.emplace_back(
-          read_pool_string(this->string_pool, offset));
-    }
-  }
-
+  cached = this->decode_slot_entry(slot);
   return cached;
 }
 
@@ -345,6 +807,46 @@ auto BuildState::parse_slot_resolver_entry(const std::uint8_t *slot) const
   return cached;
 }
 
+auto BuildState::spilled_slot(std::string_view key) const
+    -> const std::uint8_t * {
+  if (!this->spilled || this->deleted.contains(key)) {
+    return nullptr;
+  }
+
+  return this->spilled->probe_slot(key, KIND_OUTPUT);
+}
+
+auto BuildState::overlaid(std::string_view key) const -> bool {
+  return this->overlay.contains(key) || this->spilled_slot(key) != nullptr;
+}
+
+auto BuildState::for_each_committed(
+    const std::function<void(std::string_view, const Entry &)> &callback) const
+    -> void {
+  for (const auto &[key, value] : this->overlay) {
+    callback(key, value);
+  }
+
+  if (!this->spilled) {
+    return;
+  }
+
+  // Decoded one at a time rather than through the cache, as walking all of
+  // them is exactly what would otherwise bring them all back into memory
+  for (std::uint32_t slot_index = 0;
+       slot_index < this->spilled->table_capacity; ++slot_index) {
+    const auto *slot{this->spilled->table_slots + slot_index * SLOT_SIZE};
+    if (slot[SLOT_OCCUPIED] == 0 || slot[SLOT_KIND] != KIND_OUTPUT) {
+      continue;
+    }
+
+    const auto key{slot_key(slot, this->spilled->string_pool)};
+    if (!this->deleted.contains(key) && !this->overlay.contains(key)) {
+      callback(key, this->spilled->decode_slot_entry(slot));
+    }
+  }
+}
+
 auto BuildState::contains(std::string_view key) const -> bool {
   if (this->overlay.contains(key)) {
     return true;
@@ -354,7 +856,8 @@ auto BuildState::contains(std::string_view key) const -> bool {
     return false;
   }
 
-  return this->probe_slot(key, KIND_OUTPUT) != nullptr;
+  return this->spilled_slot(key) != nullptr ||
+         this->probe_slot(key, KIND_OUTPUT) != nullptr;
 }
 
 auto BuildState::entry(std::string_view key) const -> const Entry * {
@@ -367,6 +870,11 @@ auto BuildState::entry(std::string_view key) const -> const Entry * {
     return nullptr;
   }
 
+  const auto *spilled_match{this->spilled_slot(key)};
+  if (spilled_match != nullptr) {
+    return &this->spilled->parse_slot_entry(spilled_match);
+  }
+
   const auto *slot{this->probe_slot(key, KIND_OUTPUT)};
   if (slot == nullptr) {
     return nullptr;
@@ -387,7 +895,13 @@ auto BuildState::is_stale(
     return true;
   }
 
-  const auto *slot{this->probe_slot(key, KIND_OUTPUT)};
+  // Both tables lay a slot out the same way, so the mark reads the same from
+  // either of them
+  const auto *slot{this->spilled_slot(key)};
+  if (slot == nullptr) {
+    slot = this->probe_slot(key, KIND_OUTPUT);
+  }
+
   if (slot == nullptr) {
     return true;
   }
@@ -399,13 +913,69 @@ auto BuildState::is_stale(
   return source_mtime > file_mark;
 }
 
+auto BuildState::seal(const std::filesystem::path &path)
+    -> std::optional<ArtifactSeal> {
+  std::error_code error;
+  if (!std::filesystem::is_regular_file(path, error)) {
+    return std::nullopt;
+  }
+
+  std::ifstream stream{path, std::ios::binary};
+  if (!stream.is_open()) {
+    return std::nullopt;
+  }
+
+  if (path.extension() == ".metapack") {
+    MetapackHeader header{};
+    stream.read(reinterpret_cast<char *>(&header), sizeof(header));
+    if (stream.gcount() == static_cast<std::streamsize>(sizeof(header)) &&
+        header.magic == METAPACK_MAGIC &&
+        header.format_version == METAPACK_VERSION) {
+      const auto size{std::filesystem::file_size(path, error)};
+      if (error) {
+        return std::nullopt;
+      }
+
+      return ArtifactSeal{
+          .size = size,
+          .checksum = fnv1a(
+              reinterpret_cast<const char *>(header.checksum.data()),
+              header.checksum.size())};
+    }
+
+    stream.clear();
+    stream.seekg(0);
+  }
+
+  ArtifactSeal result{.size = 0, .checksum = fnv1a(nullptr, 0)};
+  std::string chunk(64 * 1024, '\0');
+  while (stream) {
+    stream.read(chunk.data(), static_cast<std::streamsize>(chunk.size()));
+    const auto count{static_cast<std::size_t>(stream.gcount())};
+    result.checksum = fnv1a(chunk.data(), count, result.checksum);
+    result.size += count;
+  }
+
+  if (stream.bad()) {
+    return std::nullopt;
+  }
+
+  return result;
+}
+
 auto BuildState::commit(const std::filesystem::path &path,
                         std::vector<std::filesystem::path> dependencies)
     -> void {
+  this->commit(path, std::move(dependencies),
+               this->journal_path.empty() ? std::nullopt
+                                          : BuildState::seal(path));
+}
+
+auto BuildState::commit(const std::filesystem::path &path,
+                        std::vector<std::filesystem::path> dependencies,
+                        const std::optional<ArtifactSeal> &seal) -> void {
   const auto &key{path.native()};
-  const auto was_live{this->overlay.contains(key) ||
-                      (this->probe_slot(key, KIND_OUTPUT) != nullptr &&
-                       !this->deleted.contains(key))};
+  const auto was_live{this->contains(key)};
 
   auto &result{this->overlay[key]};
   result.file_mark = std::filesystem::file_time_type::clock::now();
@@ -419,6 +989,10 @@ auto BuildState::commit(const std::filesystem::path &path,
   this->dirty = true;
   this->keys_stale = true;
   this->leaf_index_stale = true;
+
+  if (!this->journal_path.empty()) {
+    this->journal_append(journal_commit_record(key, result, seal));
+  }
 }
 
 auto BuildState::forget(const std::string &key) -> void {
@@ -437,6 +1011,27 @@ auto BuildState::forget(const std::string &key) -> void {
     }
   }
 
+  // A spilled entry is still this build's, so it is deleted in front of the
+  // spill just like a loaded one is in front of the disk
+  if (this->spilled) {
+    for (std::uint32_t slot_index = 0;
+         slot_index < this->spilled->table_capacity; ++slot_index) {
+      const auto *slot{this->spilled->table_slots + slot_index * SLOT_SIZE};
+      if (slot[SLOT_OCCUPIED] == 0 || slot[SLOT_KIND] != KIND_OUTPUT) {
+        continue;
+      }
+
+      const auto key_sv{slot_key(slot, this->spilled->string_pool)};
+      if (is_key_or_descendant(key_sv, key, child_prefix) &&
+          !this->deleted.contains(key_sv)) {
+        this->deleted.emplace(key_sv);
+        if (!removed_from_overlay.contains(key_sv)) {
+          this->entry_count--;
+        }
+      }
+    }
+  }
+
   for (std::uint32_t slot_index = 0; slot_index < this->table_capacity;
        ++slot_index) {
     const auto *slot{this->table_slots + slot_index * SLOT_SIZE};
@@ -458,16 +1053,29 @@ auto BuildState::forget(const std::string &key) -> void {
   this->dirty = true;
   this->keys_stale = true;
   this->leaf_index_stale = true;
+
+  if (!this->journal_path.empty()) {
+    std::string record;
+    record.push_back(static_cast<char>(JOURNAL_FORGET));
+    append_journal_string(record, key);
+    this->journal_append(record);
+  }
 }
 
 auto BuildState::emplace(const std::filesystem::path &path, Entry entry)
     -> void {
+  this->emplace(path, std::move(entry),
+                this->journal_path.empty() ? std::nullopt
+                                           : BuildState::seal(path));
+}
+
+auto BuildState::emplace(const std::filesystem::path &path, Entry entry,
+                         const std::optional<ArtifactSeal> &seal) -> void {
   const auto &key{path.native()};
-  const auto was_live{this->overlay.contains(key) ||
-                      (this->probe_slot(key, KIND_OUTPUT) != nullptr &&
-                       !this->deleted.contains(key))};
+  const auto was_live{this->contains(key)};
 
-  this->overlay[key] = std::move(entry);
+  auto &result{this->overlay[key]};
+  result = std::move(entry);
   this->deleted.erase(key);
 
   if (!was_live) {
@@ -477,6 +1085,10 @@ auto BuildState::emplace(const std::filesystem::path &path, Entry entry)
   this->dirty = true;
   this->keys_stale = true;
   this->leaf_index_stale = true;
+
+  if (!this->journal_path.empty()) {
+    this->journal_append(journal_commit_record(key, result, seal));
+  }
 }
 
 auto BuildState::keys() const -> const std::vector<std::string_view> & {
@@ -491,6 +1103,21 @@ auto BuildState::keys() const -> const std::vector<std::string_view> & {
     this->cached_keys.push_back(key);
   }
 
+  if (this->spilled) {
+    for (std::uint32_t slot_index = 0;
+         slot_index < this->spilled->table_capacity; ++slot_index) {
+      const auto *slot{this->spilled->table_slots + slot_index * SLOT_SIZE};
+      if (slot[SLOT_OCCUPIED] == 0 || slot[SLOT_KIND] != KIND_OUTPUT) {
+        continue;
+      }
+
+      const auto key{slot_key(slot, this->spilled->string_pool)};
+      if (!this->deleted.contains(key) && !this->overlay.contains(key)) {
+        this->cached_keys.push_back(key);
+      }
+    }
+  }
+
   for (std::uint32_t slot_index = 0; slot_index < this->table_capacity;
        ++slot_index) {
     const auto *slot{this->table_slots + slot_index * SLOT_SIZE};
@@ -499,7 +1126,7 @@ auto BuildState::keys() const -> const std::vector<std::string_view> & {
     }
 
     const auto key{slot_key(slot, this->string_pool)};
-    if (!this->deleted.contains(key) && !this->overlay.contains(key)) {
+    if (!this->deleted.contains(key) && !this->overlaid(key)) {
       this->cached_keys.push_back(key);
     }
   }
@@ -508,6 +1135,281 @@ auto BuildState::keys() const -> const std::vector<std::string_view> & {
   return this->cached_keys;
 }
 
+auto BuildState::committed_keys() const -> std::vector<std::string_view> {
+  std::vector<std::string_view> result;
+  result.reserve(this->overlay.size());
+  for (const auto &[key, value] : this->overlay) {
+    result.push_back(key);
+  }
+
+  if (!this->spilled) {
+    return result;
+  }
+
+  for (std::uint32_t slot_index = 0;
+       slot_index < this->spilled->table_capacity; ++slot_index) {
+    const auto *slot{this->spilled->table_slots + slot_index * SLOT_SIZE};
+    if (slot[SLOT_OCCUPIED] == 0 || slot[SLOT_KIND] != KIND_OUTPUT) {
+      continue;
+    }
+
+    const auto key{slot_key(slot, this->spilled->string_pool)};
+    if (!this->deleted.contains(key) && !this->overlay.contains(key)) {
+      result.push_back(key);
+    }
+  }
+
+  return result;
+}
+
+auto BuildState::record_leaves(const std::uint64_t digest) -> void {
+  if (digest != this->leaves_digest) {
+    this->leaves_digest = digest;
+    this->dirty = true;
+  }
+}
+
+auto BuildState::source_revision(const std::string_view directory) const
+    -> std::string_view {
+  const auto match{this->source_revisions.find(directory)};
+  return match == this->source_revisions.cend() ? std::string_view{}
+                                                : match->second;
+}
+
+auto BuildState::record_source_revision(const std::string_view directory,
+                                        const std::string_view revision)
+    -> void {
+  const auto match{this->source_revisions.find(directory)};
+  if (revision.empty()) {
+    if (match != this->source_revisions.end()) {
+      this->source_revisions.erase(match);
+      this->dirty = true;
+    }
+  } else if (match == this->source_revisions.end()) {
+    this->source_revisions.emplace(directory, revision);
+    this->dirty = true;
+  } else if (match->second != revision) {
+    match->second = revision;
+    this->dirty = true;
+  }
+}
+
+auto BuildState::journal(const std::filesystem::path &path) -> std::size_t {
+  assert(this->journal_path.empty());
+  const auto replayed{this->replay_journal(path)};
+  this->journal_path = path;
+  this->journal_flushed = std::chrono::steady_clock::now();
+  return replayed;
+}
+
+auto BuildState::replay_journal(const std::filesystem::path &path)
+    -> std::size_t {
+  if (!std::filesystem::exists(path)) {
+    return 0;
+  }
+
+  std::string contents;
+  try {
+    contents = sourcemeta::core::read_file_to_string(path);
+  } catch (...) {
+    std::filesystem::remove(path);
+    return 0;
+  }
+
+  // A state from other inputs may describe outputs no record here touched,
+  // and nothing would tell those apart from the ones that were rebuilt
+  const auto compatible{this->inputs_match ||
+                        (this->entry_count == 0 &&
+                         this->resolver_entry_count == 0)};
+  const auto *bytes{reinterpret_cast<const std::uint8_t *>(contents.data())};
+  if (!compatible || contents.size() < JOURNAL_HEADER_SIZE ||
+      read_field<std::uint32_t>(bytes, 0) != JOURNAL_MAGIC ||
+      read_field<std::uint32_t>(bytes, 4) != JOURNAL_VERSION ||
+      read_field<std::uint32_t>(bytes, 8) != this->rules_fingerprint ||
+      read_field<std::uint64_t>(bytes, 12) != this->inputs_fingerprint) {
+    std::filesystem::remove(path);
+    return 0;
+  }
+
+  std::size_t replayed{0};
+  std::size_t offset{JOURNAL_HEADER_SIZE};
+  while (contents.size() - offset >= JOURNAL_FRAME_SIZE) {
+    const auto length{read_field<std::uint32_t>(bytes, offset)};
+    const auto checksum{
+        read_field<std::uint64_t>(bytes, offset + sizeof(std::uint32_t))};
+    if (length > contents.size() - offset - JOURNAL_FRAME_SIZE) {
+      break;
+    }
+
+    const std::string_view payload{
+        contents.data() + offset + JOURNAL_FRAME_SIZE, length};
+    if (fnv1a(payload.data(), payload.size()) != checksum) {
+      break;
+    }
+
+    try {
+      JournalReader reader{payload};
+      const auto kind{reader.byte()};
+      const auto key{reader.string()};
+      if (kind == JOURNAL_COMMIT) {
+        Entry entry{.file_mark = reader.mark(), .dependencies = {}};
+        std::optional<ArtifactSeal> seal;
+        if (reader.byte() != 0) {
+          seal = ArtifactSeal{.size = reader.qword(),
+                              .checksum = reader.qword()};
+        }
+
+        const auto count{reader.varint()};
+        for (std::uint64_t index = 0; index < count; ++index) {
+          entry.dependencies.emplace_back(reader.string());
+        }
+
+        // An artifact a crash took with it, or left other than it was
+        // committed, is left for the build to produce again
+        const std::filesystem::path artifact{key};
+        std::error_code error;
+        if (seal.has_value() ? BuildState::seal(artifact) == seal
+                             : std::filesystem::exists(artifact, error)) {
+          this->emplace(artifact, std::move(entry), seal);
+        }
+      } else if (kind == JOURNAL_FORGET) {
+        this->forget(std::string{key});
+      } else if (kind == JOURNAL_RESOLVE) {
+        ResolverEntry entry;
+        entry.file_mark = reader.mark();
+        entry.new_identifier = reader.string();
+        entry.original_identifier = reader.string();
+        entry.dialect = reader.string();
+        entry.relative_path = reader.string();
+        this->commit(std::string{key}, std::move(entry));
+      } else {
+        break;
+      }
+    } catch (const std::out_of_range &) {
+      break;
+    }
+
+    offset += JOURNAL_FRAME_SIZE + length;
+    replayed++;
+  }
+
+  // Whatever follows the last whole record is what a write cut short left,
+  // and appending after it would hide every record from then on
+  if (offset < contents.size()) {
+    std::filesystem::resize_file(path, offset);
+  }
+
+  if (replayed > 0) {
+    // Everything the state holds now was built from these inputs, either by
+    // the build that saved it or by the one that wrote the journal. Which
+    // leaves that build got through is anybody's guess, so the state no longer
+    // vouches for a set of them
+    this->inputs_match = true;
+    this->leaves_digest = 0;
+  }
+
+  return replayed;
+}
+
+auto BuildState::journal_append(const std::string_view record) -> void {
+  const auto length{static_cast<std::uint32_t>(record.size())};
+  const auto checksum{fnv1a(record.data(), record.size())};
+  this->journal_buffer.append(reinterpret_cast<const char *>(&length),
+                              sizeof(length));
+  this->journal_buffer.append(reinterpret_cast<const char *>(&checksum),
+                              sizeof(checksum));
+  this->journal_buffer.append(record);
+}
+
+auto BuildState::checkpoint_if_due() -> void {
+  std::unique_lock<std::mutex> journal_lock{this->journal_mutex,
+                                            std::defer_lock};
+  std::string pending;
+  {
+    const auto lock{this->take_lock()};
+    const auto now{std::chrono::steady_clock::now()};
+    if (this->journal_path.empty() || this->journal_buffer.empty() ||
+        (this->journal_buffer.size() < JOURNAL_FLUSH_BYTES &&
+         now - this->journal_flushed < JOURNAL_FLUSH_INTERVAL)) {
+      return;
+    }
+
+    // Another worker is writing out what came before, and whatever piled up
+    // since waits for whoever comes next rather than for the disk
+    if (!journal_lock.try_lock()) {
+      return;
+    }
+
+    pending.swap(this->journal_buffer);
+    this->journal_flushed = now;
+  }
+
+  this->journal_write(pending);
+}
+
+auto BuildState::checkpoint() -> void {
+  const std::lock_guard<std::mutex> journal_lock{this->journal_mutex};
+  std::string pending;
+  {
+    const auto lock{this->take_lock()};
+    if (this->journal_path.empty()) {
+      return;
+    }
+
+    pending.swap(this->journal_buffer);
+    this->journal_flushed = std::chrono::steady_clock::now();
+  }
+
+  this->journal_write(pending);
+}
+
+auto BuildState::journal_write(const std::string &pending) -> void {
+  if (pending.empty()) {
+    return;
+  }
+
+  // Only created once there is something to put in it, so that a build that
+  // fails before committing anything leaves nothing behind. Appended to
+  // otherwise, so that what was replayed stays in it until a saved state
+  // answers for it too
+  if (!this->journal_stream.is_open()) {
+    const auto fresh{!std::filesystem::exists(this->journal_path)};
+    this->journal_stream.open(this->journal_path,
+                              std::ios::binary | std::ios::app);
+    if (!this->journal_stream.is_open()) {
+      const auto lock{this->take_lock()};
+      this->journal_path.clear();
+      this->journal_buffer.clear();
+      return;
+    }
+
+    if (fresh) {
+      sourcemeta::core::BinaryWriter writer{this->journal_stream};
+      writer.put_dword(JOURNAL_MAGIC);
+      writer.put_dword(JOURNAL_VERSION);
+      writer.put_dword(this->rules_fingerprint);
+      writer.put_qword(this->inputs_fingerprint);
+    }
+  }
+
+  this->journal_stream.write(pending.data(),
+                             static_cast<std::streamsize>(pending.size()));
+  this->journal_stream.flush();
+  sourcemeta::core::flush(this->journal_path);
+}
+
+auto BuildState::settle_journal() -> void {
+  const std::lock_guard<std::mutex> journal_lock{this->journal_mutex};
+  if (this->journal_path.empty()) {
+    return;
+  }
+
+  this->journal_stream.close();
+  this->journal_buffer.clear();
+  std::filesystem::remove(this->journal_path);
+  this->journal_path.clear();
+}
+
 auto BuildState::resolve(const std::string &source_path,
                          const std::filesystem::file_time_type mtime) const
     -> const ResolverEntry * {
@@ -541,17 +1443,141 @@ auto BuildState::commit(const std::string &source_path, ResolverEntry entry)
   const auto was_live{this->resolver_overlay.contains(source_path) ||
                       this->probe_slot(source_path, KIND_RESOLVER) != nullptr};
 
-  this->resolver_overlay[source_path] = std::move(entry);
+  auto &result{this->resolver_overlay[source_path]};
+  result = std::move(entry);
 
   if (!was_live) {
     this->resolver_entry_count++;
   }
 
   this->dirty = true;
+
+  if (!this->journal_path.empty()) {
+    std::string record;
+    record.push_back(static_cast<char>(JOURNAL_RESOLVE));
+    append_journal_string(record, source_path);
+    append_journal_mark(record, result.file_mark);
+    append_journal_string(record, result.new_identifier);
+    append_journal_string(record, result.original_identifier);
+    append_journal_string(record, result.dialect);
+    append_journal_string(record, result.relative_path);
+    this->journal_append(record);
+  }
+}
+
+auto BuildState::absorb(const BuildState &other) -> void {
+  // Copied out first, as the keys are views into the other state's cache and
+  // reading an entry through it may populate that state's lazy maps
+  const std::vector<std::string> other_keys{other.keys().begin(),
+                                            other.keys().end()};
+  for (const auto &key : other_keys) {
+    const auto *other_entry{other.entry(key)};
+    if (other_entry != nullptr) {
+      this->emplace(key, *other_entry);
+    }
+  }
+
+  for (const auto &[source_path, resolver_entry] : other.resolver_overlay) {
+    this->commit(source_path, resolver_entry);
+  }
+
+  for (std::uint32_t slot_index = 0; slot_index < other.table_capacity;
+       ++slot_index) {
+    const auto *slot{other.table_slots + slot_index * SLOT_SIZE};
+    if (slot[SLOT_OCCUPIED] == 0 || slot[SLOT_KIND] != KIND_RESOLVER) {
+      continue;
+    }
+
+    const auto key{slot_key(slot, other.string_pool)};
+    if (other.resolver_overlay.contains(key)) {
+      continue;
+    }
+
+    this->commit(std::string{key}, other.parse_slot_resolver_entry(slot));
+  }
+}
+
+auto BuildState::absorb_committed(const BuildState &other) -> void {
+  other.for_each_committed(
+      [this](const std::string_view key, const Entry &other_entry) {
+        this->emplace(key, other_entry);
+      });
+
+  for (const auto &[source_path, resolver_entry] : other.resolver_overlay) {
+    this->commit(source_path, resolver_entry);
+  }
 }
 
 auto BuildState::in_overlay(std::string_view key) const -> bool {
-  return this->overlay.contains(key);
+  return this->overlaid(key);
+}
+
+auto BuildState::spill(const std::filesystem::path &directory) -> void {
+  if (this->overlay.empty() ||
+      (this->spilled && this->overlay.size() < this->spilled->size())) {
+    return;
+  }
+
+  // Every spill carries the ones before it along, so that only the latest file
+  // is ever read from and the rest can go
+  if (!this->spilled) {
+    this->spilled = std::make_unique<BuildState>();
+    this->spilled->configure(
+        this->leaf_rules, this->directories, this->rules_fingerprint,
+        this->inputs_fingerprint,
+        std::string_view{this->sentinel_separator}.substr(
+            1, this->sentinel_separator.size() - 2));
+  }
+
+  for (const auto &key : this->deleted) {
+    if (!this->spilled->deleted.contains(key) &&
+        this->spilled->probe_slot(key, KIND_OUTPUT) != nullptr) {
+      this->spilled->deleted.insert(key);
+      this->spilled->entry_count--;
+      this->spilled->dirty = true;
+    }
+  }
+
+  for (auto &[key, value] : this->overlay) {
+    this->spilled->emplace(key, std::move(value));
+  }
+
+  // Away from the output itself, so that writing it never indexes leaves
+  std::filesystem::create_directories(directory);
+  const auto path{directory / ("state-" +
+                               std::to_string(this->spill_generation++) +
+                               ".bin")};
+  this->spilled->save(path);
+
+  const auto previous{this->spilled->loaded_path};
+  auto next{std::make_unique<BuildState>()};
+  next->load(path, this->leaf_rules, this->directories,
+             this->rules_fingerprint, this->inputs_fingerprint,
+             std::string_view{this->sentinel_separator}.substr(
+                 1, this->sentinel_separator.size() - 2));
+  assert(next->size() == this->spilled->size());
+  this->spilled = std::move(next);
+  if (!previous.empty()) {
+    std::filesystem::remove(previous);
+  }
+
+  this->overlay.clear();
+  this->cached_keys.clear();
+  this->keys_stale = true;
+}
+
+auto BuildState::trim() -> void {
+  this->lazy_cache = {};
+  this->resolver_lazy_cache = {};
+  this->cached_keys = {};
+  this->keys_stale = true;
+  this->leaf_index_cache = {};
+  this->leaf_index_stale = true;
+  this->interned_paths = {};
+  this->path_ids = {};
+  if (this->spilled) {
+    this->spilled->trim();
+  }
 }
 
 auto BuildState::disk_entry(std::string_view key) const -> const Entry * {
@@ -622,7 +1648,7 @@ auto BuildState::build_leaf_index(const std::string &output) const -> void {
   this->leaf_index_output = output;
 
   if (this->persisted_leaf_table != nullptr && this->persisted_leaf_count > 0 &&
-      this->overlay.empty() && this->deleted.empty()) {
+      this->overlay.empty() && this->deleted.empty() && !this->spilled) {
     const auto *cursor{this->persisted_leaf_table};
     for (std::uint32_t index{0}; index < this->persisted_leaf_count; index++) {
       const auto *record{reinterpret_cast<const LeafIndexRecord *>(cursor)};
@@ -658,7 +1684,7 @@ auto BuildState::build_leaf_index(const std::string &output) const -> void {
     }
 
     const auto key{slot_key(slot, this->string_pool)};
-    if (this->deleted.contains(key) || this->overlay.contains(key)) {
+    if (this->deleted.contains(key) || this->overlaid(key)) {
       continue;
     }
 
@@ -677,41 +1703,34 @@ auto BuildState::build_leaf_index(const std::string &output) const -> void {
 
     this->index_leaf_target(mtime, is_explorer, relative_path, filename);
 
-    const auto data_count{read_field<std::uint16_t>(slot, SLOT_DATA_COUNT)};
-    if (data_count > 0) {
-      auto offset{static_cast<std::size_t>(
-          read_field<std::uint32_t>(slot, SLOT_DATA_OFFSET))};
-      for (std::uint16_t dependency_index = 0; dependency_index < data_count;
-           ++dependency_index) {
-        const auto dependency_path{read_pool_string(this->string_pool, offset)};
-        const auto [dep_relative, dep_filename] =
-            split_leaf_base(dependency_path, primary_prefix, secondary_prefix,
-                            secondary_namespaced, this->sentinel_separator);
-        if (!dep_relative.empty() && dep_relative != relative_path) {
-          this->leaf_index_cache[std::string{relative_path}]
-              .has_cross_leaf_deps = true;
-          break;
-        }
+    for (const auto identifier : this->decode_slot_dependencies(slot)) {
+      const auto [dep_relative, dep_filename] = split_leaf_base(
+          this->path(identifier), primary_prefix, secondary_prefix,
+          secondary_namespaced, this->sentinel_separator);
+      if (!dep_relative.empty() && dep_relative != relative_path) {
+        this->leaf_index_cache[std::string{relative_path}].has_cross_leaf_deps =
+            true;
+        break;
       }
     }
   }
 
-  for (const auto &[entry_path, entry_value] : this->overlay) {
+  this->for_each_committed([&](const std::string_view entry_path,
+                               const Entry &entry_value) {
     const auto [relative_path, filename] =
         split_leaf_base(entry_path, primary_prefix, secondary_prefix,
                         secondary_namespaced, this->sentinel_separator);
     if (relative_path.empty()) {
-      continue;
+      return;
     }
 
-    const bool is_explorer{
-        std::string_view{entry_path}.starts_with(secondary_prefix)};
+    const bool is_explorer{entry_path.starts_with(secondary_prefix)};
     this->index_leaf_target(entry_value.file_mark, is_explorer, relative_path,
                             filename);
     this->flag_cross_leaf_dependencies(relative_path, entry_value.dependencies,
                                        primary_prefix, secondary_prefix,
                                        secondary_namespaced);
-  }
+  });
 
   this->leaf_index_stale = false;
 }
@@ -765,6 +1784,7 @@ auto BuildState::save(const std::filesystem::path &path) const -> void {
   std::uint32_t capacity;
 
   std::uint32_t old_pool_size{0};
+  PathTable paths;
   std::unordered_set<std::string, TransparentHash, TransparentEqual>
       overlay_updates;
   std::unordered_set<std::string, TransparentHash, TransparentEqual>
@@ -776,13 +1796,8 @@ auto BuildState::save(const std::filesystem::path &path) const -> void {
     slots.resize(old_slots_size);
     std::memcpy(slots.data(), this->table_slots, old_slots_size);
 
-    sourcemeta::core::BinaryReader pool_size_reader{*this->view};
-    // Layout: [magic, version, fingerprint, inputs, capacity, entry_count,
-    // pool_size, resolver_entry_count], so the pool size is the second dword
-    // from the end. Counted back from the header size rather than written out,
-    // so that adding a field cannot leave this reading the wrong one
-    pool_size_reader.seek(HEADER_SIZE - (2 * sizeof(std::uint32_t)));
-    old_pool_size = pool_size_reader.get_dword();
+    old_pool_size = this->pool_size;
+    paths.seed(this->path_offsets, this->path_bytes, this->path_count);
 
     auto find_slot{[&](std::string_view entry_key) -> std::uint32_t {
       const auto hash{fnv1a(entry_key.data(), entry_key.size())};
@@ -827,11 +1842,12 @@ auto BuildState::save(const std::filesystem::path &path) const -> void {
       }
     }
 
-    for (const auto &[overlay_key, overlay_entry] : this->overlay) {
-      if (find_slot(overlay_key) < capacity) {
-        overlay_updates.insert(overlay_key);
-      }
-    }
+    this->for_each_committed(
+        [&](const std::string_view overlay_key, const Entry &) {
+          if (find_slot(overlay_key) < capacity) {
+            overlay_updates.emplace(overlay_key);
+          }
+        });
 
     for (const auto &[overlay_key, overlay_entry] : this->resolver_overlay) {
       if (find_slot(overlay_key) < capacity) {
@@ -858,7 +1874,7 @@ auto BuildState::save(const std::filesystem::path &path) const -> void {
       const auto key{slot_key(old_slot, this->string_pool)};
 
       if (old_kind == KIND_OUTPUT) {
-        if (this->deleted.contains(key) || this->overlay.contains(key)) {
+        if (this->deleted.contains(key) || this->overlaid(key)) {
           continue;
         }
       } else if (old_kind == KIND_RESOLVER) {
@@ -874,7 +1890,17 @@ auto BuildState::save(const std::filesystem::path &path) const -> void {
           read_field<std::uint16_t>(old_slot, SLOT_DATA_COUNT)};
 
       const auto new_data_offset{static_cast<std::uint32_t>(pool.size())};
-      if (data_count > 0) {
+      // Renumbered against the dictionary being written, which leaves out
+      // whatever only the entries that are gone depended on
+      if (old_kind == KIND_OUTPUT) {
+        std::vector<std::uint32_t> identifiers;
+        identifiers.reserve(data_count);
+        for (const auto identifier : this->decode_slot_dependencies(old_slot)) {
+          identifiers.push_back(paths.intern(this->path(identifier)));
+        }
+
+        append_identifiers(pool, identifiers);
+      } else if (data_count > 0) {
         auto raw_offset{static_cast<std::size_t>(old_data_offset)};
         for (std::uint16_t item_index = 0; item_index < data_count;
              ++item_index) {
@@ -969,7 +1995,8 @@ auto BuildState::save(const std::filesystem::path &path) const -> void {
     slot[SLOT_KIND] = kind;
   }};
 
-  for (const auto &[entry_path, entry] : this->overlay) {
+  this->for_each_committed([&](const std::string_view entry_path,
+                               const Entry &entry) {
     const auto timestamp{static_cast<std::int64_t>(
         std::chrono::duration_cast<std::chrono::nanoseconds>(
             entry.file_mark.time_since_epoch())
@@ -980,13 +2007,17 @@ auto BuildState::save(const std::filesystem::path &path) const -> void {
     assert(entry.dependencies.size() <= UINT16_MAX);
     const auto data_count{
         static_cast<std::uint16_t>(entry.dependencies.size())};
+    std::vector<std::uint32_t> identifiers;
+    identifiers.reserve(data_count);
     for (const auto &dependency : entry.dependencies) {
-      append_pool_string(pool, dependency.native());
+      identifiers.push_back(paths.intern(dependency.native()));
     }
 
+    append_identifiers(pool, identifiers);
+
     write_new_slot(entry_path, timestamp, data_offset, data_count, KIND_OUTPUT,
                    overlay_updates.contains(entry_path));
-  }
+  });
 
   for (const auto &[source_path, cache_entry] : this->resolver_overlay) {
     const auto timestamp{static_cast<std::int64_t>(
@@ -1021,17 +2052,22 @@ auto BuildState::save(const std::filesystem::path &path) const -> void {
       return {pool.data() + offset_in_pool, key_length};
     }};
 
-    auto read_slot_pool_string{[&](std::size_t &offset) -> std::string {
-      if (can_patch && offset < old_pool_size) {
-        return read_pool_string(this->string_pool, offset);
-      }
-      auto adjusted_offset{can_patch ? offset - old_pool_size : offset};
-      auto result{
-          read_pool_string(reinterpret_cast<const std::uint8_t *>(pool.data()),
-                           adjusted_offset)};
-      offset = (can_patch ? old_pool_size : 0) + adjusted_offset;
-      return result;
-    }};
+    // Every identifier in either pool is one of the dictionary being written,
+    // as it was seeded with the one on disk whenever the old pool is kept
+    auto read_slot_identifiers{
+        [&](const std::uint8_t *slot) -> std::vector<std::uint32_t> {
+          const auto offset{read_field<std::uint32_t>(slot, SLOT_DATA_OFFSET)};
+          const auto count{read_field<std::uint16_t>(slot, SLOT_DATA_COUNT)};
+          if (can_patch && offset < old_pool_size) {
+            return read_identifiers(this->string_pool, offset, old_pool_size,
+                                    count, paths.size());
+          }
+
+          return read_identifiers(
+              reinterpret_cast<const std::uint8_t *>(pool.data()),
+              can_patch ? offset - old_pool_size : offset, pool.size(), count,
+              paths.size());
+        }};
 
     const auto output_dir{path.parent_path().string()};
     const auto primary_prefix{output_dir + "/" +
@@ -1076,16 +2112,15 @@ auto BuildState::save(const std::filesystem::path &path) const -> void {
 
       std::unordered_set<std::string, TransparentHash, TransparentEqual>
           affected_leaves;
-      for (const auto &[overlay_key, overlay_entry] : this->overlay) {
-        const auto [relative_path, filename] =
-            split_leaf_base(overlay_key, primary_prefix, secondary_prefix,
-                            secondary_namespaced, this->sentinel_separator);
-        if (relative_path.empty()) {
-          continue;
-        }
-
-        affected_leaves.insert(std::string{relative_path});
-      }
+      this->for_each_committed(
+          [&](const std::string_view overlay_key, const Entry &) {
+            const auto [relative_path, filename] =
+                split_leaf_base(overlay_key, primary_prefix, secondary_prefix,
+                                secondary_namespaced, this->sentinel_separator);
+            if (!relative_path.empty()) {
+              affected_leaves.insert(std::string{relative_path});
+            }
+          });
 
       for (const auto &affected_relative : affected_leaves) {
         auto &leaf_entry{save_leaf_index[affected_relative]};
@@ -1126,16 +2161,10 @@ auto BuildState::save(const std::filesystem::path &path) const -> void {
             }
           }
 
-          const auto data_count{
-              read_field<std::uint16_t>(slot, SLOT_DATA_COUNT)};
-          if (data_count > 0 && !leaf_entry.has_cross_leaf_deps) {
-            auto offset{static_cast<std::size_t>(
-                read_field<std::uint32_t>(slot, SLOT_DATA_OFFSET))};
-            for (std::uint16_t dep_index = 0; dep_index < data_count;
-                 ++dep_index) {
-              const auto dependency_path{read_slot_pool_string(offset)};
+          if (!leaf_entry.has_cross_leaf_deps) {
+            for (const auto identifier : read_slot_identifiers(slot)) {
               const auto [dep_relative, dep_filename] = split_leaf_base(
-                  dependency_path, primary_prefix, secondary_prefix,
+                  paths.at(identifier), primary_prefix, secondary_prefix,
                   secondary_namespaced, this->sentinel_separator);
               if (!dep_relative.empty() && dep_relative != affected_relative) {
                 leaf_entry.has_cross_leaf_deps = true;
@@ -1182,15 +2211,10 @@ auto BuildState::save(const std::filesystem::path &path) const -> void {
           }
         }
 
-        const auto data_count{read_field<std::uint16_t>(slot, SLOT_DATA_COUNT)};
-        if (data_count > 0 && !leaf_entry.has_cross_leaf_deps) {
-          auto offset{static_cast<std::size_t>(
-              read_field<std::uint32_t>(slot, SLOT_DATA_OFFSET))};
-          for (std::uint16_t dep_index = 0; dep_index < data_count;
-               ++dep_index) {
-            const auto dependency_path{read_slot_pool_string(offset)};
+        if (!leaf_entry.has_cross_leaf_deps) {
+          for (const auto identifier : read_slot_identifiers(slot)) {
             const auto [dep_relative, dep_filename] = split_leaf_base(
-                dependency_path, primary_prefix, secondary_prefix,
+                paths.at(identifier), primary_prefix, secondary_prefix,
                 secondary_namespaced, this->sentinel_separator);
             if (!dep_relative.empty() && dep_relative != relative_path) {
               leaf_entry.has_cross_leaf_deps = true;
@@ -1237,6 +2261,9 @@ auto BuildState::save(const std::filesystem::path &path) const -> void {
           writer.put_dword(output_count);
           writer.put_dword(total_pool_size);
           writer.put_dword(resolver_count);
+          writer.put_dword(paths.size());
+          writer.put_dword(static_cast<std::uint32_t>(paths.bytes.size()));
+          writer.put_qword(this->leaves_digest);
 
           writer.put_bytes(reinterpret_cast<const std::byte *>(slots.data()),
                            slots.size());
@@ -1251,6 +2278,28 @@ auto BuildState::save(const std::filesystem::path &path) const -> void {
                              pool.size());
           }
 
+          writer.put_bytes(
+              reinterpret_cast<const std::byte *>(paths.offsets.data()),
+              paths.offsets.size() * sizeof(std::uint32_t));
+          if (!paths.bytes.empty()) {
+            writer.put_bytes(
+                reinterpret_cast<const std::byte *>(paths.bytes.data()),
+                paths.bytes.size());
+          }
+
+          writer.put_dword(
+              static_cast<std::uint32_t>(this->source_revisions.size()));
+          for (const auto &[directory, revision] : this->source_revisions) {
+            writer.put_dword(static_cast<std::uint32_t>(directory.size()));
+            writer.put_bytes(
+                reinterpret_cast<const std::byte *>(directory.data()),
+                directory.size());
+            writer.put_dword(static_cast<std::uint32_t>(revision.size()));
+            writer.put_bytes(
+                reinterpret_cast<const std::byte *>(revision.data()),
+                revision.size());
+          }
+
           writer.put_bytes(
               reinterpret_cast<const std::byte *>(leaf_index_buffer.data()),
               leaf_index_buffer.size());
@@ -1,10 +1,14 @@
 #ifndef SOURCEMETA_ONE_HTTP_H
 #define SOURCEMETA_ONE_HTTP_H
 
+#include <sourcemeta/one/http_access_log.h>
 #include <sourcemeta/one/http_helpers.h>
+#include <sourcemeta/one/http_metrics.h>
 #include <sourcemeta/one/http_request.h>
 #include <sourcemeta/one/http_response.h>
 #include <sourcemeta/one/http_server.h>
+#include <sourcemeta/one/http_timing.h>
 #include <sourcemeta/one/http_uwebsockets.h>
+#include <sourcemeta/one/http_workers.h>
 
 #endif
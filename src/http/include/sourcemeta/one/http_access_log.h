@@ -0,0 +1,371 @@
+#ifndef SOURCEMETA_ONE_HTTP_ACCESS_LOG_H
+#define SOURCEMETA_ONE_HTTP_ACCESS_LOG_H
+
+#include <sourcemeta/core/http.h>
+#include <sourcemeta/core/time.h>
+
+#include <sourcemeta/one/http_request.h>
+#include <sourcemeta/one/http_timing.h>
+
+#include <algorithm>   // std::min
+#include <array>       // std::array
+#include <atomic>      // std::atomic
+#include <cerrno>      // errno, EINTR
+#include <chrono>      // std::chrono
+#include <cstddef>     // std::size_t
+#include <cstdint>     // std::uint8_t, std::uint16_t, std::uint64_t
+#include <cstring>     // std::memcpy
+#include <format>      // std::format_to
+#include <iterator>    // std::back_inserter
+#include <memory>      // std::unique_ptr, std::make_unique
+#include <mutex>       // std::mutex, std::scoped_lock
+#include <optional>    // std::optional, std::nullopt
+#include <string>      // std::string
+#include <string_view> // std::string_view
+#include <thread>      // std::thread, std::this_thread
+#include <unistd.h>    // write, STDERR_FILENO
+#include <vector>      // std::vector
+
+namespace sourcemeta::one {
+
+// One answered request, as the worker that answered it hands it over. Fixed
+// in size and owning nothing, so that handing it over allocates nothing, at
+// the price of cutting a path that is longer than any registry path is
+struct HTTPAccessRecord {
+  std::chrono::system_clock::time_point time;
+  std::chrono::microseconds latency;
+  std::uint64_t bytes;
+  std::uint16_t status;
+  // Always one of the statuses the library defines, which live for as long as
+  // the program does
+  std::string_view status_wire;
+  bool cached;
+  // Only where the request was being timed
+  HTTPTiming timing;
+  std::uint8_t method_length;
+  std::uint8_t view_length;
+  std::uint16_t path_length;
+  std::array<char, 8> method;
+  std::array<char, 32> view;
+  std::array<char, 256> path;
+};
+
+// What the access log writes and how much of it
+struct HTTPAccessLogOptions {
+  enum class Format : std::uint8_t { Text, JSON };
+  Format format{Format::Text};
+  // Log one in this many answered requests. A request that failed is always
+  // logged, as that is what somebody reading the log is after
+  std::uint64_t sample{1};
+};
+
+// Where one worker leaves what it answered for the writer to pick up. Only
+// ever written by that worker and read by the writer, so neither ever waits
+// on the other, and a worker that finds it full drops the record and counts
+// it rather than wait for a log that cannot keep up
+class HTTPAccessRing {
+public:
+  static constexpr std::size_t CAPACITY{1024};
+
+  explicit HTTPAccessRing(const std::thread::id thread) : thread_{thread} {}
+
+  auto push(const HTTPAccessRecord &record) noexcept -> void {
+    const auto head{this->head_.load(std::memory_order_relaxed)};
+    if (head - this->tail_.load(std::memory_order_acquire) == CAPACITY) {
+      this->dropped_.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+
+    this->records_[head % CAPACITY] = record;
+    this->head_.store(head + 1, std::memory_order_release);
+  }
+
+  template <typename Callback> auto drain(Callback callback) -> void {
+    const auto tail{this->tail_.load(std::memory_order_relaxed)};
+    const auto head{this->head_.load(std::memory_order_acquire)};
+    for (auto index{tail}; index < head; index++) {
+      callback(this->records_[index % CAPACITY]);
+    }
+
+    this->tail_.store(head, std::memory_order_release);
+  }
+
+  [[nodiscard]] auto take_dropped() noexcept -> std::uint64_t {
+    return this->dropped_.exchange(0, std::memory_order_relaxed);
+  }
+
+  [[nodiscard]] auto thread() const noexcept -> std::thread::id {
+    return this->thread_;
+  }
+
+  // Only ever touched by the worker that owns the ring
+  std::uint64_t sampled{0};
+
+private:
+  std::array<HTTPAccessRecord, CAPACITY> records_{};
+  // Apart, so that the worker and the writer do not keep taking the same
+  // cache line from each other
+  alignas(64) std::atomic<std::uint64_t> head_{0};
+  alignas(64) std::atomic<std::uint64_t> tail_{0};
+  std::atomic<std::uint64_t> dropped_{0};
+  std::thread::id thread_;
+};
+
+// Writes what every worker answered from a thread of its own, in batches, so
+// that no worker ever waits on the log. Without one running, a line is
+// written there and then by whoever answered, as it always was
+class HTTPAccessLog {
+public:
+  explicit HTTPAccessLog(const HTTPAccessLogOptions &options)
+      : options_{options} {
+    this->writer_ = std::thread{[this]() -> void { this->run(); }};
+    HTTPAccessLog::active_.store(this, std::memory_order_release);
+  }
+
+  // Whatever was handed over before is still written
+  ~HTTPAccessLog() {
+    HTTPAccessLog::active_.store(nullptr, std::memory_order_release);
+    this->stopping_.store(true, std::memory_order_release);
+    this->writer_.join();
+  }
+
+  // To avoid mistakes
+  HTTPAccessLog(const HTTPAccessLog &) = delete;
+  HTTPAccessLog(HTTPAccessLog &&) = delete;
+  auto operator=(const HTTPAccessLog &) -> HTTPAccessLog & = delete;
+  auto operator=(HTTPAccessLog &&) -> HTTPAccessLog & = delete;
+
+  // Taken before answering, as a request read asynchronously is held by the
+  // very handler that goes away with the answer. Nothing when the request is
+  // not sampled
+  [[nodiscard]] static auto capture(const sourcemeta::core::HTTPStatus &status,
+                                    const HTTPRequest &request)
+      -> std::optional<HTTPAccessRecord> {
+    auto *const log{HTTPAccessLog::active_.load(std::memory_order_acquire)};
+    if (log != nullptr && log->options_.sample > 1 && status.code < 400) {
+      auto &ring{log->ring()};
+      if (ring.sampled++ % log->options_.sample != 0) {
+        return std::nullopt;
+      }
+    }
+
+    HTTPAccessRecord record{};
+    record.time = std::chrono::system_clock::now();
+    record.latency = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - request.started());
+    record.status = status.code;
+    record.status_wire = status.wire;
+    record.cached = request.annotated_cached();
+    record.method_length = static_cast<std::uint8_t>(
+        HTTPAccessLog::copy(request.method(), record.method));
+    record.view_length = static_cast<std::uint8_t>(
+        HTTPAccessLog::copy(request.annotated_view(), record.view));
+    record.path_length = static_cast<std::uint16_t>(
+        HTTPAccessLog::copy(request.path(), record.path));
+    return record;
+  }
+
+  // The timings are those the answer went out with, which unlike the request
+  // include compressing it
+  static auto write(const std::optional<HTTPAccessRecord> &record,
+                    const std::uint64_t bytes, const HTTPTiming &timing)
+      -> void {
+    if (!record.has_value()) {
+      return;
+    }
+
+    auto copy{record.value()};
+    copy.bytes = bytes;
+    copy.timing = timing;
+    auto *const log{HTTPAccessLog::active_.load(std::memory_order_acquire)};
+    if (log == nullptr) {
+      std::string line;
+      HTTPAccessLog::format_text(line, copy, std::this_thread::get_id());
+      HTTPAccessLog::flush(line);
+      return;
+    }
+
+    log->ring().push(copy);
+  }
+
+private:
+  template <std::size_t Size>
+  static auto copy(const std::string_view value, std::array<char, Size> &into)
+      -> std::size_t {
+    const auto length{std::min(value.size(), Size)};
+    std::memcpy(into.data(), value.data(), length);
+    return length;
+  }
+
+  // The ring of the calling worker, made the first time it answers anything
+  auto ring() -> HTTPAccessRing & {
+    thread_local HTTPAccessLog *owner{nullptr};
+    thread_local HTTPAccessRing *ring{nullptr};
+    if (owner != this) {
+      const std::scoped_lock guard{this->rings_mutex_};
+      this->rings_.push_back(
+          std::make_unique<HTTPAccessRing>(std::this_thread::get_id()));
+      ring = this->rings_.back().get();
+      owner = this;
+    }
+
+    return *ring;
+  }
+
+  static auto format_text(std::string &output, const HTTPAccessRecord &record,
+                          const std::thread::id thread) -> void {
+    std::format_to(std::back_inserter(output), "[{}] {} {} {} {}",
+                   sourcemeta::core::to_imf_fixdate(record.time), thread,
+                   record.status_wire,
+                   std::string_view{record.method.data(), record.method_length},
+                   std::string_view{record.path.data(), record.path_length});
+    // Spelled as the header was, so that either can be read against the other
+    if (record.timing.enabled()) {
+      output += ' ';
+      record.timing.serialize(output, record.latency);
+    }
+
+    output += '\n';
+  }
+
+  static auto escape(std::string &output, const std::string_view value)
+      -> void {
+    for (const auto character : value) {
+      if (character == '"' || character == '\\') {
+        output += '\\';
+        output += character;
+      } else if (static_cast<unsigned char>(character) < 0x20) {
+        std::format_to(std::back_inserter(output), "\\u{:04x}",
+                       static_cast<unsigned int>(character));
+      } else {
+        output += character;
+      }
+    }
+  }
+
+  static auto format_json(std::string &output, const HTTPAccessRecord &record)
+      -> void {
+    std::format_to(
+        std::back_inserter(output),
+        "{{\"time\":{},\"status\":{},\"method\":\"",
+        std::chrono::duration_cast<std::chrono::milliseconds>(
+            record.time.time_since_epoch())
+            .count(),
+        record.status);
+    HTTPAccessLog::escape(
+        output, std::string_view{record.method.data(), record.method_length});
+    output += "\",\"path\":\"";
+    HTTPAccessLog::escape(
+        output, std::string_view{record.path.data(), record.path_length});
+    output += "\",\"view\":\"";
+    HTTPAccessLog::escape(
+        output, std::string_view{record.view.data(), record.view_length});
+    std::format_to(std::back_inserter(output),
+                   "\",\"latency\":{},\"bytes\":{},\"cached\":{}",
+                   record.latency.count(), record.bytes,
+                   record.cached ? "true" : "false");
+    // In microseconds, like the latency
+    if (record.timing.enabled()) {
+      output += ",\"timing\":{";
+      bool first{true};
+      record.timing.each([&output, &first](const std::string_view name,
+                                           const std::uint32_t microseconds)
+                                  -> void {
+        std::format_to(std::back_inserter(output), "{}\"{}\":{}",
+                       first ? "" : ",", name, microseconds);
+        first = false;
+      });
+
+      output += '}';
+    }
+
+    output += "}\n";
+  }
+
+  // Straight to the descriptor, in one go where it takes it, rather than
+  // through the stream and its lock
+  static auto flush(const std::string_view output) -> void {
+    std::size_t written{0};
+    while (written < output.size()) {
+      const auto result{::write(STDERR_FILENO, output.data() + written,
+                                output.size() - written)};
+      if (result < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+
+        return;
+      }
+
+      written += static_cast<std::size_t>(result);
+    }
+  }
+
+  auto run() -> void {
+    std::string batch;
+    std::vector<HTTPAccessRing *> rings;
+    while (true) {
+      // Read before draining, so that the last pass comes after the last
+      // record any worker could have handed over
+      const auto stopping{this->stopping_.load(std::memory_order_acquire)};
+      {
+        const std::scoped_lock guard{this->rings_mutex_};
+        rings.clear();
+        for (const auto &ring : this->rings_) {
+          rings.push_back(ring.get());
+        }
+      }
+
+      std::uint64_t dropped{0};
+      for (auto *ring : rings) {
+        const auto thread{ring->thread()};
+        ring->drain([this, &batch, thread](const HTTPAccessRecord &record) {
+          if (this->options_.format == HTTPAccessLogOptions::Format::JSON) {
+            HTTPAccessLog::format_json(batch, record);
+          } else {
+            HTTPAccessLog::format_text(batch, record, thread);
+          }
+        });
+
+        dropped += ring->take_dropped();
+      }
+
+      if (dropped > 0) {
+        if (this->options_.format == HTTPAccessLogOptions::Format::JSON) {
+          std::format_to(std::back_inserter(batch), "{{\"dropped\":{}}}\n",
+                         dropped);
+        } else {
+          std::format_to(
+              std::back_inserter(batch),
+              "[{}] {} Dropped {} access log lines, as the log could not "
+              "keep up\n",
+              sourcemeta::core::to_imf_fixdate(
+                  std::chrono::system_clock::now()),
+              std::this_thread::get_id(), dropped);
+        }
+      }
+
+      if (!batch.empty()) {
+        HTTPAccessLog::flush(batch);
+        batch.clear();
+      }
+
+      if (stopping) {
+        return;
+      }
+
+      std::this_thread::sleep_for(std::chrono::milliseconds{20});
+    }
+  }
+
+  HTTPAccessLogOptions options_;
+  std::mutex rings_mutex_;
+  std::vector<std::unique_ptr<HTTPAccessRing>> rings_;
+  std::atomic<bool> stopping_{false};
+  std::thread writer_;
+  static inline std::atomic<HTTPAccessLog *> active_{nullptr};
+};
+
+} // namespace sourcemeta::one
+
+#endif
@@ -7,16 +7,19 @@
 #include <sourcemeta/core/text.h>
 #include <sourcemeta/core/time.h>
 
+#include <sourcemeta/one/http_access_log.h>
+#include <sourcemeta/one/http_metrics.h>
 #include <sourcemeta/one/http_request.h>
 #include <sourcemeta/one/http_response.h>
 #include <sourcemeta/one/shared.h>
 
-#include <algorithm>   // std::ranges::equal
+#include <algorithm>   // std::min, std::ranges::equal
 #include <array>       // std::array
 #include <cassert>     // assert
 #include <chrono>      // std::chrono::system_clock
 #include <cstddef>     // std::size_t
-#include <format>      // std::format
+#include <cstdint>     // std::uint8_t, std::uint64_t
+#include <memory>      // std::shared_ptr
 #include <mutex>       // std::mutex, std::scoped_lock
 #include <optional>    // std::optional
 #include <print>       // std::print
@@ -25,7 +28,7 @@
 #include <string>      // std::string
 #include <string_view> // std::string_view
 #include <thread>      // std::this_thread
-#include <utility>     // std::pair
+#include <utility>     // std::move, std::pair
 #include <vector>      // std::vector
 
 namespace sourcemeta::one {
@@ -193,30 +196,127 @@ inline auto request_body_too_large(const HTTPRequest &request) -> bool {
   return declared.has_value() && declared.value() > MAX_REQUEST_BODY_BYTES;
 }
 
+// What a Range field (RFC 9110 §14.2) asks of a representation of a known
+// size. The server may ignore the field altogether, which it does for any
+// unit other than bytes, for anything malformed, and for more than one range,
+// as answering those as multipart is not worth it for resuming a download.
+// A single range that no byte of the representation satisfies is for RFC 9110
+// §15.5.17 to answer instead
+// https://datatracker.ietf.org/doc/html/rfc9110#section-14.2
+struct HTTPByteRange {
+  enum class Kind : std::uint8_t { Whole, Partial, Unsatisfiable };
+  Kind kind;
+  std::size_t first;
+  std::size_t length;
+};
+
+inline auto http_byte_range(std::string_view field, const std::size_t size)
+    -> HTTPByteRange {
+  const HTTPByteRange WHOLE{
+      .kind = HTTPByteRange::Kind::Whole, .first = 0, .length = size};
+  constexpr std::string_view UNIT{"bytes="};
+  if (field.size() < UNIT.size() ||
+      !std::ranges::equal(field.substr(0, UNIT.size()), UNIT,
+                          [](const char left, const char right) -> bool {
+                            return sourcemeta::core::to_lowercase(left) ==
+                                   right;
+                          })) {
+    return WHOLE;
+  }
+
+  field.remove_prefix(UNIT.size());
+  const auto start{field.find_first_not_of(" \t")};
+  const auto end{field.find_last_not_of(" \t")};
+  if (start == std::string_view::npos ||
+      field.find(',') != std::string_view::npos) {
+    return WHOLE;
+  }
+
+  field = field.substr(start, end - start + 1);
+  const auto dash{field.find('-')};
+  if (dash == std::string_view::npos) {
+    return WHOLE;
+  }
+
+  const auto number{
+      [](const std::string_view digits) -> std::optional<std::uint64_t> {
+        if (digits.empty() ||
+            digits.find_first_not_of("0123456789") != std::string_view::npos) {
+          return std::nullopt;
+        }
+
+        return sourcemeta::core::to_uint64_t(digits);
+      }};
+
+  const auto first{number(field.substr(0, dash))};
+  const auto last{number(field.substr(dash + 1))};
+
+  // A suffix range, such as `-500` for the last 500 bytes
+  if (dash == 0) {
+    if (!last.has_value()) {
+      return WHOLE;
+    }
+
+    if (last.value() == 0 || size == 0) {
+      return {.kind = HTTPByteRange::Kind::Unsatisfiable,
+              .first = 0,
+              .length = 0};
+    }
+
+    const auto length{
+        static_cast<std::size_t>(std::min<std::uint64_t>(last.value(), size))};
+    return {.kind = HTTPByteRange::Kind::Partial,
+            .first = size - length,
+            .length = length};
+  }
+
+  if (!first.has_value() || (dash + 1 < field.size() && !last.has_value()) ||
+      (last.has_value() && last.value() < first.value())) {
+    return WHOLE;
+  }
+
+  if (first.value() >= size) {
+    return {
+        .kind = HTTPByteRange::Kind::Unsatisfiable, .first = 0, .length = 0};
+  }
+
+  const auto final_byte{last.has_value()
+                            ? std::min<std::uint64_t>(last.value(), size - 1)
+                            : size - 1};
+  return {.kind = HTTPByteRange::Kind::Partial,
+          .first = static_cast<std::size_t>(first.value()),
+          .length = static_cast<std::size_t>(final_byte - first.value() + 1)};
+}
+
 // Answering can be the last thing that happens on a connection, and a request
 // read asynchronously is held by the very handler that goes away with it. So
 // what is said about a request is taken while it is certainly still there,
-// which costs nothing, as the line was built either way
+// and only handed to the access log and counted once the answer is out
 inline auto send_response(const sourcemeta::core::HTTPStatus &status,
                           const HTTPRequest &request, HTTPResponse &response)
     -> void {
-  const auto line{
-      std::format("{} {} {}", status.wire, request.method(), request.path())};
-  response.send_without_content();
-  HTTP_LOG(line);
+  const auto record{HTTPAccessLog::capture(status, request)};
+  const auto sample{HTTPMetrics::sample(request)};
+  const auto timing{request.timing()};
+  const auto bytes{response.send_without_content(request, timing)};
+  HTTPAccessLog::write(record, bytes, timing);
+  HTTPMetrics::response(sample, status.code, bytes);
 }
 
 inline auto send_response(
     const sourcemeta::core::HTTPStatus &status, const HTTPRequest &request,
-    HTTPResponse &response, const std::string &message,
+    HTTPResponse &response, const std::string_view message,
     const Encoding current_encoding,
-    const std::optional<std::size_t> precomputed_compressed_size = std::nullopt)
-    -> void {
-  const auto line{
-      std::format("{} {} {}", status.wire, request.method(), request.path())};
-  response.send(request, message, current_encoding,
-                precomputed_compressed_size);
-  HTTP_LOG(line);
+    const std::optional<std::size_t> precomputed_compressed_size = std::nullopt,
+    std::shared_ptr<const void> owner = nullptr) -> void {
+  const auto record{HTTPAccessLog::capture(status, request)};
+  const auto sample{HTTPMetrics::sample(request)};
+  auto timing{request.timing()};
+  const auto bytes{response.send(request, timing, message, current_encoding,
+                                 precomputed_compressed_size,
+                                 std::move(owner))};
+  HTTPAccessLog::write(record, bytes, timing);
+  HTTPMetrics::response(sample, status.code, bytes);
 }
 
 // RFC 9110 §9.3.7: OPTIONS responses describe communication options
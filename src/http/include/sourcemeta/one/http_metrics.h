@@ -0,0 +1,356 @@
+#ifndef SOURCEMETA_ONE_HTTP_METRICS_H
+#define SOURCEMETA_ONE_HTTP_METRICS_H
+
+#include <sourcemeta/one/shared.h>
+
+#include <algorithm>   // std::min, std::clamp, std::ranges::find
+#include <array>       // std::array
+#include <atomic>      // std::atomic
+#include <bit>         // std::bit_width
+#include <chrono>      // std::chrono
+#include <cstddef>     // std::size_t
+#include <cstdint>     // std::uint8_t, std::uint16_t, std::uint64_t
+#include <format>      // std::format_to
+#include <iterator>    // std::back_inserter
+#include <memory>      // std::unique_ptr, std::make_unique
+#include <mutex>       // std::mutex, std::scoped_lock
+#include <string>      // std::string, std::to_string
+#include <string_view> // std::string_view
+#include <vector>      // std::vector
+
+namespace sourcemeta::one {
+
+// Every counter here has exactly one thread writing it, so adding to it is a
+// plain load and store rather than an instruction that locks the cache line,
+// and whoever reads it only ever sees a value it really had
+inline auto http_metric_add(std::atomic<std::uint64_t> &counter,
+                            const std::uint64_t value) noexcept -> void {
+  counter.store(counter.load(std::memory_order_relaxed) + value,
+                std::memory_order_relaxed);
+}
+
+// A distribution of whole numbers, such as microseconds or bytes, kept the way
+// an HDR histogram keeps one: two buckets per power of two, so every bucket is
+// as wide relative to what it holds, in a fixed amount of memory. Anything
+// beyond about a hundred seconds, or a hundred megabytes, shares the last one
+class HTTPHistogram {
+public:
+  static constexpr std::size_t BUCKETS{54};
+
+  [[nodiscard]] static constexpr auto bucket(const std::uint64_t value) noexcept
+      -> std::size_t {
+    if (value < 2) {
+      return static_cast<std::size_t>(value);
+    }
+
+    const auto octave{static_cast<std::size_t>(std::bit_width(value)) - 1};
+    const auto half{static_cast<std::size_t>((value >> (octave - 1)) & 1)};
+    return std::min(octave * 2 + half, BUCKETS - 1);
+  }
+
+  // The largest value a bucket holds. The last one holds everything beyond
+  [[nodiscard]] static constexpr auto upper(const std::size_t index) noexcept
+      -> std::uint64_t {
+    if (index < 2) {
+      return index;
+    }
+
+    const auto octave{index / 2};
+    const auto half{index % 2};
+    return (std::uint64_t{1} << octave) +
+           (static_cast<std::uint64_t>(half + 1) << (octave - 1)) - 1;
+  }
+
+  auto record(const std::uint64_t value) noexcept -> void {
+    http_metric_add(this->buckets_[HTTPHistogram::bucket(value)], 1);
+    http_metric_add(this->sum_, value);
+  }
+
+  // What one or more histograms held at some point while they were read
+  struct Totals {
+    std::array<std::uint64_t, BUCKETS> buckets{};
+    std::uint64_t sum{0};
+    std::uint64_t count{0};
+  };
+
+  auto add_to(Totals &totals) const noexcept -> void {
+    for (std::size_t index{0}; index < BUCKETS; index++) {
+      const auto value{this->buckets_[index].load(std::memory_order_relaxed)};
+      totals.buckets[index] += value;
+      totals.count += value;
+    }
+
+    totals.sum += this->sum_.load(std::memory_order_relaxed);
+  }
+
+private:
+  std::array<std::atomic<std::uint64_t>, BUCKETS> buckets_{};
+  std::atomic<std::uint64_t> sum_{0};
+};
+
+// What the server counts about itself, kept by every thread on its own so that
+// nothing answering a request ever waits on another, and only summed up when
+// somebody asks for it. A request is counted under the operation its route was
+// registered with, which is interned once when a router is read rather than
+// looked up while answering
+class HTTPMetrics {
+public:
+  // Enough for every route a registry has, with room for reloads to add more.
+  // The first stands for requests answered before routing and for whatever
+  // does not fit
+  static constexpr std::size_t OPERATIONS{128};
+
+  // What the gate made of a request that reached a route
+  enum class Gate : std::uint8_t { Ungated, Admitted, Refused };
+
+  // The same name always comes back as the same operation, across reloads too
+  static auto operation(const std::string_view name) -> std::uint16_t {
+    auto &registry{HTTPMetrics::registry()};
+    const std::scoped_lock guard{registry.mutex};
+    const auto match{std::ranges::find(registry.operations, name)};
+    if (match != registry.operations.end()) {
+      return static_cast<std::uint16_t>(match - registry.operations.begin());
+    } else if (registry.operations.size() == OPERATIONS) {
+      return 0;
+    }
+
+    registry.operations.emplace_back(name);
+    return static_cast<std::uint16_t>(registry.operations.size() - 1);
+  }
+
+  // What counting an answer needs of its request, which has to be taken
+  // before answering, as the request may not outlive the answer
+  struct Sample {
+    std::uint16_t operation;
+    Encoding encoding;
+    std::chrono::steady_clock::time_point started;
+  };
+
+  template <typename Request>
+  [[nodiscard]] static auto sample(const Request &request) noexcept -> Sample {
+    return {.operation = request.annotated_operation(),
+            .encoding = request.response_encoding(),
+            .started = request.started()};
+  }
+
+  static auto response(const Sample &sample, const std::uint16_t status,
+                       const std::uint64_t bytes) -> void {
+    auto &shard{HTTPMetrics::shard()};
+    auto &entry{
+        shard.operations[sample.operation < OPERATIONS ? sample.operation : 0]};
+    http_metric_add(
+        entry.statuses[std::clamp<std::size_t>(status / 100, 1, 5) - 1], 1);
+    entry.latency.record(HTTPMetrics::whole(
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - sample.started)));
+    http_metric_add(shard.bytes[static_cast<std::size_t>(sample.encoding)],
+                    bytes);
+  }
+
+  static auto gate(const Gate outcome) -> void {
+    http_metric_add(
+        HTTPMetrics::shard().gates[static_cast<std::size_t>(outcome)], 1);
+  }
+
+  static auto evaluation(const std::chrono::microseconds duration) -> void {
+    HTTPMetrics::shard().evaluation.record(HTTPMetrics::whole(duration));
+  }
+
+  static auto request_body(const std::uint64_t bytes) -> void {
+    HTTPMetrics::shard().body.record(bytes);
+  }
+
+  // In the Prometheus text exposition format
+  static auto expose(std::string &output) -> void {
+    auto &registry{HTTPMetrics::registry()};
+    std::vector<std::string> operations;
+    std::vector<const Shard *> shards;
+    {
+      const std::scoped_lock guard{registry.mutex};
+      operations = registry.operations;
+      for (const auto &shard : registry.shards) {
+        shards.push_back(shard.get());
+      }
+    }
+
+    auto out{std::back_inserter(output)};
+    std::format_to(out, "# HELP sourcemeta_one_requests_total Requests "
+                        "answered, by operation and status class\n"
+                        "# TYPE sourcemeta_one_requests_total counter\n");
+    std::vector<HTTPHistogram::Totals> latencies(operations.size());
+    for (std::size_t operation{0}; operation < operations.size();
+         operation++) {
+      std::array<std::uint64_t, 5> statuses{};
+      for (const auto *shard : shards) {
+        const auto &entry{shard->operations[operation]};
+        for (std::size_t index{0}; index < statuses.size(); index++) {
+          statuses[index] +=
+              entry.statuses[index].load(std::memory_order_relaxed);
+        }
+
+        entry.latency.add_to(latencies[operation]);
+      }
+
+      for (std::size_t index{0}; index < statuses.size(); index++) {
+        if (statuses[index] > 0) {
+          std::format_to(out,
+                         "sourcemeta_one_requests_total{{operation=\"{}\","
+                         "status=\"{}xx\"}} {}\n",
+                         operations[operation], index + 1, statuses[index]);
+        }
+      }
+    }
+
+    std::format_to(out, "# HELP sourcemeta_one_request_duration_seconds Time "
+                        "from receiving a request to answering it\n"
+                        "# TYPE sourcemeta_one_request_duration_seconds "
+                        "histogram\n");
+    for (std::size_t operation{0}; operation < operations.size();
+         operation++) {
+      if (latencies[operation].count > 0) {
+        HTTPMetrics::expose_histogram(
+            output, "sourcemeta_one_request_duration_seconds",
+            std::format("operation=\"{}\",", operations[operation]),
+            latencies[operation], true);
+      }
+    }
+
+    std::array<std::uint64_t, 2> bytes{};
+    std::array<std::uint64_t, 3> gates{};
+    HTTPHistogram::Totals evaluation;
+    HTTPHistogram::Totals body;
+    for (const auto *shard : shards) {
+      for (std::size_t index{0}; index < bytes.size(); index++) {
+        bytes[index] += shard->bytes[index].load(std::memory_order_relaxed);
+      }
+
+      for (std::size_t index{0}; index < gates.size(); index++) {
+        gates[index] += shard->gates[index].load(std::memory_order_relaxed);
+      }
+
+      shard->evaluation.add_to(evaluation);
+      shard->body.add_to(body);
+    }
+
+    std::format_to(
+        out,
+        "# HELP sourcemeta_one_response_bytes_total Bytes of content sent, by "
+        "the encoding they were sent in\n"
+        "# TYPE sourcemeta_one_response_bytes_total counter\n"
+        "sourcemeta_one_response_bytes_total{{encoding=\"identity\"}} {}\n"
+        "sourcemeta_one_response_bytes_total{{encoding=\"gzip\"}} {}\n"
+        "# HELP sourcemeta_one_authentication_total Requests that reached a "
+        "route, by what the gate made of them\n"
+        "# TYPE sourcemeta_one_authentication_total counter\n"
+        "sourcemeta_one_authentication_total{{outcome=\"ungated\"}} {}\n"
+        "sourcemeta_one_authentication_total{{outcome=\"admitted\"}} {}\n"
+        "sourcemeta_one_authentication_total{{outcome=\"refused\"}} {}\n",
+        bytes[static_cast<std::size_t>(Encoding::Identity)],
+        bytes[static_cast<std::size_t>(Encoding::GZIP)],
+        gates[static_cast<std::size_t>(Gate::Ungated)],
+        gates[static_cast<std::size_t>(Gate::Admitted)],
+        gates[static_cast<std::size_t>(Gate::Refused)]);
+
+    std::format_to(out, "# HELP sourcemeta_one_evaluation_duration_seconds "
+                        "Time spent evaluating an instance against a schema\n"
+                        "# TYPE sourcemeta_one_evaluation_duration_seconds "
+                        "histogram\n");
+    HTTPMetrics::expose_histogram(output,
+                                  "sourcemeta_one_evaluation_duration_seconds",
+                                  "", evaluation, true);
+    std::format_to(out, "# HELP sourcemeta_one_request_body_bytes Size of "
+                        "the request bodies that were read\n"
+                        "# TYPE sourcemeta_one_request_body_bytes "
+                        "histogram\n");
+    HTTPMetrics::expose_histogram(output, "sourcemeta_one_request_body_bytes",
+                                  "", body, false);
+  }
+
+private:
+  struct Operation {
+    // From 1xx to 5xx
+    std::array<std::atomic<std::uint64_t>, 5> statuses{};
+    HTTPHistogram latency;
+  };
+
+  struct Shard {
+    std::array<Operation, OPERATIONS> operations{};
+    // By the encoding the content was sent in
+    std::array<std::atomic<std::uint64_t>, 2> bytes{};
+    std::array<std::atomic<std::uint64_t>, 3> gates{};
+    HTTPHistogram evaluation;
+    HTTPHistogram body;
+  };
+
+  struct Registry {
+    std::mutex mutex;
+    // Kept for as long as the process runs, so that nothing a thread counted
+    // is lost when it ends
+    std::vector<std::unique_ptr<Shard>> shards;
+    std::vector<std::string> operations{"other"};
+  };
+
+  static auto registry() -> Registry & {
+    static Registry instance;
+    return instance;
+  }
+
+  // The shard of the calling thread, made the first time it counts anything,
+  // which is the one time it takes the lock
+  static auto shard() -> Shard & {
+    thread_local Shard *current{nullptr};
+    if (current == nullptr) {
+      auto &registry{HTTPMetrics::registry()};
+      const std::scoped_lock guard{registry.mutex};
+      registry.shards.push_back(std::make_unique<Shard>());
+      current = registry.shards.back().get();
+    }
+
+    return *current;
+  }
+
+  // A clock that went backwards is not a negative duration
+  static auto whole(const std::chrono::microseconds duration) noexcept
+      -> std::uint64_t {
+    return duration.count() < 0 ? 0
+                                : static_cast<std::uint64_t>(duration.count());
+  }
+
+  // Microseconds as seconds, without going through floating point
+  static auto seconds(const std::uint64_t microseconds) -> std::string {
+    return std::format("{}.{:06}", microseconds / 1000000,
+                       microseconds % 1000000);
+  }
+
+  static auto expose_histogram(std::string &output, const std::string_view name,
+                               const std::string_view labels,
+                               const HTTPHistogram::Totals &totals,
+                               const bool microseconds) -> void {
+    auto out{std::back_inserter(output)};
+    std::uint64_t cumulative{0};
+    for (std::size_t index{0}; index + 1 < HTTPHistogram::BUCKETS; index++) {
+      cumulative += totals.buckets[index];
+      const auto upper{HTTPHistogram::upper(index)};
+      std::format_to(out, "{}_bucket{{{}le=\"{}\"}} {}\n", name, labels,
+                     microseconds ? HTTPMetrics::seconds(upper)
+                                  : std::to_string(upper),
+                     cumulative);
+    }
+
+    std::format_to(out, "{}_bucket{{{}le=\"+Inf\"}} {}\n", name, labels,
+                   totals.count);
+    // Without the separator that precedes the bucket bound
+    const auto series{
+        labels.empty()
+            ? std::string{}
+            : std::format("{{{}}}", labels.substr(0, labels.size() - 1))};
+    std::format_to(out, "{}_sum{} {}\n{}_count{} {}\n", name, series,
+                   microseconds ? HTTPMetrics::seconds(totals.sum)
+                                : std::to_string(totals.sum),
+                   name, series, totals.count);
+  }
+};
+
+} // namespace sourcemeta::one
+
+#endif
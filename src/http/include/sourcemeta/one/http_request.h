@@ -3,13 +3,17 @@
 
 #include <sourcemeta/core/http.h>
 #include <sourcemeta/core/uri.h>
+#include <sourcemeta/one/shared.h>
 
+#include <sourcemeta/one/http_metrics.h>
 #include <sourcemeta/one/http_response.h>
+#include <sourcemeta/one/http_timing.h>
 #include <sourcemeta/one/http_uwebsockets.h>
 
-#include <chrono>      // std::chrono::system_clock
+#include <chrono>      // std::chrono::system_clock, std::chrono::steady_clock
 #include <concepts>    // std::invocable
 #include <cstddef>     // std::size_t
+#include <cstdint>     // std::uint16_t
 #include <exception>   // std::exception_ptr, std::current_exception
 #include <memory>      // std::shared_ptr, std::make_shared
 #include <optional>    // std::optional
@@ -30,14 +34,26 @@ public:
   // Primary constructor from raw uWebSockets pointers
   HTTPRequest(uWS::HttpRequest *request,
               uWS::HttpResponse<true> *response) noexcept
-      : request_{request}, response_{response} {}
+      : request_{request}, response_{response},
+        started_{std::chrono::steady_clock::now()} {
+    // Only a server started with timing on ever looks any further
+    if (HTTPTiming::mode() != HTTPTiming::Mode::Off) [[unlikely]] {
+      if (HTTPTiming::mode() == HTTPTiming::Mode::Always ||
+          this->header_exists("x-server-timing")) {
+        this->timing_.enable();
+      }
+    }
+  }
 
   // Snapshot constructor for async contexts where uWS::HttpRequest is gone
   HTTPRequest(std::string method, std::string path,
               sourcemeta::one::Encoding encoding,
-              uWS::HttpResponse<true> *response) noexcept
+              uWS::HttpResponse<true> *response,
+              const std::chrono::steady_clock::time_point started =
+                  std::chrono::steady_clock::now()) noexcept
       : request_{nullptr}, response_{response}, method_{std::move(method)},
-        path_{std::move(path)}, response_encoding_{encoding} {}
+        path_{std::move(path)}, response_encoding_{encoding},
+        started_{started} {}
 
   auto negotiate() -> void {
     const auto chosen{sourcemeta::core::http_negotiate_encoding(
@@ -136,6 +152,68 @@ public:
     return this->response_encoding_;
   }
 
+  // When the request arrived, which is what its latency is measured from
+  [[nodiscard]] auto started() const noexcept
+      -> std::chrono::steady_clock::time_point {
+    return this->started_;
+  }
+
+  // What the access log says about a request beyond what it asked for. The
+  // view is one the caller was placed in, and has to outlive the request,
+  // which the views of an authentication table do for as long as whatever
+  // holds the table is retained
+  auto annotate_view(const std::string_view view) noexcept -> void {
+    this->view_ = view;
+  }
+
+  [[nodiscard]] auto annotated_view() const noexcept -> std::string_view {
+    return this->view_;
+  }
+
+  // The operation the route that took the request was registered with, as
+  // interned for counting
+  auto annotate_operation(const std::uint16_t operation) noexcept -> void {
+    this->operation_ = operation;
+  }
+
+  [[nodiscard]] auto annotated_operation() const noexcept -> std::uint16_t {
+    return this->operation_;
+  }
+
+  // The span answering this request stands for, for whatever is done on its
+  // behalf once the handler that opened it is gone
+  auto annotate_trace(const TraceContext &context) noexcept -> void {
+    this->trace_ = context;
+  }
+
+  // Answered out of something kept from before rather than worked out again
+  auto annotate_cached() noexcept -> void { this->cached_ = true; }
+
+  [[nodiscard]] auto annotated_cached() const noexcept -> bool {
+    return this->cached_;
+  }
+
+  // Where the time answering this request has gone so far
+  [[nodiscard]] auto timing() noexcept -> HTTPTiming & { return this->timing_; }
+
+  [[nodiscard]] auto timing() const noexcept -> const HTTPTiming & {
+    return this->timing_;
+  }
+
+  // Keep something alive for as long as this request is being answered, which
+  // for a request with a body is until the body has been read, as whoever
+  // reads it does so long after the handler that asked for it returned
+  auto retain(std::shared_ptr<const void> owner) noexcept -> void {
+    this->retained_ = std::move(owner);
+  }
+
+  // Whatever is being kept alive for this request, for content that points
+  // into it and goes out after the handler returns
+  [[nodiscard]] auto retained() const noexcept
+      -> const std::shared_ptr<const void> & {
+    return this->retained_;
+  }
+
   // Read the entire request body asynchronously.
   // - callback: Invoked with (response, body, too_big) on completion
   // - on_error: Invoked with (response, exception_ptr) on any exception,
@@ -149,7 +227,12 @@ public:
     auto raw_response = this->response_;
     auto snapshot = std::make_shared<HTTPRequest>(
         std::string{this->method()}, std::string{this->path()},
-        this->response_encoding_, raw_response);
+        this->response_encoding_, raw_response, this->started_);
+    snapshot->view_ = this->view_;
+    snapshot->cached_ = this->cached_;
+    snapshot->operation_ = this->operation_;
+    snapshot->timing_ = this->timing_;
+    snapshot->trace_ = this->trace_;
     auto buffer = std::make_shared<std::string>();
     auto completed = std::make_shared<bool>(false);
 
@@ -159,11 +242,15 @@ public:
     raw_response->onData(
         // NOLINTNEXTLINE(bugprone-exception-escape)
         [raw_response, snapshot, buffer, completed, max_size, callback,
-         on_error](std::string_view chunk, bool is_last) mutable -> void {
+         on_error, retained = this->retained_](std::string_view chunk,
+                                               bool is_last) mutable -> void {
           if (*completed) {
             return;
           }
 
+          // Whatever reading the body leads to is part of answering it
+          const HTTPTiming::Current current{snapshot->timing_};
+          const TraceContext::Adopt trace{snapshot->trace_};
           try {
             if (buffer->size() + chunk.size() > max_size) {
               *completed = true;
@@ -181,6 +268,7 @@ public:
 
             if (is_last) {
               *completed = true;
+              HTTPMetrics::request_body(buffer->size());
               HTTPResponse response{raw_response};
               try {
                 callback(*snapshot, response, std::move(*buffer), false);
@@ -204,6 +292,13 @@ private:
   bool satisfiable_encoding_{true};
   sourcemeta::one::Encoding response_encoding_{
       sourcemeta::one::Encoding::Identity};
+  std::chrono::steady_clock::time_point started_;
+  std::string_view view_;
+  bool cached_{false};
+  std::uint16_t operation_{0};
+  HTTPTiming timing_;
+  TraceContext trace_;
+  std::shared_ptr<const void> retained_;
 };
 
 } // namespace sourcemeta::one
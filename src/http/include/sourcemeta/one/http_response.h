@@ -5,10 +5,14 @@
 #include <sourcemeta/core/http.h>
 #include <sourcemeta/one/shared.h>
 
+#include <sourcemeta/one/http_timing.h>
 #include <sourcemeta/one/http_uwebsockets.h>
 
+#include <cassert>     // assert
+#include <chrono>      // std::chrono::steady_clock
 #include <cstddef>     // std::size_t
-#include <cstdint>     // std::uint8_t
+#include <cstdint>     // std::uint8_t, std::uintmax_t
+#include <memory>      // std::shared_ptr, std::make_shared
 #include <optional>    // std::optional
 #include <string>      // std::string
 #include <string_view> // std::string_view
@@ -18,6 +22,14 @@ namespace sourcemeta::one {
 
 class HTTPResponse {
 public:
+  // Content up to this size is handed to the socket in one go, which keeps
+  // whatever the client is not ready for yet in a buffer of its own. Anything
+  // larger is written only as fast as the client reads it, so that however
+  // many slow clients are downloading, none holds more than this much beyond
+  // the content itself
+  static constexpr std::size_t STREAM_THRESHOLD{static_cast<std::size_t>(64) *
+                                                1024};
+
   HTTPResponse(uWS::HttpResponse<true> *response) noexcept
       : response_{response} {}
 
@@ -34,13 +46,29 @@ public:
     return this->response_;
   }
 
-  auto send_without_content() -> void { this->response_->end(); }
+  auto send_without_content() -> std::size_t {
+    this->response_->end();
+    return 0;
+  }
 
   template <typename Request>
-  auto send(const Request &request, const std::string &message,
-            const Encoding current_encoding,
+  auto send_without_content(const Request &request, const HTTPTiming &timing)
+      -> std::size_t {
+    this->write_timing(request, timing);
+    return this->send_without_content();
+  }
+
+  // Returns how many bytes of content go out, which is none for HEAD. Any
+  // compression is timed into the given timings rather than into the request,
+  // as those are what outlive the answer. Content that has to be streamed is
+  // kept alive by the given owner, or copied if there is none
+  template <typename Request>
+  auto send(const Request &request, HTTPTiming &timing,
+            const std::string_view message, const Encoding current_encoding,
             const std::optional<std::size_t> precomputed_compressed_size =
-                std::nullopt) -> void {
+                std::nullopt,
+            std::shared_ptr<const void> owner = nullptr) -> std::size_t {
+    HTTPTiming *const timed{timing.enabled() ? &timing : nullptr};
     const auto method{request.method()};
     const auto expected_encoding{request.response_encoding()};
     if (expected_encoding == Encoding::GZIP) {
@@ -53,50 +81,131 @@ public:
         // precomputed compressed size, so we can answer HEAD without
         // running the compressor just to discard its output.
         if (method == "head" && precomputed_compressed_size.has_value()) {
+          this->write_timing(request, timing);
           this->response_->endWithoutBody(precomputed_compressed_size);
           this->response_->end();
         } else {
-          auto effective_message{sourcemeta::core::gzip(
-              reinterpret_cast<const std::uint8_t *>(message.data()),
-              message.size())};
+          auto effective_message{[timed, &message] {
+            const HTTPTimingScope scope{HTTPTiming::Stage::Compression, timed};
+            return sourcemeta::core::gzip(
+                reinterpret_cast<const std::uint8_t *>(message.data()),
+                message.size());
+          }()};
+          this->write_timing(request, timing);
           if (method == "head") {
             this->response_->endWithoutBody(effective_message.size());
             this->response_->end();
           } else {
-            this->response_->end(std::move(effective_message));
+            const auto size{effective_message.size()};
+            this->end(std::move(effective_message));
+            return size;
           }
         }
       } else {
+        this->write_timing(request, timing);
         if (method == "head") {
           this->response_->endWithoutBody(message.size());
           this->response_->end();
         } else {
-          this->response_->end(message);
+          this->end(message, std::move(owner));
+          return message.size();
         }
       }
     } else if (expected_encoding == Encoding::Identity) {
       if (current_encoding == Encoding::GZIP) {
-        auto effective_message{sourcemeta::core::gunzip(
-            reinterpret_cast<const std::uint8_t *>(message.data()),
-            message.size())};
+        auto effective_message{[timed, &message] {
+          const HTTPTimingScope scope{HTTPTiming::Stage::Compression, timed};
+          return sourcemeta::core::gunzip(
+              reinterpret_cast<const std::uint8_t *>(message.data()),
+              message.size());
+        }()};
+        this->write_timing(request, timing);
         if (method == "head") {
           this->response_->endWithoutBody(effective_message.size());
           this->response_->end();
         } else {
-          this->response_->end(effective_message);
+          const auto size{effective_message.size()};
+          this->end(std::move(effective_message));
+          return size;
         }
       } else {
+        this->write_timing(request, timing);
         if (method == "head") {
           this->response_->endWithoutBody(message.size());
           this->response_->end();
         } else {
-          this->response_->end(message);
+          this->end(message, std::move(owner));
+          return message.size();
         }
       }
     }
+
+    return 0;
   }
 
 private:
+  auto end(const std::string_view content, std::shared_ptr<const void> owner)
+      -> void {
+    if (content.size() <= STREAM_THRESHOLD) {
+      this->response_->end(content);
+    } else if (owner) {
+      this->stream(content, std::move(owner));
+    } else {
+      this->end(std::string{content});
+    }
+  }
+
+  auto end(std::string &&content) -> void {
+    if (content.size() <= STREAM_THRESHOLD) {
+      this->response_->end(content);
+    } else {
+      auto owned{std::make_shared<const std::string>(std::move(content))};
+      const std::string_view view{*owned};
+      this->stream(view, std::move(owned));
+    }
+  }
+
+  // Offers the socket as much of the content as it takes without buffering,
+  // and the rest each time it drains, for as long as the connection lasts.
+  // uWebSockets drops both callbacks, and with them the owner, once the last
+  // byte is out or the client goes away
+  auto stream(const std::string_view content, std::shared_ptr<const void> owner)
+      -> void {
+    if (HTTPResponse::pump(this->response_, content)) {
+      return;
+    }
+
+    auto *const response{this->response_};
+    response->onWritable(
+        [response, content,
+         owner = std::move(owner)](const std::uintmax_t) -> bool {
+          return HTTPResponse::pump(response, content);
+        });
+    // Returning with the response still pending requires one
+    response->onAborted([]() -> void {});
+  }
+
+  // Whether the socket took all that was left of the content. It only counts
+  // the content, so where it is up to is where the next write starts
+  static auto pump(uWS::HttpResponse<true> *const response,
+                   const std::string_view content) -> bool {
+    const auto offset{static_cast<std::size_t>(response->getWriteOffset())};
+    assert(offset <= content.size());
+    return response->tryEnd(content.substr(offset), content.size()).first;
+  }
+
+  // The last header to go out, as everything it reports on has happened by
+  // then. The total runs from when the request arrived
+  template <typename Request>
+  auto write_timing(const Request &request, const HTTPTiming &timing) -> void {
+    if (timing.enabled()) [[unlikely]] {
+      std::string value;
+      timing.serialize(value,
+                       std::chrono::steady_clock::now() - request.started());
+      this->response_->writeHeader("Server-Timing", value);
+    }
+  }
+
   uWS::HttpResponse<true> *response_;
 };
 
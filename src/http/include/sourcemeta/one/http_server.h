@@ -4,20 +4,22 @@
 #include <sourcemeta/one/http_request.h>
 #include <sourcemeta/one/http_response.h>
 #include <sourcemeta/one/http_uwebsockets.h>
+#include <sourcemeta/one/http_workers.h>
 
-#include <algorithm>   // std::max
-#include <atomic>      // std::atomic
-#include <cassert>     // assert
-#include <chrono>      // std::chrono::milliseconds
-#include <csignal>     // std::signal, SIGINT, SIGTERM
-#include <cstdint>     // std::uint16_t
-#include <latch>       // std::latch
-#include <memory>      // std::unique_ptr, std::make_unique
-#include <mutex>       // std::mutex, std::scoped_lock
-#include <string_view> // std::string_view
-#include <thread>      // std::thread, std::thread::hardware_concurrency
-#include <unistd.h>    // write, STDERR_FILENO
-#include <vector>      // std::vector
+#include <algorithm>          // std::max
+#include <atomic>             // std::atomic
+#include <cassert>            // assert
+#include <chrono>             // std::chrono::milliseconds
+#include <condition_variable> // std::condition_variable
+#include <csignal>            // std::signal, SIGINT, SIGTERM
+#include <cstdint>            // std::uint16_t
+#include <latch>              // std::latch
+#include <memory>             // std::unique_ptr, std::make_unique
+#include <mutex>              // std::mutex, std::unique_lock
+#include <string_view>        // std::string_view
+#include <thread>             // std::thread
+#include <unistd.h>           // write, close, STDERR_FILENO
+#include <vector>             // std::vector
 
 namespace sourcemeta::one {
 
@@ -35,10 +37,10 @@ class HTTPServer {
 public:
   template <typename RequestHandler, typename ListenCallback,
             typename ErrorCallback>
-  HTTPServer(const std::uint16_t port, RequestHandler on_request,
-             ListenCallback on_listen, ErrorCallback on_error) {
-    HTTPServer::concurrency_ =
-        std::max(1u, std::thread::hardware_concurrency());
+  HTTPServer(const std::uint16_t port, const HTTPServerWorkers &workers,
+             RequestHandler on_request, ListenCallback on_listen,
+             ErrorCallback on_error) {
+    HTTPServer::concurrency_ = std::max(1u, workers.count);
     HTTPServer::round_robin_.store(0, std::memory_order_relaxed);
     HTTPServer::should_stop_.store(false, std::memory_order_relaxed);
     HTTPServer::workers_alive_.store(HTTPServer::concurrency_,
@@ -86,13 +88,24 @@ public:
     std::latch setup_barrier{
         static_cast<std::ptrdiff_t>(HTTPServer::concurrency_ + 1)};
     std::mutex setup_mutex;
+    // The kernel numbers the sockets sharing a port in the order they were
+    // bound, which is what steering by CPU picks them by, so every worker
+    // binds in turn rather than as soon as it gets there
+    std::condition_variable setup_turn;
+    unsigned int next_listener{0};
+    const auto cpus{workers.pin ? http_allowed_cpus()
+                                : std::vector<unsigned int>{}};
 
     std::vector<std::unique_ptr<std::thread>> threads;
     threads.reserve(HTTPServer::concurrency_);
     for (unsigned int index{0}; index < HTTPServer::concurrency_; ++index) {
       threads.emplace_back(std::make_unique<std::thread>(
           [index, port, &on_request, &on_listen, &on_error, &setup_barrier,
-           &setup_mutex]() -> void {
+           &setup_mutex, &setup_turn, &next_listener, &cpus]() -> void {
+            if (!cpus.empty()) {
+              http_pin_thread(cpus[index % cpus.size()]);
+            }
+
             // uWS provides slow-loris protection out of the box, so
             // we don't have to configure any of it ourselves.
             uWS::SocketContextOptions options{};
@@ -115,12 +128,23 @@ public:
                 });
 
             {
-              std::scoped_lock guard{setup_mutex};
+              std::unique_lock guard{setup_mutex};
+              setup_turn.wait(guard, [index, &next_listener]() -> bool {
+                return next_listener == index;
+              });
               app->listen(
                   static_cast<int>(port),
-                  [port, &on_listen,
-                   &on_error](us_listen_socket_t *const socket) -> void {
+                  [index, port, &on_listen, &on_error,
+                   &cpus](us_listen_socket_t *const socket) -> void {
                     if (socket) {
+                      // Once for the whole group, which is every socket bound
+                      // to the port, and so only once there is one
+                      if (index == 0 && !cpus.empty()) {
+                        http_steer_by_cpu(
+                            us_poll_fd(reinterpret_cast<us_poll_t *>(socket)),
+                            HTTPServer::concurrency_);
+                      }
+
                       const auto bound_port{
                           static_cast<std::uint16_t>(us_socket_local_port(
                               true,
@@ -132,12 +156,17 @@ public:
                       on_error(port);
                     }
                   });
+              next_listener += 1;
+              setup_turn.notify_all();
             }
 
-            // Install preOpen for round-robin load balancing before
-            // signaling readiness, so no connections arrive without
-            // the hook active
+            // Install preOpen before signaling readiness, so no
+            // connections arrive without the hook active
+#if defined(__linux__)
+            app->preOpen(HTTPServer::accept_here);
+#else
             app->preOpen(HTTPServer::load_balance);
+#endif
 
             // Publish this app and wait for all threads to finish
             // setup before entering the event loop
@@ -212,6 +241,26 @@ private:
     HTTPServer::should_stop_.store(true, std::memory_order_release);
   }
 
+  // Every worker listens on a socket of its own bound to the same port with
+  // SO_REUSEPORT, and Linux spreads connections across those sockets itself,
+  // so a connection is served by whichever loop the kernel woke for it,
+  // without a second wakeup on another loop
+  static auto accept_here(struct us_socket_context_t *,
+                          LIBUS_SOCKET_DESCRIPTOR fd, char *, int)
+      -> LIBUS_SOCKET_DESCRIPTOR {
+    // Drop new accepts once shutdown has been requested, as the loop that
+    // would serve them is about to close
+    if (HTTPServer::should_stop_.load(std::memory_order_acquire)) {
+      ::close(fd);
+      return static_cast<LIBUS_SOCKET_DESCRIPTOR>(-1);
+    }
+
+    return fd;
+  }
+
+  // Elsewhere, such as on macOS, SO_REUSEPORT lets every worker bind the port
+  // but hands every connection to one of them, so they are passed round from
+  // there instead
   static auto load_balance(struct us_socket_context_t *,
                            LIBUS_SOCKET_DESCRIPTOR fd, char *, int)
       -> LIBUS_SOCKET_DESCRIPTOR {
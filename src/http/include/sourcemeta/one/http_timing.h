@@ -0,0 +1,181 @@
+#ifndef SOURCEMETA_ONE_HTTP_TIMING_H
+#define SOURCEMETA_ONE_HTTP_TIMING_H
+
+#include <algorithm>   // std::min
+#include <array>       // std::array
+#include <chrono>      // std::chrono
+#include <cstddef>     // std::size_t
+#include <cstdint>     // std::uint8_t, std::uint32_t, std::uint64_t
+#include <format>      // std::format_to
+#include <iterator>    // std::back_inserter
+#include <limits>      // std::numeric_limits
+#include <string>      // std::string
+#include <string_view> // std::string_view
+
+namespace sourcemeta::one {
+
+// Where the time answering one request went, stage by stage, as reported by
+// the Server-Timing header of the W3C Server Timing specification. Small and
+// owning nothing, so that it travels with the request and into the access log
+// by copy
+// See https://www.w3.org/TR/server-timing/
+class HTTPTiming {
+public:
+  enum class Stage : std::uint8_t {
+    Authentication,
+    Resolution,
+    Metadata,
+    Template,
+    Evaluation,
+    Compression
+  };
+
+  static constexpr std::size_t STAGES{6};
+
+  // What the server was started with. Nothing is timed by default, and asking
+  // for it per request only does anything where the server allows it, so
+  // that a request never pays for looking at its own headers otherwise
+  enum class Mode : std::uint8_t { Off, Request, Always };
+
+  // Set once, before the server answers anything
+  static auto mode(const Mode value) noexcept -> void {
+    HTTPTiming::mode_ = value;
+  }
+
+  [[nodiscard]] static auto mode() noexcept -> Mode {
+    return HTTPTiming::mode_;
+  }
+
+  auto enable() noexcept -> void { this->enabled_ = true; }
+
+  [[nodiscard]] auto enabled() const noexcept -> bool {
+    return this->enabled_;
+  }
+
+  // A stage reached more than once, such as resolving several artifacts, adds
+  // up rather than keeping the last
+  auto add(const Stage stage,
+           const std::chrono::steady_clock::duration elapsed) noexcept
+      -> void {
+    const auto index{static_cast<std::size_t>(stage)};
+    const auto microseconds{
+        std::chrono::duration_cast<std::chrono::microseconds>(elapsed)
+            .count()};
+    const auto total{static_cast<std::uint64_t>(this->microseconds_[index]) +
+                     static_cast<std::uint64_t>(microseconds)};
+    this->microseconds_[index] = static_cast<std::uint32_t>(
+        std::min<std::uint64_t>(total,
+                                std::numeric_limits<std::uint32_t>::max()));
+    this->reached_ = static_cast<std::uint8_t>(this->reached_ | (1U << index));
+  }
+
+  template <typename Callback>
+  auto each(Callback callback) const -> void {
+    for (std::size_t index{0}; index < STAGES; index++) {
+      if ((this->reached_ & (1U << index)) != 0) {
+        callback(NAMES[index], this->microseconds_[index]);
+      }
+    }
+  }
+
+  // The header value, in milliseconds as the specification has it, with the
+  // whole of the answer last
+  auto serialize(std::string &output,
+                 const std::chrono::steady_clock::duration total) const
+      -> void {
+    this->each([&output](const std::string_view name,
+                         const std::uint32_t microseconds) -> void {
+      HTTPTiming::metric(output, name, microseconds);
+      output += ", ";
+    });
+
+    HTTPTiming::metric(
+        output, "total",
+        static_cast<std::uint64_t>(
+            std::chrono::duration_cast<std::chrono::microseconds>(total)
+                .count()));
+  }
+
+  // The timings of the request being answered on this thread, if that request
+  // is being timed at all. A stage asks here rather than being handed the
+  // request, as most of them are reached far from it
+  [[nodiscard]] static auto current() noexcept -> HTTPTiming * {
+    return HTTPTiming::current_;
+  }
+
+  // Makes a request the one being answered on this thread for as long as it
+  // lives, which only matters if the request is being timed
+  class Current {
+  public:
+    explicit Current(HTTPTiming &timing) noexcept
+        : previous_{HTTPTiming::current_} {
+      if (timing.enabled()) [[unlikely]] {
+        HTTPTiming::current_ = &timing;
+      }
+    }
+
+    ~Current() { HTTPTiming::current_ = this->previous_; }
+
+    // To avoid mistakes
+    Current(const Current &) = delete;
+    Current(Current &&) = delete;
+    auto operator=(const Current &) -> Current & = delete;
+    auto operator=(Current &&) -> Current & = delete;
+
+  private:
+    HTTPTiming *previous_;
+  };
+
+private:
+  static constexpr std::array<std::string_view, STAGES> NAMES{
+      {"auth", "resolve", "metadata", "template", "evaluate", "compress"}};
+
+  static auto metric(std::string &output, const std::string_view name,
+                     const std::uint64_t microseconds) -> void {
+    std::format_to(std::back_inserter(output), "{};dur={}.{:03}", name,
+                   microseconds / 1000, microseconds % 1000);
+  }
+
+  std::array<std::uint32_t, STAGES> microseconds_{};
+  std::uint8_t reached_{0};
+  bool enabled_{false};
+  static inline Mode mode_{Mode::Off};
+  static inline thread_local HTTPTiming *current_{nullptr};
+};
+
+// Times whatever happens while it lives as one stage of the request being
+// answered on this thread. Where that request is not being timed, which is
+// nearly always, this costs one branch on each end and nothing else
+class HTTPTimingScope {
+public:
+  explicit HTTPTimingScope(const HTTPTiming::Stage stage,
+                           HTTPTiming *const timing =
+                               HTTPTiming::current()) noexcept
+      : timing_{timing}, stage_{stage} {
+    if (this->timing_ != nullptr) [[unlikely]] {
+      this->start_ = std::chrono::steady_clock::now();
+    }
+  }
+
+  ~HTTPTimingScope() {
+    if (this->timing_ != nullptr) [[unlikely]] {
+      this->timing_->add(this->stage_,
+                         std::chrono::steady_clock::now() - this->start_);
+    }
+  }
+
+  // To avoid mistakes
+  HTTPTimingScope(const HTTPTimingScope &) = delete;
+  HTTPTimingScope(HTTPTimingScope &&) = delete;
+  auto operator=(const HTTPTimingScope &) -> HTTPTimingScope & = delete;
+  auto operator=(HTTPTimingScope &&) -> HTTPTimingScope & = delete;
+
+private:
+  HTTPTiming *timing_;
+  HTTPTiming::Stage stage_;
+  std::chrono::steady_clock::time_point start_;
+};
+
+} // namespace sourcemeta::one
+
+#endif
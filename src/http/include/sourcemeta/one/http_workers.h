@@ -0,0 +1,148 @@
+#ifndef SOURCEMETA_ONE_HTTP_WORKERS_H
+#define SOURCEMETA_ONE_HTTP_WORKERS_H
+
+#include <algorithm> // std::min, std::max
+#include <cstdint>   // std::uint64_t
+#include <fstream>   // std::ifstream
+#include <numeric>   // std::iota
+#include <optional>  // std::optional, std::nullopt
+#include <string>    // std::string, std::stoull
+#include <thread>    // std::thread::hardware_concurrency
+#include <vector>    // std::vector
+
+#if defined(__linux__)
+#include <linux/filter.h> // sock_filter, sock_fprog, BPF_*, SKF_AD_*
+#include <pthread.h>      // pthread_self, pthread_setaffinity_np
+#include <sched.h>        // sched_getaffinity, cpu_set_t, CPU_*
+#include <sys/socket.h>   // setsockopt, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF
+#endif
+
+namespace sourcemeta::one {
+
+// How many event loops a server runs, and whether each one stays on a CPU of
+// its own
+struct HTTPServerWorkers {
+  unsigned int count;
+  bool pin{false};
+};
+
+// The CPUs this process is allowed to run on, which a container or `taskset`
+// may well have narrowed down from every CPU the machine has
+inline auto http_allowed_cpus() -> std::vector<unsigned int> {
+#if defined(__linux__)
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+    std::vector<unsigned int> result;
+    for (unsigned int cpu{0}; cpu < CPU_SETSIZE; cpu++) {
+      if (CPU_ISSET(cpu, &set)) {
+        result.push_back(cpu);
+      }
+    }
+
+    if (!result.empty()) {
+      return result;
+    }
+  }
+#endif
+
+  std::vector<unsigned int> result(
+      std::max(1u, std::thread::hardware_concurrency()));
+  std::iota(result.begin(), result.end(), 0u);
+  return result;
+}
+
+// How many CPUs worth of time the control group of this process may use,
+// rounded up, if it is limited at all. A container given half of a large
+// machine still sees every CPU, and running a loop per CPU then only has them
+// take turns at the quota. Only the group the process sees as its root is
+// read, which is the one a container is limited by
+inline auto http_cpu_quota() -> std::optional<unsigned int> {
+#if defined(__linux__)
+  const auto whole{[](const std::uint64_t quota,
+                      const std::uint64_t period) -> unsigned int {
+    return static_cast<unsigned int>(
+        std::max<std::uint64_t>(1, (quota + period - 1) / period));
+  }};
+
+  // Control groups v2, as `<quota> <period>` or `max <period>`
+  std::ifstream unified{"/sys/fs/cgroup/cpu.max"};
+  std::string quota;
+  std::uint64_t period{0};
+  if (unified >> quota >> period) {
+    if (quota == "max" || period == 0) {
+      return std::nullopt;
+    }
+
+    try {
+      return whole(std::stoull(quota), period);
+    } catch (...) {
+      return std::nullopt;
+    }
+  }
+
+  // Control groups v1, where no quota reads as -1
+  std::ifstream legacy_quota{"/sys/fs/cgroup/cpu/cpu.cfs_quota_us"};
+  std::ifstream legacy_period{"/sys/fs/cgroup/cpu/cpu.cfs_period_us"};
+  long long legacy_quota_value{-1};
+  long long legacy_period_value{0};
+  if (legacy_quota >> legacy_quota_value &&
+      legacy_period >> legacy_period_value && legacy_quota_value > 0 &&
+      legacy_period_value > 0) {
+    return whole(static_cast<std::uint64_t>(legacy_quota_value),
+                 static_cast<std::uint64_t>(legacy_period_value));
+  }
+#endif
+
+  return std::nullopt;
+}
+
+// One loop per CPU the process may run on and has time on, whichever is fewer
+inline auto http_default_workers() -> unsigned int {
+  const auto allowed{static_cast<unsigned int>(http_allowed_cpus().size())};
+  const auto quota{http_cpu_quota()};
+  return std::max(1u, quota.has_value() ? std::min(allowed, quota.value())
+                                        : allowed);
+}
+
+// Keep the calling thread on one CPU, so that what it has cached stays there
+inline auto http_pin_thread([[maybe_unused]] const unsigned int cpu) -> bool {
+#if defined(__linux__)
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+  return false;
+#endif
+}
+
+// Have the kernel hand a connection to the listening socket at the index of
+// the CPU that took it in, out of the sockets sharing the port in the order
+// they were bound. With the loops bound in order and pinned one per CPU from
+// the first, a connection is then served on the CPU that received it. Where
+// the CPUs are not numbered from zero up, connections are still spread by
+// CPU, only not onto the same one. Without it, the kernel spreads them by a
+// hash of the addresses
+inline auto http_steer_by_cpu([[maybe_unused]] const int descriptor,
+                              [[maybe_unused]] const unsigned int sockets)
+    -> bool {
+#if defined(__linux__) && defined(SO_ATTACH_REUSEPORT_CBPF)
+  // NOLINTNEXTLINE(modernize-avoid-c-arrays)
+  sock_filter code[]{
+      {BPF_LD | BPF_W | BPF_ABS, 0, 0,
+       static_cast<std::uint32_t>(SKF_AD_OFF + SKF_AD_CPU)},
+      {BPF_ALU | BPF_MOD | BPF_K, 0, 0, sockets},
+      {BPF_RET | BPF_A, 0, 0, 0}};
+  const sock_fprog program{.len = sizeof(code) / sizeof(code[0]),
+                           .filter = code};
+  return setsockopt(descriptor, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &program,
+                    sizeof(program)) == 0;
+#else
+  return false;
+#endif
+}
+
+} // namespace sourcemeta::one
+
+#endif
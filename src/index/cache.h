@@ -0,0 +1,206 @@
+#ifndef SOURCEMETA_ONE_INDEX_CACHE_H_
+#define SOURCEMETA_ONE_INDEX_CACHE_H_
+
+#include <sourcemeta/one/build.h>
+#include <sourcemeta/one/metapack.h>
+
+#include <sourcemeta/core/crypto.h>
+#include <sourcemeta/core/io.h>
+
+#include <atomic>      // std::atomic
+#include <cstddef>     // std::size_t
+#include <filesystem>  // std::filesystem
+#include <iterator>    // std::make_move_iterator
+#include <memory>      // std::unique_ptr
+#include <optional>    // std::optional, std::nullopt
+#include <string>      // std::string
+#include <string_view> // std::string_view
+#include <utility>     // std::move
+#include <vector>      // std::vector
+
+namespace sourcemeta::one {
+
+// Artifacts taken over from other builds of the same registry, such as the
+// ones every branch of a repository runs from an empty output. An artifact is
+// keyed in two steps, as what a handler reads is only partly known before it
+// runs: the first key covers the dependencies the plan names, and leads to a
+// record of what else the handler read last time, and the second adds those
+// as they are now and leads to the artifact. Dependencies are keyed by what
+// they hold rather than by when they were written, which is the only thing
+// two machines can agree on
+class ArtifactCache {
+public:
+  ArtifactCache(std::unique_ptr<BuildCache> cache_backend,
+                std::filesystem::path output_path,
+                std::filesystem::path sources_path, std::string key_salt)
+      : backend{std::move(cache_backend)}, output{std::move(output_path)},
+        sources{std::move(sources_path)}, salt{std::move(key_salt)} {}
+
+  // The first key of an action, or nothing where a dependency the plan names
+  // cannot be read, which leaves that action to its handler
+  [[nodiscard]] auto key(const BuildPlan::Action &action) const
+      -> std::optional<std::string> {
+    std::string material{this->salt};
+    material += '\n';
+    material += std::to_string(action.type);
+    material += '\n';
+    material += this->token(action.destination);
+    material += '\n';
+    material += action.view;
+    material += '\n';
+    material += action.data;
+    material += '\n';
+    for (const auto &dependency : action.dependencies) {
+      if (!ArtifactCache::describe(material, this->token(dependency),
+                                   dependency)) {
+        return std::nullopt;
+      }
+    }
+
+    return sourcemeta::core::sha256(material);
+  }
+
+  // Place the artifact of an action from the cache, recording what its handler
+  // would have read, and answer whether there was one to place
+  [[nodiscard]] auto fetch(const std::string &key, BuildPlan::Action &action)
+      -> bool {
+    try {
+      const auto record{this->backend->read(key)};
+      if (record.has_value()) {
+        std::vector<std::filesystem::path> read;
+        std::string material{key};
+        material += '\n';
+        bool complete{true};
+        std::string_view remaining{record.value()};
+        while (complete && !remaining.empty()) {
+          const auto end{remaining.find('\n')};
+          const auto token{remaining.substr(0, end)};
+          remaining.remove_prefix(end == std::string_view::npos ? remaining.size()
+                                                                : end + 1);
+          auto path{this->locate(token)};
+          complete = ArtifactCache::describe(material, token, path);
+          read.push_back(std::move(path));
+        }
+
+        if (complete &&
+            this->backend->fetch(sourcemeta::core::sha256(material),
+                                  action.destination)) {
+          action.dependencies.insert(action.dependencies.end(),
+                                     std::make_move_iterator(read.begin()),
+                                     std::make_move_iterator(read.end()));
+          this->hit_count.fetch_add(1, std::memory_order_relaxed);
+          return true;
+        }
+      }
+    } catch (const std::filesystem::filesystem_error &) {
+      // A cache that cannot be reached is a cache that does not have it
+    }
+
+    this->miss_count.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+
+  // Keep what a handler just built, where the dependencies past the first
+  // `known` are what it read on top of what the plan named
+  auto store(const std::string &key, const BuildPlan::Action &action,
+             const std::size_t known) -> void {
+    std::string record;
+    std::string material{key};
+    material += '\n';
+    for (std::size_t index{known}; index < action.dependencies.size();
+         index++) {
+      const auto &dependency{action.dependencies[index]};
+      const auto token{this->token(dependency)};
+      if (!ArtifactCache::describe(material, token, dependency)) {
+        return;
+      }
+
+      record += token;
+      record += '\n';
+    }
+
+    try {
+      this->backend->store(sourcemeta::core::sha256(material),
+                            action.destination);
+      // The artifact first, so that whoever follows the record finds it
+      this->backend->write(key, record);
+    } catch (const std::filesystem::filesystem_error &) {
+      // Failing to share an artifact is no reason to fail the build of it
+    }
+  }
+
+  [[nodiscard]] auto hits() const noexcept -> std::size_t {
+    return this->hit_count.load(std::memory_order_relaxed);
+  }
+
+  [[nodiscard]] auto lookups() const noexcept -> std::size_t {
+    return this->hits() + this->miss_count.load(std::memory_order_relaxed);
+  }
+
+private:
+  // A path named relative to the output or to the configuration where it is
+  // under either, as machines sharing a cache rarely agree on where those are
+  [[nodiscard]] auto token(const std::filesystem::path &path) const
+      -> std::string {
+    if (sourcemeta::core::is_lexically_under_path(path, this->output)) {
+      return "output:" + path.lexically_relative(this->output).string();
+    } else if (sourcemeta::core::is_lexically_under_path(path,
+                                                         this->sources)) {
+      return "sources:" + path.lexically_relative(this->sources).string();
+    }
+
+    return path.string();
+  }
+
+  [[nodiscard]] auto locate(const std::string_view token) const
+      -> std::filesystem::path {
+    if (token.starts_with("output:")) {
+      return this->output / token.substr(7);
+    } else if (token.starts_with("sources:")) {
+      return this->sources / token.substr(8);
+    }
+
+    return token;
+  }
+
+  // Append what a dependency holds, answering whether it could be read. A
+  // metapack is described by the checksum of its payload alone, as its header
+  // also records when and how fast it was written
+  static auto describe(std::string &material, const std::string_view token,
+                       const std::filesystem::path &path) -> bool {
+    if (!std::filesystem::is_regular_file(path)) {
+      return false;
+    }
+
+    material += token;
+    material += '\t';
+    if (path.extension() == ".metapack") {
+      const sourcemeta::core::FileView view{path};
+      const auto info{sourcemeta::one::metapack_info(view)};
+      if (!info.has_value()) {
+        return false;
+      }
+
+      material += info->mime;
+      material += '\t';
+      material += info->checksum_hex;
+    } else {
+      material += sourcemeta::core::sha256(
+          sourcemeta::core::read_file_to_string(path));
+    }
+
+    material += '\n';
+    return true;
+  }
+
+  std::unique_ptr<BuildCache> backend;
+  std::filesystem::path output;
+  std::filesystem::path sources;
+  std::string salt;
+  std::atomic<std::size_t> hit_count{0};
+  std::atomic<std::size_t> miss_count{0};
+};
+
+} // namespace sourcemeta::one
+
+#endif
@@ -0,0 +1,204 @@
+#ifndef SOURCEMETA_ONE_INDEX_DETECT_H_
+#define SOURCEMETA_ONE_INDEX_DETECT_H_
+
+#include <sourcemeta/core/io.h>
+
+#include <algorithm>          // std::ranges::any_of
+#include <condition_variable> // std::condition_variable
+#include <cstddef>            // std::size_t
+#include <exception>          // std::exception_ptr, std::current_exception
+#include <filesystem>         // std::filesystem
+#include <memory>             // std::unique_ptr, std::make_unique
+#include <mutex>              // std::mutex, std::unique_lock
+#include <span>               // std::span
+#include <string>             // std::string
+#include <thread>             // std::thread
+#include <unordered_map>      // std::unordered_map
+#include <utility>            // std::move
+#include <vector>             // std::vector
+
+namespace sourcemeta::one {
+
+// The paths a collection ignores, one component per level, so that whether an
+// entry is ignored is a single lookup against what its directory already
+// matched rather than a comparison against every ignored path. Built over
+// canonical paths, as that is what ignoring is defined over
+class IgnoreTrie {
+public:
+  struct Node {
+    std::unordered_map<std::string, std::unique_ptr<Node>> children;
+    bool ignored{false};
+  };
+
+  IgnoreTrie(const std::filesystem::path &root,
+             std::span<const std::filesystem::path> ignore)
+      : paths{ignore.begin(), ignore.end()} {
+    const auto canonical_root{sourcemeta::core::weakly_canonical(root)};
+    for (const auto &path : ignore) {
+      const auto canonical{sourcemeta::core::weakly_canonical(path)};
+      if (sourcemeta::core::is_lexically_under_path(canonical_root,
+                                                    canonical)) {
+        this->top.ignored = true;
+        continue;
+      }
+
+      if (!sourcemeta::core::is_lexically_under_path(canonical,
+                                                     canonical_root)) {
+        continue;
+      }
+
+      auto *node{&this->top};
+      for (const auto &component :
+           canonical.lexically_relative(canonical_root)) {
+        auto &child{node->children[component.string()]};
+        if (!child) {
+          child = std::make_unique<Node>();
+        }
+
+        node = child.get();
+      }
+
+      node->ignored = true;
+    }
+  }
+
+  // What the root of the collection matched
+  [[nodiscard]] auto root() const noexcept -> const Node * {
+    return &this->top;
+  }
+
+  // What an entry matched, given what its directory matched. Nothing once a
+  // directory is under none of the ignored paths, as then neither is anything
+  // in it
+  [[nodiscard]] static auto descend(const Node *node,
+                                    const std::filesystem::path &name)
+      -> const Node * {
+    if (node == nullptr) {
+      return nullptr;
+    }
+
+    const auto match{node->children.find(name.string())};
+    return match == node->children.end() ? nullptr : match->second.get();
+  }
+
+  // A symbolic link is ignored by where it leads rather than by where it sits,
+  // which no walk over names can answer
+  [[nodiscard]] auto covers(const std::filesystem::path &path) const -> bool {
+    return std::ranges::any_of(this->paths, [&path](const auto &ignore) {
+      return sourcemeta::core::is_under_path(path, ignore);
+    });
+  }
+
+private:
+  Node top;
+  std::vector<std::filesystem::path> paths;
+};
+
+// Walk every collection at once, with each thread taking the next directory
+// anybody found rather than a fixed share, as a repository rarely spreads its
+// schemas evenly. Regular files are handed to the callback, from any of the
+// threads and in no particular order, which leaves putting them in order to
+// whoever needs one. Directories behind symbolic links are not followed, as
+// with a recursive directory iterator
+template <typename Callback>
+auto walk_collections(std::span<const std::filesystem::path> roots,
+                      std::span<const IgnoreTrie> ignores,
+                      const std::size_t concurrency, const Callback &callback)
+    -> void {
+  struct Pending {
+    std::size_t root;
+    std::filesystem::path directory;
+    const IgnoreTrie::Node *node;
+  };
+
+  std::vector<Pending> queue;
+  for (std::size_t index{0}; index < roots.size(); index++) {
+    if (!ignores[index].root()->ignored &&
+        std::filesystem::is_directory(roots[index])) {
+      queue.push_back({index, roots[index], ignores[index].root()});
+    }
+  }
+
+  std::mutex mutex;
+  std::condition_variable condition;
+  std::size_t busy{0};
+  std::exception_ptr failure;
+
+  const auto worker{[&]() -> void {
+    std::unique_lock lock{mutex};
+    while (true) {
+      condition.wait(lock, [&] {
+        return !queue.empty() || busy == 0 || failure != nullptr;
+      });
+
+      if (queue.empty() || failure != nullptr) {
+        return;
+      }
+
+      auto pending{std::move(queue.back())};
+      queue.pop_back();
+      busy++;
+      lock.unlock();
+
+      std::vector<Pending> found;
+      try {
+        const auto &ignore{ignores[pending.root]};
+        for (const auto &entry :
+             std::filesystem::directory_iterator{pending.directory}) {
+          const auto *node{
+              IgnoreTrie::descend(pending.node, entry.path().filename())};
+          if (node != nullptr && node->ignored) {
+            continue;
+          }
+
+          if (entry.is_symlink()) {
+            if (entry.is_regular_file() && !ignore.covers(entry.path())) {
+              callback(pending.root, entry);
+            }
+          } else if (entry.is_directory()) {
+            found.push_back({pending.root, entry.path(), node});
+          } else if (entry.is_regular_file()) {
+            callback(pending.root, entry);
+          }
+        }
+      } catch (...) {
+        lock.lock();
+        if (failure == nullptr) {
+          failure = std::current_exception();
+        }
+
+        busy--;
+        condition.notify_all();
+        return;
+      }
+
+      lock.lock();
+      busy--;
+      for (auto &directory : found) {
+        queue.push_back(std::move(directory));
+      }
+
+      condition.notify_all();
+    }
+  }};
+
+  std::vector<std::thread> threads;
+  const auto count{std::max<std::size_t>(concurrency, 1)};
+  threads.reserve(count - 1);
+  for (std::size_t index{1}; index < count; index++) {
+    threads.emplace_back(worker);
+  }
+
+  worker();
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  if (failure != nullptr) {
+    std::rethrow_exception(failure);
+  }
+}
+
+} // namespace sourcemeta::one
+
+#endif
@@ -86,6 +86,66 @@ private:
   std::string value_;
 };
 
+class OptionInvalidShardValueError : public std::exception {
+public:
+  OptionInvalidShardValueError(std::string option, std::string value)
+      : option_{std::move(option)}, value_{std::move(value)} {}
+
+  [[nodiscard]] auto what() const noexcept -> const char * override {
+    return "Expected a shard of the form <index>/<count> for option";
+  }
+
+  [[nodiscard]] auto option() const noexcept -> const std::string & {
+    return this->option_;
+  }
+
+  [[nodiscard]] auto value() const noexcept -> const std::string & {
+    return this->value_;
+  }
+
+private:
+  std::string option_;
+  std::string value_;
+};
+
+class OptionConflictError : public std::exception {
+public:
+  OptionConflictError(std::string option, std::string other)
+      : option_{std::move(option)}, other_{std::move(other)} {}
+
+  [[nodiscard]] auto what() const noexcept -> const char * override {
+    return "These options cannot be used together";
+  }
+
+  [[nodiscard]] auto option() const noexcept -> const std::string & {
+    return this->option_;
+  }
+
+  [[nodiscard]] auto other() const noexcept -> const std::string & {
+    return this->other_;
+  }
+
+private:
+  std::string option_;
+  std::string other_;
+};
+
+class OptionUnsupportedError : public std::exception {
+public:
+  OptionUnsupportedError(std::string option) : option_{std::move(option)} {}
+
+  [[nodiscard]] auto what() const noexcept -> const char * override {
+    return "This option is not supported on this platform";
+  }
+
+  [[nodiscard]] auto option() const noexcept -> const std::string & {
+    return this->option_;
+  }
+
+private:
+  std::string option_;
+};
+
 class CrossPolicyReferenceError : public std::exception {
 public:
   CrossPolicyReferenceError(std::filesystem::path path, std::string referrer,
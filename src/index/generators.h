@@ -171,23 +171,34 @@ struct GENERATE_MATERIALISED_SCHEMA {
     resolver.cache_path(action.data, action.destination);
   }
 
+  // Compiled metaschemas outlive a build when the indexer keeps watching, which
+  // is only right for the ones no edit can change. A metaschema the catalog
+  // defines itself is compiled again by the next build that validates against
+  // it. Never called while a build is running
+  static auto forget_catalog_metaschemas() -> void {
+    const std::unique_lock lock{mutex};
+    std::erase_if(cache, [](const auto &entry) {
+      return !sourcemeta::blaze::is_known_schema(entry.first);
+    });
+  }
+
 private:
+  struct Slot {
+    std::once_flag flag;
+    sourcemeta::blaze::Template value;
+  };
+
+  // Wave 0 is exclusively schema materialisation, so a single lock across the
+  // exhaustive compile would serialise every worker. A shared lock lets cache
+  // hits proceed without contending, and a per-dialect `once_flag` compiles
+  // each dialect exactly once while distinct dialects compile concurrently
+  static inline std::shared_mutex mutex;
+  static inline std::unordered_map<std::string, std::unique_ptr<Slot>> cache;
+
   static auto compile(const std::string &cache_key,
                       const sourcemeta::core::JSON &schema,
                       const sourcemeta::one::Resolver &resolver)
       -> const sourcemeta::blaze::Template & {
-    struct Slot {
-      std::once_flag flag;
-      sourcemeta::blaze::Template value;
-    };
-
-    // Wave 0 is exclusively schema materialisation, so a single lock across the
-    // exhaustive compile would serialise every worker. A shared lock lets cache
-    // hits proceed without contending, and a per-dialect `once_flag` compiles
-    // each dialect exactly once while distinct dialects compile concurrently
-    static std::shared_mutex mutex;
-    static std::unordered_map<std::string, std::unique_ptr<Slot>> cache;
-
     Slot *slot{nullptr};
     {
       const std::shared_lock lock{mutex};
@@ -207,6 +218,8 @@ private:
     }
 
     std::call_once(slot->flag, [&] {
+      sourcemeta::one::TraceSpan span{"compile", cache_key};
+      span.argument("mode", std::string{"exhaustive"});
       slot->value = sourcemeta::blaze::compile(
           schema, sourcemeta::blaze::schema_walker,
           [&resolver](const auto identifier) { return resolver(identifier); },
@@ -560,12 +573,19 @@ static auto generate_blaze_template(
                 [&callback, &resolver](const auto identifier) {
                   return resolver(identifier, callback);
                 });
-  const auto schema_template{sourcemeta::blaze::compile(
-      contents, sourcemeta::blaze::schema_walker,
-      [&callback, &resolver](const auto identifier) {
-        return resolver(identifier, callback);
-      },
-      sourcemeta::blaze::default_schema_compiler, frame, frame.root(), mode)};
+  const auto schema_template{[&] {
+    sourcemeta::one::TraceSpan span{"compile", destination.native()};
+    span.argument("mode",
+                  std::string{mode == sourcemeta::blaze::Mode::Exhaustive
+                                  ? "exhaustive"
+                                  : "fast"});
+    return sourcemeta::blaze::compile(
+        contents, sourcemeta::blaze::schema_walker,
+        [&callback, &resolver](const auto identifier) {
+          return resolver(identifier, callback);
+        },
+        sourcemeta::blaze::default_schema_compiler, frame, frame.root(), mode);
+  }()};
   const auto result{sourcemeta::blaze::to_json(schema_template)};
   const auto timestamp_end{std::chrono::steady_clock::now()};
   sourcemeta::one::metapack_write_json(
@@ -900,6 +920,12 @@ struct GENERATE_URITEMPLATE_ROUTES {
                  next_id++, sourcemeta::one::ACTION_TYPE_HEALTH_CHECK_V1,
                  health_check_arguments);
 
+      const sourcemeta::core::URITemplateRouter::Argument metrics_arguments[] =
+          {{"errorSchema", std::string_view{error_schema}}};
+      router.add(sourcemeta::one::ENDPOINT_METRICS, "get_server_metrics",
+                 next_id++, sourcemeta::one::ACTION_TYPE_METRICS_V1,
+                 metrics_arguments);
+
       const sourcemeta::core::URITemplateRouter::Argument
           auth_logout_arguments[] = {
               {"errorSchema", std::string_view{error_schema}}};
@@ -982,8 +1008,14 @@ struct GENERATE_URITEMPLATE_ROUTES {
       router.otherwise(sourcemeta::one::ACTION_TYPE_DEFAULT_V1);
     }
 
+    // Saving writes over whatever file is there, and a published generation
+    // shares that file with the output, so it is saved beside it and then
+    // renamed over it like every other artifact
     std::filesystem::create_directories(action.destination.parent_path());
-    sourcemeta::core::URITemplateRouterView::save(router, action.destination);
+    auto incoming{action.destination};
+    incoming += ".incoming";
+    sourcemeta::core::URITemplateRouterView::save(router, incoming);
+    std::filesystem::rename(incoming, action.destination);
   }
 };
 
@@ -0,0 +1,154 @@
+#ifndef SOURCEMETA_ONE_INDEX_GIT_H_
+#define SOURCEMETA_ONE_INDEX_GIT_H_
+
+#include <sourcemeta/core/process.h>
+
+#include <array>       // std::array
+#include <cstddef>     // std::size_t
+#include <filesystem>  // std::filesystem::path, std::filesystem::is_directory
+#include <optional>    // std::optional, std::nullopt
+#include <span>        // std::span
+#include <string>      // std::string
+#include <string_view> // std::string_view
+#include <utility>     // std::move
+#include <vector>      // std::vector
+
+namespace sourcemeta::one {
+
+// A directory exactly as the commit checked out over it has it
+struct GitSnapshot {
+  // The tree object of the directory in that commit, which only changes when
+  // something under the directory does
+  std::string tree;
+  // Every file under the directory, relative to it
+  std::vector<std::filesystem::path> files;
+};
+
+// What git prints on success, or nothing if it failed or is not installed, as
+// anything git cannot answer is answered by looking at the files instead
+inline auto git_output(const std::filesystem::path &directory,
+                       std::span<const std::string_view> arguments)
+    -> std::optional<std::string> {
+  try {
+    auto result{sourcemeta::core::spawn_and_capture(
+        "git", arguments, {.directory = directory})};
+    if (!result.exit_code.has_value() || result.exit_code.value() != 0) {
+      return std::nullopt;
+    }
+
+    return std::move(result.standard_output);
+  } catch (const sourcemeta::core::ProcessProgramNotFoundError &) {
+    return std::nullopt;
+  } catch (const sourcemeta::core::ProcessSpawnError &) {
+    return std::nullopt;
+  }
+}
+
+// Git separates what it lists by a null byte when asked to, which is the only
+// way to tell where a path ends whatever characters it has in it
+inline auto git_split(const std::string_view output)
+    -> std::vector<std::string_view> {
+  std::vector<std::string_view> result;
+  std::size_t start{0};
+  while (start < output.size()) {
+    const auto end{output.find('\0', start)};
+    if (end == std::string_view::npos) {
+      result.push_back(output.substr(start));
+      break;
+    }
+
+    result.push_back(output.substr(start, end - start));
+    start = end + 1;
+  }
+
+  return result;
+}
+
+// Nothing unless the directory is in a git work tree that matches the commit
+// checked out over it to the byte. Anything modified, staged, untracked or
+// even ignored under it is something a walk would see and git would not, and
+// so are symbolic links and submodules, which a walk follows into. In any of
+// those cases only looking at the files can tell what is there
+inline auto git_snapshot(const std::filesystem::path &directory)
+    -> std::optional<GitSnapshot> {
+  if (!std::filesystem::is_directory(directory)) {
+    return std::nullopt;
+  }
+
+  constexpr std::array<std::string_view, 4> REVISION{
+      {"rev-parse", "--verify", "--quiet", "HEAD:./"}};
+  auto tree{git_output(directory, REVISION)};
+  if (!tree.has_value()) {
+    return std::nullopt;
+  }
+
+  while (!tree->empty() && (tree->back() == '\n' || tree->back() == '\r')) {
+    tree->pop_back();
+  }
+
+  if (tree->empty()) {
+    return std::nullopt;
+  }
+
+  // Git would otherwise take a lock on the index to refresh it, which another
+  // git process working on the same repository would then trip over
+  constexpr std::array<std::string_view, 8> STATUS{
+      {"--no-optional-locks", "status", "--porcelain", "-z",
+       "--untracked-files=all", "--ignored=matching", "--", "."}};
+  const auto status{git_output(directory, STATUS)};
+  if (!status.has_value() || !status->empty()) {
+    return std::nullopt;
+  }
+
+  // The tree is the directory itself, so nothing is to be left out of it for
+  // being elsewhere than where git runs
+  const std::array<std::string_view, 5> LIST{
+      {"ls-tree", "-r", "-z", "--full-tree", tree.value()}};
+  const auto listing{git_output(directory, LIST)};
+  if (!listing.has_value()) {
+    return std::nullopt;
+  }
+
+  GitSnapshot result{.tree = std::move(tree).value(), .files = {}};
+  for (const auto line : git_split(listing.value())) {
+    // Each is a mode, a type and an object, and then the path after a tab
+    const auto tab{line.find('\t')};
+    if (tab == std::string_view::npos) {
+      return std::nullopt;
+    }
+
+    if (line.starts_with("120000") || line.starts_with("160000")) {
+      return std::nullopt;
+    }
+
+    result.files.emplace_back(line.substr(tab + 1));
+  }
+
+  return result;
+}
+
+// The files that differ between two trees of the same directory, relative to
+// it, counting files that are only in either of them. Nothing if either tree
+// is no longer there to compare, as after the history was rewritten and
+// collected
+inline auto git_changes(const std::filesystem::path &directory,
+                        const std::string_view from, const std::string_view to)
+    -> std::optional<std::vector<std::filesystem::path>> {
+  const std::array<std::string_view, 7> DIFFERENCE{
+      {"diff-tree", "-r", "-z", "--name-only", "--no-renames", from, to}};
+  const auto output{git_output(directory, DIFFERENCE)};
+  if (!output.has_value()) {
+    return std::nullopt;
+  }
+
+  std::vector<std::filesystem::path> result;
+  for (const auto path : git_split(output.value())) {
+    result.emplace_back(path);
+  }
+
+  return result;
+}
+
+} // namespace sourcemeta::one
+
+#endif
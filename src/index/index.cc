@@ -14,29 +14,45 @@
 
 #include <sourcemeta/one/build.h>
 #include <sourcemeta/one/configuration.h>
+#include <sourcemeta/one/metapack_archive.h>
 #include <sourcemeta/one/resolver.h>
 #include <sourcemeta/one/shared.h>
 #include <sourcemeta/one/web.h>
 
+#include "cache.h"
+#include "detect.h"
 #include "explorer.h"
 #include "generators.h"
+#include "git.h"
+#include "memory.h"
+#include "publish.h"
+#include "quarantine.h"
+#include "report.h"
 #include "rules.h"
+#include "watch.h"
 
 #include <algorithm>     // std::ranges::any_of, std::ranges::sort
 #include <array>         // std::array
 #include <atomic>        // std::atomic
 #include <cassert>       // assert
+#include <charconv>      // std::from_chars
 #include <chrono>        // std::chrono
 #include <cstdint>       // std::uint8_t
 #include <cstdlib>       // EXIT_FAILURE, EXIT_SUCCESS
 #include <exception>     // std::exception
 #include <filesystem>    // std::filesystem
-#include <functional>    // std::reference_wrapper, std::cref
+#include <format>        // std::format
+#include <functional>    // std::reference_wrapper, std::cref, std::function
+#include <memory>        // std::unique_ptr, std::make_unique, std::make_shared
 #include <mutex>         // std::mutex, std::lock_guard
+#include <optional>      // std::optional, std::nullopt
 #include <print>         // std::print, std::println
+#include <span>          // std::span
 #include <sstream>       // std::ostringstream
 #include <string>        // std::string
 #include <string_view>   // std::string_view
+#include <system_error>  // std::errc, std::error_code
+#include <unordered_map> // std::unordered_map
 #include <unordered_set> // std::unordered_set
 #include <vector>        // std::vector
 
@@ -51,6 +67,7 @@
 
 // NOLINTNEXTLINE(cppcoreguidelines-macro-usage)
 #define PROFILE_END(state, label)                                              \
+  trace_phase((label), (state).second);                                        \
   (state).first.emplace_back(                                                  \
       (label), std::chrono::duration_cast<std::chrono::milliseconds>(          \
                    std::chrono::steady_clock::now() - (state).second));        \
@@ -107,13 +124,34 @@ static constexpr std::array<BuildHandlerFunction, sourcemeta::one::ACTION_COUNT>
 // still refuses the build, one step later than it would have
 static auto view_filter_from(
     const sourcemeta::one::Authentication::Table &gate,
-    const std::span<const sourcemeta::one::Authentication::RecordedView> table)
-    -> sourcemeta::one::ViewFilter {
-  return [&gate, table](const std::size_t view,
-                        const std::string_view relative) -> bool {
+    const std::span<const sourcemeta::one::Authentication::RecordedView> table,
+    const sourcemeta::one::LeafSet &leaves) -> sourcemeta::one::ViewFilter {
+  // Planning asks about every leaf once per view, several times over, so each
+  // leaf is read against the table once up front for every view together, and
+  // what planning asks after that is a lookup. Nothing is written to this once
+  // planning starts, which is what lets its threads share it
+  auto visibility{std::make_shared<
+      std::unordered_map<std::string_view, std::vector<bool>>>()};
+  visibility->reserve(leaves.size());
+  for (const auto &[uri, leaf] : leaves) {
+    const auto &relative{leaf.relative_path->native()};
+    visibility->emplace(
+        relative,
+        gate.visibility(sourcemeta::one::Authentication::Path::relative(
+                            std::string{"/"} + relative),
+                        table));
+  }
+
+  return [&gate, table, visibility = std::move(visibility)](
+             const std::size_t view, const std::string_view relative) -> bool {
     // A build names its views by position in the table it was handed, which is
     // a fact about this build rather than about who governs what
     assert(view < table.size());
+    const auto match{visibility->find(relative)};
+    if (match != visibility->end()) {
+      return match->second[view];
+    }
+
     std::string path;
     path.reserve(relative.size() + 1);
     path.push_back('/');
@@ -138,6 +176,216 @@ static auto parse_numeric_option(const sourcemeta::core::Options &app,
   }
 }
 
+// One process of a build split across several, named by its position among
+// them. Each builds the artifacts of the schemas it owns and nothing else, and
+// one last process takes over what they committed and finishes the build
+struct Shard {
+  std::size_t index;
+  std::size_t count;
+};
+
+static auto parse_shard_option(const sourcemeta::core::Options &app,
+                               const std::string_view option) -> Shard {
+  const auto &raw{app.at(option).front()};
+  const auto *const end{raw.data() + raw.size()};
+  std::size_t index{0};
+  std::size_t count{0};
+  const auto index_result{std::from_chars(raw.data(), end, index)};
+  if (index_result.ec == std::errc{} && index_result.ptr != end &&
+      *index_result.ptr == '/') {
+    const auto count_result{std::from_chars(index_result.ptr + 1, end, count)};
+    if (count_result.ec == std::errc{} && count_result.ptr == end &&
+        count > 0 && index < count) {
+      return {.index = index, .count = count};
+    }
+  }
+
+  throw sourcemeta::one::OptionInvalidShardValueError(std::string{option},
+                                                      std::string{raw});
+}
+
+// Which shard owns a schema. Keyed by the identifier, since that names a schema
+// the same way in every process whatever order each detected it in, and hashed
+// with what the state keys its table by
+static auto shard_owner(const std::string_view identifier,
+                        const std::size_t count) -> std::size_t {
+  return static_cast<std::size_t>(
+      sourcemeta::one::BuildState::fingerprint(identifier) % count);
+}
+
+static auto shard_state_path(const std::filesystem::path &output,
+                             const std::size_t index) -> std::filesystem::path {
+  return output / std::format("state.shard-{}.bin", index);
+}
+
+// Where a build kept under a memory budget moves its state to when it has to,
+// which is only ever read by that same build. Shards of one build run at once
+// over the same output, so each has its own
+static auto spill_directory(const std::filesystem::path &output,
+                            const std::optional<Shard> &shard)
+    -> std::filesystem::path {
+  if (shard.has_value()) {
+    return output / std::format("state.spill-{}", shard->index);
+  }
+
+  return output / "state.spill";
+}
+
+// Only ever under the lock of the build state, as spilling it moves entries
+// that sibling actions may be asking about
+static auto release_memory(sourcemeta::one::BuildState &entries,
+                           sourcemeta::one::Resolver &resolver,
+                           sourcemeta::one::MemoryBudget &budget) -> void {
+  entries.spill(budget.spill_directory());
+  entries.trim();
+  resolver.evict_dialects();
+  budget.released();
+}
+
+// Whether an action writes an artifact of one schema alone, which is the only
+// work a shard can do without the rest of the catalog having been built
+static constexpr auto
+is_leaf_action(const sourcemeta::one::BuildPlan::Action::Type type) -> bool {
+  return std::ranges::any_of(
+      sourcemeta::one::INDEX_RULES.leaves, [type](const auto &rule) {
+        return !rule.combine_only && rule.action == type;
+      });
+}
+
+static auto retain_actions(
+    sourcemeta::one::BuildPlan &plan,
+    const std::function<bool(const sourcemeta::one::BuildPlan::Action &)>
+        &keep) -> void {
+  plan.size = 0;
+  for (auto &wave : plan.waves) {
+    std::erase_if(wave, [&keep](const auto &action) { return !keep(action); });
+    plan.size += wave.size();
+  }
+
+  std::erase_if(plan.waves, [](const auto &wave) { return wave.empty(); });
+}
+
+// Hands over every schema file of a collection as git lists it, which is only
+// possible when git has the collection exactly as the commit checked out over
+// it, and records which tree that was for the next build to compare against.
+// A file git says is unchanged since the tree the previous build recorded
+// keeps the mark it was resolved at then, so that nothing about it is looked
+// at again. Anything else is stat'ed, and is made to look newer than what was
+// resolved for it before, as git writing a file does not always move its
+// modification time past that. False when git cannot vouch for the collection,
+// which is then left to a walk
+template <typename Callback>
+static auto detect_from_git(
+    sourcemeta::one::BuildState &entries, const std::filesystem::path &root,
+    const sourcemeta::one::IgnoreTrie &ignore,
+    const std::unordered_set<std::string> &configuration_files,
+    const Callback &callback) -> bool {
+  if (ignore.root()->ignored) {
+    return true;
+  }
+
+  const auto snapshot{sourcemeta::one::git_snapshot(root)};
+  if (!snapshot.has_value()) {
+    entries.record_source_revision(root.native(), "");
+    return false;
+  }
+
+  const auto recorded{entries.source_revision(root.native())};
+  const auto changes{
+      recorded.empty()
+          ? std::nullopt
+          : sourcemeta::one::git_changes(root, recorded, snapshot->tree)};
+  std::unordered_set<std::string> changed;
+  if (changes.has_value()) {
+    for (const auto &path : changes.value()) {
+      changed.insert(path.native());
+    }
+  }
+
+  const auto canonical_root{sourcemeta::core::weakly_canonical(root)};
+  for (const auto &relative : snapshot->files) {
+    const auto extension{relative.extension()};
+    if (extension != ".yaml" && extension != ".yml" && extension != ".json") {
+      continue;
+    }
+
+    const auto *node{ignore.root()};
+    bool ignored{false};
+    for (const auto &component : relative) {
+      node = sourcemeta::one::IgnoreTrie::descend(node, component);
+      if (node == nullptr) {
+        break;
+      } else if (node->ignored) {
+        ignored = true;
+        break;
+      }
+    }
+
+    // Nothing under the collection is a symbolic link, so this is as
+    // canonical as what a walk would have compared
+    if (ignored ||
+        configuration_files.contains((canonical_root / relative).native())) {
+      continue;
+    }
+
+    const auto path{root / relative};
+    const auto *previous{entries.resolve(
+        path.native(), std::filesystem::file_time_type::min())};
+    if (previous != nullptr && changes.has_value() &&
+        !changed.contains(relative.native())) {
+      callback(path, previous->file_mark);
+      continue;
+    }
+
+    auto mtime{std::filesystem::last_write_time(path)};
+    if (previous != nullptr && mtime <= previous->file_mark) {
+      mtime = previous->file_mark + std::chrono::nanoseconds{1};
+    }
+
+    callback(path, mtime);
+  }
+
+  entries.record_source_revision(root.native(), snapshot->tree);
+  return true;
+}
+
+// A shard reads the schemas other shards own from their sources, since nothing
+// it runs materialises them, so what it records having read names a source
+// where a build of everything would name the materialised artifact. Both
+// describe the same schema and the artifact is what a later build asks about,
+// so that is what gets recorded. Materialising itself is passed over, since
+// which of the two it reads depends on timing even within one process
+static auto alias_foreign_sources(
+    sourcemeta::one::BuildState &partial,
+    const std::unordered_map<std::string, std::filesystem::path> &foreign,
+    const std::string_view materialised_prefix,
+    const std::string_view materialised_suffix) -> void {
+  const std::vector<std::string> keys{partial.keys().begin(),
+                                      partial.keys().end()};
+  for (const auto &key : keys) {
+    if (key.starts_with(materialised_prefix) &&
+        key.ends_with(materialised_suffix)) {
+      continue;
+    }
+
+    const auto *current{partial.entry(key)};
+    assert(current != nullptr);
+    auto entry{*current};
+    bool aliased{false};
+    for (auto &dependency : entry.dependencies) {
+      const auto match{foreign.find(dependency.native())};
+      if (match != foreign.end()) {
+        dependency = match->second;
+        aliased = true;
+      }
+    }
+
+    if (aliased) {
+      partial.emplace(key, std::move(entry));
+    }
+  }
+}
+
 static auto print_progress(const std::size_t threads,
                            const std::string_view title,
                            const std::string_view prefix,
@@ -150,6 +398,102 @@ static auto print_progress(const std::size_t threads,
              title, prefix, std::this_thread::get_id(), threads);
 }
 
+// A phase is over by the time it is known to be one, so it is recorded from
+// where the previous one ended rather than held open as a span
+static auto trace_phase(const std::string_view label,
+                        const std::chrono::steady_clock::time_point start)
+    -> void {
+  auto *trace{sourcemeta::one::Trace::installed()};
+  auto *exporter{sourcemeta::one::OTLPExporter::installed()};
+  if (trace == nullptr && exporter == nullptr) {
+    return;
+  }
+
+  sourcemeta::one::Trace::Event event{
+      .category = "phase",
+      .name = std::string{label},
+      .start = start,
+      .end = std::chrono::steady_clock::now(),
+      .thread = trace != nullptr ? sourcemeta::one::Trace::thread() : 0,
+      .arguments = {}};
+  if (exporter != nullptr) {
+    exporter->record(event);
+  }
+
+  if (trace != nullptr) {
+    trace->record(std::move(event));
+  }
+}
+
+// Errors that a schema raises are reported against the file it came from, which
+// only the resolver knows by the time an action runs
+static auto run_handler(sourcemeta::one::BuildState &entries,
+                        sourcemeta::one::BuildPlan::Action &action,
+                        sourcemeta::one::Resolver &resolver,
+                        const sourcemeta::one::Configuration &configuration,
+                        const sourcemeta::core::JSON &raw_configuration)
+    -> void {
+  const auto handler{HANDLERS[static_cast<std::uint8_t>(action.type)]};
+  assert(handler);
+  try {
+    handler(
+        entries, action,
+        [&action](const auto &path) { action.dependencies.emplace_back(path); },
+        resolver, configuration, raw_configuration);
+  } catch (const sourcemeta::blaze::SchemaResolutionError &error) {
+    const auto *entry{
+        action.data.empty() ? nullptr : &resolver.entry(action.data)};
+    if (entry) {
+      throw sourcemeta::core::FileError<
+          sourcemeta::blaze::SchemaResolutionError>(
+          entry->path, error.identifier(), error.what());
+    }
+
+    throw;
+  } catch (const sourcemeta::blaze::SchemaReferenceError &error) {
+    const auto *entry{
+        action.data.empty() ? nullptr : &resolver.entry(action.data)};
+    if (entry) {
+      throw sourcemeta::core::FileError<
+          sourcemeta::blaze::SchemaReferenceError>(
+          entry->path, error.identifier(), error.location(), error.what());
+    }
+
+    throw;
+  } catch (
+      const sourcemeta::blaze::SchemaReferenceObjectResourceError &error) {
+    const auto *entry{
+        action.data.empty() ? nullptr : &resolver.entry(action.data)};
+    if (entry) {
+      throw sourcemeta::core::FileError<
+          sourcemeta::blaze::SchemaReferenceObjectResourceError>(
+          entry->path, error.identifier());
+    }
+
+    throw;
+  } catch (const sourcemeta::blaze::SchemaVocabularyError &error) {
+    const auto *entry{
+        action.data.empty() ? nullptr : &resolver.entry(action.data)};
+    if (entry) {
+      throw sourcemeta::core::FileError<
+          sourcemeta::blaze::SchemaVocabularyError>(entry->path, error.uri(),
+                                                    error.what());
+    }
+
+    throw;
+  } catch (const sourcemeta::blaze::CompilerInvalidRegexError &error) {
+    const auto *entry{
+        action.data.empty() ? nullptr : &resolver.entry(action.data)};
+    if (entry) {
+      throw sourcemeta::core::FileError<
+          sourcemeta::blaze::CompilerInvalidRegexError>(
+          entry->path, error.base(), error.location(), error.regex());
+    }
+
+    throw;
+  }
+}
+
 static auto execute_plan(sourcemeta::one::BuildState &entries,
                          const std::filesystem::path &canonical_output,
                          sourcemeta::one::Resolver &resolver,
@@ -157,98 +501,173 @@ static auto execute_plan(sourcemeta::one::BuildState &entries,
                          const sourcemeta::core::JSON &raw_configuration,
                          const std::size_t concurrency,
                          sourcemeta::one::BuildPlan &plan,
-                         const std::string_view label) -> void {
+                         const std::string_view label,
+                         sourcemeta::one::ArtifactCache *artifact_cache,
+                         sourcemeta::one::BuildReport *report,
+                         sourcemeta::one::MemoryBudget *budget,
+                         sourcemeta::one::Quarantine *quarantine) -> void {
   // Give it a generous thread stack size, otherwise we might overflow
   // the small-by-default thread stack with Blaze
   constexpr auto THREAD_STACK_SIZE{8 * 1024 * 1024};
   std::atomic<std::size_t> progress_counter{0};
-  for (auto &wave : plan.waves) {
+  for (std::size_t wave_index{0}; wave_index < plan.waves.size();
+       wave_index++) {
+    auto &wave{plan.waves[wave_index]};
+    sourcemeta::one::TraceSpan wave_span{
+        "wave", std::format("{} #{}", label, wave_index + 1)};
+    wave_span.argument("actions", wave.size());
     sourcemeta::core::parallel_for_each(
         wave.begin(), wave.end(),
         [&](auto &action, const auto threads, const auto) {
+          // Workers start with no span open, so their actions are placed under
+          // the wave explicitly
+          const sourcemeta::one::TraceContext::Adopt adopted{
+              wave_span.context()};
           const auto current{
               progress_counter.fetch_add(1, std::memory_order_relaxed) + 1};
           const std::string_view destination_view{action.destination.native()};
           const auto relative_path{
               destination_view.substr(canonical_output.native().size() + 1)};
+          sourcemeta::one::TraceSpan span{
+              "action", sourcemeta::one::ACTION_NAMES[static_cast<std::uint8_t>(
+                            action.type)]};
+          span.argument("path", std::string{relative_path});
 
           if (action.type == sourcemeta::one::ACTION_REMOVE) {
             print_progress(threads, "Disposing", relative_path, current,
                            plan.size);
             std::filesystem::remove_all(action.destination);
-            const auto lock{entries.take_lock()};
-            entries.forget(action.destination.native());
+            if (report != nullptr) {
+              report->executed(action.type, relative_path, 0, std::nullopt, {},
+                               {});
+            }
+
+            {
+              const auto lock{entries.take_lock()};
+              entries.forget(action.destination.native());
+            }
+
+            entries.checkpoint_if_due();
             return;
           }
 
           print_progress(threads, label, relative_path, current, plan.size);
-          const auto handler{HANDLERS[static_cast<std::uint8_t>(action.type)]};
-          assert(handler);
-          try {
-            handler(
-                entries, action,
-                [&action](const auto &path) {
-                  action.dependencies.emplace_back(path);
-                },
-                resolver, configuration, raw_configuration);
-          } catch (const sourcemeta::blaze::SchemaResolutionError &error) {
-            const auto *entry{
-                action.data.empty() ? nullptr : &resolver.entry(action.data)};
-            if (entry) {
-              throw sourcemeta::core::FileError<
-                  sourcemeta::blaze::SchemaResolutionError>(
-                  entry->path, error.identifier(), error.what());
-            }
+          if (quarantine != nullptr && !quarantine->admit(action)) {
+            span.argument("quarantined", std::uint64_t{1});
+            return;
+          }
 
-            throw;
-          } catch (const sourcemeta::blaze::SchemaReferenceError &error) {
-            const auto *entry{
-                action.data.empty() ? nullptr : &resolver.entry(action.data)};
-            if (entry) {
-              throw sourcemeta::core::FileError<
-                  sourcemeta::blaze::SchemaReferenceError>(
-                  entry->path, error.identifier(), error.location(),
-                  error.what());
+          // Only what a schema builds out of itself, as anything reading many
+          // of them is cheap next to what it would take to key it
+          std::optional<std::string> cache_key;
+          if (artifact_cache != nullptr && is_leaf_action(action.type)) {
+            cache_key = artifact_cache->key(action);
+            if (cache_key.has_value() &&
+                artifact_cache->fetch(cache_key.value(), action)) {
+              // Materialising is the one handler that leaves more behind than
+              // its artifact, as the rest of the build reads a schema from
+              // there once it exists
+              if (action.type == sourcemeta::one::ACTION_MATERIALISE) {
+                resolver.cache_path(action.data, action.destination);
+              }
+
+              span.argument("cached", std::uint64_t{1});
+              if (report != nullptr) {
+                report->skipped(action.type);
+              }
+
+              const auto seal{
+                  sourcemeta::one::BuildState::seal(action.destination)};
+              {
+                const auto lock{entries.take_lock()};
+                entries.commit(action.destination,
+                               std::move(action.dependencies), seal);
+                if (budget != nullptr && budget->exceeded()) {
+                  release_memory(entries, resolver, *budget);
+                }
+              }
+
+              entries.checkpoint_if_due();
+              return;
             }
+          }
 
-            throw;
-          } catch (const sourcemeta::blaze::SchemaReferenceObjectResourceError
-                       &error) {
-            const auto *entry{
-                action.data.empty() ? nullptr : &resolver.entry(action.data)};
-            if (entry) {
-              throw sourcemeta::core::FileError<
-                  sourcemeta::blaze::SchemaReferenceObjectResourceError>(
-                  entry->path, error.identifier());
+          const auto known_dependencies{action.dependencies.size()};
+          const auto memory_before{report != nullptr
+                                       ? sourcemeta::one::memory_sample()
+                                       : sourcemeta::one::MemorySample{}};
+          if (quarantine == nullptr) {
+            run_handler(entries, action, resolver, configuration,
+                        raw_configuration);
+          } else {
+            try {
+              run_handler(entries, action, resolver, configuration,
+                          raw_configuration);
+            } catch (const std::exception &error) {
+              span.argument("failed", std::uint64_t{1});
+              const auto *entry{
+                  sourcemeta::one::Quarantine::describes_schema(action.type)
+                      ? &resolver.entry(action.data)
+                      : nullptr};
+              quarantine->failed(action,
+                                 entry ? entry->path.string() : std::string{},
+                                 error.what(), std::current_exception());
+              return;
             }
+          }
 
-            throw;
-          } catch (const sourcemeta::blaze::SchemaVocabularyError &error) {
-            const auto *entry{
-                action.data.empty() ? nullptr : &resolver.entry(action.data)};
-            if (entry) {
-              throw sourcemeta::core::FileError<
-                  sourcemeta::blaze::SchemaVocabularyError>(
-                  entry->path, error.uri(), error.what());
+          if (cache_key.has_value()) {
+            artifact_cache->store(cache_key.value(), action,
+                                  known_dependencies);
+          }
+
+          if (span.active() || report != nullptr) {
+            std::error_code error;
+            const auto bytes{
+                std::filesystem::file_size(action.destination, error)};
+            if (!error) {
+              span.argument("bytes", static_cast<std::uint64_t>(bytes));
             }
 
-            throw;
-          } catch (const sourcemeta::blaze::CompilerInvalidRegexError &error) {
-            const auto *entry{
-                action.data.empty() ? nullptr : &resolver.entry(action.data)};
-            if (entry) {
-              throw sourcemeta::core::FileError<
-                  sourcemeta::blaze::CompilerInvalidRegexError>(
-                  entry->path, error.base(), error.location(), error.regex());
+            if (report != nullptr) {
+              // Read back from the header the handler just wrote, which is
+              // what --profile ranks by too
+              std::optional<std::chrono::milliseconds> duration;
+              if (!error && action.destination.extension() == ".metapack") {
+                const sourcemeta::core::FileView view{action.destination};
+                const auto info{sourcemeta::one::metapack_info(view)};
+                if (info.has_value()) {
+                  duration = info->duration;
+                }
+              }
+
+              report->executed(
+                  action.type, relative_path,
+                  error ? 0 : static_cast<std::uint64_t>(bytes), duration,
+                  memory_before, sourcemeta::one::memory_sample());
             }
+          }
 
-            throw;
+          // Sealing reads the artifact, which is no reason to hold up every
+          // other worker that commits
+          const auto seal{
+              sourcemeta::one::BuildState::seal(action.destination)};
+          {
+            const auto lock{entries.take_lock()};
+            entries.commit(action.destination, std::move(action.dependencies),
+                           seal);
+            if (budget != nullptr && budget->exceeded()) {
+              release_memory(entries, resolver, *budget);
+            }
           }
 
-          const auto lock{entries.take_lock()};
-          entries.commit(action.destination, std::move(action.dependencies));
+          entries.checkpoint_if_due();
         },
         concurrency, THREAD_STACK_SIZE);
+
+    // Nothing is running between waves, and a wave is as much as a build that
+    // dies should ever have to do again
+    entries.checkpoint();
   }
 }
 
@@ -265,7 +684,7 @@ Index Options:
    --verbose, -v                  Enable verbose output
    --deterministic, -d            Stable (but slower) log output across platforms
    --concurrency, -c <number>     Set the number of concurrent threads
-   --profile, -p                  Output information about slowest steps
+   --profile, -p                  Output the slowest and most memory hungry steps
    --time, -t                     Output high-level timing information
    --comment, -m <text>           Attach a comment to the build
 
@@ -275,501 +694,122 @@ Advanced Options:
 
      Set the maximum number of direct entries in a directory listing
 
-Output Directory:
-
-   The output directory is owned by the indexer. Do NOT:
-
-   - Manually modify, add, or delete any file inside it
-   - Sync content into it or partially restore it from a backup
-   - Run concurrent indexer invocations over the same output
+   --shard <index>/<count>
 
-For more documentation, visit https://one.sourcemeta.com
-)EOF"};
+     Build only the schemas that this process owns out of <count>
+     processes over the same output, for a later --merge-shards
 
-static auto index_main(const std::string_view &program,
-                       const sourcemeta::core::Options &app) -> int {
-  if (app.contains("help")) {
-    if (!app.contains("skip-banner")) {
-      std::println("Sourcemeta One {} v{}\n", sourcemeta::one::edition(),
-                   sourcemeta::one::version());
-    }
+   --merge-shards <count>
 
-    std::println("Usage: {} <one.json> <path/to/output/directory>",
-                 std::filesystem::path{program}.filename().string());
-    std::print("{}", USAGE_DETAILS);
-    return EXIT_SUCCESS;
-  }
+     Take over what <count> processes run with --shard built, and finish
+     the build as though it had been run as one process
 
-  if (app.positional().size() != 2) {
-    if (!app.contains("skip-banner")) {
-      std::println(stderr, "Sourcemeta One {} v{}\n",
-                   sourcemeta::one::edition(), sourcemeta::one::version());
-    }
+   --artifact-cache <directory>
 
-    std::println(stderr, "Usage: {} <one.json> <path/to/output/directory>",
-                 std::filesystem::path{program}.filename().string());
-    std::print(stderr, "{}", USAGE_DETAILS);
-    return EXIT_FAILURE;
-  }
+     Reuse artifacts that any build sharing this directory already built
+     from the same inputs, and keep the ones this build makes for others
 
-  if (!app.contains("skip-banner")) {
-    std::println(stderr, "Sourcemeta One {} v{}", sourcemeta::one::edition(),
-                 sourcemeta::one::version());
-  }
+   --memory-budget <mebibytes>
 
-  PROFILE_INIT(profiling);
+     Keep the build near this much resident memory by moving its state to
+     disk and dropping what it can read back whenever it goes past it
 
-  /////////////////////////////////////////////////////////////////////////////
-  // (1) Parse the output directory
-  /////////////////////////////////////////////////////////////////////////////
+   --git
 
-  const auto output_path{
-      sourcemeta::core::weakly_canonical(app.positional().at(1))};
+     Ask git what changed under every collection checked out from a commit
+     with nothing modified, untracked or ignored, and only look at that.
+     Any other collection is looked at in full
 
-  if (std::filesystem::exists(output_path) &&
-      !std::filesystem::is_directory(output_path)) {
-    throw sourcemeta::core::IOFileAlreadyExistsError{output_path};
-  }
+   --archive
 
-  std::println(stderr, "Writing output to: {}", output_path.string());
+     Also pack every artifact into large files that the server maps once,
+     rewriting only the ones holding an artifact this build changed. Every
+     artifact is still kept as a file of its own too, which publishing
+     copies and which the server still reads some of, such as the search
+     index, so this saves neither disk space nor inodes
 
-  /////////////////////////////////////////////////////////////////////////////
-  // (2) Process the configuration file
-  /////////////////////////////////////////////////////////////////////////////
+   --publish <directory>
 
-  const auto configuration_path{
-      sourcemeta::core::canonical(app.positional().at(0))};
-  std::println(stderr, "Using configuration: {}", configuration_path.string());
-  std::unordered_set<std::string> configuration_files;
-  const auto raw_configuration{sourcemeta::one::Configuration::read(
-      configuration_path, SOURCEMETA_ONE_SELF, configuration_files)};
+     Also lay the output out as a new generation in this directory and
+     point its "current" link at it once it is whole, sharing every file
+     that did not change with the previous generation. Serve the link, and
+     every generation no server holds any longer is removed
 
-  if (app.contains("configuration")) {
-    std::ostringstream configuration_output;
-    sourcemeta::core::prettify(raw_configuration, configuration_output);
-    std::println("{}", configuration_output.str());
-    return EXIT_SUCCESS;
-  }
+   --keep-going
 
-  auto configuration{sourcemeta::one::Configuration::parse(
-      raw_configuration, configuration_path, configuration_path.parent_path())};
+     Set aside a schema that fails to build rather than stopping, build and
+     save everything that does not depend on it, and exit with an error.
+     The next build retries only what was set aside
 
-  /////////////////////////////////////////////////////////////////////////////
-  // (3) Resolve a URI to a schema filesystem path
-  /////////////////////////////////////////////////////////////////////////////
+   --report <path>
 
-  if (app.contains("resolve-schema")) {
-    const auto &resolve_schema_value{app.at("resolve-schema").front()};
-    sourcemeta::core::URI input_uri{""};
-    try {
-      input_uri = sourcemeta::core::URI{resolve_schema_value};
-    } catch (const sourcemeta::core::URIParseError &) {
-      throw sourcemeta::one::OptionInvalidURIValueError(
-          "resolve-schema", std::string{resolve_schema_value});
-    }
+     Write what the build planned, ran and took over from caches, per
+     phase and per action type, as JSON for machines to compare builds by.
+     Memory growth is pinned on single actions only with --concurrency 1
 
-    std::println(stderr, "Resolving schema for URI: {}", input_uri.recompose());
-    const auto result{configuration.resolve_schema(input_uri)};
-    if (result.has_value()) {
-      std::println("{}", result.value().string());
-      return EXIT_SUCCESS;
-    }
+   --trace-file <path>
 
-    return EXIT_FAILURE;
-  }
+     Write a trace of what each thread ran and when during the build, in
+     the Trace Event Format that Perfetto and chrome://tracing open
 
-  /////////////////////////////////////////////////////////////////////////////
-  // (4) Prepare the output directory and load previous state
-  /////////////////////////////////////////////////////////////////////////////
+   --trace-otlp <path|url>
 
-  std::filesystem::create_directories(output_path);
-  const auto canonical_output{std::filesystem::canonical(output_path)};
+     Export the phases, waves and actions of every build as OpenTelemetry
+     spans, appending OTLP/JSON to a file or posting it to the traces
+     endpoint of a collector, such as http://localhost:4318/v1/traces
 
-  sourcemeta::one::BuildState entries;
-  const auto state_path{canonical_output / "state.bin"};
-  // What this build is being asked to apply: the configuration exactly as the
-  // anchor records it, and the version of the tool applying it, since a
-  // version change is what makes artifacts of an older format unusable. A
-  // fingerprint over both, so that a state describing one of them never
-  // vouches for work done under the other
-  std::ostringstream inputs_text;
-  sourcemeta::core::prettify(raw_configuration, inputs_text);
-  inputs_text << sourcemeta::one::version();
-  const auto inputs_fingerprint{
-      sourcemeta::one::BuildState::fingerprint(inputs_text.str())};
+   --trace-sample <n>
 
-  entries.load(
-      state_path, sourcemeta::one::INDEX_RULES.leaves,
-      sourcemeta::one::INDEX_RULES.directories,
-      sourcemeta::one::rules_fingerprint<sourcemeta::one::INDEX_RULES>(),
-      inputs_fingerprint, sourcemeta::one::INDEX_RULES.sentinel);
+     Export one in this many builds with --trace-otlp, rather than all
 
-  // Only trust on-disk files when the state was loaded successfully,
-  // otherwise the entries map and the on-disk artefacts are out of sync
+   --watch
 
-  std::string current_version;
-  const auto this_version{sourcemeta::one::version()};
-  const auto version_path{canonical_output / "version.json"};
-  if (!entries.empty() && entries.built_from_these_inputs() &&
-      std::filesystem::exists(version_path)) {
-    const auto version_json{sourcemeta::core::read_json(version_path)};
-    current_version = version_json.to_string();
-  }
+     Keep running after the build, and build again whenever a schema or the
+     configuration changes, looking again only where something changed
+     (Linux only)
 
-  // Both of these records are written early, while everything derived from
-  // them is written later and the state only once the whole build has
-  // finished. So one of them matching what this build is applying is not on
-  // its own evidence that it was ever applied: a run that died in between
-  // leaves exactly that. The state carries what it was built from, and only
-  // that agreeing makes either record worth reading
-  auto current_configuration{sourcemeta::core::JSON{nullptr}};
-  const auto configuration_json_path{canonical_output / "configuration.json"};
-  if (!entries.empty() && entries.built_from_these_inputs() &&
-      std::filesystem::exists(configuration_json_path)) {
-    current_configuration =
-        sourcemeta::core::read_json(configuration_json_path);
-  }
+Output Directory:
 
-  const std::string comment{app.contains("comment")
-                                ? std::string{app.at("comment").at(0)}
-                                : std::string{}};
-  const auto build_type{configuration.html.has_value()
-                            ? sourcemeta::one::MODE_FULL
-                            : sourcemeta::one::MODE_HEADLESS};
-  const std::string_view mode_label{
-      configuration.html.has_value() ? "Full" : "Headless"};
+   The output directory is owned by the indexer. Do NOT:
 
-  // Mainly to not screw up the logs
-  std::mutex mutex;
-  const auto concurrency{app.contains("concurrency")
-                             ? parse_numeric_option(app, "concurrency")
-                             : std::thread::hardware_concurrency()};
+   - Manually modify, add, or delete any file inside it
+   - Sync content into it or partially restore it from a backup
+   - Run concurrent indexer invocations over the same output
 
-  PROFILE_END(profiling, "Startup");
-
-  /////////////////////////////////////////////////////////////////////////////
-  // (5) First pass to locate all of the schemas we will be indexing
-  // NOTE: No files are generated. We only want to know what's out there
-  /////////////////////////////////////////////////////////////////////////////
-
-  struct DetectedSchema {
-    std::filesystem::path collection_relative_path;
-    std::reference_wrapper<const sourcemeta::one::Configuration::Collection>
-        collection;
-    std::filesystem::path path;
-    std::filesystem::file_time_type mtime;
-  };
-
-  const auto deterministic{app.contains("deterministic")};
-  std::vector<DetectedSchema> detected_schemas;
-  for (const auto &pair : configuration.entries) {
-    const auto *collection{
-        std::get_if<sourcemeta::one::Configuration::Collection>(&pair.second)};
-    if (!collection) {
-      continue;
-    }
-
-    if (!std::filesystem::is_directory(collection->absolute_path)) {
-      continue;
-    }
-
-    for (auto iterator =
-             std::filesystem::recursive_directory_iterator{
-                 collection->absolute_path};
-         iterator != std::filesystem::recursive_directory_iterator{};
-         ++iterator) {
-      const auto &entry{*iterator};
-
-      if (std::ranges::any_of(collection->ignore, [&entry](
-                                                      const auto &ignore_path) {
-            return sourcemeta::core::is_under_path(entry.path(), ignore_path);
-          })) {
-        if (entry.is_directory()) {
-          iterator.disable_recursion_pending();
-        }
-        continue;
-      }
-
-      if (!entry.is_regular_file()) {
-        continue;
-      }
-
-      const auto extension{entry.path().extension()};
-      // TODO: Allow the configuration file to override this
-      if (extension != ".yaml" && extension != ".yml" && extension != ".json") {
-        continue;
-      }
-
-      // Only schema-extension files can be configuration files, so the
-      // canonicalisation (per-component syscalls) is deferred until after the
-      // cheap extension filter has rejected everything else
-      if (configuration_files.contains(
-              std::filesystem::weakly_canonical(entry.path()).native())) {
-        continue;
-      }
-
-      if (!deterministic) {
-        std::println(stderr, "Detecting: {} (#{})", entry.path().string(),
-                     detected_schemas.size() + 1);
-      }
-
-      detected_schemas.push_back({pair.first, std::cref(*collection),
-                                  entry.path(), entry.last_write_time()});
-    }
-  };
-
-  if (deterministic) {
-    std::ranges::sort(detected_schemas, [](const auto &left,
-                                           const auto &right) {
-      const auto left_key{
-          left.collection_relative_path /
-          left.path.lexically_relative(left.collection.get().absolute_path)};
-      const auto right_key{
-          right.collection_relative_path /
-          right.path.lexically_relative(right.collection.get().absolute_path)};
-      return left_key < right_key;
-    });
-    std::size_t count{0};
-    for (const auto &detected : detected_schemas) {
-      std::println(stderr, "Detecting: {} (#{})", detected.path.string(),
-                   ++count);
-    }
-  }
-
-  PROFILE_END(profiling, "Detect");
-
-  /////////////////////////////////////////////////////////////////////////////
-  // (6) Resolve all detected schemas in parallel
-  /////////////////////////////////////////////////////////////////////////////
-
-  sourcemeta::one::Resolver resolver{configuration.url};
-  resolver.reserve(detected_schemas.size());
-
-  // Phase 1: populate resolver from cache for unchanged source files.
-
-  // Skip the cache entirely if the configuration changed, as cached
-  // identifiers and paths may no longer be valid
-  const auto incremental{raw_configuration == current_configuration &&
-                         current_version == this_version};
-  std::vector<std::reference_wrapper<const DetectedSchema>> uncached_schemas;
-  for (const auto &detected : detected_schemas) {
-    const auto *cached{
-        incremental ? entries.resolve(detected.path.native(), detected.mtime)
-                    : nullptr};
-    if (cached != nullptr) {
-      const auto &collection{detected.collection.get()};
-      resolver.emplace(
-          cached->new_identifier,
-          sourcemeta::one::Resolver::Entry{
-              .path = detected.path,
-              .relative_path = cached->relative_path,
-              .mtime = detected.mtime,
-              .evaluate =
-                  sourcemeta::one::Configuration::should_evaluate(collection),
-              .cache_path = canonical_output / "schemas" /
-                            cached->relative_path / "%" / "schema.metapack",
-              .dialect = cached->dialect,
-              .original_identifier = cached->original_identifier,
-              .collection = &collection});
-    } else {
-      uncached_schemas.emplace_back(detected);
-    }
-  }
-
-  // Phase 2: resolve uncached schemas and commit to cache
-  sourcemeta::core::parallel_for_each(
-      uncached_schemas.begin(), uncached_schemas.end(),
-      [&resolver, &mutex, &entries, &uncached_schemas,
-       &app](const auto &detected_ref, const auto threads, const auto cursor) {
-        const auto &detected{detected_ref.get()};
-        print_progress(threads, "Resolving",
-                       (detected.collection_relative_path /
-                        detected.path.lexically_relative(
-                            detected.collection.get().absolute_path))
-                           .string(),
-                       cursor, uncached_schemas.size());
-        const auto result{resolver.add(detected.collection_relative_path,
-                                       detected.collection.get(), detected.path,
-                                       detected.mtime)};
-
-        {
-          const auto &resolved{result.second.get()};
-          std::lock_guard<std::mutex> lock{mutex};
-          entries.commit(detected.path.native(),
-                         sourcemeta::one::BuildState::ResolverEntry{
-                             .file_mark = detected.mtime,
-                             .new_identifier = std::string{result.first.get()},
-                             .original_identifier =
-                                 std::string{resolved.original_identifier},
-                             .dialect = std::string{resolved.dialect},
-                             .relative_path = resolved.relative_path.string()});
-        }
-
-        if (app.contains("verbose")) {
-          std::lock_guard<std::mutex> lock{mutex};
-          std::println(stderr, "{} => {}",
-                       result.second.get().original_identifier,
-                       result.first.get());
-        }
-      },
-      concurrency);
-
-  PROFILE_END(profiling, "Resolve");
-
-  /////////////////////////////////////////////////////////////////////////////
-  // (7) Run the delta plans
-  /////////////////////////////////////////////////////////////////////////////
-
-  const sourcemeta::one::BuildLimits limits{
-      .maximum_direct_directory_entries =
-          app.contains("maximum-direct-directory-entries")
-              ? parse_numeric_option(app, "maximum-direct-directory-entries")
-              : 1000};
-
-  std::vector<std::pair<std::string_view, sourcemeta::one::LeafView>>
-      leaves_storage;
-  leaves_storage.reserve(resolver.data().size());
-  for (const auto &[uri, entry] : resolver.data()) {
-    leaves_storage.emplace_back(
-        std::string_view{uri},
-        sourcemeta::one::LeafView{.path = &entry.path,
-                                  .relative_path = &entry.relative_path,
-                                  .mtime = entry.mtime,
-                                  .evaluate = entry.evaluate});
-  }
-  const sourcemeta::one::LeafSet leaves{leaves_storage};
-
-  // The views this build writes for, read below from the table it compiles, so
-  // that the naming rule is applied once and a build and the server it feeds
-  // cannot come to different answers about what the views are
-  std::vector<std::vector<std::string_view>> view_policy_paths;
-  std::vector<std::vector<std::string_view>> view_policy_keys;
-  std::vector<std::vector<std::string_view>> view_policy_session_secrets;
-  std::vector<std::string> view_policy_claims;
-  std::vector<std::vector<std::string_view>> view_policy_email_domains;
-  const auto view_policies{
-      sourcemeta::one::GENERATE_AUTHENTICATION::make_policies(
-          configuration, view_policy_paths, view_policy_keys,
-          view_policy_session_secrets, view_policy_claims,
-          view_policy_email_domains)};
-  const auto authentication_path{canonical_output / "authentication.bin"};
-  // The table this build just compiled is what the plan is filtered against, so
-  // it is read from memory rather than through the file it is also written to
-  const auto compiled{sourcemeta::one::Authentication::Table::compile(
-      view_policies, configuration.path,
-      [](const std::string_view) { return true; })};
-  sourcemeta::one::Authentication::Table::write(compiled, authentication_path);
-  const sourcemeta::one::Authentication::Table gate{compiled};
-
-  const auto view_table{gate.views()};
-  std::vector<std::string_view> views;
-  views.reserve(view_table.size());
-  for (const auto &view : view_table) {
-    views.push_back(view.name());
-  }
-
-  const auto visible{view_filter_from(gate, view_table)};
-
-  auto produce_plan{sourcemeta::one::delta<sourcemeta::one::INDEX_RULES>(
-      sourcemeta::one::BuildPhase::Produce, build_type, entries,
-      canonical_output, leaves, this_version, incremental, comment, mode_label,
-      limits, views, visible)};
-  PROFILE_END(profiling, "Producing (Delta)");
-  execute_plan(entries, canonical_output, resolver, configuration,
-               raw_configuration, concurrency, produce_plan, "Producing");
-  PROFILE_END(profiling, "Producing (Build)");
-
-  auto combine_plan{sourcemeta::one::delta<sourcemeta::one::INDEX_RULES>(
-      sourcemeta::one::BuildPhase::Combine, build_type, entries,
-      canonical_output, leaves, this_version, incremental, comment, mode_label,
-      limits, views, visible)};
-  PROFILE_END(profiling, "Combining (Delta)");
-  execute_plan(entries, canonical_output, resolver, configuration,
-               raw_configuration, concurrency, combine_plan, "Combining");
-  PROFILE_END(profiling, "Combining (Build)");
-
-  /////////////////////////////////////////////////////////////////////////////
-  // (8) Save state and profile
-  /////////////////////////////////////////////////////////////////////////////
-
-  entries.save(state_path);
-
-  PROFILE_END(profiling, "Cleanup");
-
-  /////////////////////////////////////////////////////////////////////////////
-  // (9) Output metrics
-  /////////////////////////////////////////////////////////////////////////////
-
-  // TODO: Add a test for this
-  if (app.contains("profile")) {
-    std::println(stderr, "Profiling...");
-    std::vector<std::pair<std::filesystem::path, std::chrono::milliseconds>>
-        durations;
-    for (const auto &entry :
-         std::filesystem::recursive_directory_iterator{canonical_output}) {
-      if (entry.is_regular_file() && entry.path().extension() == ".metapack") {
-        try {
-          sourcemeta::core::FileView file_view{entry.path()};
-          const auto file_info_option{
-              sourcemeta::one::metapack_info(file_view)};
-          assert(file_info_option.has_value());
-          const auto &file_info{file_info_option.value()};
-          durations.emplace_back(entry.path(), file_info.duration);
-        } catch (...) {
-          std::println(stderr, "Could not profile file: {}",
-                       entry.path().string());
-          throw;
-        }
-      }
-    }
-
-    std::ranges::sort(durations, [](const auto &left, const auto &right) {
-      return left.second > right.second;
-    });
-
-    constexpr std::size_t PROFILE_ENTRIES_MAXIMUM{25};
-    for (std::size_t index = 0;
-         index < std::min(durations.size(),
-                          static_cast<std::size_t>(PROFILE_ENTRIES_MAXIMUM));
-         index++) {
-      std::println(
-          "{}ms {}", durations[index].second.count(),
-          std::filesystem::relative(durations[index].first, canonical_output)
-              .string());
-    }
-  }
-
-  PROFILE_END(profiling, "Profile");
-
-  if (app.contains("time")) {
-    for (const auto &entry : profiling.first) {
-      std::println("{}ms {}", entry.second.count(), entry.first);
-    }
-  }
-
-  return EXIT_SUCCESS;
-}
-
-auto main(int argc, char *argv[]) noexcept -> int {
-  sourcemeta::core::stacktrace_on_crash();
+For more documentation, visit https://one.sourcemeta.com
+)EOF"};
 
+struct DetectedSchema {
+  std::filesystem::path collection_relative_path;
+  std::reference_wrapper<const sourcemeta::one::Configuration::Collection>
+      collection;
+  std::filesystem::path path;
+  std::filesystem::file_time_type mtime;
+};
+
+// How long nothing has to change before a watch builds, as saving a file is
+// rarely a single event and switching branches is thousands of them
+static constexpr std::chrono::milliseconds WATCH_QUIET_PERIOD{100};
+
+// What a build hands over to the next one while the indexer keeps watching
+struct WatchSession {
+  sourcemeta::one::Watcher watcher;
+  // Every file a build read its configuration from, canonical as detection
+  // compares them
+  std::unordered_set<std::string> configuration_files;
+  // What the previous build detected, to be patched with what changed since
+  // rather than walked for again. Only meaningful while resident, which a
+  // build that fails halfway leaves unset
+  std::vector<DetectedSchema> detected;
+  bool resident{false};
+  sourcemeta::one::WatchChanges changes;
+};
+
+// Meant to be called from within a catch block, so that a build that failed
+// is reported the same way whether it ends the program or a watch carries on
+static auto report_error() noexcept -> int {
   try {
-    sourcemeta::core::Options app;
-    app.flag("help", {"h"});
-    app.option("concurrency", {"c"});
-    app.flag("verbose", {"v"});
-    app.flag("profile", {"p"});
-    app.flag("time", {"t"});
-    app.flag("configuration", {"g"});
-    app.option("resolve-schema", {"r"});
-    app.flag("skip-banner", {"s"});
-    app.flag("deterministic", {"d"});
-    app.option("comment", {"m"});
-    app.option("maximum-direct-directory-entries", {});
-    app.parse(argc, argv);
-    const std::string_view program{argv[0]};
-
-    return index_main(program, app);
+    throw;
   } catch (const sourcemeta::one::ConfigurationCyclicReferenceError &error) {
     std::print(stderr,
                "error: {}\n  from path {}\n  at location \"{}\"\n"
@@ -794,6 +834,18 @@ auto main(int argc, char *argv[]) noexcept -> int {
     std::print(stderr, "error: {}\n  at option {}\n  with value {}\n",
                error.what(), error.option(), error.value());
     return EXIT_FAILURE;
+  } catch (const sourcemeta::one::OptionInvalidShardValueError &error) {
+    std::print(stderr, "error: {}\n  at option {}\n  with value {}\n",
+               error.what(), error.option(), error.value());
+    return EXIT_FAILURE;
+  } catch (const sourcemeta::one::OptionConflictError &error) {
+    std::print(stderr, "error: {}\n  at option {}\n  with option {}\n",
+               error.what(), error.option(), error.other());
+    return EXIT_FAILURE;
+  } catch (const sourcemeta::one::OptionUnsupportedError &error) {
+    std::print(stderr, "error: {}\n  at option {}\n", error.what(),
+               error.option());
+    return EXIT_FAILURE;
   } catch (const sourcemeta::core::OptionsUnexpectedValueFlagError &error) {
     std::print(stderr, "error: {}\n  at option {}\n", error.what(),
                error.option());
@@ -1028,22 +1080,1099 @@ auto main(int argc, char *argv[]) noexcept -> int {
                "error: Could not locate the requested file\n  at path {}\n",
                error.path().string());
     return EXIT_FAILURE;
-  } catch (const sourcemeta::core::FileError<
-           sourcemeta::blaze::CompilerInvalidRegexError> &error) {
+  } catch (const sourcemeta::core::FileError<
+           sourcemeta::blaze::CompilerInvalidRegexError> &error) {
+    std::println(stderr,
+                 "error: Invalid regular expression\n"
+                 "  pattern \"{}\"\n"
+                 "  at path {}\n"
+                 "  at schema {}\n"
+                 "  at location {}",
+                 error.regex(), error.path().string(), error.base().recompose(),
+                 sourcemeta::core::to_string(error.location()));
+    return EXIT_FAILURE;
+  } catch (const std::filesystem::filesystem_error &error) {
+    std::println(stderr, "{}", error.what());
+    return EXIT_FAILURE;
+  } catch (const std::exception &error) {
+    std::println(stderr, "unexpected error: {}", error.what());
+    return EXIT_FAILURE;
+  }
+}
+
+static auto index_build(const sourcemeta::core::Options &app,
+                        WatchSession *session) -> int {
+  // Installed before anything is timed, so that every phase makes it in, and
+  // taken down however the build ends, as spans would otherwise outlive it
+  std::unique_ptr<sourcemeta::one::Trace> trace;
+  if (app.contains("trace-file")) {
+    trace = std::make_unique<sourcemeta::one::Trace>();
+  }
+
+  sourcemeta::one::Trace::install(trace.get());
+  const struct TraceGuard {
+    ~TraceGuard() { sourcemeta::one::Trace::install(nullptr); }
+  } trace_guard;
+  // Everything the build does is under this, so that an exported build is one
+  // trace rather than one per phase
+  const sourcemeta::one::TraceSpan build_span{"build", "build"};
+
+  PROFILE_INIT(profiling);
+
+  /////////////////////////////////////////////////////////////////////////////
+  // (1) Parse the output directory
+  /////////////////////////////////////////////////////////////////////////////
+
+  const auto output_path{
+      sourcemeta::core::weakly_canonical(app.positional().at(1))};
+
+  if (std::filesystem::exists(output_path) &&
+      !std::filesystem::is_directory(output_path)) {
+    throw sourcemeta::core::IOFileAlreadyExistsError{output_path};
+  }
+
+  std::println(stderr, "Writing output to: {}", output_path.string());
+
+  /////////////////////////////////////////////////////////////////////////////
+  // (2) Process the configuration file
+  /////////////////////////////////////////////////////////////////////////////
+
+  const auto configuration_path{
+      sourcemeta::core::canonical(app.positional().at(0))};
+  std::println(stderr, "Using configuration: {}", configuration_path.string());
+  std::unordered_set<std::string> configuration_files;
+  const auto raw_configuration{sourcemeta::one::Configuration::read(
+      configuration_path, SOURCEMETA_ONE_SELF, configuration_files)};
+  if (session != nullptr) {
+    session->configuration_files.insert(configuration_path.native());
+    session->watcher.watch_file(configuration_path);
+    for (const auto &file : configuration_files) {
+      session->configuration_files.insert(file);
+      session->watcher.watch_file(file);
+    }
+  }
+
+  if (app.contains("configuration")) {
+    std::ostringstream configuration_output;
+    sourcemeta::core::prettify(raw_configuration, configuration_output);
+    std::println("{}", configuration_output.str());
+    return EXIT_SUCCESS;
+  }
+
+  auto configuration{sourcemeta::one::Configuration::parse(
+      raw_configuration, configuration_path, configuration_path.parent_path())};
+
+  /////////////////////////////////////////////////////////////////////////////
+  // (3) Resolve a URI to a schema filesystem path
+  /////////////////////////////////////////////////////////////////////////////
+
+  if (app.contains("resolve-schema")) {
+    const auto &resolve_schema_value{app.at("resolve-schema").front()};
+    sourcemeta::core::URI input_uri{""};
+    try {
+      input_uri = sourcemeta::core::URI{resolve_schema_value};
+    } catch (const sourcemeta::core::URIParseError &) {
+      throw sourcemeta::one::OptionInvalidURIValueError(
+          "resolve-schema", std::string{resolve_schema_value});
+    }
+
+    std::println(stderr, "Resolving schema for URI: {}", input_uri.recompose());
+    const auto result{configuration.resolve_schema(input_uri)};
+    if (result.has_value()) {
+      std::println("{}", result.value().string());
+      return EXIT_SUCCESS;
+    }
+
+    return EXIT_FAILURE;
+  }
+
+  /////////////////////////////////////////////////////////////////////////////
+  // (4) Prepare the output directory and load previous state
+  /////////////////////////////////////////////////////////////////////////////
+
+  std::filesystem::create_directories(output_path);
+  const auto canonical_output{std::filesystem::canonical(output_path)};
+
+  sourcemeta::one::BuildState entries;
+  const auto state_path{canonical_output / "state.bin"};
+  // What this build is being asked to apply: the configuration exactly as the
+  // anchor records it, and the version of the tool applying it, since a
+  // version change is what makes artifacts of an older format unusable. A
+  // fingerprint over both, so that a state describing one of them never
+  // vouches for work done under the other
+  std::ostringstream inputs_text;
+  sourcemeta::core::prettify(raw_configuration, inputs_text);
+  inputs_text << sourcemeta::one::version();
+  const auto inputs_fingerprint{
+      sourcemeta::one::BuildState::fingerprint(inputs_text.str())};
+
+  entries.load(
+      state_path, sourcemeta::one::INDEX_RULES.leaves,
+      sourcemeta::one::INDEX_RULES.directories,
+      sourcemeta::one::rules_fingerprint<sourcemeta::one::INDEX_RULES>(),
+      inputs_fingerprint, sourcemeta::one::INDEX_RULES.sentinel);
+
+  // Before anything reads what the state vouches for, as a build that died
+  // partway vouched for more than the state it saved last. Only a build that
+  // saves the state it loaded can tell when the journal is no longer needed.
+  // A shard leaves its own state instead, and every shard loads the same one
+  if (!app.contains("shard")) {
+    const auto journal_path{canonical_output / "state.journal"};
+    const auto replayed{entries.journal(journal_path)};
+    if (replayed > 0) {
+      std::println(stderr, "Resuming from journal: {} ({} changes)",
+                   journal_path.string(), replayed);
+    }
+  }
+
+  // Only trust on-disk files when the state was loaded successfully,
+  // otherwise the entries map and the on-disk artefacts are out of sync
+
+  std::string current_version;
+  const auto this_version{sourcemeta::one::version()};
+  const auto version_path{canonical_output / "version.json"};
+  if (!entries.empty() && entries.built_from_these_inputs() &&
+      std::filesystem::exists(version_path)) {
+    const auto version_json{sourcemeta::core::read_json(version_path)};
+    current_version = version_json.to_string();
+  }
+
+  // Both of these records are written early, while everything derived from
+  // them is written later and the state only once the whole build has
+  // finished. So one of them matching what this build is applying is not on
+  // its own evidence that it was ever applied: a run that died in between
+  // leaves exactly that. The state carries what it was built from, and only
+  // that agreeing makes either record worth reading
+  auto current_configuration{sourcemeta::core::JSON{nullptr}};
+  const auto configuration_json_path{canonical_output / "configuration.json"};
+  if (!entries.empty() && entries.built_from_these_inputs() &&
+      std::filesystem::exists(configuration_json_path)) {
+    current_configuration =
+        sourcemeta::core::read_json(configuration_json_path);
+  }
+
+  const std::string comment{app.contains("comment")
+                                ? std::string{app.at("comment").at(0)}
+                                : std::string{}};
+  const auto build_type{configuration.html.has_value()
+                            ? sourcemeta::one::MODE_FULL
+                            : sourcemeta::one::MODE_HEADLESS};
+  const std::string_view mode_label{
+      configuration.html.has_value() ? "Full" : "Headless"};
+
+  // Mainly to not screw up the logs
+  std::mutex mutex;
+  const auto concurrency{app.contains("concurrency")
+                             ? parse_numeric_option(app, "concurrency")
+                             : std::thread::hardware_concurrency()};
+
+  // A build split across processes over the same output. Each shard plans
+  // exactly what a build of everything would, builds the artifacts of the
+  // schemas it owns, and leaves what it committed beside the state. The merge
+  // takes all of that over and does the rest, which is everything that reads
+  // more than one schema
+  if (app.contains("shard") && app.contains("merge-shards")) {
+    throw sourcemeta::one::OptionConflictError("shard", "merge-shards");
+  }
+
+  // A shard only builds part of the output, and that part is nothing to serve
+  if (app.contains("shard") && app.contains("publish")) {
+    throw sourcemeta::one::OptionConflictError("shard", "publish");
+  }
+
+  const std::optional<Shard> shard{
+      app.contains("shard") ? std::optional<Shard>{parse_shard_option(
+                                  app, "shard")}
+                            : std::nullopt};
+  const auto merge_shards{app.contains("merge-shards")
+                              ? parse_numeric_option(app, "merge-shards")
+                              : 0};
+  std::vector<std::unique_ptr<sourcemeta::one::BuildState>> shard_states;
+  for (std::size_t index{0}; index < merge_shards; index++) {
+    const auto path{shard_state_path(canonical_output, index)};
+    auto shard_state{std::make_unique<sourcemeta::one::BuildState>()};
+    shard_state->load(
+        path, sourcemeta::one::INDEX_RULES.leaves,
+        sourcemeta::one::INDEX_RULES.directories,
+        sourcemeta::one::rules_fingerprint<sourcemeta::one::INDEX_RULES>(),
+        inputs_fingerprint, sourcemeta::one::INDEX_RULES.sentinel);
+    // A shard that never finished, or that applied other inputs, answers for
+    // nothing, and whatever it owned is built here instead
+    if (shard_state->empty() || !shard_state->built_from_these_inputs()) {
+      std::println(stderr, "Ignoring shard state: {}", path.string());
+      continue;
+    }
+
+    shard_states.push_back(std::move(shard_state));
+  }
+
+  // Keyed by the same inputs the state is, as nothing else decides what a
+  // handler makes of what it reads
+  std::unique_ptr<sourcemeta::one::ArtifactCache> artifact_cache;
+  if (app.contains("artifact-cache")) {
+    const auto artifact_cache_path{sourcemeta::core::weakly_canonical(
+        app.at("artifact-cache").front())};
+    std::println(stderr, "Using artifact cache: {}",
+                 artifact_cache_path.string());
+    artifact_cache = std::make_unique<sourcemeta::one::ArtifactCache>(
+        std::make_unique<sourcemeta::one::BuildCacheDirectory>(
+            artifact_cache_path),
+        canonical_output, configuration_path.parent_path(),
+        std::format(
+            "{}:{}", inputs_fingerprint,
+            sourcemeta::one::rules_fingerprint<sourcemeta::one::INDEX_RULES>()));
+  }
+
+  // Cheap enough to keep on for every build, as it only counts what the build
+  // does anyway. Profiling reads from it what artifacts cannot tell afterwards
+  std::unique_ptr<sourcemeta::one::BuildReport> report;
+  if (app.contains("report") || app.contains("profile")) {
+    report = std::make_unique<sourcemeta::one::BuildReport>();
+  }
+
+  // Failures are only held on to rather than thrown when asked for, as a build
+  // that stops at the first one is what anyone not expecting any wants
+  std::unique_ptr<sourcemeta::one::Quarantine> quarantine;
+  if (app.contains("keep-going")) {
+    quarantine = std::make_unique<sourcemeta::one::Quarantine>();
+  }
+
+  std::unique_ptr<sourcemeta::one::MemoryBudget> budget;
+  if (app.contains("memory-budget")) {
+    budget = std::make_unique<sourcemeta::one::MemoryBudget>(
+        parse_numeric_option(app, "memory-budget") * 1024 * 1024,
+        spill_directory(canonical_output, shard));
+    // Whatever a build that died partway spilled is of no use to this one
+    std::filesystem::remove_all(budget->spill_directory());
+  }
+
+  // An archive is only rewritten where this build committed or forgot an
+  // artifact, which says nothing of what a build that died before archiving
+  // changed. So the marker that the archive is whole goes until it is again
+  const auto archive_directory{canonical_output / "archive"};
+  const auto archive_marker{archive_directory / "settled"};
+  const auto archive_settled{std::filesystem::remove(archive_marker)};
+
+  PROFILE_END(profiling, "Startup");
+
+  /////////////////////////////////////////////////////////////////////////////
+  // (5) First pass to locate all of the schemas we will be indexing
+  // NOTE: No files are generated. We only want to know what's out there
+  /////////////////////////////////////////////////////////////////////////////
+
+  const auto deterministic{app.contains("deterministic")};
+  std::vector<std::pair<
+      const std::filesystem::path *,
+      std::reference_wrapper<const sourcemeta::one::Configuration::Collection>>>
+      collections;
+  std::vector<std::filesystem::path> collection_roots;
+  std::vector<sourcemeta::one::IgnoreTrie> collection_ignores;
+  for (const auto &pair : configuration.entries) {
+    const auto *collection{
+        std::get_if<sourcemeta::one::Configuration::Collection>(&pair.second)};
+    if (collection) {
+      collections.emplace_back(&pair.first, std::cref(*collection));
+      collection_roots.push_back(collection->absolute_path);
+    }
+  }
+
+  // Every trie is in place before the walk starts, as the walk holds on to
+  // where each of them begins
+  collection_ignores.reserve(collections.size());
+  for (const auto &collection : collections) {
+    collection_ignores.emplace_back(collection.second.get().absolute_path,
+                                    collection.second.get().ignore);
+  }
+
+  std::vector<DetectedSchema> detected_schemas;
+  const auto found{[&](const std::size_t index,
+                       const std::filesystem::path &path,
+                       const std::filesystem::file_time_type mtime) {
+    std::lock_guard<std::mutex> lock{mutex};
+    if (!deterministic) {
+      std::println(stderr, "Detecting: {} (#{})", path.string(),
+                   detected_schemas.size() + 1);
+    }
+
+    detected_schemas.push_back(
+        {*collections[index].first, collections[index].second, path, mtime});
+  }};
+
+  const auto detect{[&](const std::size_t index,
+                        const std::filesystem::directory_entry &entry) {
+    const auto extension{entry.path().extension()};
+    // TODO: Allow the configuration file to override this
+    if (extension != ".yaml" && extension != ".yml" &&
+        extension != ".json") {
+      return;
+    }
+
+    // Only schema-extension files can be configuration files, so the
+    // canonicalisation (per-component syscalls) is deferred until after
+    // the cheap extension filter has rejected everything else
+    if (configuration_files.contains(
+            std::filesystem::weakly_canonical(entry.path()).native())) {
+      return;
+    }
+
+    found(index, entry.path(), entry.last_write_time());
+  }};
+
+  // A watch that saw what changed since the previous build only looks again
+  // there, on top of what that build detected, as that is what makes a save
+  // cost a fraction of a build. Anything short of that, like a change to the
+  // configuration, takes walking everything again
+  if (session != nullptr && session->resident) {
+    session->resident = false;
+    detected_schemas = std::move(session->detected);
+    for (auto &detected : detected_schemas) {
+      detected.collection =
+          std::cref(std::get<sourcemeta::one::Configuration::Collection>(
+              configuration.entries.at(detected.collection_relative_path)));
+    }
+
+    auto changes{std::move(session->changes.paths)};
+    std::ranges::sort(changes);
+    const auto duplicates{std::ranges::unique(changes)};
+    changes.erase(duplicates.begin(), duplicates.end());
+    for (const auto &changed : changes) {
+      std::erase_if(detected_schemas, [&changed](const auto &detected) {
+        return sourcemeta::core::is_lexically_under_path(detected.path,
+                                                         changed);
+      });
+
+      std::error_code error;
+      const auto status{std::filesystem::symlink_status(changed, error)};
+      if (!std::filesystem::exists(status)) {
+        continue;
+      }
+
+      // Collections may nest, and then a file belongs to each of them
+      for (std::size_t index{0}; index < collections.size(); index++) {
+        if (!sourcemeta::core::is_lexically_under_path(
+                changed, collection_roots[index])) {
+          continue;
+        }
+
+        const sourcemeta::one::IgnoreTrie ignore{
+            changed, collections[index].second.get().ignore};
+        if (std::filesystem::is_directory(status)) {
+          sourcemeta::one::walk_collections(
+              std::span{&changed, 1}, std::span{&ignore, 1}, concurrency,
+              [&detect, index](const std::size_t,
+                               const std::filesystem::directory_entry &entry) {
+                detect(index, entry);
+              });
+          continue;
+        }
+
+        const std::filesystem::directory_entry entry{changed};
+        if (entry.is_regular_file() && !ignore.root()->ignored &&
+            (!entry.is_symlink() || !ignore.covers(changed))) {
+          detect(index, entry);
+        }
+      }
+    }
+  } else {
+    if (session != nullptr) {
+      for (const auto &root : collection_roots) {
+        session->watcher.watch_tree(root);
+      }
+    }
+
+    // A collection that git has exactly as its current commit has it is
+    // listed by git instead, and only what git says changed since the commit
+    // the previous build saw is looked at. Everything else keeps the mark the
+    // previous build resolved it at, whatever its modification time says
+    std::vector<std::size_t> walked;
+    for (std::size_t index{0}; index < collections.size(); index++) {
+      if (!app.contains("git") ||
+          !detect_from_git(entries, collection_roots[index],
+                           collection_ignores[index], configuration_files,
+                           [&found, index](const auto &path, const auto mtime) {
+                             found(index, path, mtime);
+                           })) {
+        walked.push_back(index);
+      }
+    }
+
+    if (walked.size() == collections.size()) {
+      sourcemeta::one::walk_collections(collection_roots, collection_ignores,
+                                        concurrency, detect);
+    } else if (!walked.empty()) {
+      // The collections git could not list are still walked all at once, so
+      // that a small one does not leave every thread but one idle. Nothing
+      // reads the tries after this point, so they are moved rather than built
+      // again
+      std::vector<std::filesystem::path> walked_roots;
+      std::vector<sourcemeta::one::IgnoreTrie> walked_ignores;
+      walked_roots.reserve(walked.size());
+      walked_ignores.reserve(walked.size());
+      for (const auto index : walked) {
+        walked_roots.push_back(collection_roots[index]);
+        walked_ignores.push_back(std::move(collection_ignores[index]));
+      }
+
+      sourcemeta::one::walk_collections(
+          walked_roots, walked_ignores, concurrency,
+          [&detect, &walked](const std::size_t root,
+                             const std::filesystem::directory_entry &entry) {
+            detect(walked[root], entry);
+          });
+    }
+  }
+
+  if (deterministic) {
+    std::ranges::sort(detected_schemas, [](const auto &left,
+                                           const auto &right) {
+      const auto left_key{
+          left.collection_relative_path /
+          left.path.lexically_relative(left.collection.get().absolute_path)};
+      const auto right_key{
+          right.collection_relative_path /
+          right.path.lexically_relative(right.collection.get().absolute_path)};
+      return left_key < right_key;
+    });
+    std::size_t count{0};
+    for (const auto &detected : detected_schemas) {
+      std::println(stderr, "Detecting: {} (#{})", detected.path.string(),
+                   ++count);
+    }
+  }
+
+  PROFILE_END(profiling, "Detect");
+
+  /////////////////////////////////////////////////////////////////////////////
+  // (6) Resolve all detected schemas in parallel
+  /////////////////////////////////////////////////////////////////////////////
+
+  sourcemeta::one::Resolver resolver{configuration.url};
+  resolver.reserve(detected_schemas.size());
+
+  // Phase 1: populate resolver from cache for unchanged source files.
+
+  // Skip the cache entirely if the configuration changed, as cached
+  // identifiers and paths may no longer be valid
+  const auto incremental{raw_configuration == current_configuration &&
+                         current_version == this_version};
+  std::vector<std::reference_wrapper<const DetectedSchema>> uncached_schemas;
+  for (const auto &detected : detected_schemas) {
+    const auto *cached{
+        incremental ? entries.resolve(detected.path.native(), detected.mtime)
+                    : nullptr};
+    // A shard resolved what it owns under the same inputs as this build, which
+    // is what makes it worth reusing even where the previous build is not
+    for (const auto &shard_state : shard_states) {
+      if (cached != nullptr) {
+        break;
+      }
+
+      cached = shard_state->resolve(detected.path.native(), detected.mtime);
+    }
+
+    if (cached != nullptr) {
+      const auto &collection{detected.collection.get()};
+      resolver.emplace(
+          cached->new_identifier,
+          sourcemeta::one::Resolver::Entry{
+              .path = detected.path,
+              .relative_path = cached->relative_path,
+              .mtime = detected.mtime,
+              .evaluate =
+                  sourcemeta::one::Configuration::should_evaluate(collection),
+              .cache_path = canonical_output / "schemas" /
+                            cached->relative_path / "%" / "schema.metapack",
+              .dialect = cached->dialect,
+              .original_identifier = cached->original_identifier,
+              .collection = &collection});
+    } else {
+      uncached_schemas.emplace_back(detected);
+    }
+  }
+
+  // Phase 2: resolve uncached schemas and commit to cache
+  sourcemeta::core::parallel_for_each(
+      uncached_schemas.begin(), uncached_schemas.end(),
+      [&resolver, &mutex, &entries, &uncached_schemas, &app,
+       &shard](const auto &detected_ref, const auto threads,
+               const auto cursor) {
+        const auto &detected{detected_ref.get()};
+        print_progress(threads, "Resolving",
+                       (detected.collection_relative_path /
+                        detected.path.lexically_relative(
+                            detected.collection.get().absolute_path))
+                           .string(),
+                       cursor, uncached_schemas.size());
+        const auto result{resolver.add(detected.collection_relative_path,
+                                       detected.collection.get(), detected.path,
+                                       detected.mtime)};
+
+        // Every shard resolves the whole catalog, as any schema may reference
+        // any other, but only records what it owns. A resolution vouches for
+        // a materialised artifact, and only the owner writes that
+        if (!shard.has_value() ||
+            shard_owner(result.first.get(), shard->count) == shard->index) {
+          const auto &resolved{result.second.get()};
+          {
+            const auto lock{entries.take_lock()};
+            entries.commit(
+                detected.path.native(),
+                sourcemeta::one::BuildState::ResolverEntry{
+                    .file_mark = detected.mtime,
+                    .new_identifier = std::string{result.first.get()},
+                    .original_identifier =
+                        std::string{resolved.original_identifier},
+                    .dialect = std::string{resolved.dialect},
+                    .relative_path = resolved.relative_path.string()});
+          }
+
+          entries.checkpoint_if_due();
+        }
+
+        if (app.contains("verbose")) {
+          std::lock_guard<std::mutex> lock{mutex};
+          std::println(stderr, "{} => {}",
+                       result.second.get().original_identifier,
+                       result.first.get());
+        }
+      },
+      concurrency);
+
+  if (report) {
+    report->resolved(detected_schemas.size(),
+                     detected_schemas.size() - uncached_schemas.size());
+  }
+
+  PROFILE_END(profiling, "Resolve");
+
+  /////////////////////////////////////////////////////////////////////////////
+  // (7) Run the delta plans
+  /////////////////////////////////////////////////////////////////////////////
+
+  const sourcemeta::one::BuildLimits limits{
+      .maximum_direct_directory_entries =
+          app.contains("maximum-direct-directory-entries")
+              ? parse_numeric_option(app, "maximum-direct-directory-entries")
+              : 1000};
+
+  std::vector<std::pair<std::string_view, sourcemeta::one::LeafView>>
+      leaves_storage;
+  leaves_storage.reserve(resolver.data().size());
+  for (const auto &[uri, entry] : resolver.data()) {
+    leaves_storage.emplace_back(
+        std::string_view{uri},
+        sourcemeta::one::LeafView{.path = &entry.path,
+                                  .relative_path = &entry.relative_path,
+                                  .mtime = entry.mtime,
+                                  .evaluate = entry.evaluate});
+  }
+  const sourcemeta::one::LeafSet leaves{leaves_storage};
+
+  // The views this build writes for, read below from the table it compiles, so
+  // that the naming rule is applied once and a build and the server it feeds
+  // cannot come to different answers about what the views are
+  std::vector<std::vector<std::string_view>> view_policy_paths;
+  std::vector<std::vector<std::string_view>> view_policy_keys;
+  std::vector<std::vector<std::string_view>> view_policy_session_secrets;
+  std::vector<std::string> view_policy_claims;
+  std::vector<std::vector<std::string_view>> view_policy_email_domains;
+  const auto view_policies{
+      sourcemeta::one::GENERATE_AUTHENTICATION::make_policies(
+          configuration, view_policy_paths, view_policy_keys,
+          view_policy_session_secrets, view_policy_claims,
+          view_policy_email_domains)};
+  const auto authentication_path{canonical_output / "authentication.bin"};
+  // The table this build just compiled is what the plan is filtered against, so
+  // it is read from memory rather than through the file it is also written to
+  const auto compiled{sourcemeta::one::Authentication::Table::compile(
+      view_policies, configuration.path,
+      [](const std::string_view) { return true; })};
+  sourcemeta::one::Authentication::Table::write(compiled, authentication_path);
+  const sourcemeta::one::Authentication::Table gate{compiled};
+
+  const auto view_table{gate.views()};
+  std::vector<std::string_view> views;
+  views.reserve(view_table.size());
+  for (const auto &view : view_table) {
+    views.push_back(view.name());
+  }
+
+  const auto visible{view_filter_from(gate, view_table, leaves)};
+
+  auto produce_plan{sourcemeta::one::delta<sourcemeta::one::INDEX_RULES>(
+      sourcemeta::one::BuildPhase::Produce, build_type, entries,
+      canonical_output, leaves, this_version, incremental, comment, mode_label,
+      limits, views, visible, concurrency)};
+  if (shard.has_value()) {
+    retain_actions(produce_plan, [&shard](const auto &action) {
+      return is_leaf_action(action.type) &&
+             shard_owner(action.data, shard->count) == shard->index;
+    });
+  } else if (!shard_states.empty()) {
+    // Taken over only once the plan exists, since it has to be the one a build
+    // of everything would have made, and so has to be made from the state the
+    // shards planned against rather than from what they left
+    for (const auto &shard_state : shard_states) {
+      entries.absorb(*shard_state);
+    }
+
+    retain_actions(produce_plan, [&shard_states](const auto &action) {
+      return !is_leaf_action(action.type) ||
+             std::ranges::none_of(shard_states, [&action](const auto &state) {
+               return state->contains(action.destination.native());
+             });
+    });
+  }
+
+  if (report) {
+    report->planned(produce_plan);
+  }
+
+  PROFILE_END(profiling, "Producing (Delta)");
+  execute_plan(entries, canonical_output, resolver, configuration,
+               raw_configuration, concurrency, produce_plan, "Producing",
+               artifact_cache.get(), report.get(), budget.get(),
+               quarantine.get());
+  PROFILE_END(profiling, "Producing (Build)");
+
+  // Nothing is running between phases, which makes it the one point where
+  // compiled metaschemas can go too
+  if (budget) {
+    entries.trim();
+    resolver.evict_dialects();
+    sourcemeta::one::GENERATE_MATERIALISED_SCHEMA::forget_catalog_metaschemas();
+  }
+
+  // Dependents are derived from every schema's dependencies at once, which is
+  // exactly what a shard does not hold
+  if (!shard.has_value()) {
+    auto combine_plan{sourcemeta::one::delta<sourcemeta::one::INDEX_RULES>(
+        sourcemeta::one::BuildPhase::Combine, build_type, entries,
+        canonical_output, leaves, this_version, incremental, comment,
+        mode_label, limits, views, visible, concurrency)};
+    if (report) {
+      report->planned(combine_plan);
+    }
+
+    PROFILE_END(profiling, "Combining (Delta)");
+    execute_plan(entries, canonical_output, resolver, configuration,
+                 raw_configuration, concurrency, combine_plan, "Combining",
+                 artifact_cache.get(), report.get(), budget.get(),
+                 quarantine.get());
+    PROFILE_END(profiling, "Combining (Build)");
+  }
+
+  /////////////////////////////////////////////////////////////////////////////
+  // (8) Save state and profile
+  /////////////////////////////////////////////////////////////////////////////
+
+  // Whatever a failure kept from being built is forgotten, down to what an
+  // earlier build left of it, so that the next build finds exactly that missing
+  // and tries it again, while the server keeps handing out what is on disk
+  const auto quarantined{quarantine && !quarantine->empty()};
+  if (quarantined) {
+    for (const auto &destination : quarantine->destinations()) {
+      entries.forget(destination);
+    }
+  }
+
+  if (shard.has_value()) {
+    // Only what this shard committed, so that the merge cannot mistake the
+    // previous build's record for something a shard vouches for
+    sourcemeta::one::BuildState partial;
+    partial.configure(
+        sourcemeta::one::INDEX_RULES.leaves,
+        sourcemeta::one::INDEX_RULES.directories,
+        sourcemeta::one::rules_fingerprint<sourcemeta::one::INDEX_RULES>(),
+        inputs_fingerprint, sourcemeta::one::INDEX_RULES.sentinel);
+    partial.absorb_committed(entries);
+
+    std::unordered_map<std::string, std::filesystem::path> foreign_sources;
+    for (const auto &[uri, entry] : resolver.data()) {
+      if (shard_owner(uri, shard->count) != shard->index) {
+        foreign_sources.emplace(entry.path.native(),
+                                canonical_output / "schemas" /
+                                    entry.relative_path / "%" /
+                                    "schema.metapack");
+      }
+    }
+
+    alias_foreign_sources(partial, foreign_sources,
+                          (canonical_output / "schemas").native() + "/",
+                          "/%/schema.metapack");
+    partial.save(shard_state_path(canonical_output, shard->index));
+  } else {
+    // Everything planned over these leaves is done by now, which is the only
+    // time the state can vouch for all of them at once. Not after a failure,
+    // as the next build has to look at every leaf to find the ones to retry
+    entries.record_leaves(
+        quarantined ? 0
+                    : sourcemeta::one::leaf_set_digest(leaves, build_type));
+    entries.save(state_path);
+    entries.settle_journal();
+    // Only once the state answers for what they built, so that a merge that
+    // dies partway can be run again over the same shards
+    for (std::size_t index{0}; index < merge_shards; index++) {
+      std::filesystem::remove(shard_state_path(canonical_output, index));
+    }
+  }
+
+  // The server answers out of an archive before it looks at the files, so one
+  // left behind by an earlier build that asked for it would hand out what this
+  // build replaced. A shard only builds part of the output, so archiving waits
+  // for the merge
+  if (!shard.has_value()) {
+    if (app.contains("archive")) {
+      // The state lists every artifact, so the output is never walked for them
+      const auto prefix_length{canonical_output.native().size() + 1};
+      const auto schemas_prefix{(canonical_output / "schemas").native() + "/"};
+      const auto explorer_prefix{(canonical_output / "explorer").native() +
+                                 "/"};
+      const auto archived{[&](const std::string_view key) {
+        return key.ends_with(".metapack") &&
+               (key.starts_with(schemas_prefix) ||
+                key.starts_with(explorer_prefix));
+      }};
+
+      std::vector<std::string> artifacts;
+      for (const auto key : entries.keys()) {
+        if (archived(key)) {
+          artifacts.emplace_back(key.substr(prefix_length));
+        }
+      }
+
+      std::vector<std::string> changed;
+      if (archive_settled) {
+        for (const auto key : entries.committed_keys()) {
+          if (archived(key)) {
+            changed.emplace_back(key.substr(prefix_length));
+          }
+        }
+
+        for (const auto &key : entries.deleted_keys()) {
+          if (archived(key)) {
+            changed.emplace_back(key.substr(prefix_length));
+          }
+        }
+      } else {
+        changed = artifacts;
+      }
+
+      const auto archive{sourcemeta::one::metapack_archive_write(
+          canonical_output, artifacts, changed, archive_directory)};
+      sourcemeta::core::write_file(archive_marker, "");
+      std::println(stderr, "Archived artifacts, rewriting {} of {} segments",
+                   archive.written, archive.segments);
+    } else {
+      std::filesystem::remove_all(archive_directory);
+    }
+  }
+
+  // Last, as a generation is only published once nothing is left to change
+  // in the output it is made of
+  if (app.contains("publish")) {
+    const auto publish_directory{
+        sourcemeta::core::weakly_canonical(app.at("publish").front())};
+    const auto publication{
+        sourcemeta::one::publish(canonical_output, publish_directory)};
     std::println(stderr,
-                 "error: Invalid regular expression\n"
-                 "  pattern \"{}\"\n"
-                 "  at path {}\n"
-                 "  at schema {}\n"
-                 "  at location {}",
-                 error.regex(), error.path().string(), error.base().recompose(),
-                 sourcemeta::core::to_string(error.location()));
-    return EXIT_FAILURE;
-  } catch (const std::filesystem::filesystem_error &error) {
-    std::println(stderr, "{}", error.what());
+                 "Published generation: {} ({} of {} files unchanged, {} "
+                 "generations collected)",
+                 publication.generation.string(), publication.unchanged,
+                 publication.files, publication.collected);
+  }
+
+  if (budget) {
+    // Only once the state no longer reads from it
+    std::error_code error;
+    std::filesystem::remove_all(budget->spill_directory(), error);
+    if (budget->releases_count() > 0) {
+      std::println(stderr,
+                   "Released memory {} times, spilling the build state {} "
+                   "times, to stay within {} MiB of memory",
+                   budget->releases_count(), entries.spills(),
+                   budget->limit() / 1024 / 1024);
+    }
+  }
+
+  PROFILE_END(profiling, "Cleanup");
+
+  /////////////////////////////////////////////////////////////////////////////
+  // (9) Output metrics
+  /////////////////////////////////////////////////////////////////////////////
+
+  // TODO: Add a test for this
+  if (app.contains("profile")) {
+    std::println(stderr, "Profiling...");
+    std::vector<std::pair<std::filesystem::path, std::chrono::milliseconds>>
+        durations;
+    for (const auto &entry :
+         std::filesystem::recursive_directory_iterator{canonical_output}) {
+      if (entry.is_regular_file() && entry.path().extension() == ".metapack") {
+        try {
+          sourcemeta::core::FileView file_view{entry.path()};
+          const auto file_info_option{
+              sourcemeta::one::metapack_info(file_view)};
+          assert(file_info_option.has_value());
+          const auto &file_info{file_info_option.value()};
+          durations.emplace_back(entry.path(), file_info.duration);
+        } catch (...) {
+          std::println(stderr, "Could not profile file: {}",
+                       entry.path().string());
+          throw;
+        }
+      }
+    }
+
+    std::ranges::sort(durations, [](const auto &left, const auto &right) {
+      return left.second > right.second;
+    });
+
+    constexpr std::size_t PROFILE_ENTRIES_MAXIMUM{25};
+    for (std::size_t index = 0;
+         index < std::min(durations.size(),
+                          static_cast<std::size_t>(PROFILE_ENTRIES_MAXIMUM));
+         index++) {
+      std::println(
+          "{}ms {}", durations[index].second.count(),
+          std::filesystem::relative(durations[index].first, canonical_output)
+              .string());
+    }
+
+    // Only for what this build ran, as memory is a property of the process
+    // an action ran in rather than of what it wrote
+    std::println(stderr, "Profiling memory...");
+    for (const auto &footprint : report->heaviest(PROFILE_ENTRIES_MAXIMUM)) {
+      std::println("{}KiB {}", footprint.growth / 1024, footprint.path);
+    }
+
+    std::println(stderr, "Profiling allocations...");
+    for (const auto &footprint : report->hungriest(PROFILE_ENTRIES_MAXIMUM)) {
+      std::println("{}KiB {}", footprint.allocated / 1024, footprint.path);
+    }
+  }
+
+  PROFILE_END(profiling, "Profile");
+
+  if (artifact_cache) {
+    const auto lookups{artifact_cache->lookups()};
+    std::println(stderr, "Artifact cache: {} hits out of {} lookups ({}%)",
+                 artifact_cache->hits(), lookups,
+                 lookups == 0 ? 0 : artifact_cache->hits() * 100 / lookups);
+  }
+
+  if (app.contains("time")) {
+    for (const auto &entry : profiling.first) {
+      std::println("{}ms {}", entry.second.count(), entry.first);
+    }
+  }
+
+  if (app.contains("report")) {
+    auto report_json{report->to_json(profiling.first)};
+    report_json.assign("incremental", sourcemeta::core::JSON{incremental});
+    if (artifact_cache) {
+      auto artifact_cache_json{sourcemeta::core::JSON::make_object()};
+      artifact_cache_json.assign(
+          "lookups", sourcemeta::core::JSON{
+                         static_cast<std::int64_t>(artifact_cache->lookups())});
+      artifact_cache_json.assign(
+          "hits", sourcemeta::core::JSON{
+                      static_cast<std::int64_t>(artifact_cache->hits())});
+      report_json.assign("artifactCache", std::move(artifact_cache_json));
+    }
+
+    if (quarantine) {
+      report_json.assign("quarantine", quarantine->to_json(canonical_output));
+    }
+
+    const auto report_path{
+        sourcemeta::core::weakly_canonical(app.at("report").front())};
+    std::println(stderr, "Writing report to: {}", report_path.string());
+    sourcemeta::core::atomic_write_file(
+        report_path, [&report_json](std::ostream &stream) {
+          sourcemeta::core::prettify(report_json, stream);
+          stream << "\n";
+        });
+  }
+
+  if (trace) {
+    const auto trace_path{
+        sourcemeta::core::weakly_canonical(app.at("trace-file").front())};
+    std::println(stderr, "Writing trace to: {}", trace_path.string());
+    sourcemeta::core::atomic_write_file(
+        trace_path, [&trace](std::ostream &stream) { trace->write(stream); });
+  }
+
+  if (session != nullptr) {
+    session->detected = std::move(detected_schemas);
+    session->resident = true;
+  }
+
+  // Only now, as a failure is only worth reporting against a build that did
+  // everything else it could
+  if (quarantined) {
+    for (const auto &[key, failure] : quarantine->sorted()) {
+      try {
+        std::rethrow_exception(failure.error);
+      } catch (...) {
+        report_error();
+      }
+    }
+
+    std::println(stderr, "Quarantined {} failures, to be retried next time",
+                 quarantine->size());
     return EXIT_FAILURE;
-  } catch (const std::exception &error) {
-    std::println(stderr, "unexpected error: {}", error.what());
+  }
+
+  return EXIT_SUCCESS;
+}
+
+static auto index_main(const std::string_view &program,
+                       const sourcemeta::core::Options &app) -> int {
+  if (app.contains("help")) {
+    if (!app.contains("skip-banner")) {
+      std::println("Sourcemeta One {} v{}\n", sourcemeta::one::edition(),
+                   sourcemeta::one::version());
+    }
+
+    std::println("Usage: {} <one.json> <path/to/output/directory>",
+                 std::filesystem::path{program}.filename().string());
+    std::print("{}", USAGE_DETAILS);
+    return EXIT_SUCCESS;
+  }
+
+  if (app.positional().size() != 2) {
+    if (!app.contains("skip-banner")) {
+      std::println(stderr, "Sourcemeta One {} v{}\n",
+                   sourcemeta::one::edition(), sourcemeta::one::version());
+    }
+
+    std::println(stderr, "Usage: {} <one.json> <path/to/output/directory>",
+                 std::filesystem::path{program}.filename().string());
+    std::print(stderr, "{}", USAGE_DETAILS);
     return EXIT_FAILURE;
   }
+
+  if (!app.contains("skip-banner")) {
+    std::println(stderr, "Sourcemeta One {} v{}", sourcemeta::one::edition(),
+                 sourcemeta::one::version());
+  }
+
+  // One exporter for as long as the indexer runs, so that every build a watch
+  // makes goes out through the same one, and taken down before it goes
+  std::unique_ptr<sourcemeta::one::OTLPExporter> exporter;
+  if (app.contains("trace-otlp")) {
+    const auto sample{app.contains("trace-sample")
+                          ? parse_numeric_option(app, "trace-sample")
+                          : 1};
+    if (sample == 0) {
+      throw sourcemeta::one::OptionInvalidNumericValueError(
+          "trace-sample", std::string{app.at("trace-sample").front()});
+    }
+
+    exporter = std::make_unique<sourcemeta::one::OTLPExporter>(
+        sourcemeta::one::OTLPExporter::Options{
+            .service = "sourcemeta-one-index", .sample = sample},
+        sourcemeta::one::OTLPExporter::sink(app.at("trace-otlp").front()));
+  }
+
+  sourcemeta::one::OTLPExporter::install(exporter.get());
+  const struct ExporterGuard {
+    ~ExporterGuard() { sourcemeta::one::OTLPExporter::install(nullptr); }
+  } exporter_guard;
+
+  // Printing the configuration or resolving a schema answers once and quits,
+  // so there is nothing to keep watching for
+  if (!app.contains("watch") || app.contains("configuration") ||
+      app.contains("resolve-schema")) {
+    return index_build(app, nullptr);
+  }
+
+  // A shard is one process out of several that only together make a build,
+  // so no one of them can rebuild on its own whatever a change reaches
+  for (const auto *option : {"shard", "merge-shards"}) {
+    if (app.contains(option)) {
+      throw sourcemeta::one::OptionConflictError("watch", option);
+    }
+  }
+
+  WatchSession session;
+  const auto output_path{
+      sourcemeta::core::weakly_canonical(app.positional().at(1))};
+  // Before the first build, as that build may well fail at the configuration,
+  // and fixing it is then what has to start the next one
+  session.watcher.watch_file(
+      sourcemeta::core::canonical(app.positional().at(0)));
+  while (true) {
+    try {
+      index_build(app, &session);
+    } catch (...) {
+      report_error();
+    }
+
+    std::println(stderr, "Watching for changes...");
+    while (true) {
+      session.changes = session.watcher.wait(WATCH_QUIET_PERIOD);
+      // What a build writes is no reason for another one, wherever the output
+      // happens to sit
+      std::erase_if(session.changes.paths, [&output_path](const auto &path) {
+        return sourcemeta::core::is_lexically_under_path(path, output_path);
+      });
+
+      if (session.changes.overflow || !session.changes.paths.empty()) {
+        break;
+      }
+    }
+
+    // The configuration decides what there is to detect in the first place
+    if (session.changes.overflow ||
+        std::ranges::any_of(session.changes.paths,
+                            [&session](const auto &path) {
+                              return session.configuration_files.contains(
+                                  std::filesystem::weakly_canonical(path)
+                                      .native());
+                            })) {
+      session.resident = false;
+    }
+
+    sourcemeta::one::GENERATE_MATERIALISED_SCHEMA::forget_catalog_metaschemas();
+  }
+}
+
+auto main(int argc, char *argv[]) noexcept -> int {
+  sourcemeta::core::stacktrace_on_crash();
+
+  try {
+    sourcemeta::core::Options app;
+    app.flag("help", {"h"});
+    app.option("concurrency", {"c"});
+    app.flag("verbose", {"v"});
+    app.flag("profile", {"p"});
+    app.flag("time", {"t"});
+    app.flag("configuration", {"g"});
+    app.option("resolve-schema", {"r"});
+    app.flag("skip-banner", {"s"});
+    app.flag("deterministic", {"d"});
+    app.option("comment", {"m"});
+    app.option("maximum-direct-directory-entries", {});
+    app.option("shard", {});
+    app.option("merge-shards", {});
+    app.option("artifact-cache", {});
+    app.option("memory-budget", {});
+    app.flag("archive", {});
+    app.option("publish", {});
+    app.flag("keep-going", {});
+    app.flag("git", {});
+    app.option("report", {});
+    app.option("trace-file", {});
+    app.option("trace-otlp", {});
+    app.option("trace-sample", {});
+    app.flag("watch", {});
+    app.parse(argc, argv);
+    const std::string_view program{argv[0]};
+
+    return index_main(program, app);
+  } catch (...) {
+    return report_error();
+  }
 }
@@ -0,0 +1,147 @@
+#ifndef SOURCEMETA_ONE_INDEX_MEMORY_H_
+#define SOURCEMETA_ONE_INDEX_MEMORY_H_
+
+#include <algorithm>  // std::min
+#include <cstddef>    // std::size_t
+#include <cstdint>    // std::uint64_t
+#include <filesystem> // std::filesystem::path
+#include <fstream>    // std::ifstream
+#include <utility>    // std::move
+
+#if defined(SOURCEMETA_ONE_INDEX_MIMALLOC)
+#include <mimalloc-stats.h> // mi_stats_get, mi_stats_t, mi_stats_init
+#include <mimalloc.h>       // mi_process_info
+#endif
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h> // getrusage, rusage, RUSAGE_SELF
+#include <unistd.h>       // sysconf, _SC_PAGESIZE
+#endif
+
+namespace sourcemeta::one {
+
+// The most memory the process has had resident at once so far, as the kernel
+// counts it when deciding what to kill. Zero where the platform does not tell
+inline auto peak_resident_bytes() noexcept -> std::uint64_t {
+#if defined(__unix__) || defined(__APPLE__)
+  rusage usage{};
+  if (getrusage(RUSAGE_SELF, &usage) != 0) {
+    return 0;
+  }
+
+#if defined(__APPLE__)
+  return static_cast<std::uint64_t>(usage.ru_maxrss);
+#else
+  // Kilobytes everywhere but on macOS
+  return static_cast<std::uint64_t>(usage.ru_maxrss) * 1024;
+#endif
+#else
+  return 0;
+#endif
+}
+
+// What the process has resident right now. Only Linux tells without asking
+// the kernel for a whole task report, so anywhere else this is the peak, which
+// errs on the side of giving memory back too early rather than too late
+inline auto resident_bytes() -> std::uint64_t {
+#if defined(__linux__)
+  std::ifstream stream{"/proc/self/statm"};
+  std::uint64_t size{0};
+  std::uint64_t resident{0};
+  if (stream >> size >> resident) {
+    return resident * static_cast<std::uint64_t>(sysconf(_SC_PAGESIZE));
+  }
+#endif
+
+  return peak_resident_bytes();
+}
+
+// Where the memory of the process stands at one point, so that what an action
+// did to it is the difference between the moment before and the moment after.
+// Both figures are for the whole process, so under concurrency they include
+// whatever ran alongside the action
+struct MemorySample {
+  // What the allocator holds from the system, which goes down as well as up.
+  // The resident size where the allocator does not tell
+  std::uint64_t held;
+  // Every byte handed out so far, freed or not, so it only ever grows. Zero
+  // where the allocator does not count
+  std::uint64_t allocated;
+};
+
+inline auto memory_sample() -> MemorySample {
+#if defined(SOURCEMETA_ONE_INDEX_MIMALLOC)
+  // On Linux the allocator reports what it committed as the resident size too
+  std::size_t committed{0};
+  mi_process_info(nullptr, nullptr, nullptr, nullptr, nullptr, &committed,
+                  nullptr, nullptr);
+  mi_stats_t stats;
+  mi_stats_init(&stats);
+  if (!mi_stats_get(&stats)) {
+    return {.held = committed, .allocated = 0};
+  }
+
+  return {.held = committed,
+          .allocated =
+              static_cast<std::uint64_t>(stats.malloc_normal.total) +
+              static_cast<std::uint64_t>(stats.malloc_huge.total)};
+#else
+  return {.held = resident_bytes(), .allocated = 0};
+#endif
+}
+
+// Keeps a build around a memory budget by having it let go of whatever it can
+// read back or work out again whenever the process goes past it, reading back
+// what it spilled from a directory of its own. Not thread safe, as it is only
+// consulted under the lock of the build state
+class MemoryBudget {
+public:
+  MemoryBudget(const std::uint64_t budget_bytes,
+               std::filesystem::path spill_directory)
+      : bytes{budget_bytes}, spill{std::move(spill_directory)} {}
+
+  // Only every so often, as reading the resident size is a system call and an
+  // action rarely grows the process by much on its own
+  [[nodiscard]] auto exceeded() -> bool {
+    if (++this->ticks < this->interval) {
+      return false;
+    }
+
+    this->ticks = 0;
+    return resident_bytes() > this->bytes;
+  }
+
+  // Letting go of memory that did not bring the process back under the budget
+  // will not do so either if done again right away, so every time that
+  // happens the budget waits twice as long before looking again
+  auto released() -> void {
+    this->releases++;
+    if (resident_bytes() > this->bytes) {
+      this->interval = std::min(this->interval * 2, MAXIMUM_INTERVAL);
+    } else {
+      this->interval = MINIMUM_INTERVAL;
+    }
+  }
+
+  [[nodiscard]] auto releases_count() const -> std::size_t {
+    return this->releases;
+  }
+
+  [[nodiscard]] auto limit() const -> std::uint64_t { return this->bytes; }
+  [[nodiscard]] auto spill_directory() const -> const std::filesystem::path & {
+    return this->spill;
+  }
+
+private:
+  static constexpr std::size_t MINIMUM_INTERVAL{64};
+  static constexpr std::size_t MAXIMUM_INTERVAL{64 * 1024};
+  std::uint64_t bytes;
+  std::filesystem::path spill;
+  std::size_t interval{MINIMUM_INTERVAL};
+  std::size_t ticks{0};
+  std::size_t releases{0};
+};
+
+} // namespace sourcemeta::one
+
+#endif
@@ -0,0 +1,167 @@
+#ifndef SOURCEMETA_ONE_INDEX_PUBLISH_H_
+#define SOURCEMETA_ONE_INDEX_PUBLISH_H_
+
+#include <sourcemeta/core/io.h>
+
+#include <sourcemeta/one/shared.h>
+
+#include <chrono>       // std::chrono
+#include <cstddef>      // std::size_t
+#include <cstdint>      // std::uint64_t
+#include <filesystem>   // std::filesystem
+#include <format>       // std::format
+#include <string_view>  // std::string_view
+#include <system_error> // std::error_code
+#include <vector>       // std::vector
+
+#if !defined(_WIN32)
+#include <fcntl.h>  // ::open, O_RDONLY, O_DIRECTORY, O_CLOEXEC
+#include <unistd.h> // ::fsync, ::close
+#endif
+
+namespace sourcemeta::one {
+
+struct PublishResult {
+  std::filesystem::path generation;
+  std::size_t files{0};
+  // The ones that are the very same file the previous generation has, which
+  // is what the build leaves of an artifact it did not have to touch
+  std::size_t unchanged{0};
+  std::size_t collected{0};
+};
+
+// A name that was just added to a directory only survives a crash once the
+// directory itself is flushed, not only the file it names
+inline auto publish_flush_directory(const std::filesystem::path &directory)
+    -> void {
+#if !defined(_WIN32)
+  const auto descriptor{
+      ::open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC)};
+  if (descriptor != -1) {
+    ::fsync(descriptor);
+    ::close(descriptor);
+  }
+#else
+  static_cast<void>(directory);
+#endif
+}
+
+// Everything the output has that a server reads, which leaves out what only
+// the next build reads back
+inline auto publish_includes(const std::filesystem::path &name) -> bool {
+  return !name.filename().string().starts_with("state.");
+}
+
+// Lay the output out as a new generation beside the ones already published,
+// and only then point the link at it. Every artifact is written by replacing
+// the file it had, never over it, so a generation can share files with the
+// output and with every other generation without any of them seeing another
+// change. An artifact that the build did not touch is then the same file as
+// the one the previous generation has, and is the one thing not flushed again
+inline auto publish(const std::filesystem::path &output,
+                    const std::filesystem::path &destination)
+    -> PublishResult {
+  const auto generations{destination / PUBLICATION_GENERATIONS};
+  std::filesystem::create_directories(generations);
+  const auto current{destination / PUBLICATION_CURRENT};
+
+  std::error_code error;
+  const auto previous_target{std::filesystem::read_symlink(current, error)};
+  const auto previous{error ? std::filesystem::path{}
+                            : destination / previous_target};
+
+  PublishResult result;
+  // Named by when it was published, so that listing the generations lists
+  // them in order
+  const auto now{static_cast<std::uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::system_clock::now().time_since_epoch())
+          .count())};
+  for (std::uint64_t attempt{0};; attempt++) {
+    result.generation = generations / std::format("{:016x}", now + attempt);
+    if (std::filesystem::create_directory(result.generation)) {
+      break;
+    }
+  }
+
+  std::vector<std::filesystem::path> directories{result.generation};
+  for (auto iterator{std::filesystem::recursive_directory_iterator{output}};
+       iterator != std::filesystem::recursive_directory_iterator{};
+       iterator++) {
+    const auto &entry{*iterator};
+    if (iterator.depth() == 0 && !publish_includes(entry.path())) {
+      iterator.disable_recursion_pending();
+      continue;
+    }
+
+    const auto relative{entry.path().lexically_relative(output)};
+    const auto target{result.generation / relative};
+    if (entry.is_directory()) {
+      std::filesystem::create_directory(target);
+      directories.push_back(target);
+      continue;
+    } else if (!entry.is_regular_file()) {
+      continue;
+    }
+
+    // A destination on another filesystem than the output gets copies, which
+    // are then never the same file as anything the previous generation has
+    std::error_code link_error;
+    std::filesystem::create_hard_link(entry.path(), target, link_error);
+    if (link_error) {
+      std::filesystem::copy_file(entry.path(), target);
+    }
+
+    result.files += 1;
+    std::error_code equivalent_error;
+    if (!previous.empty() &&
+        std::filesystem::equivalent(target, previous / relative,
+                                    equivalent_error) &&
+        !equivalent_error) {
+      result.unchanged += 1;
+    } else {
+      sourcemeta::core::flush(target);
+    }
+  }
+
+  // Last, as its lock is what tells a collector that the generation is whole
+  sourcemeta::core::write_file(result.generation / PUBLICATION_LOCK,
+                               std::string_view{});
+  sourcemeta::core::flush(result.generation / PUBLICATION_LOCK);
+  for (const auto &directory : directories) {
+    publish_flush_directory(directory);
+  }
+
+  publish_flush_directory(generations);
+
+  // A link is replaced by renaming another over it, which no reader can catch
+  // halfway. Relative, so that the publication can be moved as a whole
+  auto next{current};
+  next += ".next";
+  std::filesystem::remove(next, error);
+  std::filesystem::create_directory_symlink(
+      result.generation.lexically_relative(destination), next);
+  std::filesystem::rename(next, current);
+  publish_flush_directory(destination);
+
+  // Including generations that never finished publishing, as nothing else
+  // would ever remove them
+  std::vector<std::filesystem::path> stale;
+  for (const auto &entry : std::filesystem::directory_iterator{generations}) {
+    if (entry.path() != result.generation) {
+      stale.push_back(entry.path());
+    }
+  }
+
+  for (const auto &generation : stale) {
+    if (publication_collect(generation)) {
+      result.collected += 1;
+    }
+  }
+
+  return result;
+}
+
+} // namespace sourcemeta::one
+
+#endif
@@ -0,0 +1,179 @@
+#ifndef SOURCEMETA_ONE_INDEX_QUARANTINE_H_
+#define SOURCEMETA_ONE_INDEX_QUARANTINE_H_
+
+#include <sourcemeta/one/build.h>
+
+#include <sourcemeta/core/json.h>
+
+#include "rules.h"
+
+#include <algorithm>     // std::ranges::any_of, std::erase_if
+#include <cstddef>       // std::size_t
+#include <cstdint>       // std::uint8_t
+#include <exception>     // std::exception_ptr
+#include <filesystem>    // std::filesystem::path, std::filesystem::exists
+#include <map>           // std::map
+#include <mutex>         // std::mutex, std::lock_guard
+#include <set>           // std::set
+#include <string>        // std::string
+#include <string_view>   // std::string_view
+#include <unordered_map> // std::unordered_map
+#include <utility>       // std::move
+#include <vector>        // std::vector
+
+namespace sourcemeta::one {
+
+// What a build that keeps going past a failing schema sets aside. A schema
+// whose action failed loses every artifact it has yet to build, and anything
+// else that would have read one of those carries on without it. Nothing set
+// aside is committed, and what it had committed before is forgotten once the
+// build is over, so the next build finds it missing and retries exactly that
+class Quarantine {
+public:
+  // Whether the data of an action of this type is the schema it is over
+  [[nodiscard]] static constexpr auto
+  describes_schema(const BuildPlan::Action::Type type) -> bool {
+    return std::ranges::any_of(INDEX_RULES.leaves, [type](const auto &rule) {
+      return rule.action == type;
+    });
+  }
+
+  struct Failure {
+    std::string path;
+    BuildPlan::Action::Type type;
+    std::string message;
+    std::exception_ptr error;
+  };
+
+  // Whether an action can run given what failed before it, dropping what it
+  // would have read from a schema that failed and that no earlier build left
+  // behind either. An action over a schema that failed, or over an artifact
+  // that no schema owns and that failed, is set aside in turn
+  [[nodiscard]] auto admit(BuildPlan::Action &action) -> bool {
+    std::lock_guard<std::mutex> lock{this->mutex};
+    if (this->failed_destinations.empty()) {
+      return true;
+    }
+
+    if (Quarantine::describes_schema(action.type) &&
+        this->failures.contains(std::string{action.data})) {
+      this->failed_destinations.emplace(action.destination.native(),
+                                        std::string{action.data});
+      return false;
+    }
+
+    bool blocked{false};
+    std::erase_if(action.dependencies, [this, &blocked](const auto &path) {
+      const auto match{this->failed_destinations.find(path.native())};
+      if (match == this->failed_destinations.cend()) {
+        return false;
+      } else if (match->second.empty()) {
+        blocked = true;
+        return false;
+      }
+
+      // What an earlier build left is still what the server hands out for
+      // that schema, so it is as good an input as it was then
+      return !std::filesystem::exists(path);
+    });
+
+    if (blocked) {
+      this->failed_destinations.emplace(action.destination.native(),
+                                        std::string{});
+    }
+
+    return !blocked;
+  }
+
+  // The schema is only named for an action that describes one, as a failure
+  // anywhere else cannot be pinned on a single schema
+  auto failed(const BuildPlan::Action &action, std::string path,
+              std::string message, std::exception_ptr error) -> void {
+    std::lock_guard<std::mutex> lock{this->mutex};
+    const auto schema{Quarantine::describes_schema(action.type)};
+    const std::string key{schema ? std::string{action.data}
+                                 : action.destination.string()};
+    this->failed_destinations.emplace(action.destination.native(),
+                                      schema ? key : std::string{});
+    // Only the first, as everything after it is likely to be the same problem
+    this->failures.try_emplace(key, Failure{.path = std::move(path),
+                                            .type = action.type,
+                                            .message = std::move(message),
+                                            .error = std::move(error)});
+  }
+
+  [[nodiscard]] auto empty() -> bool {
+    std::lock_guard<std::mutex> lock{this->mutex};
+    return this->failures.empty();
+  }
+
+  [[nodiscard]] auto size() -> std::size_t {
+    std::lock_guard<std::mutex> lock{this->mutex};
+    return this->failures.size();
+  }
+
+  // Every artifact the build did not produce because of a failure, including
+  // the ones that failed themselves
+  [[nodiscard]] auto destinations() -> std::vector<std::string> {
+    std::lock_guard<std::mutex> lock{this->mutex};
+    std::vector<std::string> result;
+    result.reserve(this->failed_destinations.size());
+    for (const auto &entry : this->failed_destinations) {
+      result.push_back(entry.first);
+    }
+
+    return result;
+  }
+
+  // Sorted by what failed, so that the same failures read the same whatever
+  // order the threads ran in
+  [[nodiscard]] auto sorted() -> std::map<std::string, Failure> {
+    std::lock_guard<std::mutex> lock{this->mutex};
+    return {this->failures.cbegin(), this->failures.cend()};
+  }
+
+  [[nodiscard]] auto to_json(const std::filesystem::path &output)
+      -> sourcemeta::core::JSON {
+    auto result{sourcemeta::core::JSON::make_object()};
+    auto failures_json{sourcemeta::core::JSON::make_object()};
+    for (const auto &[key, failure] : this->sorted()) {
+      auto entry{sourcemeta::core::JSON::make_object()};
+      entry.assign("action",
+                   sourcemeta::core::JSON{std::string{ACTION_NAMES[
+                       static_cast<std::uint8_t>(failure.type)]}});
+      entry.assign("error", sourcemeta::core::JSON{failure.message});
+      if (!failure.path.empty()) {
+        entry.assign("path", sourcemeta::core::JSON{failure.path});
+      }
+
+      failures_json.assign(key, std::move(entry));
+    }
+
+    result.assign("failures", std::move(failures_json));
+
+    std::set<std::string> skipped;
+    const auto prefix_size{output.native().size() + 1};
+    for (const auto &destination : this->destinations()) {
+      skipped.insert(destination.substr(prefix_size));
+    }
+
+    auto skipped_json{sourcemeta::core::JSON::make_array()};
+    for (const auto &path : skipped) {
+      skipped_json.push_back(sourcemeta::core::JSON{path});
+    }
+
+    result.assign("skipped", std::move(skipped_json));
+    return result;
+  }
+
+private:
+  std::mutex mutex;
+  std::unordered_map<std::string, Failure> failures;
+  // Whose failure each artifact went down with, or empty where no one schema
+  // is to blame
+  std::unordered_map<std::string, std::string> failed_destinations;
+};
+
+} // namespace sourcemeta::one
+
+#endif
@@ -0,0 +1,280 @@
+#ifndef SOURCEMETA_ONE_INDEX_REPORT_H_
+#define SOURCEMETA_ONE_INDEX_REPORT_H_
+
+#include <sourcemeta/one/build.h>
+
+#include <sourcemeta/core/json.h>
+
+#include "memory.h"
+#include "rules.h"
+
+#include <algorithm>     // std::ranges::sort, std::ranges::copy_if, etc.
+#include <array>         // std::array
+#include <chrono>        // std::chrono::milliseconds
+#include <cstddef>       // std::size_t
+#include <cstdint>       // std::int64_t, std::uint64_t
+#include <iterator>      // std::back_inserter
+#include <map>           // std::map
+#include <mutex>         // std::mutex, std::lock_guard
+#include <optional>      // std::optional
+#include <string>        // std::string
+#include <string_view>   // std::string_view
+#include <unordered_map> // std::unordered_map
+#include <unordered_set> // std::unordered_set
+#include <utility>       // std::pair
+#include <vector>        // std::vector
+
+namespace sourcemeta::one {
+
+// What a build did, counted as it goes rather than worked out afterwards from
+// what it left behind, so that keeping it on costs next to nothing. Meant for
+// machines comparing one build against another, which is why everything in
+// it is a number or a name and nothing is phrased for a reader
+class BuildReport {
+public:
+  auto planned(const BuildPlan &plan) -> void {
+    std::lock_guard<std::mutex> lock{this->mutex};
+    for (const auto &wave : plan.waves) {
+      for (const auto &action : wave) {
+        this->actions[action.type].planned++;
+        if (BuildReport::describes_schema(action.type)) {
+          this->rebuilt.emplace(action.data);
+        }
+      }
+    }
+
+    for (const auto &[uri, reason] : plan.reasons) {
+      this->reasons.insert_or_assign(std::string{uri}, reason);
+    }
+  }
+
+  // The duration is what the artifact itself records, where it records one.
+  // The memory is what the process held and handed out across the action
+  auto executed(const BuildPlan::Action::Type type,
+                const std::string_view relative_path, const std::uint64_t bytes,
+                const std::optional<std::chrono::milliseconds> duration,
+                const MemorySample &before, const MemorySample &after)
+      -> void {
+    // The process as a whole may have given back more than the action took
+    const std::uint64_t growth{
+        after.held > before.held ? after.held - before.held : 0};
+    const std::uint64_t allocated{
+        after.allocated > before.allocated ? after.allocated - before.allocated
+                                           : 0};
+    std::lock_guard<std::mutex> lock{this->mutex};
+    auto &counters{this->actions[type]};
+    counters.executed++;
+    counters.bytes += bytes;
+    if (duration.has_value()) {
+      counters.durations.push_back(
+          static_cast<std::uint64_t>(duration.value().count()));
+    }
+
+    counters.growth += growth;
+    counters.growth_maximum = std::max(counters.growth_maximum, growth);
+    counters.allocated += allocated;
+    counters.allocated_maximum =
+        std::max(counters.allocated_maximum, allocated);
+
+    // Most actions fit in memory the process already had, so only the few that
+    // did not, or that churned through any, are worth keeping one by one
+    if (growth > 0 || allocated > 0) {
+      this->footprints.push_back({.path = std::string{relative_path},
+                                  .type = type,
+                                  .growth = growth,
+                                  .allocated = allocated});
+    }
+  }
+
+  struct Footprint {
+    std::string path;
+    BuildPlan::Action::Type type;
+    std::uint64_t growth;
+    std::uint64_t allocated;
+  };
+
+  // The actions that grew the memory of the process the most, largest first
+  [[nodiscard]] auto heaviest(const std::size_t limit)
+      -> std::vector<Footprint> {
+    return this->ranked(limit, &Footprint::growth);
+  }
+
+  // The actions that allocated the most, freed or not, largest first
+  [[nodiscard]] auto hungriest(const std::size_t limit)
+      -> std::vector<Footprint> {
+    return this->ranked(limit, &Footprint::allocated);
+  }
+
+  // Taken over from the artifact cache rather than run
+  auto skipped(const BuildPlan::Action::Type type) -> void {
+    std::lock_guard<std::mutex> lock{this->mutex};
+    this->actions[type].skipped++;
+  }
+
+  auto resolved(const std::size_t schemas, const std::size_t cached) -> void {
+    std::lock_guard<std::mutex> lock{this->mutex};
+    this->resolver_schemas = schemas;
+    this->resolver_cached = cached;
+  }
+
+  [[nodiscard]] auto to_json(
+      const std::vector<std::pair<std::string_view, std::chrono::milliseconds>>
+          &phases) -> sourcemeta::core::JSON {
+    std::lock_guard<std::mutex> lock{this->mutex};
+    auto result{sourcemeta::core::JSON::make_object()};
+
+    auto phases_json{sourcemeta::core::JSON::make_array()};
+    for (const auto &[name, duration] : phases) {
+      auto phase{sourcemeta::core::JSON::make_object()};
+      phase.assign("name", sourcemeta::core::JSON{std::string{name}});
+      phase.assign("milliseconds", BuildReport::number(duration.count()));
+      phases_json.push_back(std::move(phase));
+    }
+
+    result.assign("phases", std::move(phases_json));
+
+    auto resolver{sourcemeta::core::JSON::make_object()};
+    resolver.assign("schemas", BuildReport::number(this->resolver_schemas));
+    resolver.assign("cached", BuildReport::number(this->resolver_cached));
+    resolver.assign(
+        "hitRatio",
+        sourcemeta::core::JSON{
+            this->resolver_schemas == 0
+                ? 0.0
+                : static_cast<double>(this->resolver_cached) /
+                      static_cast<double>(this->resolver_schemas)});
+    result.assign("resolver", std::move(resolver));
+
+    auto actions_json{sourcemeta::core::JSON::make_object()};
+    for (std::size_t type{0}; type < this->actions.size(); type++) {
+      auto &counters{this->actions[type]};
+      if (counters.planned == 0) {
+        continue;
+      }
+
+      auto entry{sourcemeta::core::JSON::make_object()};
+      entry.assign("planned", BuildReport::number(counters.planned));
+      entry.assign("executed", BuildReport::number(counters.executed));
+      entry.assign("skipped", BuildReport::number(counters.skipped));
+      entry.assign("bytes", BuildReport::number(counters.bytes));
+      if (!counters.durations.empty()) {
+        std::ranges::sort(counters.durations);
+        auto latency{sourcemeta::core::JSON::make_object()};
+        for (const auto &[label, percentile] :
+             std::array<std::pair<std::string_view, std::size_t>, 3>{
+                 {{"p50", 50}, {"p90", 90}, {"p99", 99}}}) {
+          // Nearest rank, so that every figure is a duration some action took
+          const auto rank{(counters.durations.size() * percentile + 99) / 100};
+          latency.assign(std::string{label},
+                         BuildReport::number(counters.durations[rank - 1]));
+        }
+
+        latency.assign("max", BuildReport::number(counters.durations.back()));
+        entry.assign("milliseconds", std::move(latency));
+      }
+
+      auto memory{sourcemeta::core::JSON::make_object()};
+      memory.assign("growthBytes", BuildReport::number(counters.growth));
+      memory.assign("growthMaximumBytes",
+                    BuildReport::number(counters.growth_maximum));
+      memory.assign("allocatedBytes", BuildReport::number(counters.allocated));
+      memory.assign("allocatedMaximumBytes",
+                    BuildReport::number(counters.allocated_maximum));
+      entry.assign("memory", std::move(memory));
+
+      actions_json.assign(std::string{ACTION_NAMES[type]}, std::move(entry));
+    }
+
+    result.assign("actions", std::move(actions_json));
+    result.assign("peakResidentBytes",
+                  BuildReport::number(sourcemeta::one::peak_resident_bytes()));
+
+    // A schema rebuilt without a reason of its own was rebuilt for what it
+    // depends on, which only the plan as a whole can tell
+    auto dirty{sourcemeta::core::JSON::make_object()};
+    std::map<std::string_view, std::string_view> sorted;
+    for (const auto &uri : this->rebuilt) {
+      const auto match{this->reasons.find(uri)};
+      sorted.emplace(uri, match == this->reasons.cend()
+                              ? "dependency"
+                              : BuildReport::describe(match->second));
+    }
+
+    for (const auto &[uri, reason] : sorted) {
+      dirty.assign(std::string{uri},
+                   sourcemeta::core::JSON{std::string{reason}});
+    }
+
+    result.assign("dirty", std::move(dirty));
+    return result;
+  }
+
+private:
+  struct Counters {
+    std::uint64_t planned{0};
+    std::uint64_t executed{0};
+    std::uint64_t skipped{0};
+    std::uint64_t bytes{0};
+    std::vector<std::uint64_t> durations;
+    std::uint64_t growth{0};
+    std::uint64_t growth_maximum{0};
+    std::uint64_t allocated{0};
+    std::uint64_t allocated_maximum{0};
+  };
+
+  [[nodiscard]] auto ranked(const std::size_t limit,
+                            const std::uint64_t Footprint::*figure)
+      -> std::vector<Footprint> {
+    std::lock_guard<std::mutex> lock{this->mutex};
+    std::vector<Footprint> result;
+    std::ranges::copy_if(
+        this->footprints, std::back_inserter(result),
+        [figure](const auto &footprint) { return footprint.*figure > 0; });
+    std::ranges::sort(result, [figure](const auto &left, const auto &right) {
+      return left.*figure > right.*figure;
+    });
+
+    result.resize(std::min(limit, result.size()));
+    return result;
+  }
+
+  [[nodiscard]] static constexpr auto
+  describes_schema(const BuildPlan::Action::Type type) -> bool {
+    return std::ranges::any_of(INDEX_RULES.leaves, [type](const auto &rule) {
+      return rule.action == type;
+    });
+  }
+
+  [[nodiscard]] static constexpr auto describe(const BuildPlan::Reason reason)
+      -> std::string_view {
+    switch (reason) {
+      case BuildPlan::Reason::Full:
+        return "full";
+      case BuildPlan::Reason::New:
+        return "new";
+      case BuildPlan::Reason::Modified:
+        return "modified";
+      case BuildPlan::Reason::MissingTargets:
+        return "missing-artifacts";
+    }
+
+    return "unknown";
+  }
+
+  template <typename T>
+  [[nodiscard]] static auto number(const T value) -> sourcemeta::core::JSON {
+    return sourcemeta::core::JSON{static_cast<std::int64_t>(value)};
+  }
+
+  std::mutex mutex;
+  std::array<Counters, ACTION_COUNT> actions;
+  std::vector<Footprint> footprints;
+  std::unordered_set<std::string> rebuilt;
+  std::unordered_map<std::string, BuildPlan::Reason> reasons;
+  std::size_t resolver_schemas{0};
+  std::size_t resolver_cached{0};
+};
+
+} // namespace sourcemeta::one
+
+#endif
@@ -3,6 +3,9 @@
 
 #include <sourcemeta/one/build.h>
 
+#include <array>       // std::array
+#include <string_view> // std::string_view
+
 namespace sourcemeta::one {
 
 enum : BuildPlan::Action::Type {
@@ -36,6 +39,38 @@ enum : BuildPlan::Action::Type {
   ACTION_COUNT
 };
 
+// What traces and reports call each action type, indexed by it the same way
+// the handlers are
+inline constexpr std::array<std::string_view, ACTION_COUNT> ACTION_NAMES{{
+    "materialise",
+    "positions",
+    "locations",
+    "dependencies",
+    "stats",
+    "health",
+    "bundle",
+    "editor",
+    "blaze-exhaustive",
+    "blaze-fast",
+    "schema-metadata",
+    "dependents",
+    "search-index",
+    "mcp",
+    "directory-list",
+    "web-index",
+    "web-not-found",
+    "web-directory",
+    "web-schema",
+    "comment",
+    "configuration",
+    "version",
+    "routes",
+    "authentication",
+    "login",
+    "web-login",
+    "remove",
+}};
+
 enum : BuildPlan::Type { MODE_HEADLESS, MODE_FULL };
 
 inline constexpr DeltaRuleSet<13, 8, 5, 2> INDEX_RULES{
@@ -0,0 +1,190 @@
+#ifndef SOURCEMETA_ONE_INDEX_WATCH_H_
+#define SOURCEMETA_ONE_INDEX_WATCH_H_
+
+#include "error.h"
+
+#include <chrono>        // std::chrono::milliseconds
+#include <filesystem>    // std::filesystem
+#include <string>        // std::string
+#include <system_error>  // std::system_error, std::error_code
+#include <unordered_map> // std::unordered_map
+#include <utility>       // std::move
+#include <vector>        // std::vector
+
+#if defined(__linux__)
+#include <cerrno>        // errno
+#include <poll.h>        // poll, pollfd, POLLIN
+#include <sys/inotify.h> // inotify_init1, inotify_add_watch, inotify_event
+#include <unistd.h>      // read, close
+#endif
+
+namespace sourcemeta::one {
+
+// What changed on disk since a build, as a set of paths rather than of events,
+// since a build only cares about where to look again, not about how often or
+// in which order something happened there
+struct WatchChanges {
+  std::vector<std::filesystem::path> paths;
+  // The kernel dropped events, so nothing short of looking at everything again
+  // can tell what changed
+  bool overflow{false};
+};
+
+#if defined(__linux__)
+class Watcher {
+public:
+  Watcher() : descriptor{inotify_init1(IN_CLOEXEC)} {
+    if (this->descriptor < 0) {
+      throw std::system_error{errno, std::generic_category(),
+                              "Could not watch the filesystem"};
+    }
+  }
+
+  ~Watcher() { close(this->descriptor); }
+
+  Watcher(const Watcher &) = delete;
+  auto operator=(const Watcher &) -> Watcher & = delete;
+  Watcher(Watcher &&) = delete;
+  auto operator=(Watcher &&) -> Watcher & = delete;
+
+  // Everything under a directory, as inotify does not recurse on its own. A
+  // directory is only watched once, however often it is asked for
+  auto watch_tree(const std::filesystem::path &directory) -> void {
+    if (!std::filesystem::is_directory(directory)) {
+      return;
+    }
+
+    this->watch_directory(directory, true);
+    std::error_code error;
+    for (std::filesystem::recursive_directory_iterator iterator{
+             directory,
+             std::filesystem::directory_options::skip_permission_denied, error};
+         !error && iterator != std::filesystem::recursive_directory_iterator{};
+         iterator.increment(error)) {
+      if (iterator->is_directory() && !iterator->is_symlink()) {
+        this->watch_directory(iterator->path(), true);
+      }
+    }
+  }
+
+  // The directory a file is in rather than the file, as editors tend to save
+  // by writing a new file and renaming it over the old one. Only that
+  // directory, whatever is created in it later
+  auto watch_file(const std::filesystem::path &file) -> void {
+    if (std::filesystem::is_directory(file.parent_path())) {
+      this->watch_directory(file.parent_path(), false);
+    }
+  }
+
+  // Block until something changed and then nothing else did for a while, as
+  // saving a file is rarely one event and a checkout is thousands of them
+  [[nodiscard]] auto wait(const std::chrono::milliseconds quiet)
+      -> WatchChanges {
+    WatchChanges changes;
+    // Forever for the first event, and then only for as long as the quiet
+    // period that has to pass before the changes are handed over
+    int timeout{-1};
+    while (true) {
+      pollfd request{.fd = this->descriptor, .events = POLLIN, .revents = 0};
+      const auto ready{poll(&request, 1, timeout)};
+      if (ready < 0 && errno == EINTR) {
+        continue;
+      } else if (ready < 0) {
+        throw std::system_error{errno, std::generic_category(),
+                                "Could not watch the filesystem"};
+      } else if (ready == 0) {
+        return changes;
+      }
+
+      this->drain(changes);
+      if (!changes.paths.empty() || changes.overflow) {
+        timeout = static_cast<int>(quiet.count());
+      }
+    }
+  }
+
+private:
+  struct Directory {
+    std::filesystem::path path;
+    bool recursive;
+  };
+
+  auto watch_directory(const std::filesystem::path &directory,
+                       const bool recursive) -> void {
+    constexpr auto EVENTS{IN_CLOSE_WRITE | IN_CREATE | IN_DELETE |
+                          IN_MOVED_FROM | IN_MOVED_TO | IN_ATTRIB |
+                          IN_DELETE_SELF | IN_ONLYDIR};
+    const auto watch{
+        inotify_add_watch(this->descriptor, directory.c_str(), EVENTS)};
+    if (watch < 0) {
+      throw std::system_error{errno, std::generic_category(),
+                              "Could not watch the directory " +
+                                  directory.string()};
+    }
+
+    // The kernel answers with the same watch for the same directory, which
+    // then stays recursive once anybody asked for it to be
+    const auto [match, inserted]{
+        this->directories.try_emplace(watch, Directory{directory, recursive})};
+    if (!inserted) {
+      match->second.recursive = match->second.recursive || recursive;
+    }
+  }
+
+  auto drain(WatchChanges &changes) -> void {
+    // Aligned as the kernel expects the events it writes into it to be
+    alignas(inotify_event) char buffer[64 * 1024];
+    const auto length{read(this->descriptor, buffer, sizeof(buffer))};
+    if (length <= 0) {
+      return;
+    }
+
+    for (const char *cursor{buffer}; cursor < buffer + length;) {
+      const auto *event{reinterpret_cast<const inotify_event *>(cursor)};
+      cursor += sizeof(inotify_event) + event->len;
+      if (event->mask & IN_Q_OVERFLOW) {
+        changes.overflow = true;
+        continue;
+      }
+
+      const auto match{this->directories.find(event->wd)};
+      if (match == this->directories.end()) {
+        continue;
+      }
+
+      if (event->mask & IN_IGNORED) {
+        this->directories.erase(match);
+        continue;
+      }
+
+      auto path{event->len > 0 ? match->second.path / event->name
+                               : match->second.path};
+      // Watched straight away, as whatever lands in a new directory next would
+      // otherwise go unseen
+      if (match->second.recursive && (event->mask & IN_ISDIR) &&
+          (event->mask & (IN_CREATE | IN_MOVED_TO))) {
+        this->watch_tree(path);
+      }
+
+      changes.paths.push_back(std::move(path));
+    }
+  }
+
+  int descriptor;
+  std::unordered_map<int, Directory> directories;
+};
+#else
+class Watcher {
+public:
+  Watcher() { throw OptionUnsupportedError{"watch"}; }
+  auto watch_tree(const std::filesystem::path &) -> void {}
+  auto watch_file(const std::filesystem::path &) -> void {}
+  [[nodiscard]] auto wait(const std::chrono::milliseconds) -> WatchChanges {
+    return {};
+  }
+};
+#endif
+
+} // namespace sourcemeta::one
+
+#endif
@@ -14,6 +14,7 @@
 #include <filesystem>  // std::filesystem::path
 #include <optional>    // std::optional
 #include <span>        // std::span
+#include <string>      // std::string
 #include <string_view> // std::string_view
 
 namespace sourcemeta::one {
@@ -93,6 +94,10 @@ SOURCEMETA_ONE_METAPACK_EXPORT
 auto metapack_read_json(const std::filesystem::path &path)
     -> std::optional<sourcemeta::core::JSON>;
 
+SOURCEMETA_ONE_METAPACK_EXPORT
+auto metapack_read_json(std::span<const std::uint8_t> bytes)
+    -> std::optional<sourcemeta::core::JSON>;
+
 SOURCEMETA_ONE_METAPACK_EXPORT
 auto metapack_read_text(const std::filesystem::path &path)
     -> std::optional<std::string>;
@@ -101,18 +106,34 @@ SOURCEMETA_ONE_METAPACK_EXPORT
 auto metapack_info(const sourcemeta::core::FileView &view)
     -> std::optional<MetapackInfo>;
 
+SOURCEMETA_ONE_METAPACK_EXPORT
+auto metapack_info(std::span<const std::uint8_t> bytes)
+    -> std::optional<MetapackInfo>;
+
 SOURCEMETA_ONE_METAPACK_EXPORT
 auto metapack_payload_offset(const sourcemeta::core::FileView &view)
     -> std::optional<std::size_t>;
 
+SOURCEMETA_ONE_METAPACK_EXPORT
+auto metapack_payload_offset(std::span<const std::uint8_t> bytes)
+    -> std::optional<std::size_t>;
+
 SOURCEMETA_ONE_METAPACK_EXPORT
 auto metapack_extension_offset(const sourcemeta::core::FileView &view)
     -> std::size_t;
 
+SOURCEMETA_ONE_METAPACK_EXPORT
+auto metapack_extension_offset(std::span<const std::uint8_t> bytes)
+    -> std::size_t;
+
 SOURCEMETA_ONE_METAPACK_EXPORT
 auto metapack_extension_size(const sourcemeta::core::FileView &view)
     -> std::uint32_t;
 
+SOURCEMETA_ONE_METAPACK_EXPORT
+auto metapack_extension_size(std::span<const std::uint8_t> bytes)
+    -> std::uint32_t;
+
 template <typename T>
 auto metapack_extension(const sourcemeta::core::FileView &view) -> const T * {
   const auto offset{metapack_extension_offset(view)};
@@ -128,6 +149,26 @@ auto metapack_extension(const sourcemeta::core::FileView &view) -> const T * {
   return view.as<T>(offset);
 }
 
+// An artifact in an archive starts wherever the one before it ended, so only
+// a packed extension can be pointed at in place
+template <typename T>
+auto metapack_extension(const std::span<const std::uint8_t> bytes)
+    -> const T * {
+  static_assert(alignof(T) == 1);
+  const auto offset{metapack_extension_offset(bytes)};
+  if (offset == 0) {
+    return nullptr;
+  }
+
+  const auto size{metapack_extension_size(bytes)};
+  if (size < sizeof(T)) {
+    return nullptr;
+  }
+
+  // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+  return reinterpret_cast<const T *>(bytes.data() + offset);
+}
+
 } // namespace sourcemeta::one
 
 #endif
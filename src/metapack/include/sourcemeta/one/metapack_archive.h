@@ -0,0 +1,120 @@
+#ifndef SOURCEMETA_ONE_METAPACK_ARCHIVE_H_
+#define SOURCEMETA_ONE_METAPACK_ARCHIVE_H_
+
+#ifndef SOURCEMETA_ONE_METAPACK_EXPORT
+#include <sourcemeta/one/metapack_export.h>
+#endif
+
+#include <sourcemeta/core/io.h>
+
+#include <cstddef>     // std::size_t
+#include <cstdint>     // std::uint8_t, std::uint16_t, std::uint32_t, etc.
+#include <filesystem>  // std::filesystem::path
+#include <memory>      // std::unique_ptr
+#include <span>        // std::span
+#include <string>      // std::string
+#include <string_view> // std::string_view
+#include <vector>      // std::vector
+
+namespace sourcemeta::one {
+
+static constexpr std::uint32_t METAPACK_ARCHIVE_MAGIC{0x5241504D};
+static constexpr std::uint16_t METAPACK_ARCHIVE_VERSION{2};
+// Every artifact of a resource lands in the same segment, so a resource that
+// changed costs a rewrite of one segment. There are as many segments as it
+// takes for each to hold around this many artifacts, so that what a rewrite
+// costs stays the same whatever the size of the registry
+static constexpr std::size_t METAPACK_ARCHIVE_SEGMENT_ENTRIES{1024};
+static constexpr std::size_t METAPACK_ARCHIVE_MINIMUM_SEGMENTS{16};
+static constexpr std::size_t METAPACK_ARCHIVE_MAXIMUM_SEGMENTS{4096};
+
+#pragma pack(push, 1)
+struct MetapackArchiveHeader {
+  std::uint32_t magic;
+  std::uint16_t format_version;
+  std::uint16_t reserved;
+  // How many segments the archive was split into when this one was written,
+  // and which of them this is. A segment written for another split holds
+  // what no name falls in any more
+  std::uint32_t segments;
+  std::uint32_t segment;
+  // Always a power of two, and at least twice the entries, so that a probe
+  // reaches an empty slot after a few steps at most
+  std::uint32_t slots;
+  std::uint32_t entries;
+};
+
+struct MetapackArchiveSlot {
+  std::uint64_t hash;
+  std::uint64_t key_offset;
+  std::uint64_t offset;
+  std::uint64_t size;
+  // Zero for a slot that holds nothing, as no artifact is named by nothing
+  std::uint32_t key_length;
+  std::uint32_t reserved;
+};
+#pragma pack(pop)
+
+// How many segments an archive of this many artifacts is split into. Always
+// a power of two
+SOURCEMETA_ONE_METAPACK_EXPORT
+auto metapack_archive_segments(std::size_t artifacts) -> std::size_t;
+
+// Which of the given number of segments holds an artifact, named by its path
+// relative to the output directory with forward slashes
+SOURCEMETA_ONE_METAPACK_EXPORT
+auto metapack_archive_segment(std::string_view key, std::size_t segments)
+    -> std::size_t;
+
+SOURCEMETA_ONE_METAPACK_EXPORT
+auto metapack_archive_segment_path(const std::filesystem::path &directory,
+                                   std::size_t segment)
+    -> std::filesystem::path;
+
+struct MetapackArchiveWrite {
+  std::size_t written;
+  std::size_t segments;
+};
+
+// Pack the given artifacts of the output directory, named as a segment names
+// them, into the segments of the archive directory. Only a segment that holds
+// one of the changed artifacts, including one that is gone, or that is not
+// there is written, so nothing but those artifacts is ever looked at. The
+// caller answers for the rest being what the archive was last written from.
+// Each segment is replaced whole and atomically, so a server that maps one
+// sees it before or after, never in between
+SOURCEMETA_ONE_METAPACK_EXPORT
+auto metapack_archive_write(const std::filesystem::path &output,
+                            std::span<const std::string> artifacts,
+                            std::span<const std::string> changed,
+                            const std::filesystem::path &directory)
+    -> MetapackArchiveWrite;
+
+// Every segment of an archive mapped once, answering where an artifact is
+// with a hash and a probe into the segment its name falls in. A segment that
+// is missing, that does not read as one or that was written for another split
+// holds nothing, so that whoever asks falls back to the artifact on its own
+class SOURCEMETA_ONE_METAPACK_EXPORT MetapackArchive {
+public:
+  explicit MetapackArchive(const std::filesystem::path &directory);
+  ~MetapackArchive();
+
+  MetapackArchive(const MetapackArchive &) = delete;
+  MetapackArchive(MetapackArchive &&) = delete;
+  auto operator=(const MetapackArchive &) -> MetapackArchive & = delete;
+  auto operator=(MetapackArchive &&) -> MetapackArchive & = delete;
+
+  // The artifact exactly as it would be read from its own file, or nothing if
+  // the archive does not hold it
+  [[nodiscard]] auto find(std::string_view key) const
+      -> std::span<const std::uint8_t>;
+
+  [[nodiscard]] auto empty() const noexcept -> bool;
+
+private:
+  std::vector<std::unique_ptr<sourcemeta::core::FileView>> segments_;
+};
+
+} // namespace sourcemeta::one
+
+#endif
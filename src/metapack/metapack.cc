@@ -77,18 +77,21 @@ static auto write_metapack(const std::filesystem::path &destination,
   // disk. For Identity storage only the size is kept.
   const auto compressed{sourcemeta::core::gzip(
       reinterpret_cast<const std::uint8_t *>(content.data()), content.size())};
-  sourcemeta::core::write_file(destination, [&](std::ostream &output) -> void {
-    write_binary_header(output, mime, encoding, extension, duration, content,
-                        content.size(), compressed.size());
-
-    if (encoding == MetapackEncoding::GZIP) {
-      output.write(compressed.data(),
-                   static_cast<std::streamsize>(compressed.size()));
-    } else {
-      output.write(content.data(),
-                   static_cast<std::streamsize>(content.size()));
-    }
-  });
+  // Replaced rather than written over, so that whoever has the previous one
+  // mapped or linked elsewhere keeps reading it whole
+  sourcemeta::core::atomic_write_file(
+      destination, [&](std::ostream &output) -> void {
+        write_binary_header(output, mime, encoding, extension, duration,
+                            content, content.size(), compressed.size());
+
+        if (encoding == MetapackEncoding::GZIP) {
+          output.write(compressed.data(),
+                       static_cast<std::streamsize>(compressed.size()));
+        } else {
+          output.write(content.data(),
+                       static_cast<std::streamsize>(content.size()));
+        }
+      });
 }
 
 auto metapack_write_json(const std::filesystem::path &destination,
@@ -137,89 +140,110 @@ auto metapack_write_file(const std::filesystem::path &destination,
                  sourcemeta::core::read_file_to_string(source));
 }
 
-auto metapack_extension_offset(const sourcemeta::core::FileView &view)
-    -> std::size_t {
-  if (view.size() < sizeof(MetapackHeader) + sizeof(std::uint32_t)) {
-    return 0;
+// A file is read through the same code as a range of a larger one, so an
+// artifact reads the same whether it sits on its own or in an archive
+static auto bytes_of(const sourcemeta::core::FileView &view)
+    -> std::span<const std::uint8_t> {
+  if (view.size() == 0) {
+    return {};
+  }
+
+  return {view.as<std::uint8_t>(), view.size()};
+}
+
+// The header is packed and a range of an archive starts wherever the previous
+// artifact ended, so nothing is read in place through a wider type
+template <typename T>
+static auto read_at(const std::span<const std::uint8_t> bytes,
+                    const std::size_t offset) -> T {
+  assert(offset + sizeof(T) <= bytes.size());
+  T result;
+  std::memcpy(&result, bytes.data() + offset, sizeof(T));
+  return result;
+}
+
+static auto read_header(const std::span<const std::uint8_t> bytes)
+    -> std::optional<MetapackHeader> {
+  if (bytes.size() < sizeof(MetapackHeader) + sizeof(std::uint32_t)) {
+    return std::nullopt;
+  }
+
+  const auto header{read_at<MetapackHeader>(bytes, 0)};
+  if (header.magic != METAPACK_MAGIC ||
+      header.format_version != METAPACK_VERSION) {
+    return std::nullopt;
   }
 
-  const auto *header{view.as<MetapackHeader>()};
-  if (header->magic != METAPACK_MAGIC ||
-      header->format_version != METAPACK_VERSION) {
+  return header;
+}
+
+auto metapack_extension_offset(const std::span<const std::uint8_t> bytes)
+    -> std::size_t {
+  const auto header{read_header(bytes)};
+  if (!header.has_value()) {
     return 0;
   }
 
   const auto offset_of_extension_size{sizeof(MetapackHeader) +
                                       header->mime_length};
-  if (offset_of_extension_size + sizeof(std::uint32_t) > view.size()) {
+  if (offset_of_extension_size + sizeof(std::uint32_t) > bytes.size()) {
     return 0;
   }
 
-  const auto extension_size{*view.as<std::uint32_t>(offset_of_extension_size)};
+  const auto extension_size{
+      read_at<std::uint32_t>(bytes, offset_of_extension_size)};
   if (extension_size == 0) {
     return 0;
   }
 
   const auto extension_data_offset{offset_of_extension_size +
                                    sizeof(std::uint32_t)};
-  if (extension_data_offset + extension_size > view.size()) {
+  if (extension_data_offset + extension_size > bytes.size()) {
     return 0;
   }
 
   return extension_data_offset;
 }
 
-auto metapack_extension_size(const sourcemeta::core::FileView &view)
-    -> std::uint32_t {
-  if (view.size() < sizeof(MetapackHeader) + sizeof(std::uint32_t)) {
-    return 0;
-  }
+auto metapack_extension_offset(const sourcemeta::core::FileView &view)
+    -> std::size_t {
+  return metapack_extension_offset(bytes_of(view));
+}
 
-  const auto *header{view.as<MetapackHeader>()};
-  if (header->magic != METAPACK_MAGIC ||
-      header->format_version != METAPACK_VERSION) {
+auto metapack_extension_size(const std::span<const std::uint8_t> bytes)
+    -> std::uint32_t {
+  const auto header{read_header(bytes)};
+  if (!header.has_value()) {
     return 0;
   }
 
   const auto offset_of_extension_size{sizeof(MetapackHeader) +
                                       header->mime_length};
-  if (offset_of_extension_size + sizeof(std::uint32_t) > view.size()) {
+  if (offset_of_extension_size + sizeof(std::uint32_t) > bytes.size()) {
     return 0;
   }
 
-  return *view.as<std::uint32_t>(offset_of_extension_size);
+  return read_at<std::uint32_t>(bytes, offset_of_extension_size);
 }
 
-auto metapack_read_json(const std::filesystem::path &path)
-    -> std::optional<sourcemeta::core::JSON> {
-  if (!std::filesystem::is_regular_file(path)) {
-    return std::nullopt;
-  }
-
-  sourcemeta::core::FileView view{path};
-  if (view.size() < sizeof(MetapackHeader) + sizeof(std::uint32_t)) {
-    return std::nullopt;
-  }
-
-  const auto *header{view.as<MetapackHeader>()};
-  if (header->magic != METAPACK_MAGIC ||
-      header->format_version != METAPACK_VERSION) {
-    return std::nullopt;
-  }
+auto metapack_extension_size(const sourcemeta::core::FileView &view)
+    -> std::uint32_t {
+  return metapack_extension_size(bytes_of(view));
+}
 
-  auto payload_offset{sizeof(MetapackHeader) + header->mime_length};
-  if (payload_offset + sizeof(std::uint32_t) > view.size()) {
+auto metapack_read_json(const std::span<const std::uint8_t> bytes)
+    -> std::optional<sourcemeta::core::JSON> {
+  const auto header{read_header(bytes)};
+  if (!header.has_value()) {
     return std::nullopt;
   }
 
-  const auto *extension_size{view.as<std::uint32_t>(payload_offset)};
-  payload_offset += sizeof(std::uint32_t);
-  if (*extension_size > view.size() - payload_offset) {
+  const auto payload_offset{metapack_payload_offset(bytes)};
+  if (!payload_offset.has_value()) {
     return std::nullopt;
   }
-  payload_offset += *extension_size;
 
-  const auto payload_data_size{view.size() - payload_offset};
+  const auto payload_data_size{bytes.size() - payload_offset.value()};
   if (payload_data_size == 0) {
     return std::nullopt;
   }
@@ -232,7 +256,7 @@ auto metapack_read_json(const std::filesystem::path &path)
 
     try {
       const auto decompressed{
-          sourcemeta::core::gunzip(view.as<std::uint8_t>(payload_offset),
+          sourcemeta::core::gunzip(bytes.data() + payload_offset.value(),
                                    payload_data_size, header->content_bytes)};
       // The header records the exact uncompressed size, so a payload that
       // inflates to a different size is corrupt or a decompression bomb whose
@@ -252,8 +276,8 @@ auto metapack_read_json(const std::filesystem::path &path)
   }
 
   // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
-  const auto *payload_data{
-      reinterpret_cast<const char *>(view.as<std::uint8_t>(payload_offset))};
+  const auto *payload_data{reinterpret_cast<const char *>(
+      bytes.data() + payload_offset.value())};
   const std::string payload_string{payload_data, header->content_bytes};
   try {
     return sourcemeta::core::parse_json(payload_string);
@@ -262,35 +286,35 @@ auto metapack_read_json(const std::filesystem::path &path)
   }
 }
 
-auto metapack_read_text(const std::filesystem::path &path)
-    -> std::optional<std::string> {
+auto metapack_read_json(const std::filesystem::path &path)
+    -> std::optional<sourcemeta::core::JSON> {
   if (!std::filesystem::is_regular_file(path)) {
     return std::nullopt;
   }
+
   sourcemeta::core::FileView view{path};
-  if (view.size() < sizeof(MetapackHeader) + sizeof(std::uint32_t)) {
-    return std::nullopt;
-  }
+  return metapack_read_json(bytes_of(view));
+}
 
-  const auto *header{view.as<MetapackHeader>()};
-  if (header->magic != METAPACK_MAGIC ||
-      header->format_version != METAPACK_VERSION) {
+auto metapack_read_text(const std::filesystem::path &path)
+    -> std::optional<std::string> {
+  if (!std::filesystem::is_regular_file(path)) {
     return std::nullopt;
   }
 
-  auto payload_offset{sizeof(MetapackHeader) + header->mime_length};
-  if (payload_offset + sizeof(std::uint32_t) > view.size()) {
+  sourcemeta::core::FileView view{path};
+  const auto bytes{bytes_of(view)};
+  const auto header{read_header(bytes)};
+  if (!header.has_value()) {
     return std::nullopt;
   }
 
-  const auto *extension_size{view.as<std::uint32_t>(payload_offset)};
-  payload_offset += sizeof(std::uint32_t);
-  if (*extension_size > view.size() - payload_offset) {
+  const auto payload_offset{metapack_payload_offset(bytes)};
+  if (!payload_offset.has_value()) {
     return std::nullopt;
   }
-  payload_offset += *extension_size;
 
-  const auto payload_data_size{view.size() - payload_offset};
+  const auto payload_data_size{bytes.size() - payload_offset.value()};
   if (payload_data_size == 0) {
     return std::nullopt;
   }
@@ -303,7 +327,7 @@ auto metapack_read_text(const std::filesystem::path &path)
 
     try {
       auto decompressed{
-          sourcemeta::core::gunzip(view.as<std::uint8_t>(payload_offset),
+          sourcemeta::core::gunzip(bytes.data() + payload_offset.value(),
                                    payload_data_size, header->content_bytes)};
       // The header records the exact uncompressed size, so a payload that
       // inflates to a different size is corrupt or a decompression bomb whose
@@ -323,24 +347,19 @@ auto metapack_read_text(const std::filesystem::path &path)
   }
 
   // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
-  const auto *payload_data{
-      reinterpret_cast<const char *>(view.as<std::uint8_t>(payload_offset))};
+  const auto *payload_data{reinterpret_cast<const char *>(
+      bytes.data() + payload_offset.value())};
   return std::string{payload_data, header->content_bytes};
 }
 
-auto metapack_info(const sourcemeta::core::FileView &view)
+auto metapack_info(const std::span<const std::uint8_t> bytes)
     -> std::optional<MetapackInfo> {
-  if (view.size() < sizeof(MetapackHeader) + sizeof(std::uint32_t)) {
-    return std::nullopt;
-  }
-
-  const auto *header{view.as<MetapackHeader>()};
-  if (header->magic != METAPACK_MAGIC ||
-      header->format_version != METAPACK_VERSION) {
+  const auto header{read_header(bytes)};
+  if (!header.has_value()) {
     return std::nullopt;
   }
 
-  if (sizeof(MetapackHeader) + header->mime_length > view.size()) {
+  if (sizeof(MetapackHeader) + header->mime_length > bytes.size()) {
     return std::nullopt;
   }
 
@@ -358,7 +377,7 @@ auto metapack_info(const sourcemeta::core::FileView &view)
 
   // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
   const auto *mime_data{reinterpret_cast<const char *>(
-      view.as<std::uint8_t>(sizeof(MetapackHeader)))};
+      bytes.data() + sizeof(MetapackHeader))};
 
   return MetapackInfo{.checksum_hex = std::move(checksum_hex),
                       .last_modified = time_point,
@@ -369,31 +388,36 @@ auto metapack_info(const sourcemeta::core::FileView &view)
                       .duration = std::chrono::milliseconds{header->duration}};
 }
 
-auto metapack_payload_offset(const sourcemeta::core::FileView &view)
-    -> std::optional<std::size_t> {
-  if (view.size() < sizeof(MetapackHeader) + sizeof(std::uint32_t)) {
-    return std::nullopt;
-  }
+auto metapack_info(const sourcemeta::core::FileView &view)
+    -> std::optional<MetapackInfo> {
+  return metapack_info(bytes_of(view));
+}
 
-  const auto *header{view.as<MetapackHeader>()};
-  if (header->magic != METAPACK_MAGIC ||
-      header->format_version != METAPACK_VERSION) {
+auto metapack_payload_offset(const std::span<const std::uint8_t> bytes)
+    -> std::optional<std::size_t> {
+  const auto header{read_header(bytes)};
+  if (!header.has_value()) {
     return std::nullopt;
   }
 
   auto offset{sizeof(MetapackHeader) + header->mime_length};
-  if (offset + sizeof(std::uint32_t) > view.size()) {
+  if (offset + sizeof(std::uint32_t) > bytes.size()) {
     return std::nullopt;
   }
 
-  const auto *extension_size{view.as<std::uint32_t>(offset)};
+  const auto extension_size{read_at<std::uint32_t>(bytes, offset)};
   offset += sizeof(std::uint32_t);
-  if (*extension_size > view.size() - offset) {
+  if (extension_size > bytes.size() - offset) {
     return std::nullopt;
   }
-  offset += *extension_size;
+  offset += extension_size;
 
   return offset;
 }
 
+auto metapack_payload_offset(const sourcemeta::core::FileView &view)
+    -> std::optional<std::size_t> {
+  return metapack_payload_offset(bytes_of(view));
+}
+
 } // namespace sourcemeta::one
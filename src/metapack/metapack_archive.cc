@@ -0,0 +1,335 @@
+#include <sourcemeta/one/metapack_archive.h>
+
+#include <sourcemeta/core/io.h>
+
+#include <algorithm>    // std::ranges::sort, std::ranges::all_of, std::max, etc
+#include <bit>          // std::bit_ceil, std::has_single_bit
+#include <cstring>      // std::memcmp
+#include <filesystem>   // std::filesystem
+#include <format>       // std::format
+#include <ios>          // std::streamsize
+#include <memory>       // std::make_unique
+#include <ostream>      // std::ostream
+#include <stdexcept>    // std::runtime_error
+#include <string>       // std::string
+#include <string_view>  // std::string_view
+#include <system_error> // std::error_code
+#include <utility>      // std::move
+#include <vector>       // std::vector, std::erase_if
+
+namespace sourcemeta::one {
+
+namespace {
+
+auto fnv1a(const char *data, const std::size_t length,
+           std::uint64_t hash = 14695981039346656037ULL) -> std::uint64_t {
+  for (std::size_t index = 0; index < length; ++index) {
+    hash ^= static_cast<std::uint64_t>(static_cast<std::uint8_t>(data[index]));
+    hash *= 1099511628211ULL;
+  }
+
+  return hash;
+}
+
+struct ArchiveEntry {
+  std::string_view key;
+  std::filesystem::path path;
+  std::uint64_t size;
+};
+
+auto read_archive_header(const sourcemeta::core::FileView &view)
+    -> const MetapackArchiveHeader * {
+  if (view.size() < sizeof(MetapackArchiveHeader)) {
+    return nullptr;
+  }
+
+  const auto *header{view.as<MetapackArchiveHeader>()};
+  if (header->magic != METAPACK_ARCHIVE_MAGIC ||
+      header->format_version != METAPACK_ARCHIVE_VERSION ||
+      !std::has_single_bit(header->segments) ||
+      header->segment >= header->segments ||
+      !std::has_single_bit(header->slots) ||
+      header->slots > (view.size() - sizeof(MetapackArchiveHeader)) /
+                          sizeof(MetapackArchiveSlot)) {
+    return nullptr;
+  }
+
+  return header;
+}
+
+// How many segments the archive in the directory was split into, or zero if
+// any segment in it does not read as one written for the same split as the
+// rest, as nothing it holds can be trusted to be where a name falls then
+auto archive_segments(const std::filesystem::path &directory) -> std::size_t {
+  std::size_t result{0};
+  if (!std::filesystem::is_directory(directory)) {
+    return result;
+  }
+
+  for (const auto &entry : std::filesystem::directory_iterator{directory}) {
+    if (entry.path().extension() != ".bin") {
+      continue;
+    }
+
+    const sourcemeta::core::FileView view{entry.path()};
+    const auto *header{read_archive_header(view)};
+    if (header == nullptr || entry.path() != metapack_archive_segment_path(
+                                                 directory, header->segment) ||
+        (result != 0 && header->segments != result)) {
+      return 0;
+    }
+
+    result = header->segments;
+  }
+
+  return result;
+}
+
+auto write_segment(const std::filesystem::path &path,
+                   const std::vector<ArchiveEntry> &entries,
+                   const std::size_t segments, const std::size_t segment)
+    -> void {
+  const auto slots_count{
+      std::bit_ceil(std::max<std::size_t>(entries.size() * 2, 1))};
+  std::vector<MetapackArchiveSlot> slots(slots_count);
+  const auto keys_start{sizeof(MetapackArchiveHeader) +
+                        slots_count * sizeof(MetapackArchiveSlot)};
+  std::uint64_t keys_size{0};
+  for (const auto &entry : entries) {
+    keys_size += entry.key.size();
+  }
+
+  std::uint64_t key_offset{keys_start};
+  std::uint64_t offset{keys_start + keys_size};
+  for (const auto &entry : entries) {
+    const auto hash{fnv1a(entry.key.data(), entry.key.size())};
+    auto index{hash & (slots_count - 1)};
+    while (slots[index].key_length != 0) {
+      index = (index + 1) & (slots_count - 1);
+    }
+
+    slots[index] = {.hash = hash,
+                    .key_offset = key_offset,
+                    .offset = offset,
+                    .size = entry.size,
+                    .key_length = static_cast<std::uint32_t>(entry.key.size()),
+                    .reserved = 0};
+    key_offset += entry.key.size();
+    offset += entry.size;
+  }
+
+  const MetapackArchiveHeader header{
+      .magic = METAPACK_ARCHIVE_MAGIC,
+      .format_version = METAPACK_ARCHIVE_VERSION,
+      .reserved = 0,
+      .segments = static_cast<std::uint32_t>(segments),
+      .segment = static_cast<std::uint32_t>(segment),
+      .slots = static_cast<std::uint32_t>(slots_count),
+      .entries = static_cast<std::uint32_t>(entries.size())};
+
+  sourcemeta::core::atomic_write_file(path, [&](std::ostream &output) {
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    output.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    output.write(reinterpret_cast<const char *>(slots.data()),
+                 static_cast<std::streamsize>(slots.size() *
+                                              sizeof(MetapackArchiveSlot)));
+    for (const auto &entry : entries) {
+      output.write(entry.key.data(),
+                   static_cast<std::streamsize>(entry.key.size()));
+    }
+
+    for (const auto &entry : entries) {
+      const sourcemeta::core::FileView view{entry.path};
+      // Every offset was laid out from the sizes the artifacts had when they
+      // were listed, so one that changed since would misplace every artifact
+      // after it
+      if (view.size() != entry.size) {
+        throw std::runtime_error{std::format(
+            "The artifact changed while it was being archived: {}",
+            entry.path.string())};
+      }
+
+      // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+      output.write(reinterpret_cast<const char *>(view.as<std::uint8_t>()),
+                   static_cast<std::streamsize>(view.size()));
+    }
+  });
+}
+
+} // namespace
+
+auto metapack_archive_segments(const std::size_t artifacts) -> std::size_t {
+  const auto needed{(artifacts + METAPACK_ARCHIVE_SEGMENT_ENTRIES - 1) /
+                    METAPACK_ARCHIVE_SEGMENT_ENTRIES};
+  return std::clamp(std::bit_ceil(needed), METAPACK_ARCHIVE_MINIMUM_SEGMENTS,
+                    METAPACK_ARCHIVE_MAXIMUM_SEGMENTS);
+}
+
+auto metapack_archive_segment(const std::string_view key,
+                              const std::size_t segments) -> std::size_t {
+  // What is under the same resource goes together, so that rebuilding one
+  // touches one segment
+  const auto resource_end{key.rfind("/%/")};
+  const auto resource{resource_end == std::string_view::npos
+                          ? key.substr(0, key.rfind('/') + 1)
+                          : key.substr(0, resource_end)};
+  return fnv1a(resource.data(), resource.size()) % segments;
+}
+
+auto metapack_archive_segment_path(const std::filesystem::path &directory,
+                                   const std::size_t segment)
+    -> std::filesystem::path {
+  return directory / std::format("{:04x}.bin", segment);
+}
+
+auto metapack_archive_write(const std::filesystem::path &output,
+                            const std::span<const std::string> artifacts,
+                            const std::span<const std::string> changed,
+                            const std::filesystem::path &directory)
+    -> MetapackArchiveWrite {
+  // A split that is still within a factor of two of the right one is kept, as
+  // moving to another means writing every segment again
+  const auto existing{archive_segments(directory)};
+  const auto wanted{metapack_archive_segments(artifacts.size())};
+  const auto segments{existing != 0 && existing >= wanted / 2 &&
+                              existing <= wanted * 2
+                          ? existing
+                          : wanted};
+  std::vector<bool> dirty(segments, existing != segments);
+  if (existing != segments) {
+    std::filesystem::remove_all(directory);
+  }
+
+  for (const auto &key : changed) {
+    dirty[metapack_archive_segment(key, segments)] = true;
+  }
+
+  std::vector<std::vector<ArchiveEntry>> grouped(segments);
+  for (const auto &key : artifacts) {
+    const auto segment{metapack_archive_segment(key, segments)};
+    grouped[segment].push_back({.key = key, .path = output / key, .size = 0});
+  }
+
+  std::filesystem::create_directories(directory);
+  std::size_t written{0};
+  for (std::size_t index{0}; index < segments; index++) {
+    auto &entries{grouped[index]};
+    const auto path{metapack_archive_segment_path(directory, index)};
+    if (!dirty[index] &&
+        (entries.empty() || std::filesystem::is_regular_file(path))) {
+      continue;
+    }
+
+    // Whatever is listed but was never written, or is gone since, is for the
+    // server to not find
+    for (auto &entry : entries) {
+      std::error_code error;
+      entry.size = std::filesystem::file_size(entry.path, error);
+      if (error) {
+        entry.size = 0;
+      }
+    }
+
+    std::erase_if(entries, [](const auto &entry) { return entry.size == 0; });
+    if (entries.empty()) {
+      std::error_code error;
+      std::filesystem::remove(path, error);
+      continue;
+    }
+
+    // The same artifacts have to come to the same segment, in whatever order
+    // they were listed
+    std::ranges::sort(entries, [](const auto &left, const auto &right) {
+      return left.key < right.key;
+    });
+
+    write_segment(path, entries, segments, index);
+    written += 1;
+  }
+
+  return {.written = written, .segments = segments};
+}
+
+MetapackArchive::MetapackArchive(const std::filesystem::path &directory) {
+  // The first segment there says how many there are to look for
+  for (std::size_t index{0}; index < METAPACK_ARCHIVE_MAXIMUM_SEGMENTS;
+       index++) {
+    const auto path{metapack_archive_segment_path(directory, index)};
+    if (!this->segments_.empty() && index >= this->segments_.size()) {
+      break;
+    }
+
+    if (!std::filesystem::is_regular_file(path)) {
+      continue;
+    }
+
+    auto view{std::make_unique<sourcemeta::core::FileView>(path)};
+    const auto *header{read_archive_header(*view)};
+    if (header == nullptr || header->segment != index) {
+      continue;
+    }
+
+    if (this->segments_.empty()) {
+      this->segments_.resize(header->segments);
+    } else if (header->segments != this->segments_.size()) {
+      continue;
+    }
+
+    this->segments_[index] = std::move(view);
+  }
+}
+
+MetapackArchive::~MetapackArchive() = default;
+
+auto MetapackArchive::find(const std::string_view key) const
+    -> std::span<const std::uint8_t> {
+  if (this->segments_.empty() || key.empty()) {
+    return {};
+  }
+
+  const auto &view{
+      this->segments_[metapack_archive_segment(key, this->segments_.size())]};
+  if (!view) {
+    return {};
+  }
+
+  const auto *header{view->as<MetapackArchiveHeader>()};
+  const auto mask{static_cast<std::uint64_t>(header->slots) - 1};
+  const auto hash{fnv1a(key.data(), key.size())};
+  const auto size{view->size()};
+  for (std::uint64_t probe{0}, index{hash & mask}; probe <= mask;
+       probe++, index = (index + 1) & mask) {
+    const auto *slot{view->as<MetapackArchiveSlot>(
+        sizeof(MetapackArchiveHeader) + index * sizeof(MetapackArchiveSlot))};
+    if (slot->key_length == 0) {
+      return {};
+    }
+
+    // Whatever the segment claims is checked against what was mapped, as a
+    // truncated or corrupt segment must not send a read past its end
+    if (slot->hash != hash || slot->key_length != key.size() ||
+        slot->key_offset > size || slot->key_length > size - slot->key_offset ||
+        std::memcmp(view->as<std::uint8_t>(slot->key_offset), key.data(),
+                    key.size()) != 0) {
+      continue;
+    }
+
+    if (slot->offset > size || slot->size > size - slot->offset ||
+        slot->size == 0) {
+      return {};
+    }
+
+    return {view->as<std::uint8_t>(slot->offset), slot->size};
+  }
+
+  return {};
+}
+
+auto MetapackArchive::empty() const noexcept -> bool {
+  return std::ranges::all_of(this->segments_, [](const auto &segment) {
+    return segment == nullptr;
+  });
+}
+
+} // namespace sourcemeta::one
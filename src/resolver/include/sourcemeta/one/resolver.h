@@ -72,6 +72,10 @@ public:
 
   [[nodiscard]] auto entry(std::string_view identifier) const -> const Entry &;
 
+  // Let go of the meta-schemas kept in memory, which are then read back the
+  // next time a schema needs one. Safe to call while schemas are resolving
+  auto evict_dialects() -> void;
+
 private:
   Views views;
   // Resolution is a const operation that runs concurrently with the
@@ -179,6 +179,10 @@ auto Resolver::operator()(
     ~ResolveGuard() { resolving.erase(id); }
   } resolve_guard{std::string{identifier}};
 
+  // Nested under whatever asked, which is how a trace tells the lookups an
+  // artifact waited on apart from the work it did itself
+  sourcemeta::one::TraceSpan span{"resolve", identifier};
+
   // The cached materialisation path is the only part of an entry that is
   // mutated after registration, and those writes happen concurrently with
   // resolution, so it must be snapshotted under the shared lock. The rest
@@ -202,11 +206,13 @@ auto Resolver::operator()(
 
   // If we don't recognise the schema, try a fallback as a last resort
   if (view == nullptr) {
+    span.argument("from", std::string{"fallback"});
     return sourcemeta::blaze::schema_resolver(identifier);
   }
 
   auto cached{this->cached_dialect(identifier)};
   if (cached.has_value()) {
+    span.argument("from", std::string{"memory"});
     if (callback) {
       callback(cached_path.has_value() ? cached_path.value() : view->path);
     }
@@ -219,6 +225,7 @@ auto Resolver::operator()(
   /////////////////////////////////////////////////////////////////////////////
 
   if (cached_path.has_value()) {
+    span.argument("from", std::string{"artifact"});
     // We can guarantee the cached outcome is JSON, so we don't need to try
     // reading as YAML
     auto schema_option{
@@ -238,6 +245,7 @@ auto Resolver::operator()(
   // (3) Read the original schema file
   /////////////////////////////////////////////////////////////////////////////
 
+  span.argument("from", std::string{"source"});
   auto schema{sourcemeta::core::read_yaml_or_json(view->path)};
   assert(sourcemeta::blaze::is_schema(schema));
   if (callback) {
@@ -377,6 +385,13 @@ auto Resolver::cache_dialect(const sourcemeta::core::JSON::String &uri,
   }
 }
 
+auto Resolver::evict_dialects() -> void {
+  std::unique_lock lock{this->dialect_mutex};
+  for (auto &entry : this->dialects) {
+    entry.second.reset();
+  }
+}
+
 auto Resolver::cached_dialect(const sourcemeta::core::JSON::String &uri) const
     -> std::optional<sourcemeta::core::JSON> {
   std::shared_lock lock{this->dialect_mutex};
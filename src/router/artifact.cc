@@ -15,7 +15,9 @@
 #include <filesystem>  // std::filesystem
 #include <format>      // std::format
 #include <limits>      // std::numeric_limits
-#include <optional>    // std::optional
+#include <memory>      // std::shared_ptr, std::make_shared
+#include <optional>    // std::optional, std::nullopt
+#include <span>        // std::span
 #include <string>      // std::string
 #include <string_view> // std::string_view
 #include <utility>     // std::move
@@ -40,7 +42,7 @@ auto RouterAction::canonical_path(const std::string_view input) const
 auto RouterAction::artifact_locate(const Authentication::Path &path,
                                    const Tree tree, const std::string_view view,
                                    const std::string_view artifact_name) const
-    -> std::optional<std::filesystem::path> {
+    -> std::optional<ResolvedArtifact> {
   // The unit tree holds one answer whoever asks, so only the view tree carries
   // the segment naming who is being served
   const auto tree_root{tree == Tree::Schemas
@@ -59,14 +61,28 @@ auto RouterAction::artifact_locate(const Authentication::Path &path,
   if (!sourcemeta::core::is_under_path(canonical, tree_root)) {
     return std::nullopt;
   }
+
+  // An archived artifact is found with a hash of its name, without asking the
+  // filesystem anything, and the file it was packed from need not be there
+  const auto &archive{this->dispatcher_.archive()};
+  if (!archive.empty()) {
+    const auto bytes{archive.find(
+        canonical.lexically_relative(this->index_directory_).generic_string())};
+    if (!bytes.empty()) {
+      return ResolvedArtifact{std::move(canonical), bytes};
+    }
+  }
+
   if (!std::filesystem::exists(canonical)) {
     return std::nullopt;
   }
-  return canonical;
+  return ResolvedArtifact{std::move(canonical)};
 }
 
 auto RouterAction::caller_from(const Authentication::Credentials &credentials)
     const -> Authentication::Caller {
+  const HTTPTimingScope scope{HTTPTiming::Stage::Authentication};
+  const TraceSpan trace{"auth", "caller"};
   return this->dispatcher_.authentication().caller(credentials);
 }
 
@@ -74,6 +90,12 @@ auto RouterAction::artifact_resolve_path(
     const Authentication::Caller &caller, const std::string_view input,
     const Tree tree, const std::string_view artifact_name) const
     -> ArtifactResolution {
+  const HTTPTimingScope scope{HTTPTiming::Stage::Resolution};
+  TraceSpan trace{"resolve", artifact_name};
+  if (trace.active()) {
+    trace.argument("path", std::string{input});
+  }
+
   // The gate and the locator have to agree on where a request points, so both
   // read the one canonical path rather than each deriving its own. A path that
   // names nowhere in this instance is refused without consulting the gate,
@@ -86,8 +108,12 @@ auto RouterAction::artifact_resolve_path(
   // The gate consults the registry path, not the filesystem, and runs before
   // the existence check, so a path held back from this caller and a path that
   // was never here are indistinguishable from the outside
-  const auto &authentication{this->dispatcher_.authentication()};
-  if (!authentication.permits(path.value(), caller)) {
+  //
+  // Whether anybody at all may read the location is answered by the same walk
+  // of the table, as the unit tree needs it below on every request it serves
+  const auto reach{
+      this->dispatcher_.authentication().reach(path.value(), caller)};
+  if (!reach.permitted) {
     return {.path = std::nullopt, .is_public = false};
   }
 
@@ -115,28 +141,27 @@ auto RouterAction::artifact_resolve_path(
   // view, since reaching one at all means the location is ungoverned. The unit
   // tree holds one answer whoever asks, so what decides it there is whether
   // anybody at all may read the location, asked of the anonymous view
-  const auto is_public{
-      tree == Tree::Schemas
-          ? authentication.permits(path.value(), authentication.caller({}))
-          : caller.view() == VIEW_PUBLIC};
-  return {.path = ResolvedArtifact{std::move(located).value()},
-          .is_public = is_public};
+  const auto is_public{tree == Tree::Schemas ? reach.everybody
+                                             : caller.view() == VIEW_PUBLIC};
+  return {.path = std::move(located), .is_public = is_public};
 }
 
 auto RouterAction::artifact_resolve_path_unauthenticated(
     const std::string_view view, const std::string_view input, const Tree tree,
     const std::string_view artifact_name) const
     -> std::optional<ResolvedArtifact> {
+  const HTTPTimingScope scope{HTTPTiming::Stage::Resolution};
+  TraceSpan trace{"resolve", artifact_name};
+  if (trace.active()) {
+    trace.argument("path", std::string{input});
+  }
+
   const auto path{this->canonical_path(input)};
   if (!path.has_value()) {
     return std::nullopt;
   }
 
-  auto located{this->artifact_locate(path.value(), tree, view, artifact_name)};
-  if (!located.has_value()) {
-    return std::nullopt;
-  }
-  return ResolvedArtifact{std::move(located).value()};
+  return this->artifact_locate(path.value(), tree, view, artifact_name);
 }
 
 auto RouterAction::artifact_resolve_static(
@@ -151,6 +176,10 @@ auto RouterAction::artifact_resolve_static(
 
 auto RouterAction::artifact_read_json(const ResolvedArtifact &artifact) const
     -> std::optional<sourcemeta::core::JSON> {
+  if (!artifact.bytes().empty()) {
+    return sourcemeta::one::metapack_read_json(artifact.bytes());
+  }
+
   return sourcemeta::one::metapack_read_json(artifact.path());
 }
 
@@ -190,15 +219,27 @@ auto RouterAction::artifact_serve(
     return;
   }
 
-  if (!std::filesystem::exists(absolute_path)) {
-    sourcemeta::one::json_error(
-        request, response, sourcemeta::core::HTTP_STATUS_NOT_FOUND,
-        "urn:sourcemeta:one:not-found", "There is nothing at this URL",
-        error_schema, enable_cors ? "*" : "");
-    return;
+  // An archived artifact is already mapped, and is otherwise mapped from its
+  // own file for as long as it is being served, which for large content goes
+  // on after this returns
+  std::shared_ptr<const sourcemeta::core::FileView> file;
+  auto view{artifact.bytes()};
+  if (view.empty()) {
+    if (!std::filesystem::exists(absolute_path)) {
+      sourcemeta::one::json_error(
+          request, response, sourcemeta::core::HTTP_STATUS_NOT_FOUND,
+          "urn:sourcemeta:one:not-found", "There is nothing at this URL",
+          error_schema, enable_cors ? "*" : "");
+      return;
+    }
+
+    file = std::make_shared<const sourcemeta::core::FileView>(absolute_path);
+    if (file->size() > 0) {
+      view = std::span<const std::uint8_t>{file->as<std::uint8_t>(),
+                                           file->size()};
+    }
   }
 
-  sourcemeta::core::FileView view{absolute_path};
   if (view.size() <
       sizeof(sourcemeta::one::MetapackHeader) + sizeof(std::uint32_t)) {
     sourcemeta::one::json_error(
@@ -208,7 +249,10 @@ auto RouterAction::artifact_serve(
     return;
   }
 
-  const auto info{sourcemeta::one::metapack_info(view)};
+  const auto info{[&view] {
+    const HTTPTimingScope scope{HTTPTiming::Stage::Metadata};
+    return sourcemeta::one::metapack_info(view);
+  }()};
   if (!info.has_value()) {
     sourcemeta::one::json_error(
         request, response, sourcemeta::core::HTTP_STATUS_NOT_FOUND,
@@ -275,6 +319,7 @@ auto RouterAction::artifact_serve(
                                         ? etag_weak
                                         : etag_strong);
 
+      request.annotate_cached();
       sourcemeta::one::send_response(sourcemeta::core::HTTP_STATUS_NOT_MODIFIED,
                                      request, response);
       return;
@@ -305,13 +350,71 @@ auto RouterAction::artifact_serve(
                                         ? etag_weak
                                         : etag_strong);
 
+      request.annotate_cached();
       sourcemeta::one::send_response(sourcemeta::core::HTTP_STATUS_NOT_MODIFIED,
                                      request, response);
       return;
     }
   }
 
-  response.write_status(status);
+  const auto payload_start{sourcemeta::one::metapack_payload_offset(view)};
+  if (!payload_start.has_value()) {
+    sourcemeta::one::json_error(
+        request, response, sourcemeta::core::HTTP_STATUS_NOT_FOUND,
+        "urn:sourcemeta:one:not-found", "There is nothing at this URL",
+        error_schema, enable_cors ? "*" : "");
+    return;
+  }
+
+  const std::string_view contents{
+      // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+      reinterpret_cast<const char *>(view.data() + payload_start.value()),
+      view.size() - payload_start.value()};
+
+  // RFC 9110 §14: only content that goes out as it is stored can be cut into
+  // byte ranges, which is what resuming an interrupted download of a large
+  // bundle needs. RFC 9110 §13.1.5: a range is only served if the validator
+  // in If-Range, when there is one, still names this very content, as
+  // otherwise the client would splice together two different versions
+  // https://datatracker.ietf.org/doc/html/rfc9110#section-14
+  // https://datatracker.ietf.org/doc/html/rfc9110#section-13.1.5
+  const auto ranged{status == sourcemeta::core::HTTP_STATUS_OK &&
+                    info->encoding ==
+                        sourcemeta::one::MetapackEncoding::Identity &&
+                    request.response_encoding() ==
+                        sourcemeta::one::Encoding::Identity};
+  HTTPByteRange range{.kind = HTTPByteRange::Kind::Whole,
+                      .first = 0,
+                      .length = contents.size()};
+  if (ranged && request.method() == "get" && request.header_exists("range") &&
+      (!request.header_exists("if-range") ||
+       request.header("if-range") == etag_strong ||
+       request.header("if-range") ==
+           sourcemeta::core::to_imf_fixdate(info->last_modified))) {
+    range = http_byte_range(request.header("range"), contents.size());
+  }
+
+  // RFC 9110 §15.5.17: say how large the content is, so that the client can
+  // ask for what it actually has
+  // https://datatracker.ietf.org/doc/html/rfc9110#section-15.5.17
+  if (range.kind == HTTPByteRange::Kind::Unsatisfiable) {
+    response.write_status(sourcemeta::core::HTTP_STATUS_RANGE_NOT_SATISFIABLE);
+    if (enable_cors) {
+      response.write_header("Access-Control-Allow-Origin", "*");
+      response.write_header("Access-Control-Expose-Headers", "Link, ETag");
+    }
+    response.write_header("Content-Range",
+                          std::format("bytes */{}", contents.size()));
+    response.write_header("Cache-Control", cache_control);
+    response.write_header("Vary", vary);
+    sourcemeta::one::send_response(
+        sourcemeta::core::HTTP_STATUS_RANGE_NOT_SATISFIABLE, request, response);
+    return;
+  }
+
+  const auto partial{range.kind == HTTPByteRange::Kind::Partial};
+  response.write_status(partial ? sourcemeta::core::HTTP_STATUS_PARTIAL_CONTENT
+                                : status);
 
   // RFC 9110 §15.5.2: a 401 response MUST carry WWW-Authenticate. The
   // conditional-request short-circuits above answer 304, never 401, so tying
@@ -365,6 +468,17 @@ auto RouterAction::artifact_serve(
   // value; we just emit verbatim.
   response.write_header("Cache-Control", cache_control);
 
+  if (ranged) {
+    response.write_header("Accept-Ranges", "bytes");
+  }
+
+  if (partial) {
+    response.write_header("Content-Range",
+                          std::format("bytes {}-{}/{}", range.first,
+                                      range.first + range.length - 1,
+                                      contents.size()));
+  }
+
   // See
   // https://json-schema.org/draft/2020-12/json-schema-core.html#section-9.5.1.1
   if (!link.empty()) {
@@ -379,9 +493,10 @@ auto RouterAction::artifact_serve(
              extension_total)
             ? std::string_view{
                   // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
-                  reinterpret_cast<const char *>(view.as<std::uint8_t>(
+                  reinterpret_cast<const char *>(
+                      view.data() +
                       sourcemeta::one::metapack_extension_offset(view) +
-                      sizeof(DialectExtension))),
+                      sizeof(DialectExtension)),
                   dialect_ext->dialect_length}
             : std::string_view{};
     if (!dialect.empty()) {
@@ -389,24 +504,21 @@ auto RouterAction::artifact_serve(
     }
   }
 
-  const auto payload_start{sourcemeta::one::metapack_payload_offset(view)};
-  if (!payload_start.has_value()) {
-    sourcemeta::one::json_error(
-        request, response, sourcemeta::core::HTTP_STATUS_NOT_FOUND,
-        "urn:sourcemeta:one:not-found", "There is nothing at this URL",
-        error_schema, enable_cors ? "*" : "");
-    return;
-  }
-
-  const auto payload_size{view.size() - payload_start.value()};
-  // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
-  const std::string contents{reinterpret_cast<const char *>(
-                                 view.as<std::uint8_t>(payload_start.value())),
-                             payload_size};
+  // What the content points into, which a large response has to keep for as
+  // long as it is being read. An archived artifact points into the archive,
+  // which stays for as long as whatever dispatched the request retains it
+  std::shared_ptr<const void> owner{
+      file ? std::shared_ptr<const void>{file} : request.retained()};
 
-  if (info->encoding == sourcemeta::one::MetapackEncoding::GZIP) {
+  if (partial) {
+    sourcemeta::one::send_response(
+        sourcemeta::core::HTTP_STATUS_PARTIAL_CONTENT, request, response,
+        contents.substr(range.first, range.length),
+        sourcemeta::one::Encoding::Identity, std::nullopt, std::move(owner));
+  } else if (info->encoding == sourcemeta::one::MetapackEncoding::GZIP) {
     sourcemeta::one::send_response(status, request, response, contents,
-                                   sourcemeta::one::Encoding::GZIP);
+                                   sourcemeta::one::Encoding::GZIP,
+                                   std::nullopt, std::move(owner));
   } else {
     // The header carries the compressed size as a fixed-width `uint64_t`
     // to keep the metapack format portable across architectures. Narrow
@@ -418,7 +530,7 @@ auto RouterAction::artifact_serve(
     sourcemeta::one::send_response(
         status, request, response, contents,
         sourcemeta::one::Encoding::Identity,
-        static_cast<std::size_t>(info->compressed_bytes));
+        static_cast<std::size_t>(info->compressed_bytes), std::move(owner));
   }
 }
 
@@ -5,24 +5,107 @@
 #include <sourcemeta/one/metapack.h>
 #include <sourcemeta/one/router.h>
 
+#include <sourcemeta/core/io.h>
+
 #include <cassert>     // assert
+#include <chrono>      // std::chrono
+#include <cstddef>     // std::size_t
+#include <cstdint>     // std::uint8_t
+#include <filesystem>  // std::filesystem
 #include <memory>      // std::make_shared, std::shared_ptr
+#include <optional>    // std::optional
+#include <span>        // std::span
+#include <string>      // std::string
 #include <string_view> // std::string_view
 #include <utility>     // std::move, std::pair
 
 namespace sourcemeta::one {
 
+namespace {
+
+auto artifact_checksum(const std::span<const std::uint8_t> bytes)
+    -> std::string {
+  auto info{sourcemeta::one::metapack_info(bytes)};
+  return info.has_value() ? std::move(info.value().checksum_hex)
+                          : std::string{};
+}
+
+// Only the evaluation itself is timed, as finding the template is what the
+// template cache is counted for
+template <typename Callback> auto timed_evaluation(Callback callback) {
+  const TraceSpan trace{"evaluate", "evaluate"};
+  const auto start{std::chrono::steady_clock::now()};
+  auto result{callback()};
+  const auto elapsed{std::chrono::steady_clock::now() - start};
+  HTTPMetrics::evaluation(
+      std::chrono::duration_cast<std::chrono::microseconds>(elapsed));
+  // Already measured, so a timed request is told about it for free
+  auto *const timing{HTTPTiming::current()};
+  if (timing != nullptr) [[unlikely]] {
+    timing->add(HTTPTiming::Stage::Evaluation, elapsed);
+  }
+
+  return result;
+}
+
+} // namespace
+
 auto Router::blaze_template(const ResolvedArtifact &artifact)
     -> std::shared_ptr<const sourcemeta::blaze::Template> {
-  return this->template_cache_.get_or_compute(
-      artifact.path(), [&artifact]() -> sourcemeta::blaze::Template {
-        const auto template_json{
-            sourcemeta::one::metapack_read_json(artifact.path())};
+  // Whether out of the cache or compiled there and then
+  const HTTPTimingScope scope{HTTPTiming::Stage::Template};
+  const auto cached{this->template_cache_.get_or_compute(
+      artifact.path(), [&artifact]() -> CachedTemplate {
+        std::optional<sourcemeta::core::FileView> view;
+        auto bytes{artifact.bytes()};
+        if (bytes.empty()) {
+          view.emplace(artifact.path());
+          bytes = {view->as<std::uint8_t>(), view->size()};
+        }
+
+        const auto template_json{sourcemeta::one::metapack_read_json(bytes)};
         assert(template_json.has_value());
         auto compiled{sourcemeta::blaze::from_json(template_json.value())};
         assert(compiled.has_value());
-        return std::move(compiled).value();
-      });
+        return {.checksum = artifact_checksum(bytes),
+                .value = std::move(compiled).value()};
+      })};
+  return {cached, &cached->value};
+}
+
+auto Router::carry_templates(const Router &previous) -> std::size_t {
+  this->template_cache_.count_from(previous.template_cache_);
+  std::size_t carried{0};
+  for (const auto &[path, cached] : previous.template_cache_.entries()) {
+    const auto relative{path.lexically_relative(previous.base_)};
+    if (relative.empty() || *relative.begin() == ".." ||
+        cached->checksum.empty()) {
+      continue;
+    }
+
+    // The same artifact is looked for the way a request here would find it,
+    // and only a template compiled from the very same bytes is still valid
+    std::optional<sourcemeta::core::FileView> view;
+    auto bytes{this->archive_.find(relative.generic_string())};
+    if (bytes.empty()) {
+      const auto candidate{this->base_ / relative};
+      if (!std::filesystem::is_regular_file(candidate)) {
+        continue;
+      }
+
+      view.emplace(candidate);
+      bytes = {view->as<std::uint8_t>(), view->size()};
+    }
+
+    if (artifact_checksum(bytes) == cached->checksum) {
+      [[maybe_unused]] const auto kept{this->template_cache_.insert(
+          sourcemeta::core::weakly_canonical(this->base_ / relative),
+          cached)};
+      carried += 1;
+    }
+  }
+
+  return carried;
 }
 
 auto RouterAction::structural_template(const std::string_view schema_uri,
@@ -42,9 +125,11 @@ auto RouterAction::structural_evaluate(const std::string_view schema_uri,
     -> std::pair<bool, sourcemeta::core::JSON> {
   const auto schema_template{this->structural_template(schema_uri, mode)};
   sourcemeta::blaze::Evaluator evaluator;
-  auto result{
-      sourcemeta::blaze::standard(evaluator, *schema_template, instance,
-                                  sourcemeta::blaze::StandardOutput::Basic)};
+  auto result{timed_evaluation([&evaluator, &schema_template, &instance] {
+    return sourcemeta::blaze::standard(
+        evaluator, *schema_template, instance,
+        sourcemeta::blaze::StandardOutput::Basic);
+  })};
   const auto *valid{result.try_at("valid")};
   const bool is_valid{valid != nullptr && valid->is_boolean() &&
                       valid->to_boolean()};
@@ -57,7 +142,9 @@ auto RouterAction::structural_evaluate_fast(
   const auto schema_template{this->structural_template(
       schema_uri, sourcemeta::blaze::Mode::FastValidation)};
   sourcemeta::blaze::Evaluator evaluator;
-  return evaluator.validate(*schema_template, instance);
+  return timed_evaluation([&evaluator, &schema_template, &instance] {
+    return evaluator.validate(*schema_template, instance);
+  });
 }
 
 auto RouterAction::blaze_template(const Authentication::Caller &caller,
@@ -81,7 +168,9 @@ auto RouterAction::schema_evaluate_fast(
   const auto schema_template{this->blaze_template(
       caller, schema_uri, sourcemeta::blaze::Mode::FastValidation)};
   sourcemeta::blaze::Evaluator evaluator;
-  return evaluator.validate(*schema_template, instance);
+  return timed_evaluation([&evaluator, &schema_template, &instance] {
+    return evaluator.validate(*schema_template, instance);
+  });
 }
 
 auto RouterAction::schema_evaluate(const Authentication::Caller &caller,
@@ -91,9 +180,11 @@ auto RouterAction::schema_evaluate(const Authentication::Caller &caller,
     -> std::pair<bool, sourcemeta::core::JSON> {
   const auto schema_template{this->blaze_template(caller, schema_uri, mode)};
   sourcemeta::blaze::Evaluator evaluator;
-  auto result{
-      sourcemeta::blaze::standard(evaluator, *schema_template, instance,
-                                  sourcemeta::blaze::StandardOutput::Basic)};
+  auto result{timed_evaluation([&evaluator, &schema_template, &instance] {
+    return sourcemeta::blaze::standard(
+        evaluator, *schema_template, instance,
+        sourcemeta::blaze::StandardOutput::Basic);
+  })};
   const auto *valid{result.try_at("valid")};
   const bool is_valid{valid != nullptr && valid->is_boolean() &&
                       valid->to_boolean()};
@@ -107,7 +198,9 @@ auto RouterAction::schema_evaluate_with_tracing(
   const auto schema_template{this->blaze_template(
       caller, schema_uri, sourcemeta::blaze::Mode::Exhaustive)};
   sourcemeta::blaze::Evaluator evaluator;
-  return evaluator.validate(*schema_template, instance, callback);
+  return timed_evaluation([&evaluator, &schema_template, &instance, &callback] {
+    return evaluator.validate(*schema_template, instance, callback);
+  });
 }
 
 } // namespace sourcemeta::one
@@ -10,10 +10,11 @@
 
 #include <sourcemeta/one/authentication.h>
 #include <sourcemeta/one/http.h>
+#include <sourcemeta/one/metapack_archive.h>
 #include <sourcemeta/one/router_lru.h>
 
 #include <cstddef>     // std::size_t
-#include <cstdint>     // std::uint8_t
+#include <cstdint>     // std::uint8_t, std::uint16_t
 #include <filesystem>  // std::filesystem::path
 #include <memory>      // std::make_unique, std::shared_ptr, std::unique_ptr
 #include <mutex>       // std::once_flag
@@ -93,11 +94,19 @@ public:
     return this->path_;
   }
 
+  // The artifact as the archive holds it, or nothing when it is read from its
+  // own file at the path instead. Valid for as long as the router is
+  [[nodiscard]] auto bytes() const noexcept -> std::span<const std::uint8_t> {
+    return this->bytes_;
+  }
+
 private:
   friend class RouterAction;
-  explicit ResolvedArtifact(std::filesystem::path path)
-      : path_{std::move(path)} {}
+  explicit ResolvedArtifact(std::filesystem::path path,
+                            std::span<const std::uint8_t> bytes = {})
+      : path_{std::move(path)}, bytes_{bytes} {}
   std::filesystem::path path_;
+  std::span<const std::uint8_t> bytes_;
 };
 
 // What a registry path came to for the caller who asked. There is no refusal
@@ -327,7 +336,7 @@ private:
   [[nodiscard]] auto artifact_locate(const Authentication::Path &path,
                                      Tree tree, std::string_view view,
                                      std::string_view artifact_name) const
-      -> std::optional<std::filesystem::path>;
+      -> std::optional<ResolvedArtifact>;
 
   [[nodiscard]] auto structural_template(std::string_view schema_uri,
                                          sourcemeta::blaze::Mode mode) const
@@ -393,10 +402,24 @@ public:
   [[nodiscard]] auto blaze_template(const ResolvedArtifact &artifact)
       -> std::shared_ptr<const sourcemeta::blaze::Template>;
 
+  // Take over every template that a router over an earlier output compiled
+  // from an artifact this output still has as it was, so that moving on to a
+  // new output does not start every schema from cold. Returns how many
+  auto carry_templates(const Router &previous) -> std::size_t;
+
   [[nodiscard]] auto authentication() const noexcept -> const Authentication & {
     return this->authentication_;
   }
 
+  [[nodiscard]] auto archive() const noexcept -> const MetapackArchive & {
+    return this->archive_;
+  }
+
+  [[nodiscard]] auto template_cache_statistics() const noexcept
+      -> RouterLRUStatistics {
+    return this->template_cache_.statistics();
+  }
+
 private:
   static constexpr std::size_t TEMPLATE_CACHE_CAPACITY{50};
 
@@ -414,9 +437,23 @@ private:
   std::unique_ptr<Slot[]> slots_;
   std::size_t slots_size_;
   std::string_view default_error_schema_;
-  RouterLRU<std::filesystem::path, sourcemeta::blaze::Template> template_cache_{
+  // The operation of every route, as interned for counting, by identifier
+  std::vector<std::uint16_t> operations_;
+  // And as named, for the span answering a request to be named after
+  std::vector<std::string_view> operation_names_;
+  struct CachedTemplate {
+    // Of the artifact it was compiled from, which is what tells whether
+    // another output still has the same one
+    std::string checksum;
+    sourcemeta::blaze::Template value;
+  };
+
+  RouterLRU<std::filesystem::path, CachedTemplate> template_cache_{
       TEMPLATE_CACHE_CAPACITY};
   Authentication authentication_;
+  // Mapped once for the life of the server, as what resolves out of it points
+  // into the mapping rather than at a copy
+  MetapackArchive archive_;
 };
 
 } // namespace sourcemeta::one
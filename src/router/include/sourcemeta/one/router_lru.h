@@ -1,16 +1,25 @@
 #ifndef SOURCEMETA_ONE_ROUTER_LRU_H
 #define SOURCEMETA_ONE_ROUTER_LRU_H
 
+#include <atomic>        // std::atomic
 #include <cstddef>       // std::size_t
+#include <cstdint>       // std::uint64_t
 #include <functional>    // std::equal_to, std::hash
 #include <list>          // std::list
 #include <memory>        // std::make_shared, std::shared_ptr
 #include <mutex>         // std::scoped_lock, std::mutex
 #include <unordered_map> // std::unordered_map
 #include <utility>       // std::pair
+#include <vector>        // std::vector
 
 namespace sourcemeta::one {
 
+struct RouterLRUStatistics {
+  std::uint64_t hits;
+  std::uint64_t misses;
+  std::uint64_t evictions;
+};
+
 template <typename Key, typename Value, typename Hash = std::hash<Key>,
           typename KeyEqual = std::equal_to<Key>>
 class RouterLRU {
@@ -35,8 +44,13 @@ public:
       }
     }
 
-    auto computed{std::make_shared<const Value>(factory())};
+    return this->insert(key, std::make_shared<const Value>(factory()));
+  }
 
+  // Keep a value that was computed elsewhere, such as one that another cache
+  // held. Whatever is already here for the key wins, as it may well have been
+  // handed out already
+  auto insert(const Key &key, value_handle value) -> value_handle {
     const std::scoped_lock guard{this->mutex_};
     const auto found{this->index_.find(key)};
     if (found != this->index_.end()) {
@@ -45,7 +59,7 @@ public:
       return found->second->second;
     }
 
-    this->entries_.emplace_front(key, computed);
+    this->entries_.emplace_front(key, value);
     try {
       this->index_.emplace(key, this->entries_.begin());
     } catch (...) {
@@ -56,17 +70,29 @@ public:
     if (this->entries_.size() > this->capacity_) {
       this->index_.erase(this->entries_.back().first);
       this->entries_.pop_back();
+      this->evictions_.fetch_add(1, std::memory_order_relaxed);
     }
 
-    return computed;
+    return value;
+  }
+
+  // A copy of what is held, from the least to the most recently used, so that
+  // inserting it in turn into another cache leaves the same order there. A copy
+  // rather than a walk under the lock, as whoever reads it may take a while
+  [[nodiscard]] auto entries() const
+      -> std::vector<std::pair<Key, value_handle>> {
+    const std::scoped_lock guard{this->mutex_};
+    return {this->entries_.rbegin(), this->entries_.rend()};
   }
 
   [[nodiscard]] auto try_get(const Key &key) -> value_handle {
     const std::scoped_lock guard{this->mutex_};
     const auto found{this->index_.find(key)};
     if (found == this->index_.end()) {
+      this->misses_.fetch_add(1, std::memory_order_relaxed);
       return nullptr;
     }
+    this->hits_.fetch_add(1, std::memory_order_relaxed);
     this->entries_.splice(this->entries_.begin(), this->entries_,
                           found->second);
     return found->second->second;
@@ -81,6 +107,23 @@ public:
     return this->capacity_;
   }
 
+  // Counted under the lock every lookup takes anyway, and read without it, so
+  // that asking for them never holds up a lookup
+  [[nodiscard]] auto statistics() const noexcept -> RouterLRUStatistics {
+    return {.hits = this->hits_.load(std::memory_order_relaxed),
+            .misses = this->misses_.load(std::memory_order_relaxed),
+            .evictions = this->evictions_.load(std::memory_order_relaxed)};
+  }
+
+  // Go on counting from where another cache was, such as the one this one
+  // takes over from, so that the counts only ever grow
+  auto count_from(const RouterLRU &other) noexcept -> void {
+    const auto counted{other.statistics()};
+    this->hits_.fetch_add(counted.hits, std::memory_order_relaxed);
+    this->misses_.fetch_add(counted.misses, std::memory_order_relaxed);
+    this->evictions_.fetch_add(counted.evictions, std::memory_order_relaxed);
+  }
+
   auto clear() -> void {
     const std::scoped_lock guard{this->mutex_};
     this->index_.clear();
@@ -95,6 +138,9 @@ private:
   entry_list entries_;
   std::unordered_map<Key, entry_iterator, Hash, KeyEqual> index_;
   mutable std::mutex mutex_;
+  std::atomic<std::uint64_t> hits_{0};
+  std::atomic<std::uint64_t> misses_{0};
+  std::atomic<std::uint64_t> evictions_{0};
 };
 
 } // namespace sourcemeta::one
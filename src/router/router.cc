@@ -3,12 +3,16 @@
 #include <sourcemeta/core/uri.h>
 #include <sourcemeta/one/router.h>
 
+#include <algorithm>   // std::ranges::transform
+#include <cctype>      // std::toupper
 #include <chrono>      // std::chrono::seconds
+#include <cstddef>     // std::size_t
 #include <memory>      // std::make_unique
 #include <mutex>       // std::call_once
 #include <optional>    // std::optional, std::nullopt
 #include <string>      // std::string
 #include <string_view> // std::string_view
+#include <utility>     // std::move
 #include <vector>      // std::vector
 
 namespace sourcemeta::one {
@@ -69,12 +73,27 @@ Router::Router(const std::filesystem::path &base,
       slots_size_{router.size() + 1},
       authentication_{
           sourcemeta::one::Authentication::Table{base / "authentication.bin"},
-          provider_fetcher()} {
+          provider_fetcher()},
+      archive_{base / "archive"} {
   router.arguments(0, [this](const auto &key, const auto &value) -> void {
     if (key == "errorSchema") {
       this->default_error_schema_ = std::get<std::string_view>(value);
     }
   });
+
+  // Interned here, once per output, so that counting a request is indexing
+  // rather than looking a name up. The catch-all has no operation of its own
+  this->operations_.resize(this->slots_size_);
+  this->operation_names_.resize(this->slots_size_, "default");
+  this->operations_[0] = sourcemeta::one::HTTPMetrics::operation("default");
+  for (std::size_t index{0}; index < router.size(); index++) {
+    const auto identifier{router.at(index)};
+    if (identifier < this->operations_.size()) {
+      this->operation_names_[identifier] = router.operation_id(identifier);
+      this->operations_[identifier] = sourcemeta::one::HTTPMetrics::operation(
+          this->operation_names_[identifier]);
+    }
+  }
 }
 
 auto Router::error(const sourcemeta::one::HTTPRequest &request,
@@ -119,6 +138,35 @@ auto Router::dispatch(
     const std::span<std::string_view> matches,
     sourcemeta::one::HTTPRequest &request,
     sourcemeta::one::HTTPResponse &response) -> void {
+  if (identifier < this->operations_.size()) [[likely]] {
+    request.annotate_operation(this->operations_[identifier]);
+  }
+
+  // A request sent as part of a trace carries on in it, which is only worth
+  // reading the header for where spans are exported at all
+  const auto remote{
+      sourcemeta::one::OTLPExporter::installed() != nullptr
+          ? sourcemeta::one::TraceContext::parse(request.header("traceparent"))
+          : std::nullopt};
+  const sourcemeta::one::TraceContext::Adopt adopted{
+      remote.value_or(sourcemeta::one::TraceContext{})};
+  sourcemeta::one::TraceSpan span{
+      "dispatch",
+      identifier < this->operation_names_.size()
+          ? this->operation_names_[identifier]
+          : "default",
+      sourcemeta::one::Trace::Kind::Server};
+  if (span.active()) {
+    std::string method{request.method()};
+    std::ranges::transform(method, method.begin(), [](const char character) {
+      return static_cast<char>(std::toupper(character));
+    });
+
+    span.argument("http.request.method", std::move(method));
+    span.argument("url.path", std::string{request.path()});
+    request.annotate_trace(span.context());
+  }
+
   auto *instance{this->action(identifier, context)};
   if (instance == nullptr) [[unlikely]] {
     this->error(request, response,
@@ -147,13 +195,21 @@ auto Router::dispatch(
   // Read once here, since the same caller is served every artifact this request
   // reaches and every gate question asked of them afterwards is a comparison
   // against this rather than another reading of what they presented
-  const auto caller{
-      this->authentication_.caller({.bearer = credential, .cookies = cookies})};
-  if (identifier != 0 && request.method() != "options" &&
-      !instance->is_authentication_exempt() &&
-      !this->authentication_.permits(
-          Authentication::RouteTarget{request.path()}, caller,
-          instance->required_audience())) {
+  const auto caller{[this, &credential, &cookies] {
+    const sourcemeta::one::HTTPTimingScope scope{
+        sourcemeta::one::HTTPTiming::Stage::Authentication};
+    const sourcemeta::one::TraceSpan trace{"auth", "caller"};
+    return this->authentication_.caller(
+        {.bearer = credential, .cookies = cookies});
+  }()};
+  request.annotate_view(caller.view());
+  const bool gated{identifier != 0 && request.method() != "options" &&
+                   !instance->is_authentication_exempt()};
+  if (gated && !this->authentication_.permits(
+                   Authentication::RouteTarget{request.path()}, caller,
+                   instance->required_audience())) {
+    sourcemeta::one::HTTPMetrics::gate(
+        sourcemeta::one::HTTPMetrics::Gate::Refused);
     if (instance->serve_renewal_page(request, response)) {
       return;
     }
@@ -164,6 +220,9 @@ auto Router::dispatch(
     return;
   }
 
+  sourcemeta::one::HTTPMetrics::gate(
+      gated ? sourcemeta::one::HTTPMetrics::Gate::Admitted
+            : sourcemeta::one::HTTPMetrics::Gate::Ungated);
   instance->rest(matches, caller, request, response);
 }
 
@@ -0,0 +1,145 @@
+#ifndef SOURCEMETA_ONE_SERVER_GENERATION_H_
+#define SOURCEMETA_ONE_SERVER_GENERATION_H_
+
+#include <sourcemeta/core/uritemplate.h>
+
+#include <sourcemeta/one/actions.h>
+#include <sourcemeta/one/shared.h>
+
+#include <atomic>     // std::atomic
+#include <chrono>     // std::chrono
+#include <csignal>    // SIGHUP, sigset_t, sigemptyset, sigaddset, sigwait
+#include <cstddef>    // std::size_t
+#include <exception>  // std::exception
+#include <filesystem> // std::filesystem::path
+#include <memory>     // std::shared_ptr, std::make_shared
+#include <pthread.h>  // pthread_sigmask, pthread_kill
+#include <string>     // std::string, std::to_string
+#include <thread>     // std::thread
+#include <utility>    // std::move
+
+namespace sourcemeta::one {
+
+// Everything a server reads out of one output, from the moment it is started
+// on it until the last request it took on it is answered. A request starts
+// and ends on the same one, whatever replaced it meanwhile
+class ServerGeneration {
+public:
+  explicit ServerGeneration(const std::filesystem::path &base)
+      : lease_{base}, router_{this->lease_.directory() / "routes.bin"},
+        actions_{this->lease_.directory(), this->router_, CONSTRUCTORS} {}
+
+  // To avoid mistakes
+  ServerGeneration(const ServerGeneration &) = delete;
+  ServerGeneration(ServerGeneration &&) = delete;
+  auto operator=(const ServerGeneration &) -> ServerGeneration & = delete;
+  auto operator=(ServerGeneration &&) -> ServerGeneration & = delete;
+
+  [[nodiscard]] auto directory() const noexcept
+      -> const std::filesystem::path & {
+    return this->lease_.directory();
+  }
+
+  [[nodiscard]] auto router() const noexcept
+      -> const sourcemeta::core::URITemplateRouterView & {
+    return this->router_;
+  }
+
+  [[nodiscard]] auto actions() noexcept -> Router & { return this->actions_; }
+
+private:
+  PublicationLease lease_;
+  sourcemeta::core::URITemplateRouterView router_;
+  Router actions_;
+};
+
+// The generation new requests are served from, replaced as a whole whenever
+// the output is read again. Whatever was already taken on the one before
+// holds on to it, so it goes away once the last of that is answered
+class ServerGenerations {
+public:
+  explicit ServerGenerations(std::filesystem::path base)
+      : base_{std::move(base)},
+        current_{std::make_shared<ServerGeneration>(this->base_)} {}
+
+  // Nothing but the requests in flight ever holds on to a generation, as an
+  // idle worker that kept the last one it served would keep its output leased
+  // and out of reach of whatever collects publications for as long as it sat
+  // idle
+  [[nodiscard]] auto current() const -> std::shared_ptr<ServerGeneration> {
+    return this->current_.load(std::memory_order_acquire);
+  }
+
+  // Read the output again off to the side and only then start serving from
+  // it, returning how many compiled templates it took over. Nothing changes
+  // if reading it fails, which is left to throw
+  auto reload() -> std::size_t {
+    const auto previous{this->current_.load(std::memory_order_acquire)};
+    auto next{std::make_shared<ServerGeneration>(this->base_)};
+    const auto carried{next->actions().carry_templates(previous->actions())};
+    this->current_.store(std::move(next), std::memory_order_release);
+    return carried;
+  }
+
+private:
+  const std::filesystem::path base_;
+  std::atomic<std::shared_ptr<ServerGeneration>> current_;
+};
+
+// Reads the output again whenever the process is sent SIGHUP, on a thread of
+// its own, so that no worker ever waits on it. The signal is blocked before
+// any worker exists, as every thread inherits that, and only this one ever
+// takes it. Has to be constructed before the workers are started
+class ServerReloader {
+public:
+  explicit ServerReloader(ServerGenerations &generations) {
+    sigemptyset(&this->signals_);
+    sigaddset(&this->signals_, SIGHUP);
+    pthread_sigmask(SIG_BLOCK, &this->signals_, nullptr);
+    this->thread_ = std::thread{[this, &generations]() -> void {
+      while (true) {
+        int signal{0};
+        if (sigwait(&this->signals_, &signal) != 0 ||
+            this->stopping_.load(std::memory_order_acquire)) {
+          return;
+        }
+
+        const auto start{std::chrono::steady_clock::now()};
+        try {
+          const auto carried{generations.reload()};
+          const auto duration{
+              std::chrono::duration_cast<std::chrono::milliseconds>(
+                  std::chrono::steady_clock::now() - start)};
+          HTTP_LOG("Reloaded the output in " +
+                   std::to_string(duration.count()) + " ms, keeping " +
+                   std::to_string(carried) + " compiled templates");
+        } catch (const std::exception &error) {
+          HTTP_LOG("Could not reload the output, still serving the previous "
+                   "one: " +
+                   std::string{error.what()});
+        }
+      }
+    }};
+  }
+
+  ~ServerReloader() {
+    this->stopping_.store(true, std::memory_order_release);
+    pthread_kill(this->thread_.native_handle(), SIGHUP);
+    this->thread_.join();
+  }
+
+  // To avoid mistakes
+  ServerReloader(const ServerReloader &) = delete;
+  ServerReloader(ServerReloader &&) = delete;
+  auto operator=(const ServerReloader &) -> ServerReloader & = delete;
+  auto operator=(ServerReloader &&) -> ServerReloader & = delete;
+
+private:
+  sigset_t signals_{};
+  std::atomic<bool> stopping_{false};
+  std::thread thread_;
+};
+
+} // namespace sourcemeta::one
+
+#endif
@@ -4,25 +4,38 @@
 #include <sourcemeta/core/uritemplate.h>
 
 #include <sourcemeta/one/actions.h>
+#include <sourcemeta/one/shared.h>
+
+#include "generation.h"
 
 #include <array>       // std::array
 #include <chrono>      // std::chrono::steady_clock, std::chrono::milliseconds
 #include <cstddef>     // std::size_t
-#include <cstdint>     // std::uint16_t
+#include <cstdint>     // std::uint16_t, std::uint64_t
 #include <cstdio>      // std::setvbuf, stderr, _IOLBF
 #include <cstdlib>     // EXIT_FAILURE, EXIT_SUCCESS
 #include <filesystem>  // std::filesystem
 #include <iostream>    // std::cerr
 #include <limits>      // std::numeric_limits
+#include <memory>      // std::unique_ptr, std::make_unique
+#include <optional>    // std::nullopt
 #include <print>       // std::println
 #include <string>      // std::string, std::to_string
 #include <string_view> // std::string_view
+#include <vector>      // std::vector
 
 // TODO: Maybe we should merge this entire function into `Router`?
-static auto dispatch(sourcemeta::one::Router &actions,
-                     const sourcemeta::core::URITemplateRouterView &router,
+static auto dispatch(sourcemeta::one::ServerGenerations &generations,
                      sourcemeta::one::HTTPRequest &request,
                      sourcemeta::one::HTTPResponse &response) noexcept -> void {
+  const auto generation{generations.current()};
+  auto &actions{generation->actions()};
+  const auto &router{generation->router()};
+  // The generation stays for as long as this request is being answered, even
+  // if a reload replaces it meanwhile
+  request.retain(generation);
+  // Every stage reached from here on is timed into this request, if at all
+  const sourcemeta::one::HTTPTiming::Current timing{request.timing()};
   try {
     request.negotiate();
     if (request.satisfiable_encoding()) {
@@ -62,7 +75,13 @@ static auto dispatch(sourcemeta::one::Router &actions,
 
 SOURCEMETA_FORCEINLINE inline auto print_usage(const std::string_view program)
     -> void {
-  std::println(stderr, "Usage: {} <path/to/output/directory> <port>", program);
+  std::println(stderr,
+               "Usage: {} [--workers <count>] [--pin] "
+               "[--log-format <text|json>] [--log-sample <n>] "
+               "[--server-timing <request|always>] "
+               "[--trace-otlp <path|url>] [--trace-sample <n>] "
+               "<path/to/output/directory> <port>",
+               program);
 }
 
 // We try to keep this function as straight to the point as possible
@@ -84,12 +103,110 @@ auto main(int argc, char *argv[]) noexcept -> int {
     std::println(stderr, "Sourcemeta One {} v{}", sourcemeta::one::edition(),
                  sourcemeta::one::version());
 
-    if (argc != 3) [[unlikely]] {
+    // Few enough options to read by hand, which keeps startup to what the
+    // server needs to bind the port
+    sourcemeta::one::HTTPServerWorkers workers{.count = 0, .pin = false};
+    sourcemeta::one::HTTPAccessLogOptions access_log;
+    std::string_view trace_destination;
+    std::uint64_t trace_sample{1};
+    std::vector<std::string_view> positional;
+    for (int index{1}; index < argc; index++) {
+      const std::string_view argument{argv[index]};
+      if (argument == "--pin") {
+        workers.pin = true;
+      } else if (argument == "--workers") {
+        const auto count{index + 1 < argc
+                             ? sourcemeta::core::to_uint16_t(argv[++index])
+                             : std::nullopt};
+        if (!count.has_value() || count.value() == 0) [[unlikely]] {
+          print_usage(program);
+          std::println(stderr,
+                       "error: The number of workers must be a positive "
+                       "integer");
+          return EXIT_FAILURE;
+        }
+
+        workers.count = count.value();
+      } else if (argument == "--log-format") {
+        const std::string_view format{index + 1 < argc ? argv[++index] : ""};
+        if (format == "text") {
+          access_log.format =
+              sourcemeta::one::HTTPAccessLogOptions::Format::Text;
+        } else if (format == "json") {
+          access_log.format =
+              sourcemeta::one::HTTPAccessLogOptions::Format::JSON;
+        } else [[unlikely]] {
+          print_usage(program);
+          std::println(stderr,
+                       "error: The log format must be either text or json");
+          return EXIT_FAILURE;
+        }
+      } else if (argument == "--log-sample") {
+        const auto sample{index + 1 < argc
+                              ? sourcemeta::core::to_uint64_t(argv[++index])
+                              : std::nullopt};
+        if (!sample.has_value() || sample.value() == 0) [[unlikely]] {
+          print_usage(program);
+          std::println(stderr,
+                       "error: The log sample must be a positive integer");
+          return EXIT_FAILURE;
+        }
+
+        access_log.sample = sample.value();
+      } else if (argument == "--trace-otlp") {
+        trace_destination = index + 1 < argc ? argv[++index] : "";
+        if (trace_destination.empty()) [[unlikely]] {
+          print_usage(program);
+          std::println(stderr, "error: The trace destination must be a file "
+                               "path or a collector URL");
+          return EXIT_FAILURE;
+        }
+      } else if (argument == "--trace-sample") {
+        const auto sample{index + 1 < argc
+                              ? sourcemeta::core::to_uint64_t(argv[++index])
+                              : std::nullopt};
+        if (!sample.has_value() || sample.value() == 0) [[unlikely]] {
+          print_usage(program);
+          std::println(stderr,
+                       "error: The trace sample must be a positive integer");
+          return EXIT_FAILURE;
+        }
+
+        trace_sample = sample.value();
+      } else if (argument == "--server-timing") {
+        // Per request means only for a request that carries the
+        // X-Server-Timing header, so that one slow request can be looked into
+        // without every other answer saying where its time went
+        const std::string_view timing{index + 1 < argc ? argv[++index] : ""};
+        if (timing == "request") {
+          sourcemeta::one::HTTPTiming::mode(
+              sourcemeta::one::HTTPTiming::Mode::Request);
+        } else if (timing == "always") {
+          sourcemeta::one::HTTPTiming::mode(
+              sourcemeta::one::HTTPTiming::Mode::Always);
+        } else [[unlikely]] {
+          print_usage(program);
+          std::println(stderr, "error: The server timing must be either "
+                               "request or always");
+          return EXIT_FAILURE;
+        }
+      } else {
+        positional.push_back(argument);
+      }
+    }
+
+    if (positional.size() != 2) [[unlikely]] {
       print_usage(program);
       return EXIT_FAILURE;
     }
 
-    const std::string_view port_argument{argv[2]};
+    // Sized to what the process may actually run on by default rather than to
+    // every CPU the machine has
+    if (workers.count == 0) {
+      workers.count = sourcemeta::one::http_default_workers();
+    }
+
+    const std::string_view port_argument{positional[1]};
     const auto parsed_port{sourcemeta::core::to_uint16_t(port_argument)};
     if (!parsed_port.has_value() || parsed_port.value() == 0) [[unlikely]] {
       print_usage(program);
@@ -101,22 +218,40 @@ auto main(int argc, char *argv[]) noexcept -> int {
 
     // Note we purposely DO NOT canonicalise in order to NOT resolve
     // symlinks in the output location
-    const std::filesystem::path base{argv[1]};
+    const std::filesystem::path base{positional[0]};
     if (!base.is_absolute()) [[unlikely]] {
       print_usage(program);
       std::println(stderr, "error: The output directory path must be absolute");
       return EXIT_FAILURE;
     }
 
-    const sourcemeta::core::URITemplateRouterView router{base / "routes.bin"};
-    sourcemeta::one::Router actions{base, router,
-                                    sourcemeta::one::CONSTRUCTORS};
+    // A published output is served from the generation its link names as the
+    // server starts, or as it is sent SIGHUP, even once the link moves on, so
+    // that everything one request is answered with comes from the same build
+    sourcemeta::one::ServerGenerations generations{base};
+    const sourcemeta::one::ServerReloader reloader{generations};
+    // After the reloader, so that its writer never takes SIGHUP either
+    const sourcemeta::one::HTTPAccessLog log{access_log};
+    // Taken down before it goes, so that no span outlives it, and whatever it
+    // still holds is exported as the server stops
+    std::unique_ptr<sourcemeta::one::OTLPExporter> exporter;
+    if (!trace_destination.empty()) {
+      exporter = std::make_unique<sourcemeta::one::OTLPExporter>(
+          sourcemeta::one::OTLPExporter::Options{
+              .service = "sourcemeta-one-server", .sample = trace_sample},
+          sourcemeta::one::OTLPExporter::sink(trace_destination));
+    }
+
+    sourcemeta::one::OTLPExporter::install(exporter.get());
+    const struct ExporterGuard {
+      ~ExporterGuard() { sourcemeta::one::OTLPExporter::install(nullptr); }
+    } exporter_guard;
 
     const sourcemeta::one::HTTPServer server{
-        port,
-        [&actions, &router](sourcemeta::one::HTTPRequest &request,
-                            sourcemeta::one::HTTPResponse &response) {
-          dispatch(actions, router, request, response);
+        port, workers,
+        [&generations](sourcemeta::one::HTTPRequest &request,
+                       sourcemeta::one::HTTPResponse &response) {
+          dispatch(generations, request, response);
         },
         [timestamp_start](const std::uint16_t bound_port) {
           const auto duration{
@@ -5,6 +5,8 @@
 // between the indexer and the server
 
 #include <sourcemeta/one/shared_encoding.h>
+#include <sourcemeta/one/shared_publication.h>
+#include <sourcemeta/one/shared_trace.h>
 #include <sourcemeta/one/shared_version.h>
 
 #endif
@@ -0,0 +1,51 @@
+#ifndef SOURCEMETA_ONE_SHARED_PUBLICATION_H_
+#define SOURCEMETA_ONE_SHARED_PUBLICATION_H_
+
+#include <filesystem>  // std::filesystem::path
+#include <string_view> // std::string_view
+
+namespace sourcemeta::one {
+
+// A published output is a directory of generations, each one a complete
+// output of its own, and a symbolic link naming the one being served. The
+// link is only ever replaced whole, so whoever follows it lands on a finished
+// generation, never on one being written
+constexpr std::string_view PUBLICATION_CURRENT{"current"};
+constexpr std::string_view PUBLICATION_GENERATIONS{"generations"};
+// Every server holds this shared for as long as it serves the generation it
+// sits in, which is what keeps the generation from being collected under it
+constexpr std::string_view PUBLICATION_LOCK{"generation.lock"};
+
+// The generation a server is started on, held for as long as this lives. A
+// path that is not the link of a publication is served as it is, and holds
+// nothing
+class PublicationLease {
+public:
+  explicit PublicationLease(const std::filesystem::path &base);
+  ~PublicationLease();
+
+  PublicationLease(const PublicationLease &) = delete;
+  PublicationLease(PublicationLease &&) = delete;
+  auto operator=(const PublicationLease &) -> PublicationLease & = delete;
+  auto operator=(PublicationLease &&) -> PublicationLease & = delete;
+
+  // What to serve from, which stays the same generation even after the link
+  // moves on to a newer one
+  [[nodiscard]] auto directory() const noexcept
+      -> const std::filesystem::path & {
+    return this->directory_;
+  }
+
+private:
+  std::filesystem::path directory_;
+  int descriptor_{-1};
+};
+
+// Remove a generation unless a server still holds it. A generation with no
+// lock at all is one that never finished publishing, and nothing can hold it
+[[nodiscard]] auto publication_collect(const std::filesystem::path &generation)
+    -> bool;
+
+} // namespace sourcemeta::one
+
+#endif
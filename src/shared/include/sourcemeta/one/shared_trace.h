@@ -0,0 +1,237 @@
+#ifndef SOURCEMETA_ONE_SHARED_TRACE_H_
+#define SOURCEMETA_ONE_SHARED_TRACE_H_
+
+#include <array>              // std::array
+#include <chrono>             // std::chrono
+#include <condition_variable> // std::condition_variable
+#include <cstddef>            // std::size_t
+#include <cstdint>            // std::uint8_t, std::uint32_t, std::uint64_t
+#include <filesystem>         // std::filesystem::path
+#include <functional>         // std::function
+#include <mutex>              // std::mutex
+#include <optional>           // std::optional
+#include <ostream>            // std::ostream
+#include <span>               // std::span
+#include <string>             // std::string
+#include <string_view>        // std::string_view
+#include <thread>             // std::thread
+#include <utility>            // std::pair
+#include <variant>            // std::variant
+#include <vector>             // std::vector
+
+namespace sourcemeta::one {
+
+class OTLPExporter;
+
+// Where a span sits in a distributed trace, as the W3C Trace Context
+// specification carries it from one process to the next. A context with no
+// trace is no context at all, and whatever starts under it starts a trace
+// See https://www.w3.org/TR/trace-context/
+struct TraceContext {
+  std::array<std::uint8_t, 16> trace{};
+  std::array<std::uint8_t, 8> span{};
+  bool sampled{false};
+
+  [[nodiscard]] auto valid() const noexcept -> bool;
+
+  // A `traceparent` field value. Anything that is not version 00 of it, or
+  // that names an all-zero trace or parent, is as good as none
+  [[nodiscard]] static auto parse(std::string_view traceparent)
+      -> std::optional<TraceContext>;
+
+  // The context of the span open on this thread, if any
+  [[nodiscard]] static auto current() noexcept -> const TraceContext &;
+
+  class Adopt;
+};
+
+// Carries a context over to wherever the work it started continues, such as
+// another thread or a callback that runs later, for as long as it lives
+class TraceContext::Adopt {
+public:
+  explicit Adopt(const TraceContext &context) noexcept;
+  ~Adopt();
+
+  Adopt(const Adopt &) = delete;
+  auto operator=(const Adopt &) -> Adopt & = delete;
+  Adopt(Adopt &&) = delete;
+  auto operator=(Adopt &&) -> Adopt & = delete;
+
+private:
+  TraceContext previous;
+};
+
+// What ran when and on which thread, written out in the Trace Event Format
+// that Perfetto and `chrome://tracing` read. Nothing is recorded unless a
+// trace is installed, and then every span is two clock reads and an append
+// under a lock, which is noise next to any work worth a span
+class Trace {
+public:
+  using Clock = std::chrono::steady_clock;
+  using Argument =
+      std::pair<std::string_view, std::variant<std::string, std::uint64_t>>;
+
+  // What a span stands for to whoever looks at it from outside the process
+  enum class Kind : std::uint8_t { Internal, Server };
+
+  struct Event {
+    // Expected to be a literal, as every span of a kind shares it
+    std::string_view category;
+    std::string name;
+    Clock::time_point start;
+    Clock::time_point end;
+    std::uint32_t thread{0};
+    std::vector<Argument> arguments;
+  };
+
+  Trace();
+
+  // Just to prevent mistakes
+  Trace(const Trace &) = delete;
+  auto operator=(const Trace &) -> Trace & = delete;
+  Trace(Trace &&) = delete;
+  auto operator=(Trace &&) -> Trace & = delete;
+
+  // At most one trace receives spans at a time, process wide, as spans come
+  // from places that have no other way of reaching it. Installing nothing
+  // turns tracing off again
+  static auto install(Trace *trace) noexcept -> void;
+  [[nodiscard]] static auto installed() noexcept -> Trace *;
+
+  // Small and stable per thread, in the order threads first recorded anything,
+  // as that is what a viewer lays its rows out by
+  [[nodiscard]] static auto thread() -> std::uint32_t;
+
+  auto record(Event event) -> void;
+  auto write(std::ostream &stream) const -> void;
+
+private:
+  Clock::time_point origin;
+  mutable std::mutex mutex;
+  std::vector<Event> events;
+};
+
+// Sends spans elsewhere as OpenTelemetry sees them, in batches of OTLP/JSON
+// export requests, from a thread of its own. Whether a trace is exported is
+// decided once, where it starts, and everything under it follows. What waits
+// for export is bounded, and a span that finds no room is dropped and counted
+// rather than held, so that exporting never grows without bound behind a
+// destination that cannot keep up
+// See https://opentelemetry.io/docs/specs/otlp/
+class OTLPExporter {
+public:
+  // Takes one export request at a time, from the exporting thread only
+  using Sink = std::function<void(std::string_view)>;
+
+  struct Options {
+    // The `service.name` every span is exported under
+    std::string service;
+    // Export one in this many traces
+    std::uint64_t sample{1};
+    std::size_t capacity{8192};
+    std::size_t batch{512};
+    std::chrono::milliseconds interval{2000};
+  };
+
+  OTLPExporter(Options configuration, Sink sink);
+  // Whatever was recorded before is still exported
+  ~OTLPExporter();
+
+  // Just to prevent mistakes
+  OTLPExporter(const OTLPExporter &) = delete;
+  auto operator=(const OTLPExporter &) -> OTLPExporter & = delete;
+  OTLPExporter(OTLPExporter &&) = delete;
+  auto operator=(OTLPExporter &&) -> OTLPExporter & = delete;
+
+  // At most one exporter at a time, process wide, like a trace
+  static auto install(OTLPExporter *exporter) noexcept -> void;
+  [[nodiscard]] static auto installed() noexcept -> OTLPExporter *;
+
+  // Whether a trace starting with this context is exported. Read off the
+  // random trace identifier, so that every process seeing the trace decides
+  // the same way without asking the others
+  [[nodiscard]] auto sample(const TraceContext &context) const noexcept
+      -> bool;
+
+  auto record(Trace::Event event, Trace::Kind kind,
+              const TraceContext &context, const TraceContext &parent)
+      -> void;
+
+  // A span that was over by the time it was known to be one, as a child of
+  // whatever span is open on this thread
+  auto record(Trace::Event event) -> void;
+
+  // Appends every export request to a file, one per line, as the OTLP file
+  // exporter does
+  [[nodiscard]] static auto file(const std::filesystem::path &path) -> Sink;
+  // Posts every export request to the traces endpoint of a collector, such as
+  // `http://localhost:4318/v1/traces`
+  [[nodiscard]] static auto collector(std::string url) -> Sink;
+  // A collector for an HTTP or HTTPS URL, and a file for anything else
+  [[nodiscard]] static auto sink(std::string_view destination) -> Sink;
+
+private:
+  struct Span {
+    Trace::Event event;
+    Trace::Kind kind;
+    TraceContext context;
+    std::array<std::uint8_t, 8> parent;
+  };
+
+  auto run() -> void;
+  auto serialize(std::span<const Span> spans, std::ostream &stream) const
+      -> void;
+
+  Options options;
+  Sink destination;
+  // Spans are timed on the steady clock and exported on the system one
+  std::chrono::system_clock::time_point wall_origin;
+  Trace::Clock::time_point steady_origin;
+  std::mutex mutex;
+  std::condition_variable wake;
+  std::vector<Span> queue;
+  std::uint64_t dropped{0};
+  bool stopping{false};
+  std::thread exporting;
+};
+
+// A span over the lifetime of the object, recorded into whatever trace is
+// installed when it ends, and exported if an exporter is installed. Free when
+// there is neither. Any span started on the same thread while it is open is
+// its child
+class TraceSpan {
+public:
+  TraceSpan(std::string_view category, std::string_view name,
+            Trace::Kind kind = Trace::Kind::Internal);
+  ~TraceSpan();
+
+  TraceSpan(const TraceSpan &) = delete;
+  auto operator=(const TraceSpan &) -> TraceSpan & = delete;
+  TraceSpan(TraceSpan &&) = delete;
+  auto operator=(TraceSpan &&) -> TraceSpan & = delete;
+
+  [[nodiscard]] auto active() const noexcept -> bool {
+    return this->trace != nullptr || this->exporter != nullptr;
+  }
+
+  // What to adopt for work this span started that carries on elsewhere
+  [[nodiscard]] auto context() const noexcept -> const TraceContext & {
+    return this->own;
+  }
+
+  auto argument(std::string_view key, std::string value) -> void;
+  auto argument(std::string_view key, std::uint64_t value) -> void;
+
+private:
+  Trace *trace;
+  OTLPExporter *exporter;
+  Trace::Kind kind;
+  TraceContext parent;
+  TraceContext own;
+  bool adopted{false};
+  Trace::Event event;
+};
+
+} // namespace sourcemeta::one
+
+#endif
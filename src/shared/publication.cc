@@ -0,0 +1,92 @@
+#include <sourcemeta/one/shared_publication.h>
+
+#include <system_error> // std::error_code
+
+#if !defined(_WIN32)
+#include <fcntl.h>    // ::open, O_RDONLY, O_CLOEXEC
+#include <sys/file.h> // ::flock, LOCK_SH, LOCK_EX, LOCK_NB
+#include <sys/stat.h> // ::stat, ::fstat
+#include <unistd.h>   // ::close
+#endif
+
+namespace sourcemeta::one {
+
+PublicationLease::PublicationLease(const std::filesystem::path &base)
+    : directory_{base} {
+#if !defined(_WIN32)
+  std::filesystem::path previous;
+  while (true) {
+    std::error_code error;
+    const auto target{std::filesystem::read_symlink(base, error)};
+    // Having read the same link twice without holding what it names means it
+    // does not name a generation at all, rather than one collected under us
+    if (error || target == previous) {
+      return;
+    }
+
+    previous = target;
+    const auto generation{target.is_absolute() ? target
+                                               : base.parent_path() / target};
+    const auto lock{generation / PUBLICATION_LOCK};
+    const auto descriptor{::open(lock.c_str(), O_RDONLY | O_CLOEXEC)};
+    if (descriptor == -1) {
+      continue;
+    }
+
+    // A collector removes the lock while holding it, so the one held here only
+    // counts if it is still the one the generation has
+    struct stat held{};
+    struct stat named{};
+    if (::flock(descriptor, LOCK_SH) == 0 && ::fstat(descriptor, &held) == 0 &&
+        ::stat(lock.c_str(), &named) == 0 && held.st_dev == named.st_dev &&
+        held.st_ino == named.st_ino) {
+      this->directory_ = generation;
+      this->descriptor_ = descriptor;
+      return;
+    }
+
+    ::close(descriptor);
+  }
+#endif
+}
+
+PublicationLease::~PublicationLease() {
+#if !defined(_WIN32)
+  if (this->descriptor_ != -1) {
+    ::close(this->descriptor_);
+  }
+#endif
+}
+
+auto publication_collect(const std::filesystem::path &generation) -> bool {
+#if defined(_WIN32)
+  // Nothing can tell whether a server still holds it
+  static_cast<void>(generation);
+  return false;
+#else
+  const auto lock{generation / PUBLICATION_LOCK};
+  const auto descriptor{::open(lock.c_str(), O_RDONLY | O_CLOEXEC)};
+  std::error_code error;
+  if (descriptor == -1) {
+    std::filesystem::remove_all(generation, error);
+    return !error;
+  }
+
+  if (::flock(descriptor, LOCK_EX | LOCK_NB) != 0) {
+    ::close(descriptor);
+    return false;
+  }
+
+  // The lock goes first, so that a server that opened it just before finds
+  // out that what it holds is on its way out
+  std::filesystem::remove(lock, error);
+  if (!error) {
+    std::filesystem::remove_all(generation, error);
+  }
+
+  ::close(descriptor);
+  return !error;
+#endif
+}
+
+} // namespace sourcemeta::one
@@ -0,0 +1,553 @@
+#include <sourcemeta/core/http.h>
+
+#include <sourcemeta/one/shared_trace.h>
+#include <sourcemeta/one/shared_version.h>
+
+#include <algorithm>    // std::max, std::min, std::ranges::all_of
+#include <atomic>       // std::atomic
+#include <chrono>       // std::chrono
+#include <cstdio>       // std::snprintf, stderr
+#include <cstring>      // std::memcpy
+#include <fstream>      // std::ofstream
+#include <memory>       // std::make_shared
+#include <print>        // std::println
+#include <random>       // std::mt19937_64, std::random_device
+#include <span>         // std::span
+#include <sstream>      // std::ostringstream
+#include <system_error> // std::make_error_code, std::errc
+#include <type_traits>  // std::is_same_v, std::decay_t
+#include <utility>      // std::move, std::exchange
+#include <variant>      // std::visit
+
+namespace {
+
+std::atomic<sourcemeta::one::Trace *> installed_trace{nullptr};
+std::atomic<sourcemeta::one::OTLPExporter *> installed_exporter{nullptr};
+std::atomic<std::uint32_t> next_thread{0};
+thread_local sourcemeta::one::TraceContext current_context{};
+
+// Identifiers only have to be unlikely to collide, not to be guessed, so a
+// generator per thread seeded once is plenty and never takes a lock
+auto random_fill(const std::span<std::uint8_t> bytes) -> void {
+  thread_local std::mt19937_64 generator{std::random_device{}()};
+  for (std::size_t offset{0}; offset < bytes.size(); offset += 8) {
+    const auto value{generator()};
+    std::memcpy(bytes.data() + offset, &value,
+                std::min<std::size_t>(8, bytes.size() - offset));
+  }
+
+  // All zeroes means no identifier at all
+  if (std::ranges::all_of(bytes, [](const auto byte) { return byte == 0; })) {
+    bytes.back() = 1;
+  }
+}
+
+auto from_hex(const std::string_view input, const std::span<std::uint8_t> into)
+    -> bool {
+  if (input.size() != into.size() * 2) {
+    return false;
+  }
+
+  const auto digit{[](const char character) -> int {
+    if (character >= '0' && character <= '9') {
+      return character - '0';
+    }
+
+    // The specification only allows lowercase
+    if (character >= 'a' && character <= 'f') {
+      return character - 'a' + 10;
+    }
+
+    return -1;
+  }};
+
+  for (std::size_t index{0}; index < into.size(); index++) {
+    const auto high{digit(input[index * 2])};
+    const auto low{digit(input[index * 2 + 1])};
+    if (high < 0 || low < 0) {
+      return false;
+    }
+
+    into[index] = static_cast<std::uint8_t>((high << 4) | low);
+  }
+
+  return true;
+}
+
+auto write_hex(std::ostream &stream, const std::span<const std::uint8_t> bytes)
+    -> void {
+  static constexpr std::string_view DIGITS{"0123456789abcdef"};
+  stream << '"';
+  for (const auto byte : bytes) {
+    stream << DIGITS[byte >> 4] << DIGITS[byte & 0x0f];
+  }
+
+  stream << '"';
+}
+
+auto write_string(std::ostream &stream, const std::string_view value) -> void {
+  stream << '"';
+  for (const auto character : value) {
+    switch (character) {
+      case '"':
+        stream << "\\\"";
+        break;
+      case '\\':
+        stream << "\\\\";
+        break;
+      case '\n':
+        stream << "\\n";
+        break;
+      case '\t':
+        stream << "\\t";
+        break;
+      default:
+        if (static_cast<unsigned char>(character) < 0x20) {
+          char escape[8];
+          std::snprintf(escape, sizeof(escape), "\\u%04x",
+                        static_cast<unsigned int>(character));
+          stream << escape;
+        } else {
+          stream << character;
+        }
+    }
+  }
+
+  stream << '"';
+}
+
+auto write_attribute(std::ostream &stream, const std::string_view key,
+                     const std::string_view value) -> void {
+  stream << "{\"key\":";
+  write_string(stream, key);
+  stream << ",\"value\":{\"stringValue\":";
+  write_string(stream, value);
+  stream << "}}";
+}
+
+} // namespace
+
+namespace sourcemeta::one {
+
+auto TraceContext::valid() const noexcept -> bool {
+  return std::ranges::any_of(this->trace,
+                             [](const auto byte) { return byte != 0; });
+}
+
+auto TraceContext::parse(const std::string_view traceparent)
+    -> std::optional<TraceContext> {
+  // version "-" trace-id "-" parent-id "-" trace-flags
+  if (traceparent.size() != 55 || !traceparent.starts_with("00-") ||
+      traceparent[35] != '-' || traceparent[52] != '-') {
+    return std::nullopt;
+  }
+
+  TraceContext context;
+  std::array<std::uint8_t, 1> flags{};
+  if (!from_hex(traceparent.substr(3, 32), context.trace) ||
+      !from_hex(traceparent.substr(36, 16), context.span) ||
+      !from_hex(traceparent.substr(53, 2), flags) || !context.valid() ||
+      std::ranges::all_of(context.span,
+                          [](const auto byte) { return byte == 0; })) {
+    return std::nullopt;
+  }
+
+  context.sampled = (flags[0] & 0x01) != 0;
+  return context;
+}
+
+auto TraceContext::current() noexcept -> const TraceContext & {
+  return current_context;
+}
+
+TraceContext::Adopt::Adopt(const TraceContext &context) noexcept
+    : previous{current_context} {
+  current_context = context;
+}
+
+TraceContext::Adopt::~Adopt() { current_context = this->previous; }
+
+Trace::Trace() : origin{Clock::now()} {}
+
+auto Trace::install(Trace *trace) noexcept -> void {
+  installed_trace.store(trace, std::memory_order_release);
+}
+
+auto Trace::installed() noexcept -> Trace * {
+  return installed_trace.load(std::memory_order_acquire);
+}
+
+auto Trace::thread() -> std::uint32_t {
+  thread_local const std::uint32_t identifier{
+      next_thread.fetch_add(1, std::memory_order_relaxed)};
+  return identifier;
+}
+
+auto Trace::record(Event event) -> void {
+  std::lock_guard<std::mutex> lock{this->mutex};
+  this->events.push_back(std::move(event));
+}
+
+auto Trace::write(std::ostream &stream) const -> void {
+  std::lock_guard<std::mutex> lock{this->mutex};
+  const auto microseconds{[this](const Clock::time_point point) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(point -
+                                                                 this->origin)
+        .count();
+  }};
+
+  stream << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+  std::uint32_t threads{0};
+  bool first{true};
+  for (const auto &event : this->events) {
+    threads = std::max(threads, event.thread + 1);
+    stream << (first ? "" : ",") << "{\"ph\":\"X\",\"pid\":1,\"tid\":"
+           << event.thread << ",\"cat\":";
+    first = false;
+    write_string(stream, event.category);
+    stream << ",\"name\":";
+    write_string(stream, event.name);
+    const auto start{microseconds(event.start)};
+    stream << ",\"ts\":" << start
+           << ",\"dur\":" << microseconds(event.end) - start << ",\"args\":{";
+    bool first_argument{true};
+    for (const auto &[key, value] : event.arguments) {
+      stream << (first_argument ? "" : ",");
+      first_argument = false;
+      write_string(stream, key);
+      stream << ':';
+      std::visit(
+          [&stream](const auto &content) {
+            if constexpr (std::is_same_v<std::decay_t<decltype(content)>,
+                                         std::string>) {
+              write_string(stream, content);
+            } else {
+              stream << content;
+            }
+          },
+          value);
+    }
+
+    stream << "}}";
+  }
+
+  // Thread identifiers are process wide, so a trace names every one below the
+  // highest it saw rather than only those it has spans from
+  for (std::uint32_t thread{0}; thread < threads; thread++) {
+    stream << (first ? "" : ",")
+           << "{\"ph\":\"M\",\"pid\":1,\"tid\":" << thread
+           << R"(,"name":"thread_name","args":{"name":"Thread )" << thread
+           << "\"}}";
+    first = false;
+  }
+
+  stream << "]}\n";
+}
+
+OTLPExporter::OTLPExporter(Options configuration, Sink sink)
+    : options{std::move(configuration)}, destination{std::move(sink)},
+      wall_origin{std::chrono::system_clock::now()},
+      steady_origin{Trace::Clock::now()} {
+  this->queue.reserve(this->options.batch);
+  this->exporting = std::thread{[this]() -> void { this->run(); }};
+}
+
+OTLPExporter::~OTLPExporter() {
+  {
+    std::lock_guard<std::mutex> lock{this->mutex};
+    this->stopping = true;
+  }
+
+  this->wake.notify_one();
+  this->exporting.join();
+}
+
+auto OTLPExporter::install(OTLPExporter *exporter) noexcept -> void {
+  installed_exporter.store(exporter, std::memory_order_release);
+}
+
+auto OTLPExporter::installed() noexcept -> OTLPExporter * {
+  return installed_exporter.load(std::memory_order_acquire);
+}
+
+auto OTLPExporter::sample(const TraceContext &context) const noexcept
+    -> bool {
+  if (this->options.sample <= 1) {
+    return true;
+  }
+
+  // Version 2 of the specification has the right-most bytes be the random ones
+  std::uint64_t value{0};
+  for (std::size_t index{8}; index < context.trace.size(); index++) {
+    value = (value << 8) | context.trace[index];
+  }
+
+  return value % this->options.sample == 0;
+}
+
+auto OTLPExporter::record(Trace::Event event, const Trace::Kind kind,
+                          const TraceContext &context,
+                          const TraceContext &parent) -> void {
+  std::array<std::uint8_t, 8> parent_span{};
+  if (parent.valid() && parent.trace == context.trace) {
+    parent_span = parent.span;
+  }
+
+  bool full{false};
+  {
+    std::lock_guard<std::mutex> lock{this->mutex};
+    if (this->queue.size() >= this->options.capacity) {
+      this->dropped += 1;
+      return;
+    }
+
+    this->queue.push_back({.event = std::move(event),
+                           .kind = kind,
+                           .context = context,
+                           .parent = parent_span});
+    full = this->queue.size() >= this->options.batch;
+  }
+
+  if (full) {
+    this->wake.notify_one();
+  }
+}
+
+auto OTLPExporter::record(Trace::Event event) -> void {
+  const auto &parent{TraceContext::current()};
+  TraceContext context;
+  if (parent.valid()) {
+    if (!parent.sampled) {
+      return;
+    }
+
+    context.trace = parent.trace;
+  } else {
+    random_fill(context.trace);
+    if (!this->sample(context)) {
+      return;
+    }
+  }
+
+  random_fill(context.span);
+  context.sampled = true;
+  this->record(std::move(event), Trace::Kind::Internal, context, parent);
+}
+
+auto OTLPExporter::file(const std::filesystem::path &path) -> Sink {
+  auto stream{std::make_shared<std::ofstream>(
+      path, std::ios::binary | std::ios::app)};
+  if (!stream->is_open()) {
+    throw std::filesystem::filesystem_error{
+        "Could not open the trace export file", path,
+        std::make_error_code(std::errc::io_error)};
+  }
+
+  return [stream](const std::string_view request) -> void {
+    stream->write(request.data(), static_cast<std::streamsize>(request.size()));
+    *stream << '\n';
+    stream->flush();
+  };
+}
+
+auto OTLPExporter::collector(std::string url) -> Sink {
+  return [url = std::move(url)](const std::string_view request) -> void {
+    try {
+      sourcemeta::core::HTTPSystemRequest outgoing{
+          url, sourcemeta::core::HTTPMethod::POST};
+      outgoing.connect_timeout(std::chrono::seconds{2});
+      outgoing.timeout(std::chrono::seconds{5});
+      outgoing.maximum_response_size(64UL * 1024UL);
+      outgoing.follow_redirects(false);
+      outgoing.body(std::string{request}, "application/json");
+      [[maybe_unused]] const auto response{outgoing.send()};
+      // A collector that is away costs the batch, never the process
+    } catch (...) {
+    }
+  };
+}
+
+auto OTLPExporter::sink(const std::string_view destination) -> Sink {
+  if (destination.starts_with("http://") ||
+      destination.starts_with("https://")) {
+    return OTLPExporter::collector(std::string{destination});
+  }
+
+  return OTLPExporter::file(std::filesystem::path{destination});
+}
+
+auto OTLPExporter::run() -> void {
+  std::vector<Span> batch;
+  batch.reserve(this->options.batch);
+  while (true) {
+    std::uint64_t lost{0};
+    bool last{false};
+    {
+      std::unique_lock<std::mutex> lock{this->mutex};
+      this->wake.wait_for(lock, this->options.interval, [this]() -> bool {
+        return this->stopping || this->queue.size() >= this->options.batch;
+      });
+
+      // The queue keeps the storage the previous batch had, so that steady
+      // exporting allocates nothing for it
+      batch.swap(this->queue);
+      lost = std::exchange(this->dropped, 0);
+      last = this->stopping;
+    }
+
+    for (std::size_t offset{0}; offset < batch.size();
+         offset += this->options.batch) {
+      const auto end{std::min(offset + this->options.batch, batch.size())};
+      std::ostringstream request;
+      this->serialize(std::span{batch}.subspan(offset, end - offset), request);
+      try {
+        this->destination(request.str());
+      } catch (...) {
+        // A destination that fails costs the batch, never the thread
+      }
+    }
+
+    if (lost > 0) {
+      std::println(stderr, "Dropped {} spans, as exporting could not keep up",
+                   lost);
+    }
+
+    batch.clear();
+    if (last) {
+      return;
+    }
+  }
+}
+
+auto OTLPExporter::serialize(const std::span<const Span> spans,
+                             std::ostream &stream) const -> void {
+  const auto nanoseconds{[this](const Trace::Clock::time_point point) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               this->wall_origin.time_since_epoch() +
+               (point - this->steady_origin))
+        .count();
+  }};
+
+  stream << R"({"resourceSpans":[{"resource":{"attributes":[)";
+  write_attribute(stream, "service.name", this->options.service);
+  stream << ',';
+  write_attribute(stream, "service.version", sourcemeta::one::version());
+  stream << R"(]},"scopeSpans":[{"scope":{"name":"sourcemeta-one"},"spans":[)";
+  bool first{true};
+  for (const auto &span : spans) {
+    stream << (first ? "" : ",") << "{\"traceId\":";
+    first = false;
+    write_hex(stream, span.context.trace);
+    stream << ",\"spanId\":";
+    write_hex(stream, span.context.span);
+    if (std::ranges::any_of(span.parent,
+                            [](const auto byte) { return byte != 0; })) {
+      stream << ",\"parentSpanId\":";
+      write_hex(stream, span.parent);
+    }
+
+    stream << ",\"name\":";
+    write_string(stream, span.event.name);
+    // SPAN_KIND_INTERNAL and SPAN_KIND_SERVER, and 64-bit integers are strings
+    // in the JSON encoding of OTLP
+    stream << ",\"kind\":" << (span.kind == Trace::Kind::Server ? 2 : 1)
+           << ",\"startTimeUnixNano\":\"" << nanoseconds(span.event.start)
+           << "\",\"endTimeUnixNano\":\"" << nanoseconds(span.event.end)
+           << "\",\"attributes\":[";
+    write_attribute(stream, "sourcemeta.one.category", span.event.category);
+    for (const auto &[key, value] : span.event.arguments) {
+      std::visit(
+          [&stream, key](const auto &content) {
+            if constexpr (std::is_same_v<std::decay_t<decltype(content)>,
+                                         std::string>) {
+              stream << ',';
+              write_attribute(stream, key, content);
+            } else {
+              stream << ",{\"key\":";
+              write_string(stream, key);
+              stream << ",\"value\":{\"intValue\":\"" << content << "\"}}";
+            }
+          },
+          value);
+    }
+
+    stream << "]}";
+  }
+
+  stream << "]}]}]}";
+}
+
+TraceSpan::TraceSpan(const std::string_view category,
+                     const std::string_view name, const Trace::Kind span_kind)
+    : trace{Trace::installed()}, exporter{OTLPExporter::installed()},
+      kind{span_kind} {
+  if (this->exporter != nullptr) {
+    this->parent = current_context;
+    if (this->parent.valid()) {
+      this->own.trace = this->parent.trace;
+      this->own.sampled = this->parent.sampled;
+    } else {
+      random_fill(this->own.trace);
+      this->own.sampled = this->exporter->sample(this->own);
+    }
+
+    if (this->own.sampled) {
+      random_fill(this->own.span);
+      current_context = this->own;
+      this->adopted = true;
+    } else {
+      // A trace that is not exported is still one, so that nothing under it
+      // gets to be sampled on its own
+      if (!this->parent.valid()) {
+        current_context = this->own;
+        this->adopted = true;
+      }
+
+      this->exporter = nullptr;
+    }
+  }
+
+  if (this->active()) {
+    this->event.category = category;
+    this->event.name = name;
+    this->event.thread = this->trace != nullptr ? Trace::thread() : 0;
+    this->event.start = Trace::Clock::now();
+  }
+}
+
+TraceSpan::~TraceSpan() {
+  if (this->adopted) {
+    current_context = this->parent;
+  }
+
+  if (!this->active()) {
+    return;
+  }
+
+  this->event.end = Trace::Clock::now();
+  if (this->exporter != nullptr) {
+    this->exporter->record(this->trace != nullptr ? this->event
+                                                  : std::move(this->event),
+                           this->kind, this->own, this->parent);
+  }
+
+  if (this->trace != nullptr) {
+    this->trace->record(std::move(this->event));
+  }
+}
+
+auto TraceSpan::argument(const std::string_view key, std::string value)
+    -> void {
+  if (this->active()) {
+    this->event.arguments.emplace_back(key, std::move(value));
+  }
+}
+
+auto TraceSpan::argument(const std::string_view key, const std::uint64_t value)
+    -> void {
+  if (this->active()) {
+    this->event.arguments.emplace_back(key, value);
+  }
+}
+
+} // namespace sourcemeta::one
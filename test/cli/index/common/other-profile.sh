@@ -0,0 +1,53 @@
+#!/bin/sh
+
+# Profiling ranks the artifacts by how long they took to build, and then the
+# actions of the build by how far they grew the peak resident memory
+
+set -o errexit
+set -o nounset
+
+TMP="$(mktemp -d)"
+clean() { rm -rf "$TMP"; }
+trap clean EXIT
+
+cat << EOF > "$TMP/one.json"
+{
+  "url": "https://sourcemeta.com",
+  "contents": {
+    "example": {
+      "contents": {
+        "schemas": {
+          "baseUri": "https://example.com/",
+          "path": "./schemas"
+        }
+      }
+    }
+  }
+}
+EOF
+
+mkdir -p "$TMP/schemas"
+
+cat << 'EOF' > "$TMP/schemas/test.json"
+{
+  "$schema": "http://json-schema.org/draft-07/schema#",
+  "$id": "https://example.com/test",
+  "type": "object"
+}
+EOF
+
+"$1" --skip-banner --profile --concurrency 1 "$TMP/one.json" "$TMP/output" \
+  > "$TMP/stdout.txt" 2> "$TMP/stderr.txt"
+
+grep -q '^Profiling\.\.\.$' "$TMP/stderr.txt"
+grep -q '^Profiling memory\.\.\.$' "$TMP/stderr.txt"
+grep -q '^Profiling allocations\.\.\.$' "$TMP/stderr.txt"
+grep -q '^[0-9][0-9]*ms schemas/example/schemas/test/%/schema.metapack$' \
+  "$TMP/stdout.txt"
+
+# Every memory line names an action of this build
+if grep -v 'ms ' "$TMP/stdout.txt" | grep -v '^[0-9][0-9]*KiB [^ ]' | grep -q .
+then
+  cat "$TMP/stdout.txt"
+  exit 1
+fi
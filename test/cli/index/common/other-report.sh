@@ -0,0 +1,100 @@
+#!/bin/sh
+
+# A report counts what each kind of action did and names why every schema
+# that got rebuilt was rebuilt, telling a schema that changed apart from one
+# that was only rebuilt for what it references
+
+set -o errexit
+set -o nounset
+
+TMP="$(mktemp -d)"
+clean() { rm -rf "$TMP"; }
+trap clean EXIT
+
+cat << EOF > "$TMP/one.json"
+{
+  "url": "https://sourcemeta.com",
+  "contents": {
+    "example": {
+      "contents": {
+        "schemas": {
+          "baseUri": "https://example.com/",
+          "path": "./schemas"
+        }
+      }
+    }
+  }
+}
+EOF
+
+mkdir -p "$TMP/schemas"
+
+cat << 'EOF' > "$TMP/schemas/common.json"
+{
+  "$schema": "http://json-schema.org/draft-07/schema#",
+  "$id": "https://example.com/common",
+  "type": "object"
+}
+EOF
+
+cat << 'EOF' > "$TMP/schemas/dependent.json"
+{
+  "$schema": "http://json-schema.org/draft-07/schema#",
+  "$id": "https://example.com/dependent",
+  "properties": {
+    "value": { "$ref": "https://example.com/common" }
+  }
+}
+EOF
+
+"$1" --skip-banner --report "$TMP/report.json" \
+  "$TMP/one.json" "$TMP/output" > "$TMP/log.txt" 2>&1
+grep -q '^Writing report to: .*/report.json$' "$TMP/log.txt"
+
+for expected in \
+  '"phases"' \
+  '"name": "Detect"' \
+  '"resolver"' \
+  '"hitRatio"' \
+  '"materialise"' \
+  '"bundle"' \
+  '"p99"' \
+  '"growthBytes"' \
+  '"allocatedBytes"' \
+  '"peakResidentBytes"' \
+  '"https://example.com/common": "full"' \
+  '"https://example.com/dependent": "full"'
+do
+  if ! grep -qF "$expected" "$TMP/report.json"
+  then
+    echo "Missing from the first report: $expected" 1>&2
+    cat "$TMP/report.json" 1>&2
+    exit 1
+  fi
+done
+
+# Make sure the modification time moves even on coarse filesystems
+sleep 1
+cat << 'EOF' > "$TMP/schemas/common.json"
+{
+  "$schema": "http://json-schema.org/draft-07/schema#",
+  "$id": "https://example.com/common",
+  "type": "string"
+}
+EOF
+
+"$1" --skip-banner --report "$TMP/report.json" \
+  "$TMP/one.json" "$TMP/output" > "$TMP/log.txt" 2>&1
+
+for expected in \
+  '"incremental": true' \
+  '"https://example.com/common": "modified"' \
+  '"https://example.com/dependent": "dependency"'
+do
+  if ! grep -qF "$expected" "$TMP/report.json"
+  then
+    echo "Missing from the second report: $expected" 1>&2
+    cat "$TMP/report.json" 1>&2
+    exit 1
+  fi
+done
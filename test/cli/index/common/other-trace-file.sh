@@ -0,0 +1,82 @@
+#!/bin/sh
+
+# A trace covers the phases, the waves and the actions of a build, along with
+# the lookups and compiles they did, and a build that writes one builds the
+# same artifacts as one that does not
+
+set -o errexit
+set -o nounset
+
+TMP="$(mktemp -d)"
+clean() { rm -rf "$TMP"; }
+trap clean EXIT
+
+cat << EOF > "$TMP/one.json"
+{
+  "url": "https://sourcemeta.com",
+  "contents": {
+    "example": {
+      "contents": {
+        "schemas": {
+          "baseUri": "https://example.com/",
+          "path": "./schemas"
+        }
+      }
+    }
+  }
+}
+EOF
+
+mkdir -p "$TMP/schemas"
+
+cat << 'EOF' > "$TMP/schemas/common.json"
+{
+  "$schema": "http://json-schema.org/draft-07/schema#",
+  "$id": "https://example.com/common",
+  "type": "object"
+}
+EOF
+
+cat << 'EOF' > "$TMP/schemas/dependent.json"
+{
+  "$schema": "http://json-schema.org/draft-07/schema#",
+  "$id": "https://example.com/dependent",
+  "properties": {
+    "value": { "$ref": "https://example.com/common" }
+  }
+}
+EOF
+
+"$1" --skip-banner --trace-file "$TMP/trace.json" \
+  "$TMP/one.json" "$TMP/output" > "$TMP/log.txt" 2>&1
+grep -q '^Writing trace to: .*/trace.json$' "$TMP/log.txt"
+
+head -c 40 "$TMP/trace.json" | grep -q '^{"displayTimeUnit":"ms","traceEvents":\['
+for expected in \
+  '"cat":"phase","name":"Detect"' \
+  '"cat":"phase","name":"Resolve"' \
+  '"cat":"wave","name":"Producing #1"' \
+  '"cat":"action","name":"materialise"' \
+  '"cat":"action","name":"bundle"' \
+  '"cat":"resolve","name":"https://example.com/common"' \
+  '"cat":"compile","name":"http://json-schema.org/draft-07/schema#"' \
+  '"name":"thread_name"'
+do
+  if ! grep -qF "$expected" "$TMP/trace.json"
+  then
+    echo "Missing from the trace: $expected" 1>&2
+    exit 1
+  fi
+done
+
+# Actions report what they wrote
+grep -q '"path":"schemas/example/schemas/common/%/schema.metapack","bytes":[1-9]' \
+  "$TMP/trace.json"
+
+# Tracing changes nothing about the build itself
+"$1" --skip-banner "$TMP/one.json" "$TMP/plain" > /dev/null 2>&1
+(cd "$TMP/output" && find . -type f ! -name 'state.bin' | LC_ALL=C sort) \
+  > "$TMP/traced.txt"
+(cd "$TMP/plain" && find . -type f ! -name 'state.bin' | LC_ALL=C sort) \
+  > "$TMP/plain.txt"
+diff "$TMP/traced.txt" "$TMP/plain.txt"
@@ -0,0 +1,76 @@
+#!/bin/sh
+
+# Exported spans are OTLP/JSON, one build being one trace whose phases, waves
+# and actions hang from the build, and a build that exports builds the same
+# artifacts as one that does not
+
+set -o errexit
+set -o nounset
+
+TMP="$(mktemp -d)"
+clean() { rm -rf "$TMP"; }
+trap clean EXIT
+
+cat << EOF > "$TMP/one.json"
+{
+  "url": "https://sourcemeta.com",
+  "contents": {
+    "example": {
+      "contents": {
+        "schemas": {
+          "baseUri": "https://example.com/",
+          "path": "./schemas"
+        }
+      }
+    }
+  }
+}
+EOF
+
+mkdir -p "$TMP/schemas"
+
+cat << 'EOF' > "$TMP/schemas/common.json"
+{
+  "$schema": "http://json-schema.org/draft-07/schema#",
+  "$id": "https://example.com/common",
+  "type": "object"
+}
+EOF
+
+"$1" --skip-banner --trace-otlp "$TMP/spans.jsonl" \
+  "$TMP/one.json" "$TMP/output" > /dev/null 2>&1
+
+head -c 40 "$TMP/spans.jsonl" | grep -q '^{"resourceSpans":\[{"resource":'
+for expected in \
+  '{"key":"service.name","value":{"stringValue":"sourcemeta-one-index"}}' \
+  '"name":"build","kind":1' \
+  '"name":"Detect","kind":1' \
+  '"name":"Producing #1","kind":1' \
+  '"name":"materialise","kind":1' \
+  '{"key":"sourcemeta.one.category","value":{"stringValue":"action"}}'
+do
+  if ! grep -qF "$expected" "$TMP/spans.jsonl"
+  then
+    echo "Missing from the spans: $expected" 1>&2
+    exit 1
+  fi
+done
+
+# Every span belongs to the one trace of the build
+grep -o '"traceId":"[0-9a-f]*"' "$TMP/spans.jsonl" | LC_ALL=C sort -u \
+  > "$TMP/traces.txt"
+test "$(wc -l < "$TMP/traces.txt")" -eq 1
+
+# Sampling all but one in as many builds as there are trace ids exports nothing
+"$1" --skip-banner --trace-otlp "$TMP/sampled.jsonl" \
+  --trace-sample 18446744073709551615 \
+  "$TMP/one.json" "$TMP/sampled" > /dev/null 2>&1
+test ! -s "$TMP/sampled.jsonl"
+
+# Exporting changes nothing about the build itself
+"$1" --skip-banner "$TMP/one.json" "$TMP/plain" > /dev/null 2>&1
+(cd "$TMP/output" && find . -type f ! -name 'state.bin' | LC_ALL=C sort) \
+  > "$TMP/traced.txt"
+(cd "$TMP/plain" && find . -type f ! -name 'state.bin' | LC_ALL=C sort) \
+  > "$TMP/plain.txt"
+diff "$TMP/traced.txt" "$TMP/plain.txt"
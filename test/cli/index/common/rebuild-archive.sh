@@ -0,0 +1,71 @@
+#!/bin/sh
+
+# Archiving packs every artifact into segments, and a build that changes
+# nothing rewrites none of them. A build that stops asking for an archive
+# removes it, so that the server never hands out a stale one
+
+set -o errexit
+set -o nounset
+
+TMP="$(mktemp -d)"
+clean() { rm -rf "$TMP"; }
+trap clean EXIT
+
+cat << EOF > "$TMP/one.json"
+{
+  "url": "https://sourcemeta.com",
+  "contents": {
+    "example": {
+      "contents": {
+        "schemas": {
+          "baseUri": "https://example.com/",
+          "path": "./schemas"
+        }
+      }
+    }
+  }
+}
+EOF
+
+mkdir -p "$TMP/schemas"
+
+cat << 'EOF' > "$TMP/schemas/foo.json"
+{
+  "$schema": "http://json-schema.org/draft-07/schema#",
+  "$id": "https://example.com/foo",
+  "type": "string"
+}
+EOF
+
+"$1" --skip-banner --archive "$TMP/one.json" "$TMP/output" \
+  > "$TMP/log.txt" 2>&1
+grep -q '^Archived artifacts, rewriting [1-9][0-9]* of 16 segments$' \
+  "$TMP/log.txt"
+ls "$TMP/output/archive" | grep -q '\.bin$'
+grep -q 'schemas/example/schemas/foo/%/schema.metapack' \
+  "$TMP/output/archive/"*.bin
+
+"$1" --skip-banner --archive "$TMP/one.json" "$TMP/output" \
+  > "$TMP/log.txt" 2>&1
+grep -q '^Archived artifacts, rewriting 0 of 16 segments$' "$TMP/log.txt"
+test -f "$TMP/output/archive/settled"
+
+# Only what was built again is looked at, and what it was built into is what
+# the archive hands out from then on
+sed 's/"string"/"integer"/' "$TMP/schemas/foo.json" > "$TMP/foo.json"
+mv "$TMP/foo.json" "$TMP/schemas/foo.json"
+"$1" --skip-banner --archive "$TMP/one.json" "$TMP/output" \
+  > "$TMP/log.txt" 2>&1
+grep -q '^Archived artifacts, rewriting [1-9] of 16 segments$' "$TMP/log.txt"
+
+# A build that died before archiving leaves no marker, so the next one cannot
+# tell what that build changed and writes every segment again
+rm "$TMP/output/archive/settled"
+"$1" --skip-banner --archive "$TMP/one.json" "$TMP/output" \
+  > "$TMP/log.txt" 2>&1
+SEGMENTS="$(find "$TMP/output/archive" -name '*.bin' | wc -l | tr -d ' ')"
+grep -q "^Archived artifacts, rewriting $SEGMENTS of 16 segments$" \
+  "$TMP/log.txt"
+
+"$1" --skip-banner "$TMP/one.json" "$TMP/output" > "$TMP/log.txt" 2>&1
+test ! -e "$TMP/output/archive"
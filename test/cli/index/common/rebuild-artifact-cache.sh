@@ -0,0 +1,130 @@
+#!/bin/sh
+
+# A build from an empty output over a cache another build filled must take
+# every artifact it can key over from that cache and end up with the same
+# catalog, while a schema that changed in between must be built again
+
+set -o errexit
+set -o nounset
+
+TMP="$(mktemp -d)"
+clean() { rm -rf "$TMP"; }
+trap clean EXIT
+
+cat << EOF > "$TMP/one.json"
+{
+  "url": "https://sourcemeta.com",
+  "contents": {
+    "example": {
+      "contents": {
+        "schemas": {
+          "baseUri": "https://example.com/",
+          "path": "./schemas"
+        }
+      }
+    }
+  }
+}
+EOF
+
+mkdir -p "$TMP/schemas"
+
+cat << 'EOF' > "$TMP/schemas/common.json"
+{
+  "$schema": "http://json-schema.org/draft-07/schema#",
+  "$id": "https://example.com/common",
+  "type": "object"
+}
+EOF
+
+cat << 'EOF' > "$TMP/schemas/dependent.json"
+{
+  "$schema": "http://json-schema.org/draft-07/schema#",
+  "$id": "https://example.com/dependent",
+  "properties": {
+    "value": { "$ref": "https://example.com/common" }
+  }
+}
+EOF
+
+list_artifacts() {
+  (cd "$1" && find . -type f ! -name 'state.bin' | LC_ALL=C sort)
+}
+
+cache_summary() {
+  grep '^Artifact cache: ' "$1"
+}
+
+# A cold cache has nothing to offer. One thread each, so that both builds read
+# what a schema references from the same place and so key it the same way
+"$1" --skip-banner --concurrency 1 --artifact-cache "$TMP/cache" \
+  "$TMP/one.json" "$TMP/first" > "$TMP/first.txt" 2>&1
+cache_summary "$TMP/first.txt" | grep -q ' 0 hits out of '
+
+# Another build from an empty output takes everything over
+"$1" --skip-banner --concurrency 1 --artifact-cache "$TMP/cache" \
+  "$TMP/one.json" "$TMP/second" > "$TMP/second.txt" 2>&1
+LOOKUPS="$(cache_summary "$TMP/second.txt" | sed 's/^.* out of \([0-9]*\) .*$/\1/')"
+test "$LOOKUPS" -gt 0
+cache_summary "$TMP/second.txt" | grep -q " $LOOKUPS hits out of $LOOKUPS lookups (100%)"
+
+list_artifacts "$TMP/first" > "$TMP/first-artifacts.txt"
+list_artifacts "$TMP/second" > "$TMP/second-artifacts.txt"
+diff "$TMP/first-artifacts.txt" "$TMP/second-artifacts.txt"
+
+# What was taken over is what a build would have made
+cmp "$TMP/first/schemas/example/schemas/dependent/%/bundle.metapack" \
+  "$TMP/second/schemas/example/schemas/dependent/%/bundle.metapack"
+
+# A build over what was taken over has nothing left to do
+"$1" --skip-banner --artifact-cache "$TMP/cache" \
+  "$TMP/one.json" "$TMP/second" > "$TMP/rebuild.txt" 2>&1
+if grep -q 'Producing:\|Combining:' "$TMP/rebuild.txt"; then
+  cat "$TMP/rebuild.txt"
+  exit 1
+fi
+
+# One more output that takes everything over, to be rebuilt in place below
+"$1" --skip-banner --concurrency 1 --artifact-cache "$TMP/cache" \
+  "$TMP/one.json" "$TMP/fetched" > "$TMP/fetched.txt" 2>&1
+cp -R "$TMP/cache/objects" "$TMP/objects"
+
+# A change to a schema others reference reaches the artifacts of both
+cat << 'EOF' > "$TMP/schemas/common.json"
+{
+  "$schema": "http://json-schema.org/draft-07/schema#",
+  "$id": "https://example.com/common",
+  "type": "string"
+}
+EOF
+
+# Rebuilding in place what was stored into the cache and what was fetched out
+# of it never changes what the cache holds under the keys it already had
+"$1" --skip-banner "$TMP/one.json" "$TMP/first" > "$TMP/first-again.txt" 2>&1
+"$1" --skip-banner "$TMP/one.json" "$TMP/fetched" > "$TMP/fetched-again.txt" 2>&1
+(cd "$TMP/objects" && find . -type f) | while read -r object
+do
+  if ! cmp -s "$TMP/objects/$object" "$TMP/cache/objects/$object"
+  then
+    echo "Overwritten cache object: $object" 1>&2
+    exit 1
+  fi
+done
+
+"$1" --skip-banner --artifact-cache "$TMP/cache" \
+  "$TMP/one.json" "$TMP/third" > "$TMP/third.txt" 2>&1
+if cache_summary "$TMP/third.txt" | grep -q ' (100%)$'; then
+  cat "$TMP/third.txt"
+  exit 1
+fi
+
+# Neither is what the cache held for the schemas before the change
+for artifact in common/%/schema.metapack dependent/%/bundle.metapack
+do
+  if cmp -s "$TMP/second/schemas/example/schemas/$artifact" \
+    "$TMP/third/schemas/example/schemas/$artifact"
+  then
+    echo "Stale artifact: $artifact" 1>&2
+    exit 1
+  fi
+done
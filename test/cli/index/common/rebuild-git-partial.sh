@@ -0,0 +1,97 @@
+#!/bin/sh
+
+# The collections git cannot vouch for are walked together, and what the walk
+# finds in each is still told apart from what git lists for the others
+
+set -o errexit
+set -o nounset
+
+TMP="$(mktemp -d)"
+clean() { rm -rf "$TMP"; }
+trap clean EXIT
+
+git_commit() {
+  git -C "$TMP" add --all
+  git -C "$TMP" -c user.name=one -c user.email=one@sourcemeta.com \
+    commit --quiet --message "$1"
+}
+
+expect_dirty() {
+  if ! grep -qF "\"https://sourcemeta.com/example/$1\": \"$2\"" \
+    "$TMP/report.json"
+  then
+    echo "Expected $1 to be rebuilt as $2" 1>&2
+    cat "$TMP/report.json" 1>&2
+    exit 1
+  fi
+}
+
+expect_clean() {
+  if grep -qF "\"https://sourcemeta.com/example/$1\"" "$TMP/report.json"
+  then
+    echo "Expected $1 not to be rebuilt" 1>&2
+    cat "$TMP/report.json" 1>&2
+    exit 1
+  fi
+}
+
+cat << EOF > "$TMP/one.json"
+{
+  "url": "https://sourcemeta.com",
+  "contents": {
+    "example": {
+      "contents": {
+        "first": {
+          "baseUri": "https://example.com/first/",
+          "path": "./first"
+        },
+        "second": {
+          "baseUri": "https://example.com/second/",
+          "path": "./second"
+        },
+        "third": {
+          "baseUri": "https://example.com/third/",
+          "path": "./third"
+        }
+      }
+    }
+  }
+}
+EOF
+
+write_schema() {
+  mkdir -p "$TMP/$1"
+  cat << EOF > "$TMP/$1/schema.json"
+{
+  "\$schema": "http://json-schema.org/draft-07/schema#",
+  "\$id": "https://example.com/$1/schema",
+  "type": "$2"
+}
+EOF
+}
+
+write_schema first string
+write_schema second string
+write_schema third string
+
+git init --quiet "$TMP"
+echo "output" > "$TMP/.gitignore"
+git_commit "First"
+
+"$1" --skip-banner --git --report "$TMP/report.json" \
+  "$TMP/one.json" "$TMP/output" > "$TMP/log.txt" 2>&1
+expect_dirty first/schema full
+expect_dirty second/schema full
+expect_dirty third/schema full
+
+# Only the first collection is as git has it, so the other two are walked
+sleep 1
+touch "$TMP/first/schema.json"
+write_schema second number
+write_schema third boolean
+
+"$1" --skip-banner --git --report "$TMP/report.json" \
+  "$TMP/one.json" "$TMP/output" > "$TMP/log.txt" 2>&1
+expect_clean first/schema
+expect_dirty second/schema modified
+expect_dirty third/schema modified
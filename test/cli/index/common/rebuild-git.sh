@@ -0,0 +1,121 @@
+#!/bin/sh
+
+# Asking git what changed only rebuilds what a commit changed, whatever the
+# modification times say, and falls back to looking at the files as soon as
+# the work tree has anything git did not commit
+
+set -o errexit
+set -o nounset
+
+TMP="$(mktemp -d)"
+clean() { rm -rf "$TMP"; }
+trap clean EXIT
+
+git_commit() {
+  git -C "$TMP" add --all
+  git -C "$TMP" -c user.name=one -c user.email=one@sourcemeta.com \
+    commit --quiet --message "$1"
+}
+
+expect_dirty() {
+  if ! grep -qF "\"https://sourcemeta.com/example/schemas/$1\": \"$2\"" \
+    "$TMP/report.json"
+  then
+    echo "Expected $1 to be rebuilt as $2" 1>&2
+    cat "$TMP/report.json" 1>&2
+    exit 1
+  fi
+}
+
+expect_clean() {
+  if grep -qF "\"https://sourcemeta.com/example/schemas/$1\"" \
+    "$TMP/report.json"
+  then
+    echo "Expected $1 not to be rebuilt" 1>&2
+    cat "$TMP/report.json" 1>&2
+    exit 1
+  fi
+}
+
+cat << EOF > "$TMP/one.json"
+{
+  "url": "https://sourcemeta.com",
+  "contents": {
+    "example": {
+      "contents": {
+        "schemas": {
+          "baseUri": "https://example.com/",
+          "path": "./schemas"
+        }
+      }
+    }
+  }
+}
+EOF
+
+mkdir -p "$TMP/schemas"
+
+cat << 'EOF' > "$TMP/schemas/a.json"
+{
+  "$schema": "http://json-schema.org/draft-07/schema#",
+  "$id": "https://example.com/a",
+  "type": "string"
+}
+EOF
+
+cat << 'EOF' > "$TMP/schemas/b.json"
+{
+  "$schema": "http://json-schema.org/draft-07/schema#",
+  "$id": "https://example.com/b",
+  "type": "number"
+}
+EOF
+
+git init --quiet "$TMP"
+echo "output" > "$TMP/.gitignore"
+git_commit "First"
+
+"$1" --skip-banner --git --report "$TMP/report.json" \
+  "$TMP/one.json" "$TMP/output" > "$TMP/log.txt" 2>&1
+expect_dirty a full
+expect_dirty b full
+
+# A file git has as committed is not looked at again, however new it looks
+sleep 1
+touch "$TMP/schemas/a.json"
+cat << 'EOF' > "$TMP/schemas/b.json"
+{
+  "$schema": "http://json-schema.org/draft-07/schema#",
+  "$id": "https://example.com/b",
+  "type": "integer"
+}
+EOF
+git_commit "Second"
+
+"$1" --skip-banner --git --report "$TMP/report.json" \
+  "$TMP/one.json" "$TMP/output" > "$TMP/log.txt" 2>&1
+expect_clean a
+expect_dirty b modified
+
+# Deleting a file in a commit is noticed without a walk
+git -C "$TMP" rm --quiet "$TMP/schemas/b.json"
+git_commit "Third"
+
+"$1" --skip-banner --git --report "$TMP/report.json" \
+  "$TMP/one.json" "$TMP/output" > "$TMP/log.txt" 2>&1
+expect_clean a
+test ! -d "$TMP/output/schemas/example/schemas/b"
+
+# Nothing committed yet, so git cannot vouch for the collection
+sleep 1
+cat << 'EOF' > "$TMP/schemas/a.json"
+{
+  "$schema": "http://json-schema.org/draft-07/schema#",
+  "$id": "https://example.com/a",
+  "type": "boolean"
+}
+EOF
+
+"$1" --skip-banner --git --report "$TMP/report.json" \
+  "$TMP/one.json" "$TMP/output" > "$TMP/log.txt" 2>&1
+expect_dirty a modified
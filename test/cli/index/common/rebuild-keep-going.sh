@@ -0,0 +1,103 @@
+#!/bin/sh
+
+# Keeping going sets a schema that fails aside, builds and saves everything
+# else, and fails with a report naming it. The next build retries that schema
+# alone, even though nothing about the schema itself changed
+
+set -o errexit
+set -o nounset
+
+TMP="$(mktemp -d)"
+clean() { rm -rf "$TMP"; }
+trap clean EXIT
+
+cat << EOF > "$TMP/one.json"
+{
+  "url": "https://sourcemeta.com",
+  "contents": {
+    "example": {
+      "contents": {
+        "schemas": {
+          "baseUri": "https://example.com/",
+          "path": "./schemas"
+        }
+      }
+    }
+  }
+}
+EOF
+
+mkdir -p "$TMP/schemas"
+
+cat << 'EOF' > "$TMP/schemas/good.json"
+{
+  "$schema": "http://json-schema.org/draft-07/schema#",
+  "$id": "https://example.com/good",
+  "type": "string"
+}
+EOF
+
+cat << 'EOF' > "$TMP/schemas/broken.json"
+{
+  "$schema": "http://json-schema.org/draft-07/schema#",
+  "$id": "https://example.com/broken",
+  "allOf": [ { "$ref": "https://example.com/missing" } ]
+}
+EOF
+
+if "$1" --skip-banner --keep-going --report "$TMP/report.json" \
+  "$TMP/one.json" "$TMP/output" > "$TMP/log.txt" 2>&1
+then
+  echo "Expected a build with a failing schema to fail" 1>&2
+  cat "$TMP/log.txt" 1>&2
+  exit 1
+fi
+
+grep -q '^Quarantined 1 failures, to be retried next time$' "$TMP/log.txt"
+grep -q 'at path .*/schemas/broken.json$' "$TMP/log.txt"
+test -f "$TMP/output/state.bin"
+test -f "$TMP/output/schemas/example/schemas/good/%/schema.metapack"
+test -f "$TMP/output/schemas/example/schemas/good/%/bundle.metapack"
+test ! -f "$TMP/output/schemas/example/schemas/broken/%/bundle.metapack"
+
+if ! grep -qF '"https://sourcemeta.com/example/schemas/broken": {' \
+  "$TMP/report.json"
+then
+  echo "The report does not name the failing schema" 1>&2
+  cat "$TMP/report.json" 1>&2
+  exit 1
+fi
+
+# What the failing schema was missing shows up without it changing at all
+cat << 'EOF' > "$TMP/schemas/missing.json"
+{
+  "$schema": "http://json-schema.org/draft-07/schema#",
+  "$id": "https://example.com/missing",
+  "type": "integer"
+}
+EOF
+
+"$1" --skip-banner --report "$TMP/report.json" \
+  "$TMP/one.json" "$TMP/output" > "$TMP/log.txt" 2>&1
+
+for expected in \
+  '"incremental": true' \
+  '"https://sourcemeta.com/example/schemas/broken": ' \
+  '"https://sourcemeta.com/example/schemas/missing": "new"'
+do
+  if ! grep -qF "$expected" "$TMP/report.json"
+  then
+    echo "Missing from the second report: $expected" 1>&2
+    cat "$TMP/report.json" 1>&2
+    exit 1
+  fi
+done
+
+if grep -qF 'https://sourcemeta.com/example/schemas/good' "$TMP/report.json"
+then
+  echo "The schema that built the first time was built again" 1>&2
+  cat "$TMP/report.json" 1>&2
+  exit 1
+fi
+
+test -f "$TMP/output/schemas/example/schemas/broken/%/bundle.metapack"
@@ -0,0 +1,77 @@
+#!/bin/sh
+
+# A build kept under a memory budget it cannot possibly meet spills its state
+# again and again, and still ends up with the same artifacts and a state that
+# the next build can plan from
+
+set -o errexit
+set -o nounset
+
+TMP="$(mktemp -d)"
+clean() { rm -rf "$TMP"; }
+trap clean EXIT
+
+cat << EOF > "$TMP/one.json"
+{
+  "url": "https://sourcemeta.com",
+  "contents": {
+    "example": {
+      "contents": {
+        "schemas": {
+          "baseUri": "https://example.com/",
+          "path": "./schemas"
+        }
+      }
+    }
+  }
+}
+EOF
+
+mkdir -p "$TMP/schemas"
+
+for name in one two three four five six
+do
+  cat << EOF > "$TMP/schemas/$name.json"
+{
+  "\$schema": "http://json-schema.org/draft-07/schema#",
+  "\$id": "https://example.com/$name",
+  "properties": {
+    "value": { "\$ref": "https://example.com/one" }
+  }
+}
+EOF
+done
+
+"$1" --skip-banner --memory-budget 1 --concurrency 1 \
+  "$TMP/one.json" "$TMP/output" > "$TMP/log.txt" 2>&1
+grep -q ' to stay within 1 MiB of memory$' "$TMP/log.txt"
+
+# Staying over the budget whatever it lets go of, it looks again less and less
+# often rather than every few actions, and only spills once there is more to
+# spill than there was spilled before. A build of this catalog commits around
+# a thousand artifacts, which would be fifteen releases every 64 of them
+RELEASES="$(sed -n 's/^Released memory \([0-9]*\) times.*$/\1/p' \
+  "$TMP/log.txt")"
+SPILLS="$(sed -n 's/^.*spilling the build state \([0-9]*\) times.*$/\1/p' \
+  "$TMP/log.txt")"
+test "$RELEASES" -ge 1
+test "$RELEASES" -le 6
+test "$SPILLS" -ge 1
+test "$SPILLS" -le "$RELEASES"
+test ! -e "$TMP/output/state.spill"
+
+"$1" --skip-banner "$TMP/one.json" "$TMP/plain" > /dev/null 2>&1
+(cd "$TMP/output" && find . -type f ! -name 'state.bin' | LC_ALL=C sort) \
+  > "$TMP/budget.txt"
+(cd "$TMP/plain" && find . -type f ! -name 'state.bin' | LC_ALL=C sort) \
+  > "$TMP/plain.txt"
+diff "$TMP/budget.txt" "$TMP/plain.txt"
+
+# The state it saved is as good as any other for planning the next build
+"$1" --skip-banner --memory-budget 1 "$TMP/one.json" "$TMP/output" \
+  > "$TMP/log.txt" 2>&1
+if grep -q 'Producing:\|Combining:' "$TMP/log.txt"
+then
+  cat "$TMP/log.txt"
+  exit 1
+fi
@@ -0,0 +1,93 @@
+#!/bin/sh
+
+# Publishing lays the output out as a generation and points a link at it. An
+# artifact that a rebuild did not touch is the very same file in both
+# generations, and the generation no server holds any longer is removed
+
+set -o errexit
+set -o nounset
+
+TMP="$(mktemp -d)"
+clean() { rm -rf "$TMP"; }
+trap clean EXIT
+
+cat << EOF > "$TMP/one.json"
+{
+  "url": "https://sourcemeta.com",
+  "contents": {
+    "example": {
+      "contents": {
+        "schemas": {
+          "baseUri": "https://example.com/",
+          "path": "./schemas"
+        }
+      }
+    }
+  }
+}
+EOF
+
+mkdir -p "$TMP/schemas"
+
+cat << 'EOF' > "$TMP/schemas/foo.json"
+{
+  "$schema": "http://json-schema.org/draft-07/schema#",
+  "$id": "https://example.com/foo",
+  "type": "string"
+}
+EOF
+
+cat << 'EOF' > "$TMP/schemas/bar.json"
+{
+  "$schema": "http://json-schema.org/draft-07/schema#",
+  "$id": "https://example.com/bar",
+  "type": "integer"
+}
+EOF
+
+"$1" --skip-banner --publish "$TMP/publish" "$TMP/one.json" "$TMP/output" \
+  > "$TMP/log.txt" 2>&1
+grep -q '^Published generation: .* (0 of [1-9][0-9]* files unchanged, 0 generations collected)$' \
+  "$TMP/log.txt"
+test -L "$TMP/publish/current"
+test -f "$TMP/publish/current/routes.bin"
+test -f "$TMP/publish/current/generation.lock"
+test ! -e "$TMP/publish/current/state.bin"
+FIRST="$(readlink "$TMP/publish/current")"
+FOO="schemas/example/schemas/foo/%/schema.metapack"
+BAR="schemas/example/schemas/bar/%/schema.metapack"
+FOO_INODE="$(stat -c %i "$TMP/publish/current/$FOO")"
+BAR_INODE="$(stat -c %i "$TMP/publish/current/$BAR")"
+
+cat << 'EOF' > "$TMP/schemas/bar.json"
+{
+  "$schema": "http://json-schema.org/draft-07/schema#",
+  "$id": "https://example.com/bar",
+  "type": "boolean"
+}
+EOF
+
+"$1" --skip-banner --publish "$TMP/publish" "$TMP/one.json" "$TMP/output" \
+  > "$TMP/log.txt" 2>&1
+grep -q '^Published generation: .* ([1-9][0-9]* of [1-9][0-9]* files unchanged, 1 generations collected)$' \
+  "$TMP/log.txt"
+test "$(readlink "$TMP/publish/current")" != "$FIRST"
+test ! -e "$TMP/publish/$FIRST"
+test "$(ls "$TMP/publish/generations" | wc -l)" = "1"
+test "$(stat -c %i "$TMP/publish/current/$FOO")" = "$FOO_INODE"
+test "$(stat -c %i "$TMP/publish/current/$BAR")" != "$BAR_INODE"
+
+# A configuration change regenerates the routes, which the published
+# generation shares with the output until then, and which a running server has
+# mapped. The output gets a new file rather than the same one rewritten
+ROUTES_INODE="$(stat -c %i "$TMP/publish/current/routes.bin")"
+cp "$TMP/publish/current/routes.bin" "$TMP/routes.bin"
+sed 's|"https://sourcemeta.com"|"https://sourcemeta.com/registry"|' \
+  "$TMP/one.json" > "$TMP/one.json.next"
+mv "$TMP/one.json.next" "$TMP/one.json"
+"$1" --skip-banner "$TMP/one.json" "$TMP/output" > "$TMP/log.txt" 2>&1
+if cmp -s "$TMP/output/routes.bin" "$TMP/routes.bin"; then
+  exit 1
+fi
+test "$(stat -c %i "$TMP/publish/current/routes.bin")" = "$ROUTES_INODE"
+cmp "$TMP/publish/current/routes.bin" "$TMP/routes.bin"
@@ -0,0 +1,78 @@
+#!/bin/sh
+
+# Shards kept under a memory budget run at once over the same output, so each
+# spills its state somewhere of its own rather than into, or out from under,
+# the others
+
+set -o errexit
+set -o nounset
+
+TMP="$(mktemp -d)"
+clean() { rm -rf "$TMP"; }
+trap clean EXIT
+
+cat << EOF > "$TMP/one.json"
+{
+  "url": "https://sourcemeta.com",
+  "contents": {
+    "example": {
+      "contents": {
+        "schemas": {
+          "baseUri": "https://example.com/",
+          "path": "./schemas"
+        }
+      }
+    }
+  }
+}
+EOF
+
+mkdir -p "$TMP/schemas"
+
+index=1
+while [ "$index" -le 24 ]; do
+  cat << EOF > "$TMP/schemas/schema-$index.json"
+{
+  "\$schema": "http://json-schema.org/draft-07/schema#",
+  "\$id": "https://example.com/schema-$index",
+  "properties": {
+    "value": { "\$ref": "https://example.com/schema-1" }
+  }
+}
+EOF
+  index=$((index + 1))
+done
+
+list_artifacts() {
+  (cd "$1" && find . -type f ! -name 'state*.bin' | LC_ALL=C sort)
+}
+
+"$1" --skip-banner "$TMP/one.json" "$TMP/monolithic" > /dev/null 2>&1
+
+"$1" --skip-banner --memory-budget 1 --concurrency 1 --shard 0/3 \
+  "$TMP/one.json" "$TMP/sharded" > "$TMP/shard-0.txt" 2>&1 &
+FIRST="$!"
+"$1" --skip-banner --memory-budget 1 --concurrency 1 --shard 1/3 \
+  "$TMP/one.json" "$TMP/sharded" > "$TMP/shard-1.txt" 2>&1 &
+SECOND="$!"
+"$1" --skip-banner --memory-budget 1 --concurrency 1 --shard 2/3 \
+  "$TMP/one.json" "$TMP/sharded" > "$TMP/shard-2.txt" 2>&1 &
+THIRD="$!"
+wait "$FIRST"
+wait "$SECOND"
+wait "$THIRD"
+
+for shard in 0 1 2
+do
+  grep -q '^Released memory [1-9][0-9]* times' "$TMP/shard-$shard.txt"
+  test ! -e "$TMP/sharded/state.spill-$shard"
+done
+
+test ! -e "$TMP/sharded/state.spill"
+
+"$1" --skip-banner --merge-shards 3 "$TMP/one.json" "$TMP/sharded" \
+  > /dev/null 2>&1
+
+list_artifacts "$TMP/monolithic" > "$TMP/monolithic.txt"
+list_artifacts "$TMP/sharded" > "$TMP/sharded.txt"
+diff "$TMP/monolithic.txt" "$TMP/sharded.txt"
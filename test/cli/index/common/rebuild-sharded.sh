@@ -0,0 +1,111 @@
+#!/bin/sh
+
+# A build split across shards and merged must leave the same catalog as a build
+# of everything in one process, and a state that a later build of everything
+# agrees with, so that it finds nothing left to do.
+
+set -o errexit
+set -o nounset
+
+TMP="$(mktemp -d)"
+clean() { rm -rf "$TMP"; }
+trap clean EXIT
+
+cat << EOF > "$TMP/one.json"
+{
+  "url": "https://sourcemeta.com",
+  "contents": {
+    "example": {
+      "contents": {
+        "schemas": {
+          "baseUri": "https://example.com/",
+          "path": "./schemas"
+        }
+      }
+    }
+  }
+}
+EOF
+
+mkdir -p "$TMP/schemas/nested"
+
+cat << 'EOF' > "$TMP/schemas/common.json"
+{
+  "$schema": "http://json-schema.org/draft-07/schema#",
+  "$id": "https://example.com/common",
+  "type": "object"
+}
+EOF
+
+# Enough schemas that every shard owns some, each referencing one that most
+# likely belongs to another shard
+index=1
+while [ "$index" -le 12 ]; do
+  cat << EOF > "$TMP/schemas/nested/dependent-$index.json"
+{
+  "\$schema": "http://json-schema.org/draft-07/schema#",
+  "\$id": "https://example.com/nested/dependent-$index",
+  "properties": {
+    "value": { "\$ref": "https://example.com/common" }
+  }
+}
+EOF
+  index=$((index + 1))
+done
+
+list_artifacts() {
+  (cd "$1" && find . -type f ! -name 'state*.bin' | LC_ALL=C sort)
+}
+
+# A build of everything in one process
+"$1" --skip-banner "$TMP/one.json" "$TMP/monolithic" > /dev/null 2>&1
+
+# The same build split in three and merged
+"$1" --skip-banner --shard 0/3 "$TMP/one.json" "$TMP/sharded" \
+  > /dev/null 2>&1 &
+FIRST="$!"
+"$1" --skip-banner --shard 1/3 "$TMP/one.json" "$TMP/sharded" \
+  > /dev/null 2>&1 &
+SECOND="$!"
+"$1" --skip-banner --shard 2/3 "$TMP/one.json" "$TMP/sharded" \
+  > /dev/null 2>&1 &
+THIRD="$!"
+wait "$FIRST"
+wait "$SECOND"
+wait "$THIRD"
+
+test ! -f "$TMP/sharded/state.bin"
+
+"$1" --skip-banner --merge-shards 3 "$TMP/one.json" "$TMP/sharded" \
+  > /dev/null 2>&1
+
+# The partial states are gone once the merged state answers for them
+test ! -f "$TMP/sharded/state.shard-0.bin"
+test ! -f "$TMP/sharded/state.shard-1.bin"
+test ! -f "$TMP/sharded/state.shard-2.bin"
+test -f "$TMP/sharded/state.bin"
+
+list_artifacts "$TMP/monolithic" > "$TMP/monolithic.txt"
+list_artifacts "$TMP/sharded" > "$TMP/sharded.txt"
+diff "$TMP/monolithic.txt" "$TMP/sharded.txt"
+
+# The search index reads every listing, so it is only complete once every shard
+# is in
+extract_search_paths() {
+  strings "$1/explorer/public/%/search.metapack" \
+    | grep -oE '/example/[^[:space:]"]*' \
+    | sed 's|https*://.*$||' \
+    | LC_ALL=C sort -u
+}
+
+extract_search_paths "$TMP/monolithic" > "$TMP/monolithic-search.txt"
+extract_search_paths "$TMP/sharded" > "$TMP/sharded-search.txt"
+test "$(wc -l < "$TMP/sharded-search.txt")" -eq 13
+diff "$TMP/monolithic-search.txt" "$TMP/sharded-search.txt"
+
+# A build of everything over the merged output has nothing left to do
+"$1" --skip-banner "$TMP/one.json" "$TMP/sharded" > "$TMP/rebuild.txt" 2>&1
+if grep -q 'Producing:\|Combining:' "$TMP/rebuild.txt"; then
+  cat "$TMP/rebuild.txt"
+  exit 1
+fi
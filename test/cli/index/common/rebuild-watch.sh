@@ -0,0 +1,131 @@
+#!/bin/sh
+
+# A watching indexer must republish whatever a change to a schema reaches,
+# pick up schemas that appear and drop the ones that go away, all without being
+# started again
+
+set -o errexit
+set -o nounset
+
+if [ "$(uname)" != "Linux" ]
+then
+  exit 0
+fi
+
+TMP="$(mktemp -d)"
+PID=""
+clean() {
+  if [ -n "$PID" ]; then kill "$PID" 2> /dev/null || true; fi
+  rm -rf "$TMP"
+}
+trap clean EXIT
+
+cat << EOF > "$TMP/one.json"
+{
+  "url": "https://sourcemeta.com",
+  "contents": {
+    "example": {
+      "contents": {
+        "schemas": {
+          "baseUri": "https://example.com/",
+          "path": "./schemas"
+        }
+      }
+    }
+  }
+}
+EOF
+
+mkdir -p "$TMP/schemas"
+
+cat << 'EOF' > "$TMP/schemas/common.json"
+{
+  "$schema": "http://json-schema.org/draft-07/schema#",
+  "$id": "https://example.com/common",
+  "type": "object"
+}
+EOF
+
+cat << 'EOF' > "$TMP/schemas/dependent.json"
+{
+  "$schema": "http://json-schema.org/draft-07/schema#",
+  "$id": "https://example.com/dependent",
+  "properties": {
+    "value": { "$ref": "https://example.com/common" }
+  }
+}
+EOF
+
+"$1" --skip-banner --watch "$TMP/one.json" "$TMP/output" \
+  > "$TMP/log.txt" 2>&1 &
+PID="$!"
+
+# Until the indexer went back to watching as many times as given
+wait_for_builds() {
+  for attempt in $(seq 1 100)
+  do
+    if [ "$(grep -c '^Watching for changes\.\.\.$' "$TMP/log.txt")" -ge "$1" ]
+    then
+      return 0
+    fi
+
+    sleep 0.1
+  done
+
+  cat "$TMP/log.txt"
+  exit 1
+}
+
+ARTIFACTS="$TMP/output/schemas/example/schemas"
+
+wait_for_builds 1
+test -f "$ARTIFACTS/common/%/schema.metapack"
+cp "$ARTIFACTS/dependent/%/bundle.metapack" "$TMP/bundle.metapack"
+
+# A change reaches the schemas that reference the one that changed
+cat << 'EOF' > "$TMP/schemas/common.json"
+{
+  "$schema": "http://json-schema.org/draft-07/schema#",
+  "$id": "https://example.com/common",
+  "type": "string"
+}
+EOF
+
+wait_for_builds 2
+if cmp -s "$TMP/bundle.metapack" "$ARTIFACTS/dependent/%/bundle.metapack"
+then
+  cat "$TMP/log.txt"
+  exit 1
+fi
+
+# A schema in a directory that did not exist when watching started
+mkdir -p "$TMP/schemas/nested"
+cat << 'EOF' > "$TMP/schemas/nested/extra.json"
+{
+  "$schema": "http://json-schema.org/draft-07/schema#",
+  "$id": "https://example.com/nested/extra",
+  "type": "number"
+}
+EOF
+
+for attempt in $(seq 1 100)
+do
+  if [ -f "$ARTIFACTS/nested/extra/%/schema.metapack" ]; then break; fi
+  sleep 0.1
+done
+
+test -f "$ARTIFACTS/nested/extra/%/schema.metapack"
+
+# A schema that goes away takes its artifacts with it
+rm "$TMP/schemas/dependent.json"
+for attempt in $(seq 1 100)
+do
+  if [ ! -d "$ARTIFACTS/dependent" ]; then break; fi
+  sleep 0.1
+done
+
+if [ -d "$ARTIFACTS/dependent" ]
+then
+  cat "$TMP/log.txt"
+  exit 1
+fi
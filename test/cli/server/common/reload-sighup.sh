@@ -0,0 +1,108 @@
+#!/bin/sh
+
+# A server sent SIGHUP answers from the generation the link names by then, and
+# lets go of the one before as soon as nothing in flight needs it, even while
+# its workers sit idle
+
+set -o errexit
+set -o nounset
+
+BINARY="$1"
+INDEXER="$2"
+
+TMP="$(mktemp -d)"
+clean() {
+  if [ -n "${SERVER_PID:-}" ] && kill -0 "$SERVER_PID" 2>/dev/null; then
+    kill -KILL "$SERVER_PID" 2>/dev/null || true
+  fi
+  rm -rf "$TMP"
+}
+trap clean EXIT
+
+PORT="$(awk 'BEGIN { srand('"$$"'); print 49152 + int(rand() * 16383) }')"
+
+cat << EOF > "$TMP/one.json"
+{
+  "url": "http://localhost:$PORT",
+  "contents": {
+    "example": {
+      "contents": {
+        "schemas": {
+          "baseUri": "https://example.com/",
+          "path": "./schemas"
+        }
+      }
+    }
+  }
+}
+EOF
+
+mkdir -p "$TMP/schemas"
+
+cat << 'EOF' > "$TMP/schemas/foo.json"
+{
+  "$schema": "http://json-schema.org/draft-07/schema#",
+  "$id": "https://example.com/foo",
+  "type": "string"
+}
+EOF
+
+"$INDEXER" --skip-banner --publish "$TMP/publish" "$TMP/one.json" \
+  "$TMP/output" > "$TMP/index.txt" 2>&1
+
+"$BINARY" "$TMP/publish/current" "$PORT" > "$TMP/log.txt" 2>&1 &
+SERVER_PID="$!"
+
+wait_for() {
+  WAITED=0
+  until grep -q "$1" "$TMP/log.txt" 2>/dev/null; do
+    WAITED=$((WAITED + 1))
+    if [ "$WAITED" -gt 50 ]; then
+      cat "$TMP/log.txt" >&2
+      exit 1
+    fi
+    sleep 0.1
+  done
+}
+
+status() {
+  curl --silent --output /dev/null --write-out '%{http_code}' \
+    "http://localhost:$PORT/example/schemas/$1.json"
+}
+
+wait_for "Listening on port"
+test "$(status foo)" = "200"
+test "$(status bar)" = "404"
+
+cat << 'EOF' > "$TMP/schemas/bar.json"
+{
+  "$schema": "http://json-schema.org/draft-07/schema#",
+  "$id": "https://example.com/bar",
+  "type": "integer"
+}
+EOF
+
+# The server still holds the first generation, so nothing is collected
+"$INDEXER" --skip-banner --publish "$TMP/publish" "$TMP/one.json" \
+  "$TMP/output" > "$TMP/index.txt" 2>&1
+grep -q ', 0 generations collected)$' "$TMP/index.txt"
+test "$(status bar)" = "404"
+
+kill -HUP "$SERVER_PID"
+wait_for "Reloaded the output in"
+test "$(status foo)" = "200"
+test "$(status bar)" = "200"
+
+# Only the generation being served is held now, so the first one goes
+"$INDEXER" --skip-banner --publish "$TMP/publish" "$TMP/one.json" \
+  "$TMP/output" > "$TMP/index.txt" 2>&1
+grep -q ', 1 generations collected)$' "$TMP/index.txt" || {
+  cat "$TMP/index.txt" >&2
+  exit 1
+}
+test "$(ls "$TMP/publish/generations" | wc -l)" = "2"
+
+kill -TERM "$SERVER_PID"
+wait "$SERVER_PID" && CODE="$?" || CODE="$?"
+SERVER_PID=""
+test "$CODE" = "0" || { cat "$TMP/log.txt" >&2; exit 1; }
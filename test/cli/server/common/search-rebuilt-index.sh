@@ -0,0 +1,94 @@
+#!/bin/sh
+
+# A search answered before the output is rebuilt underneath a running server is
+# not answered the same afterwards, whether from the cache or by revalidating
+
+set -o errexit
+set -o nounset
+
+BINARY="$1"
+INDEXER="$2"
+
+TMP="$(mktemp -d)"
+clean() {
+  if [ -n "${SERVER_PID:-}" ] && kill -0 "$SERVER_PID" 2>/dev/null; then
+    kill -KILL "$SERVER_PID" 2>/dev/null || true
+  fi
+  rm -rf "$TMP"
+}
+trap clean EXIT
+
+PORT="$(awk 'BEGIN { srand('"$$"'); print 49152 + int(rand() * 16383) }')"
+
+cat << EOF > "$TMP/one.json"
+{
+  "url": "http://localhost:$PORT",
+  "contents": {
+    "example": {
+      "contents": {
+        "schemas": {
+          "baseUri": "https://example.com/",
+          "path": "./schemas"
+        }
+      }
+    }
+  }
+}
+EOF
+
+mkdir -p "$TMP/schemas"
+
+cat << 'EOF' > "$TMP/schemas/foo.json"
+{
+  "$schema": "http://json-schema.org/draft-07/schema#",
+  "$id": "https://example.com/foo",
+  "type": "string"
+}
+EOF
+
+"$INDEXER" --skip-banner "$TMP/one.json" "$TMP/output" > "$TMP/index.txt" 2>&1
+
+"$BINARY" "$TMP/output" "$PORT" > "$TMP/log.txt" 2>&1 &
+SERVER_PID="$!"
+
+WAITED=0
+until grep -q "Listening on port" "$TMP/log.txt" 2>/dev/null; do
+  WAITED=$((WAITED + 1))
+  if [ "$WAITED" -gt 50 ]; then
+    cat "$TMP/log.txt" >&2
+    exit 1
+  fi
+  sleep 0.1
+done
+
+URL="http://localhost:$PORT/self/v1/api/schemas/search?q=example"
+curl --silent --fail --dump-header "$TMP/headers.txt" "$URL" > "$TMP/before.json"
+grep -q '/example/schemas/foo' "$TMP/before.json"
+if grep -q '/example/schemas/bar' "$TMP/before.json"; then
+  exit 1
+fi
+ETAG="$(grep -i '^etag:' "$TMP/headers.txt" | cut -d ' ' -f 2 | tr -d '\r')"
+test -n "$ETAG"
+
+cat << 'EOF' > "$TMP/schemas/bar.json"
+{
+  "$schema": "http://json-schema.org/draft-07/schema#",
+  "$id": "https://example.com/bar",
+  "type": "integer"
+}
+EOF
+
+"$INDEXER" --skip-banner "$TMP/one.json" "$TMP/output" > "$TMP/index.txt" 2>&1
+
+# The same search again, which was cached
+curl --silent --fail "$URL" > "$TMP/after.json"
+grep -q '/example/schemas/bar' "$TMP/after.json"
+
+# A client revalidating what it was answered before gets the new answer
+test "$(curl --silent --output /dev/null --write-out '%{http_code}' \
+  --header "If-None-Match: $ETAG" "$URL")" = "200"
+
+kill -TERM "$SERVER_PID"
+wait "$SERVER_PID" && CODE="$?" || CODE="$?"
+SERVER_PID=""
+test "$CODE" = "0" || { cat "$TMP/log.txt" >&2; exit 1; }
@@ -147,6 +147,13 @@ TEST(mcp_v1) {
       std::string_view{"Handle Model Context Protocol JSON-RPC requests"});
 }
 
+TEST(metrics_v1) {
+  EXPECT_EQ(sourcemeta::one::action_description(
+                sourcemeta::one::ACTION_TYPE_METRICS_V1),
+            std::string_view{
+                "Report the server's metrics in the Prometheus text format"});
+}
+
 TEST(every_action_has_a_non_empty_description) {
   for (sourcemeta::core::URITemplateRouter::Identifier context{0};
        context < sourcemeta::one::ACTION_TYPE_COUNT; ++context) {
@@ -0,0 +1,127 @@
+#include <sourcemeta/core/test.h>
+#include <sourcemeta/one/build.h>
+
+#include <sourcemeta/core/io.h>
+
+#include <filesystem> // std::filesystem::path
+#include <fstream>    // std::ofstream
+#include <string>     // std::string
+
+static auto cache_path(const std::string &name) -> std::filesystem::path {
+  return std::filesystem::path{BINARY_DIRECTORY} / "cache" / name;
+}
+
+static auto write_text(const std::filesystem::path &path,
+                       const std::string &contents) -> void {
+  std::filesystem::create_directories(path.parent_path());
+  std::ofstream stream{path};
+  stream << contents;
+}
+
+TEST(directory_fetch_unknown_key) {
+  const auto root{cache_path("unknown")};
+  std::filesystem::remove_all(root);
+  sourcemeta::one::BuildCacheDirectory cache{root};
+  const auto destination{root.parent_path() / "unknown-output" / "artifact"};
+  EXPECT_FALSE(cache.fetch("0123456789abcdef", destination));
+  EXPECT_FALSE(std::filesystem::exists(destination));
+}
+
+TEST(directory_store_then_fetch) {
+  const auto root{cache_path("round-trip")};
+  std::filesystem::remove_all(root);
+  const auto output{root.parent_path() / "round-trip-output"};
+  std::filesystem::remove_all(output);
+  write_text(output / "first" / "artifact", "contents");
+
+  sourcemeta::one::BuildCacheDirectory cache{root};
+  cache.store("0123456789abcdef", output / "first" / "artifact");
+
+  const auto destination{output / "second" / "nested" / "artifact"};
+  EXPECT_TRUE(cache.fetch("0123456789abcdef", destination));
+  EXPECT_EQ(sourcemeta::core::read_file_to_string(destination), "contents");
+}
+
+TEST(directory_fetch_replaces_destination) {
+  const auto root{cache_path("replace")};
+  std::filesystem::remove_all(root);
+  const auto output{root.parent_path() / "replace-output"};
+  std::filesystem::remove_all(output);
+  write_text(output / "source", "new");
+  write_text(output / "destination", "old");
+
+  sourcemeta::one::BuildCacheDirectory cache{root};
+  cache.store("0123456789abcdef", output / "source");
+  EXPECT_TRUE(cache.fetch("0123456789abcdef", output / "destination"));
+  EXPECT_EQ(sourcemeta::core::read_file_to_string(output / "destination"),
+            "new");
+}
+
+TEST(directory_store_keeps_first_contents) {
+  const auto root{cache_path("first-wins")};
+  std::filesystem::remove_all(root);
+  const auto output{root.parent_path() / "first-wins-output"};
+  std::filesystem::remove_all(output);
+  write_text(output / "first", "first");
+  write_text(output / "second", "second");
+
+  sourcemeta::one::BuildCacheDirectory cache{root};
+  cache.store("0123456789abcdef", output / "first");
+  cache.store("0123456789abcdef", output / "second");
+  EXPECT_TRUE(cache.fetch("0123456789abcdef", output / "fetched"));
+  EXPECT_EQ(sourcemeta::core::read_file_to_string(output / "fetched"),
+            "first");
+}
+
+TEST(directory_stored_artifact_outlives_source) {
+  const auto root{cache_path("outlives")};
+  std::filesystem::remove_all(root);
+  const auto output{root.parent_path() / "outlives-output"};
+  std::filesystem::remove_all(output);
+  write_text(output / "artifact", "contents");
+
+  sourcemeta::one::BuildCacheDirectory cache{root};
+  cache.store("0123456789abcdef", output / "artifact");
+  std::filesystem::remove_all(output);
+  EXPECT_TRUE(cache.fetch("0123456789abcdef", output / "artifact"));
+  EXPECT_EQ(sourcemeta::core::read_file_to_string(output / "artifact"),
+            "contents");
+}
+
+TEST(directory_read_unknown_record) {
+  const auto root{cache_path("unknown-record")};
+  std::filesystem::remove_all(root);
+  sourcemeta::one::BuildCacheDirectory cache{root};
+  EXPECT_FALSE(cache.read("0123456789abcdef").has_value());
+}
+
+TEST(directory_write_then_read_record) {
+  const auto root{cache_path("record")};
+  std::filesystem::remove_all(root);
+  sourcemeta::one::BuildCacheDirectory cache{root};
+  cache.write("0123456789abcdef", "first\nsecond\n");
+  const auto record{cache.read("0123456789abcdef")};
+  EXPECT_TRUE(record.has_value());
+  EXPECT_EQ(record.value(), "first\nsecond\n");
+
+  cache.write("0123456789abcdef", "third\n");
+  EXPECT_EQ(cache.read("0123456789abcdef").value(), "third\n");
+}
+
+TEST(directory_shared_across_instances) {
+  const auto root{cache_path("shared")};
+  std::filesystem::remove_all(root);
+  const auto output{root.parent_path() / "shared-output"};
+  std::filesystem::remove_all(output);
+  write_text(output / "artifact", "contents");
+
+  {
+    sourcemeta::one::BuildCacheDirectory cache{root};
+    cache.store("0123456789abcdef", output / "artifact");
+    cache.write("fedcba9876543210", "record");
+  }
+
+  sourcemeta::one::BuildCacheDirectory cache{root};
+  EXPECT_TRUE(cache.fetch("0123456789abcdef", output / "fetched"));
+  EXPECT_EQ(cache.read("fedcba9876543210").value(), "record");
+}
@@ -5,9 +5,13 @@
 #include "build_test_utils.h"
 #include "test_rules.h"
 
-#include <array>      // std::array
-#include <filesystem> // std::filesystem::path
-#include <string>     // std::string
+#include <array>       // std::array
+#include <cstddef>     // std::size_t
+#include <filesystem>  // std::filesystem::path
+#include <string>      // std::string, std::to_string
+#include <string_view> // std::string_view
+#include <utility>     // std::pair
+#include <vector>      // std::vector
 
 // A build of one unchanging configuration and version
 static constexpr sourcemeta::one::BuildState::InputsFingerprint INPUTS{
@@ -637,6 +641,170 @@ TEST(incremental_only_the_new_leaf_is_built_beside_an_unchanged_one) {
       output / "secondary" / "public" / "%" / "listing.bin");
 }
 
+TEST(incremental_reasons_name_why_each_leaf_is_rebuilt) {
+  const auto output{delta_path("reasons")};
+  WRITE_GLOBAL_OUTPUTS(output);
+  sourcemeta::one::BuildState entries;
+  const TestLeaves schemas{
+      {"https://example.com/foo", "/src/foo.json", "foo", MTIME(100)},
+      {"https://example.com/bar", "/src/bar.json", "bar", MTIME(200)},
+      {"https://example.com/baz", "/src/baz.json", "baz", MTIME(200)}};
+  ADD_LEAF_ENTRIES(entries, output, "foo", true, MTIME(150));
+  ADD_LEAF_ENTRIES(entries, output, "baz", true, MTIME(150));
+  ADD_GLOBAL_ENTRIES(entries, output, MTIME(150));
+  entries.emplace(output / "secondary" / "public" / "%" / "listing.bin",
+                  {.file_mark = MTIME(150), .dependencies = {}});
+
+  entries.configure(test_rules::RULES.leaves, test_rules::RULES.directories,
+                    sourcemeta::one::rules_fingerprint<test_rules::RULES>(),
+                    INPUTS, test_rules::RULES.sentinel);
+  const auto plan{sourcemeta::one::delta<test_rules::RULES>(
+      sourcemeta::one::BuildPhase::Produce, test_rules::MODE_FULL, entries,
+      output, schemas, "1.0.0", true, "", "Full", {}, VIEWS, everything())};
+
+  // The leaf nothing happened to is not a reason for anything
+  EXPECT_EQ(plan.reasons.size(), 2);
+  EXPECT_EQ(plan.reasons.at(0).first, "https://example.com/bar");
+  EXPECT_TRUE(plan.reasons.at(0).second ==
+              sourcemeta::one::BuildPlan::Reason::New);
+  EXPECT_EQ(plan.reasons.at(1).first, "https://example.com/baz");
+  EXPECT_TRUE(plan.reasons.at(1).second ==
+              sourcemeta::one::BuildPlan::Reason::Modified);
+}
+
+TEST(incremental_plan_is_the_same_whatever_the_concurrency) {
+  const auto output{delta_path("concurrency")};
+  WRITE_GLOBAL_OUTPUTS(output);
+  sourcemeta::one::BuildState entries;
+  ADD_GLOBAL_ENTRIES(entries, output, MTIME(150));
+  entries.emplace(output / "secondary" / "public" / "%" / "listing.bin",
+                  {.file_mark = MTIME(150), .dependencies = {}});
+
+  // Enough leaves to be planned in several runs, with every reason a leaf can
+  // have for being rebuilt spread across all of them
+  std::vector<TestLeafEntry> storage;
+  constexpr std::size_t LEAVES{1500};
+  storage.reserve(LEAVES);
+  for (std::size_t index{0}; index < LEAVES; index++) {
+    const auto name{"leaf" + std::to_string(index)};
+    storage.push_back({.identifier = "https://example.com/" + name,
+                       .path = "/src/" + name + ".json",
+                       .relative_path = name,
+                       .mtime = MTIME(index % 5 == 0 ? 200 : 100),
+                       .evaluate = index % 7 != 0});
+    if (index % 3 != 0) {
+      ADD_LEAF_ENTRIES(entries, output, name, index % 7 != 0, MTIME(150));
+    }
+  }
+
+  std::vector<std::pair<std::string_view, sourcemeta::one::LeafView>> views;
+  views.reserve(storage.size());
+  for (const auto &entry : storage) {
+    views.emplace_back(
+        entry.identifier,
+        sourcemeta::one::LeafView{.path = &entry.path,
+                                  .relative_path = &entry.relative_path,
+                                  .mtime = entry.mtime,
+                                  .evaluate = entry.evaluate});
+  }
+
+  entries.configure(test_rules::RULES.leaves, test_rules::RULES.directories,
+                    sourcemeta::one::rules_fingerprint<test_rules::RULES>(),
+                    INPUTS, test_rules::RULES.sentinel);
+  const sourcemeta::one::LeafSet leaves{views};
+  const auto sequential{sourcemeta::one::delta<test_rules::RULES>(
+      sourcemeta::one::BuildPhase::Produce, test_rules::MODE_FULL, entries,
+      output, leaves, "1.0.0", true, "", "Full", {}, VIEWS, everything(), 1)};
+  const auto parallel{sourcemeta::one::delta<test_rules::RULES>(
+      sourcemeta::one::BuildPhase::Produce, test_rules::MODE_FULL, entries,
+      output, leaves, "1.0.0", true, "", "Full", {}, VIEWS, everything(), 4)};
+
+  EXPECT_EQ(parallel.size, sequential.size);
+  EXPECT_EQ(parallel.waves.size(), sequential.waves.size());
+  for (std::size_t wave{0}; wave < sequential.waves.size(); wave++) {
+    EXPECT_EQ(parallel.waves[wave].size(), sequential.waves[wave].size());
+    for (std::size_t action{0}; action < sequential.waves[wave].size();
+         action++) {
+      const auto &left{sequential.waves[wave][action]};
+      const auto &right{parallel.waves[wave][action]};
+      EXPECT_EQ(right.type, left.type);
+      EXPECT_EQ(right.destination, left.destination);
+      EXPECT_EQ(right.data, left.data);
+      EXPECT_EQ(right.dependencies, left.dependencies);
+    }
+  }
+
+  // In the order the leaves came in, as a report reads them
+  EXPECT_EQ(parallel.reasons.size(), sequential.reasons.size());
+  for (std::size_t index{0}; index < sequential.reasons.size(); index++) {
+    EXPECT_EQ(parallel.reasons[index].first, sequential.reasons[index].first);
+    EXPECT_TRUE(parallel.reasons[index].second ==
+                sequential.reasons[index].second);
+  }
+}
+
+TEST(incremental_recorded_leaves_are_not_proven_again) {
+  const auto output{delta_path("recorded_leaves")};
+  WRITE_GLOBAL_OUTPUTS(output);
+  const auto state{output / "state.bin"};
+  const TestLeaves schemas{
+      {"https://example.com/foo", "/src/foo.json", "foo", MTIME(100)}};
+
+  // A record of the leaf that says nothing was ever built for it. Only a
+  // planner that took the recorded digest at its word would leave it alone
+  sourcemeta::one::BuildState previous;
+  ADD_GLOBAL_ENTRIES(previous, output, MTIME(150));
+  previous.configure(test_rules::RULES.leaves, test_rules::RULES.directories,
+                     sourcemeta::one::rules_fingerprint<test_rules::RULES>(),
+                     INPUTS, test_rules::RULES.sentinel);
+  previous.record_leaves(
+      sourcemeta::one::leaf_set_digest(schemas, test_rules::MODE_FULL));
+  previous.save(state);
+
+  sourcemeta::one::BuildState entries;
+  entries.load(state, test_rules::RULES.leaves, test_rules::RULES.directories,
+               sourcemeta::one::rules_fingerprint<test_rules::RULES>(), INPUTS,
+               test_rules::RULES.sentinel);
+  const auto recorded{sourcemeta::one::delta<test_rules::RULES>(
+      sourcemeta::one::BuildPhase::Produce, test_rules::MODE_FULL, entries,
+      output, schemas, "1.0.0", true, "", "Full", {}, VIEWS, everything())};
+  EXPECT_EQ(recorded.size, 0);
+
+  // The same leaf touched since is a different set, which is proven as usual
+  const TestLeaves touched{
+      {"https://example.com/foo", "/src/foo.json", "foo", MTIME(101)}};
+  const auto proven{sourcemeta::one::delta<test_rules::RULES>(
+      sourcemeta::one::BuildPhase::Produce, test_rules::MODE_FULL, entries,
+      output, touched, "1.0.0", true, "", "Full", {}, VIEWS, everything())};
+  EXPECT_TRUE(proven.size > 0);
+}
+
+TEST(leaf_set_digest_does_not_depend_on_order) {
+  const TestLeaves forwards{
+      {"https://example.com/foo", "/src/foo.json", "foo", MTIME(100)},
+      {"https://example.com/bar", "/src/bar.json", "bar", MTIME(200)}};
+  const TestLeaves backwards{
+      {"https://example.com/bar", "/src/bar.json", "bar", MTIME(200)},
+      {"https://example.com/foo", "/src/foo.json", "foo", MTIME(100)}};
+  const TestLeaves headless{
+      {"https://example.com/foo", "/src/foo.json", "foo", MTIME(100), false},
+      {"https://example.com/bar", "/src/bar.json", "bar", MTIME(200)}};
+  const TestLeaves fewer{
+      {"https://example.com/foo", "/src/foo.json", "foo", MTIME(100)}};
+
+  const auto digest{
+      sourcemeta::one::leaf_set_digest(forwards, test_rules::MODE_FULL)};
+  EXPECT_TRUE(digest != 0);
+  EXPECT_EQ(digest,
+            sourcemeta::one::leaf_set_digest(backwards, test_rules::MODE_FULL));
+  EXPECT_TRUE(digest != sourcemeta::one::leaf_set_digest(
+                            headless, test_rules::MODE_FULL));
+  EXPECT_TRUE(digest !=
+              sourcemeta::one::leaf_set_digest(fewer, test_rules::MODE_FULL));
+  EXPECT_TRUE(digest != sourcemeta::one::leaf_set_digest(
+                            forwards, test_rules::MODE_HEADLESS));
+}
+
 TEST(incremental_missing_version_global_is_repaired) {
   const auto output{delta_path("missing_version")};
   WRITE_GLOBAL_OUTPUTS(output);
@@ -1,12 +1,17 @@
 #include <sourcemeta/core/test.h>
 #include <sourcemeta/one/build.h>
+#include <sourcemeta/one/metapack.h>
 
 #include "test_rules.h"
 
-#include <chrono>     // std::chrono::nanoseconds, std::chrono::duration_cast
-#include <cstdint>    // std::uint64_t
-#include <filesystem> // std::filesystem::path
+#include <chrono>     // std::chrono::nanoseconds, std::chrono::hours, etc
+#include <cstdint>    // std::uint32_t, std::uint64_t
+#include <filesystem> // std::filesystem
+#include <fstream>    // std::ofstream, std::fstream
+#include <ios>        // std::ios, std::streamoff, std::streamsize
+#include <iterator>   // std::distance
 #include <string>     // std::string
+#include <vector>     // std::vector
 
 // A build of one unchanging configuration and version
 static constexpr sourcemeta::one::BuildState::InputsFingerprint INPUTS{
@@ -92,6 +97,58 @@ TEST(a_state_is_not_built_from_inputs_it_never_saw) {
   EXPECT_TRUE(loaded_entries.contains("/output/schemas/foo/%/schema.metapack"));
 }
 
+TEST(a_state_keeps_the_leaves_it_recorded) {
+  const auto path{state_path("leaves_recorded")};
+  std::filesystem::create_directories(path.parent_path());
+
+  sourcemeta::one::BuildState original_entries;
+  original_entries.configure(
+      test_rules::RULES.leaves, test_rules::RULES.directories,
+      sourcemeta::one::rules_fingerprint<test_rules::RULES>(), INPUTS,
+      test_rules::RULES.sentinel);
+  EXPECT_EQ(original_entries.recorded_leaves(), 0);
+  original_entries.record_leaves(0x1122334455667788ULL);
+  original_entries.save(path);
+
+  sourcemeta::one::BuildState loaded_entries;
+  loaded_entries.load(path, test_rules::RULES.leaves,
+                      test_rules::RULES.directories,
+                      sourcemeta::one::rules_fingerprint<test_rules::RULES>(),
+                      INPUTS, test_rules::RULES.sentinel);
+  EXPECT_EQ(loaded_entries.recorded_leaves(), 0x1122334455667788ULL);
+}
+
+TEST(a_state_keeps_the_source_revisions_it_recorded) {
+  const auto path{state_path("source_revisions")};
+  std::filesystem::create_directories(path.parent_path());
+
+  const auto now{std::filesystem::file_time_type::clock::now()};
+  sourcemeta::one::BuildState original_entries;
+  original_entries.configure(
+      test_rules::RULES.leaves, test_rules::RULES.directories,
+      sourcemeta::one::rules_fingerprint<test_rules::RULES>(), INPUTS,
+      test_rules::RULES.sentinel);
+  original_entries.emplace("/output/schemas/foo/%/schema.metapack",
+                           {.file_mark = now, .dependencies = {}});
+  EXPECT_EQ(original_entries.source_revision("/schemas/a"), "");
+  original_entries.record_source_revision("/schemas/a", "1234abcd");
+  original_entries.record_source_revision("/schemas/b", "5678ef90");
+  original_entries.record_source_revision("/schemas/c", "deadbeef");
+  original_entries.record_source_revision("/schemas/c", "");
+  original_entries.save(path);
+
+  sourcemeta::one::BuildState loaded_entries;
+  loaded_entries.load(path, test_rules::RULES.leaves,
+                      test_rules::RULES.directories,
+                      sourcemeta::one::rules_fingerprint<test_rules::RULES>(),
+                      INPUTS, test_rules::RULES.sentinel);
+  EXPECT_EQ(loaded_entries.size(), 1);
+  EXPECT_TRUE(loaded_entries.contains("/output/schemas/foo/%/schema.metapack"));
+  EXPECT_EQ(loaded_entries.source_revision("/schemas/a"), "1234abcd");
+  EXPECT_EQ(loaded_entries.source_revision("/schemas/b"), "5678ef90");
+  EXPECT_EQ(loaded_entries.source_revision("/schemas/c"), "");
+}
+
 TEST(a_state_that_was_never_written_is_built_from_nothing) {
   // Nothing has finished here, so nothing beside it was derived from anything
   const auto path{state_path("inputs_absent")};
@@ -204,6 +261,145 @@ TEST(round_trip_with_dependencies) {
   EXPECT_EQ(result->dependencies[2], "/output/schemas/qux/%/schema.metapack");
 }
 
+TEST(dependencies_are_numbered_by_path) {
+  const auto path{state_path("numbered")};
+  std::filesystem::create_directories(path.parent_path());
+
+  const auto now{std::filesystem::file_time_type::clock::now()};
+  sourcemeta::one::BuildState original_entries;
+  original_entries.configure(
+      test_rules::RULES.leaves, test_rules::RULES.directories,
+      sourcemeta::one::rules_fingerprint<test_rules::RULES>(), INPUTS,
+      test_rules::RULES.sentinel);
+  original_entries.emplace(
+      "/output/schemas/foo/%/dependencies.metapack",
+      {.file_mark = now,
+       .dependencies = {"/output/schemas/bar/%/schema.metapack",
+                        "/output/schemas/baz/%/schema.metapack"}});
+  // Backwards through the dictionary, which is what the differences between
+  // consecutive identifiers have to survive
+  original_entries.emplace(
+      "/output/schemas/qux/%/dependencies.metapack",
+      {.file_mark = now,
+       .dependencies = {"/output/schemas/baz/%/schema.metapack",
+                        "/output/schemas/bar/%/schema.metapack"}});
+  original_entries.save(path);
+
+  sourcemeta::one::BuildState loaded_entries;
+  loaded_entries.load(path, test_rules::RULES.leaves,
+                      test_rules::RULES.directories,
+                      sourcemeta::one::rules_fingerprint<test_rules::RULES>(),
+                      INPUTS, test_rules::RULES.sentinel);
+  const auto foo{loaded_entries.dependency_ids(
+      "/output/schemas/foo/%/dependencies.metapack")};
+  const auto qux{loaded_entries.dependency_ids(
+      "/output/schemas/qux/%/dependencies.metapack")};
+  EXPECT_TRUE(foo.has_value());
+  EXPECT_TRUE(qux.has_value());
+  EXPECT_EQ(foo.value().size(), 2);
+  EXPECT_EQ(qux.value().size(), 2);
+  EXPECT_EQ(foo.value()[0], qux.value()[1]);
+  EXPECT_EQ(foo.value()[1], qux.value()[0]);
+  EXPECT_EQ(loaded_entries.path(foo.value()[0]),
+            "/output/schemas/bar/%/schema.metapack");
+  EXPECT_EQ(loaded_entries.path(qux.value()[0]),
+            "/output/schemas/baz/%/schema.metapack");
+  EXPECT_FALSE(loaded_entries.dependency_ids("/output/schemas/missing")
+                   .has_value());
+  EXPECT_FALSE(
+      loaded_entries.path_id("/output/schemas/foo/%/schema.metapack")
+          .has_value());
+
+  // What this build commits is numbered alongside what it loaded
+  loaded_entries.commit(
+      std::filesystem::path{"/output/schemas/baz/%/dependencies.metapack"},
+      {"/output/schemas/bar/%/schema.metapack",
+       "/output/schemas/new/%/schema.metapack"});
+  const auto baz{loaded_entries.dependency_ids(
+      "/output/schemas/baz/%/dependencies.metapack")};
+  EXPECT_TRUE(baz.has_value());
+  EXPECT_EQ(baz.value()[0], foo.value()[0]);
+  EXPECT_EQ(loaded_entries.path_id("/output/schemas/new/%/schema.metapack"),
+            baz.value()[1]);
+  loaded_entries.save(path);
+
+  sourcemeta::one::BuildState reloaded_entries;
+  reloaded_entries.load(path, test_rules::RULES.leaves,
+                        test_rules::RULES.directories,
+                        sourcemeta::one::rules_fingerprint<test_rules::RULES>(),
+                        INPUTS, test_rules::RULES.sentinel);
+  EXPECT_EQ(reloaded_entries.size(), 3);
+  const auto *result{
+      reloaded_entries.entry("/output/schemas/baz/%/dependencies.metapack")};
+  EXPECT_NE(result, nullptr);
+  EXPECT_EQ(result->dependencies.size(), 2);
+  EXPECT_EQ(result->dependencies[0], "/output/schemas/bar/%/schema.metapack");
+  EXPECT_EQ(result->dependencies[1], "/output/schemas/new/%/schema.metapack");
+  const auto *untouched{
+      reloaded_entries.entry("/output/schemas/qux/%/dependencies.metapack")};
+  EXPECT_NE(untouched, nullptr);
+  EXPECT_EQ(untouched->dependencies[0],
+            "/output/schemas/baz/%/schema.metapack");
+  EXPECT_EQ(untouched->dependencies[1],
+            "/output/schemas/bar/%/schema.metapack");
+}
+
+TEST(dependencies_out_of_bounds_make_the_state_unreadable) {
+  const auto path{state_path("dependencies_out_of_bounds")};
+  std::filesystem::create_directories(path.parent_path());
+
+  sourcemeta::one::BuildState original_entries;
+  original_entries.configure(
+      test_rules::RULES.leaves, test_rules::RULES.directories,
+      sourcemeta::one::rules_fingerprint<test_rules::RULES>(), INPUTS,
+      test_rules::RULES.sentinel);
+  original_entries.emplace(
+      "/output/schemas/foo/%/dependencies.metapack",
+      {.file_mark = std::filesystem::file_time_type::clock::now(),
+       .dependencies = {"/output/schemas/bar/%/schema.metapack"}});
+  original_entries.save(path);
+
+  // Every byte from where the dependencies start to the end of the pool is
+  // made to continue a varint, which then never ends within it
+  std::fstream file{path, std::ios::binary | std::ios::in | std::ios::out};
+  std::uint32_t capacity{0};
+  std::uint32_t pool_size{0};
+  file.seekg(20);
+  file.read(reinterpret_cast<char *>(&capacity), sizeof(capacity));
+  file.seekg(28);
+  file.read(reinterpret_cast<char *>(&pool_size), sizeof(pool_size));
+  const std::streamoff slots{52};
+  const auto pool{slots + static_cast<std::streamoff>(capacity) * 32};
+  for (std::uint32_t index = 0; index < capacity; ++index) {
+    const auto slot{slots + static_cast<std::streamoff>(index) * 32};
+    char occupied{0};
+    file.seekg(slot + 30);
+    file.read(&occupied, 1);
+    if (occupied == 0) {
+      continue;
+    }
+
+    std::uint32_t data_offset{0};
+    file.seekg(slot + 24);
+    file.read(reinterpret_cast<char *>(&data_offset), sizeof(data_offset));
+    file.seekp(pool + data_offset);
+    const std::string continued(pool_size - data_offset, '\xFF');
+    file.write(continued.data(),
+               static_cast<std::streamsize>(continued.size()));
+  }
+
+  file.close();
+
+  sourcemeta::one::BuildState loaded_entries;
+  loaded_entries.load(path, test_rules::RULES.leaves,
+                      test_rules::RULES.directories,
+                      sourcemeta::one::rules_fingerprint<test_rules::RULES>(),
+                      INPUTS, test_rules::RULES.sentinel);
+  EXPECT_TRUE(loaded_entries.empty());
+  EXPECT_EQ(loaded_entries.entry("/output/schemas/foo/%/dependencies.metapack"),
+            nullptr);
+}
+
 TEST(round_trip_multiple_entries) {
   const auto path{state_path("multiple")};
   std::filesystem::create_directories(path.parent_path());
@@ -266,3 +462,383 @@ TEST(forget_removes_children) {
   EXPECT_TRUE(entries.contains("/output/schemas/bar/%/schema.metapack"));
   EXPECT_TRUE(entries.contains("/output/configuration.json"));
 }
+
+TEST(absorb_takes_over_a_saved_shard) {
+  const auto path{state_path("absorb_shard")};
+  std::filesystem::create_directories(path.parent_path());
+
+  const auto mark{std::filesystem::file_time_type::clock::now() -
+                  std::chrono::hours{1}};
+  sourcemeta::one::BuildState shard;
+  shard.configure(test_rules::RULES.leaves, test_rules::RULES.directories,
+                  sourcemeta::one::rules_fingerprint<test_rules::RULES>(),
+                  INPUTS, test_rules::RULES.sentinel);
+  shard.emplace("/output/schemas/foo/%/dependencies.metapack",
+                {.file_mark = mark,
+                 .dependencies = {"/output/schemas/bar/%/schema.metapack"}});
+  shard.commit("/sources/foo.json",
+               sourcemeta::one::BuildState::ResolverEntry{
+                   .file_mark = mark,
+                   .new_identifier = "https://example.com/foo",
+                   .original_identifier = "https://example.com/foo",
+                   .dialect = "https://json-schema.org/draft/2020-12/schema",
+                   .relative_path = "foo"});
+  shard.save(path);
+
+  sourcemeta::one::BuildState loaded_shard;
+  loaded_shard.load(path, test_rules::RULES.leaves,
+                    test_rules::RULES.directories,
+                    sourcemeta::one::rules_fingerprint<test_rules::RULES>(),
+                    INPUTS, test_rules::RULES.sentinel);
+
+  sourcemeta::one::BuildState entries;
+  entries.configure(test_rules::RULES.leaves, test_rules::RULES.directories,
+                    sourcemeta::one::rules_fingerprint<test_rules::RULES>(),
+                    INPUTS, test_rules::RULES.sentinel);
+  entries.absorb(loaded_shard);
+
+  // Taken over as this build's own work, with the mark the shard gave it
+  EXPECT_EQ(entries.size(), 1);
+  EXPECT_TRUE(
+      entries.in_overlay("/output/schemas/foo/%/dependencies.metapack"));
+  const auto *result{
+      entries.entry("/output/schemas/foo/%/dependencies.metapack")};
+  EXPECT_NE(result, nullptr);
+  EXPECT_EQ(result->dependencies.size(), 1);
+  EXPECT_EQ(result->dependencies[0], "/output/schemas/bar/%/schema.metapack");
+  EXPECT_EQ(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                result->file_mark.time_since_epoch())
+                .count(),
+            std::chrono::duration_cast<std::chrono::nanoseconds>(
+                mark.time_since_epoch())
+                .count());
+
+  const auto *resolved{entries.resolve("/sources/foo.json", mark)};
+  EXPECT_NE(resolved, nullptr);
+  EXPECT_EQ(resolved->new_identifier, "https://example.com/foo");
+  EXPECT_EQ(resolved->relative_path, "foo");
+}
+
+TEST(absorb_committed_skips_what_was_loaded) {
+  const auto path{state_path("absorb_committed")};
+  std::filesystem::create_directories(path.parent_path());
+
+  const auto now{std::filesystem::file_time_type::clock::now()};
+  sourcemeta::one::BuildState previous;
+  previous.configure(test_rules::RULES.leaves, test_rules::RULES.directories,
+                     sourcemeta::one::rules_fingerprint<test_rules::RULES>(),
+                     INPUTS, test_rules::RULES.sentinel);
+  previous.emplace("/output/schemas/foo/%/schema.metapack",
+                   {.file_mark = now, .dependencies = {}});
+  previous.save(path);
+
+  sourcemeta::one::BuildState shard;
+  shard.load(path, test_rules::RULES.leaves, test_rules::RULES.directories,
+             sourcemeta::one::rules_fingerprint<test_rules::RULES>(), INPUTS,
+             test_rules::RULES.sentinel);
+  shard.commit(std::filesystem::path{"/output/schemas/bar/%/schema.metapack"},
+               std::vector<std::filesystem::path>{});
+
+  // What the shard planned against is the previous build's, not its own
+  sourcemeta::one::BuildState partial;
+  partial.configure(test_rules::RULES.leaves, test_rules::RULES.directories,
+                    sourcemeta::one::rules_fingerprint<test_rules::RULES>(),
+                    INPUTS, test_rules::RULES.sentinel);
+  partial.absorb_committed(shard);
+  EXPECT_EQ(partial.size(), 1);
+  EXPECT_TRUE(partial.contains("/output/schemas/bar/%/schema.metapack"));
+  EXPECT_FALSE(partial.contains("/output/schemas/foo/%/schema.metapack"));
+}
+
+TEST(spill_keeps_committed_entries_readable) {
+  const auto path{state_path("spill")};
+  const auto directory{state_path("spill-directory")};
+  std::filesystem::remove_all(directory);
+  std::filesystem::create_directories(path.parent_path());
+
+  const auto now{std::filesystem::file_time_type::clock::now()};
+  sourcemeta::one::BuildState entries;
+  entries.configure(test_rules::RULES.leaves, test_rules::RULES.directories,
+                    sourcemeta::one::rules_fingerprint<test_rules::RULES>(),
+                    INPUTS, test_rules::RULES.sentinel);
+  entries.emplace("/output/schemas/foo/%/dependencies.metapack",
+                  {.file_mark = now,
+                   .dependencies = {"/output/schemas/bar/%/schema.metapack"}});
+  entries.emplace("/output/schemas/bar/%/schema.metapack",
+                  {.file_mark = now, .dependencies = {}});
+  entries.spill(directory);
+
+  // Still this build's own work, only no longer in memory
+  EXPECT_EQ(entries.size(), 2);
+  EXPECT_EQ(entries.keys().size(), 2);
+  EXPECT_TRUE(
+      entries.in_overlay("/output/schemas/foo/%/dependencies.metapack"));
+  const auto *result{
+      entries.entry("/output/schemas/foo/%/dependencies.metapack")};
+  EXPECT_NE(result, nullptr);
+  EXPECT_EQ(result->dependencies.size(), 1);
+  EXPECT_EQ(result->dependencies[0], "/output/schemas/bar/%/schema.metapack");
+  EXPECT_FALSE(entries.is_stale("/output/schemas/bar/%/schema.metapack",
+                                now - std::chrono::hours{1}));
+
+  // Later spills carry the earlier ones along and leave a single file behind
+  entries.emplace("/output/schemas/baz/%/schema.metapack",
+                  {.file_mark = now, .dependencies = {}});
+  entries.emplace("/output/schemas/qux/%/schema.metapack",
+                  {.file_mark = now, .dependencies = {}});
+  entries.forget("/output/schemas/bar/%");
+  entries.spill(directory);
+  entries.trim();
+  EXPECT_EQ(entries.spills(), 2);
+  EXPECT_EQ(entries.size(), 3);
+  EXPECT_FALSE(entries.contains("/output/schemas/bar/%/schema.metapack"));
+  EXPECT_TRUE(entries.contains("/output/schemas/baz/%/schema.metapack"));
+  EXPECT_TRUE(entries.contains("/output/schemas/qux/%/schema.metapack"));
+  EXPECT_EQ(std::distance(std::filesystem::directory_iterator{directory},
+                          std::filesystem::directory_iterator{}),
+            1);
+
+  entries.save(path);
+  sourcemeta::one::BuildState loaded;
+  loaded.load(path, test_rules::RULES.leaves, test_rules::RULES.directories,
+              sourcemeta::one::rules_fingerprint<test_rules::RULES>(), INPUTS,
+              test_rules::RULES.sentinel);
+  EXPECT_EQ(loaded.size(), 3);
+  EXPECT_TRUE(loaded.contains("/output/schemas/foo/%/dependencies.metapack"));
+  EXPECT_TRUE(loaded.contains("/output/schemas/baz/%/schema.metapack"));
+  EXPECT_TRUE(loaded.contains("/output/schemas/qux/%/schema.metapack"));
+  EXPECT_FALSE(loaded.contains("/output/schemas/bar/%/schema.metapack"));
+}
+
+TEST(spill_waits_for_the_overlay_to_outgrow_what_was_spilled) {
+  const auto directory{state_path("spill-waits-directory")};
+  std::filesystem::remove_all(directory);
+
+  const auto now{std::filesystem::file_time_type::clock::now()};
+  sourcemeta::one::BuildState entries;
+  entries.configure(test_rules::RULES.leaves, test_rules::RULES.directories,
+                    sourcemeta::one::rules_fingerprint<test_rules::RULES>(),
+                    INPUTS, test_rules::RULES.sentinel);
+  entries.emplace("/output/schemas/foo/%/schema.metapack",
+                  {.file_mark = now, .dependencies = {}});
+  entries.emplace("/output/schemas/bar/%/schema.metapack",
+                  {.file_mark = now, .dependencies = {}});
+  entries.spill(directory);
+  EXPECT_EQ(entries.spills(), 1);
+
+  // Rewriting both spilled entries to move a single one out is not worth it
+  entries.emplace("/output/schemas/baz/%/schema.metapack",
+                  {.file_mark = now, .dependencies = {}});
+  entries.spill(directory);
+  EXPECT_EQ(entries.spills(), 1);
+  EXPECT_EQ(entries.size(), 3);
+  EXPECT_TRUE(entries.contains("/output/schemas/baz/%/schema.metapack"));
+
+  entries.emplace("/output/schemas/qux/%/schema.metapack",
+                  {.file_mark = now, .dependencies = {}});
+  entries.spill(directory);
+  EXPECT_EQ(entries.spills(), 2);
+  EXPECT_EQ(entries.size(), 4);
+  EXPECT_TRUE(entries.contains("/output/schemas/foo/%/schema.metapack"));
+  EXPECT_TRUE(entries.contains("/output/schemas/baz/%/schema.metapack"));
+}
+
+TEST(journal_resumes_what_a_build_never_saved) {
+  const auto directory{state_path("journal")};
+  std::filesystem::remove_all(directory);
+  std::filesystem::create_directories(directory);
+  const auto path{directory / "state.bin"};
+  const auto journal{directory / "state.journal"};
+  const auto built{directory / "built.metapack"};
+  std::ofstream{built} << "{}";
+
+  const auto mark{std::filesystem::file_time_type::clock::now()};
+  {
+    sourcemeta::one::BuildState entries;
+    entries.load(path, test_rules::RULES.leaves, test_rules::RULES.directories,
+                 sourcemeta::one::rules_fingerprint<test_rules::RULES>(),
+                 INPUTS, test_rules::RULES.sentinel);
+    EXPECT_EQ(entries.journal(journal), 0);
+    entries.commit(built, {"/sources/foo.json"});
+    // Committed, but whatever wrote it went with the process
+    entries.commit(directory / "lost.metapack", {});
+    entries.commit("/sources/foo.json",
+                   sourcemeta::one::BuildState::ResolverEntry{
+                       .file_mark = mark,
+                       .new_identifier = "https://example.com/foo",
+                       .original_identifier = "https://example.com/foo",
+                       .dialect = "https://json-schema.org/draft/2020-12/schema",
+                       .relative_path = "foo"});
+    // Never saved, as though the build died here
+  }
+
+  EXPECT_FALSE(std::filesystem::exists(path));
+  sourcemeta::one::BuildState entries;
+  entries.load(path, test_rules::RULES.leaves, test_rules::RULES.directories,
+               sourcemeta::one::rules_fingerprint<test_rules::RULES>(), INPUTS,
+               test_rules::RULES.sentinel);
+  EXPECT_FALSE(entries.built_from_these_inputs());
+  EXPECT_EQ(entries.journal(journal), 3);
+  EXPECT_TRUE(entries.built_from_these_inputs());
+  EXPECT_TRUE(entries.contains(built.native()));
+  EXPECT_FALSE(entries.contains((directory / "lost.metapack").native()));
+  EXPECT_TRUE(entries.in_overlay(built.native()));
+  const auto *resolved{entries.resolve("/sources/foo.json", mark)};
+  EXPECT_NE(resolved, nullptr);
+  EXPECT_EQ(resolved->new_identifier, "https://example.com/foo");
+
+  // The saved state answers for all of it from here on
+  entries.save(path);
+  entries.settle_journal();
+  EXPECT_FALSE(std::filesystem::exists(journal));
+}
+
+TEST(journal_does_not_vouch_for_an_artifact_it_did_not_commit) {
+  const auto directory{state_path("journal_torn")};
+  std::filesystem::remove_all(directory);
+  std::filesystem::create_directories(directory);
+  const auto path{directory / "state.bin"};
+  const auto journal{directory / "state.journal"};
+  const auto kept{directory / "kept.metapack"};
+  const auto torn{directory / "torn.metapack"};
+  std::ofstream{kept} << "{\"foo\":1}";
+  std::ofstream{torn} << "{\"foo\":1}";
+
+  {
+    sourcemeta::one::BuildState entries;
+    entries.load(path, test_rules::RULES.leaves, test_rules::RULES.directories,
+                 sourcemeta::one::rules_fingerprint<test_rules::RULES>(),
+                 INPUTS, test_rules::RULES.sentinel);
+    EXPECT_EQ(entries.journal(journal), 0);
+    entries.commit(kept, {});
+    entries.commit(torn, {});
+  }
+
+  // As a crash leaves an artifact whose contents never reached the disk,
+  // down to its size
+  std::ofstream{torn} << "{\"foo\":2}";
+
+  sourcemeta::one::BuildState entries;
+  entries.load(path, test_rules::RULES.leaves, test_rules::RULES.directories,
+               sourcemeta::one::rules_fingerprint<test_rules::RULES>(), INPUTS,
+               test_rules::RULES.sentinel);
+  EXPECT_EQ(entries.journal(journal), 2);
+  EXPECT_TRUE(entries.contains(kept.native()));
+  EXPECT_FALSE(entries.contains(torn.native()));
+}
+
+TEST(journal_seals_a_metapack_by_its_header) {
+  const auto directory{state_path("journal_metapack")};
+  std::filesystem::remove_all(directory);
+  std::filesystem::create_directories(directory);
+  const auto path{directory / "state.bin"};
+  const auto journal{directory / "state.journal"};
+  const auto kept{directory / "kept.metapack"};
+  const auto replaced{directory / "replaced.metapack"};
+  const auto document{sourcemeta::core::parse_json("{\"foo\":1}")};
+  sourcemeta::one::metapack_write_json(kept, document, "application/json",
+                                       sourcemeta::one::MetapackEncoding::GZIP,
+                                       {}, std::chrono::milliseconds{0});
+  sourcemeta::one::metapack_write_json(replaced, document, "application/json",
+                                       sourcemeta::one::MetapackEncoding::GZIP,
+                                       {}, std::chrono::milliseconds{0});
+
+  {
+    sourcemeta::one::BuildState entries;
+    entries.load(path, test_rules::RULES.leaves, test_rules::RULES.directories,
+                 sourcemeta::one::rules_fingerprint<test_rules::RULES>(),
+                 INPUTS, test_rules::RULES.sentinel);
+    EXPECT_EQ(entries.journal(journal), 0);
+    const auto kept_seal{sourcemeta::one::BuildState::seal(kept)};
+    EXPECT_TRUE(kept_seal.has_value());
+    entries.commit(kept, {}, kept_seal);
+    entries.commit(replaced, {}, sourcemeta::one::BuildState::seal(replaced));
+  }
+
+  // As a crash leaves the artifact of an earlier build in place
+  sourcemeta::one::metapack_write_json(
+      replaced, sourcemeta::core::parse_json("{\"foo\":2}"),
+      "application/json", sourcemeta::one::MetapackEncoding::GZIP, {},
+      std::chrono::milliseconds{0});
+
+  sourcemeta::one::BuildState entries;
+  entries.load(path, test_rules::RULES.leaves, test_rules::RULES.directories,
+               sourcemeta::one::rules_fingerprint<test_rules::RULES>(), INPUTS,
+               test_rules::RULES.sentinel);
+  EXPECT_EQ(entries.journal(journal), 2);
+  EXPECT_TRUE(entries.contains(kept.native()));
+  EXPECT_FALSE(entries.contains(replaced.native()));
+}
+
+TEST(journal_from_other_inputs_is_not_replayed) {
+  const auto directory{state_path("journal_other")};
+  std::filesystem::remove_all(directory);
+  std::filesystem::create_directories(directory);
+  const auto path{directory / "state.bin"};
+  const auto journal{directory / "state.journal"};
+  const auto built{directory / "built.metapack"};
+  std::ofstream{built} << "{}";
+
+  {
+    sourcemeta::one::BuildState entries;
+    entries.load(path, test_rules::RULES.leaves, test_rules::RULES.directories,
+                 sourcemeta::one::rules_fingerprint<test_rules::RULES>(),
+                 INPUTS, test_rules::RULES.sentinel);
+    EXPECT_EQ(entries.journal(journal), 0);
+    entries.commit(built, {});
+  }
+
+  sourcemeta::one::BuildState entries;
+  entries.load(path, test_rules::RULES.leaves, test_rules::RULES.directories,
+               sourcemeta::one::rules_fingerprint<test_rules::RULES>(),
+               OTHER_INPUTS, test_rules::RULES.sentinel);
+  EXPECT_EQ(entries.journal(journal), 0);
+  EXPECT_FALSE(entries.contains(built.native()));
+  EXPECT_FALSE(entries.built_from_these_inputs());
+  EXPECT_FALSE(std::filesystem::exists(journal));
+}
+
+TEST(journal_cut_short_replays_every_whole_record) {
+  const auto directory{state_path("journal_cut")};
+  std::filesystem::remove_all(directory);
+  std::filesystem::create_directories(directory);
+  const auto path{directory / "state.bin"};
+  const auto journal{directory / "state.journal"};
+  const auto first{directory / "first.metapack"};
+  const auto second{directory / "second.metapack"};
+  std::ofstream{first} << "{}";
+  std::ofstream{second} << "{}";
+
+  {
+    sourcemeta::one::BuildState entries;
+    entries.load(path, test_rules::RULES.leaves, test_rules::RULES.directories,
+                 sourcemeta::one::rules_fingerprint<test_rules::RULES>(),
+                 INPUTS, test_rules::RULES.sentinel);
+    EXPECT_EQ(entries.journal(journal), 0);
+    entries.commit(first, {});
+    entries.commit(second, {});
+  }
+
+  // As a process killed halfway through writing the last record leaves it
+  std::filesystem::resize_file(journal,
+                               std::filesystem::file_size(journal) - 3);
+
+  {
+    sourcemeta::one::BuildState entries;
+    entries.load(path, test_rules::RULES.leaves, test_rules::RULES.directories,
+                 sourcemeta::one::rules_fingerprint<test_rules::RULES>(),
+                 INPUTS, test_rules::RULES.sentinel);
+    EXPECT_EQ(entries.journal(journal), 1);
+    EXPECT_TRUE(entries.contains(first.native()));
+    EXPECT_FALSE(entries.contains(second.native()));
+    // Appended after the last whole record rather than after what was cut
+    entries.commit(second, {});
+  }
+
+  sourcemeta::one::BuildState entries;
+  entries.load(path, test_rules::RULES.leaves, test_rules::RULES.directories,
+               sourcemeta::one::rules_fingerprint<test_rules::RULES>(), INPUTS,
+               test_rules::RULES.sentinel);
+  EXPECT_EQ(entries.journal(journal), 2);
+  EXPECT_TRUE(entries.contains(second.native()));
+}
@@ -0,0 +1,170 @@
+#include <sourcemeta/one/metapack.h>
+#include <sourcemeta/one/metapack_archive.h>
+
+#include <sourcemeta/core/io.h>
+#include <sourcemeta/core/json.h>
+#include <sourcemeta/core/test.h>
+
+#include <chrono>      // std::chrono
+#include <cstddef>     // std::size_t
+#include <filesystem>  // std::filesystem
+#include <format>      // std::format
+#include <string>      // std::string, std::to_string
+#include <vector>      // std::vector
+
+static auto archive_output(const std::string &name) -> std::filesystem::path {
+  const auto path{std::filesystem::path{METAPACK_TEST_DIRECTORY} / name};
+  std::filesystem::remove_all(path);
+  return path;
+}
+
+static auto write_artifact(const std::filesystem::path &output,
+                           const std::filesystem::path &relative,
+                           const std::string &value) -> void {
+  const auto path{output / relative};
+  std::filesystem::create_directories(path.parent_path());
+  auto document{sourcemeta::core::JSON::make_object()};
+  document.assign("value", sourcemeta::core::JSON{value});
+  sourcemeta::one::metapack_write_json(
+      path, document, "application/json",
+      sourcemeta::one::MetapackEncoding::GZIP, {},
+      std::chrono::milliseconds{1});
+}
+
+TEST(archive_finds_every_artifact_as_its_own_file_reads) {
+  const auto output{archive_output("archive_find")};
+  write_artifact(output, "schemas/example/foo/%/schema.metapack", "foo");
+  write_artifact(output, "schemas/example/bar/%/schema.metapack", "bar");
+  write_artifact(output, "explorer/public/%/directory.metapack", "root");
+  const std::vector<std::string> artifacts{
+      "schemas/example/foo/%/schema.metapack",
+      "schemas/example/bar/%/schema.metapack",
+      "explorer/public/%/directory.metapack"};
+
+  const auto result{sourcemeta::one::metapack_archive_write(
+      output, artifacts, artifacts, output / "archive")};
+  EXPECT_TRUE(result.written > 0);
+  EXPECT_EQ(result.segments,
+            sourcemeta::one::METAPACK_ARCHIVE_MINIMUM_SEGMENTS);
+
+  const sourcemeta::one::MetapackArchive archive{output / "archive"};
+  EXPECT_FALSE(archive.empty());
+
+  const auto foo{archive.find("schemas/example/foo/%/schema.metapack")};
+  EXPECT_EQ(foo.size(), std::filesystem::file_size(
+                            output / "schemas/example/foo/%/schema.metapack"));
+  EXPECT_EQ(sourcemeta::one::metapack_read_json(foo).value().at("value"),
+            sourcemeta::core::JSON{"foo"});
+
+  const auto root{archive.find("explorer/public/%/directory.metapack")};
+  EXPECT_EQ(sourcemeta::one::metapack_read_json(root).value().at("value"),
+            sourcemeta::core::JSON{"root"});
+  EXPECT_EQ(sourcemeta::one::metapack_info(root).value().mime,
+            "application/json");
+
+  EXPECT_TRUE(archive.find("schemas/example/baz/%/schema.metapack").empty());
+  EXPECT_TRUE(archive.find("schemas/example/foo/%/schema").empty());
+  EXPECT_TRUE(archive.find("").empty());
+}
+
+TEST(archive_rewrites_only_the_segment_of_what_changed) {
+  const auto output{archive_output("archive_incremental")};
+  std::vector<std::string> artifacts;
+  for (std::size_t index{0}; index < 64; index++) {
+    artifacts.push_back(
+        std::format("schemas/example/{}/%/schema.metapack", index));
+    write_artifact(output, artifacts.back(), std::to_string(index));
+  }
+
+  EXPECT_EQ(sourcemeta::one::metapack_archive_write(output, artifacts,
+                                                    artifacts,
+                                                    output / "archive")
+                .written,
+            sourcemeta::one::METAPACK_ARCHIVE_MINIMUM_SEGMENTS);
+  EXPECT_EQ(sourcemeta::one::metapack_archive_write(output, artifacts, {},
+                                                    output / "archive")
+                .written,
+            0);
+
+  // Whatever else is in the segment is taken as it is, rather than compared
+  // with what the segment holds
+  const std::vector<std::string> changed{"schemas/example/7/%/schema.metapack"};
+  write_artifact(output, changed.front(), "seven");
+  EXPECT_EQ(sourcemeta::one::metapack_archive_write(output, artifacts, changed,
+                                                    output / "archive")
+                .written,
+            1);
+
+  const sourcemeta::one::MetapackArchive archive{output / "archive"};
+  const auto found{archive.find("schemas/example/7/%/schema.metapack")};
+  EXPECT_EQ(sourcemeta::one::metapack_read_json(found).value().at("value"),
+            sourcemeta::core::JSON{"seven"});
+}
+
+TEST(archive_writes_a_segment_that_is_not_there) {
+  const auto output{archive_output("archive_missing")};
+  const std::vector<std::string> artifacts{
+      "schemas/example/foo/%/schema.metapack"};
+  write_artifact(output, artifacts.front(), "foo");
+  sourcemeta::one::metapack_archive_write(output, artifacts, artifacts,
+                                          output / "archive");
+  const auto segment{sourcemeta::one::metapack_archive_segment_path(
+      output / "archive",
+      sourcemeta::one::metapack_archive_segment(
+          artifacts.front(),
+          sourcemeta::one::METAPACK_ARCHIVE_MINIMUM_SEGMENTS))};
+  std::filesystem::remove(segment);
+
+  EXPECT_EQ(sourcemeta::one::metapack_archive_write(output, artifacts, {},
+                                                    output / "archive")
+                .written,
+            1);
+  EXPECT_TRUE(std::filesystem::exists(segment));
+}
+
+TEST(archive_drops_a_segment_with_nothing_left_in_it) {
+  const auto output{archive_output("archive_drop")};
+  const std::vector<std::string> artifacts{
+      "schemas/example/foo/%/schema.metapack"};
+  write_artifact(output, artifacts.front(), "foo");
+  sourcemeta::one::metapack_archive_write(output, artifacts, artifacts,
+                                          output / "archive");
+  const auto segment{sourcemeta::one::metapack_archive_segment_path(
+      output / "archive",
+      sourcemeta::one::metapack_archive_segment(
+          artifacts.front(),
+          sourcemeta::one::METAPACK_ARCHIVE_MINIMUM_SEGMENTS))};
+  EXPECT_TRUE(std::filesystem::exists(segment));
+
+  std::filesystem::remove_all(output / "schemas");
+  sourcemeta::one::metapack_archive_write(output, {}, artifacts,
+                                          output / "archive");
+  EXPECT_FALSE(std::filesystem::exists(segment));
+  const sourcemeta::one::MetapackArchive archive{output / "archive"};
+  EXPECT_TRUE(archive.empty());
+}
+
+TEST(archive_splits_into_more_segments_as_it_grows) {
+  EXPECT_EQ(sourcemeta::one::metapack_archive_segments(0),
+            sourcemeta::one::METAPACK_ARCHIVE_MINIMUM_SEGMENTS);
+  EXPECT_EQ(sourcemeta::one::metapack_archive_segments(
+                16 * sourcemeta::one::METAPACK_ARCHIVE_SEGMENT_ENTRIES),
+            16);
+  EXPECT_EQ(sourcemeta::one::metapack_archive_segments(
+                16 * sourcemeta::one::METAPACK_ARCHIVE_SEGMENT_ENTRIES + 1),
+            32);
+  EXPECT_EQ(sourcemeta::one::metapack_archive_segments(
+                sourcemeta::one::METAPACK_ARCHIVE_MAXIMUM_SEGMENTS * 2 *
+                sourcemeta::one::METAPACK_ARCHIVE_SEGMENT_ENTRIES),
+            sourcemeta::one::METAPACK_ARCHIVE_MAXIMUM_SEGMENTS);
+}
+
+TEST(archive_ignores_a_segment_that_does_not_read_as_one) {
+  const auto output{archive_output("archive_corrupt")};
+  std::filesystem::create_directories(output / "archive");
+  sourcemeta::core::write_file(
+      sourcemeta::one::metapack_archive_segment_path(output / "archive", 0),
+      "not an archive");
+  const sourcemeta::one::MetapackArchive archive{output / "archive"};
+  EXPECT_TRUE(archive.empty());
+}
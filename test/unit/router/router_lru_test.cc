@@ -279,3 +279,67 @@ TEST(concurrent_mixed_traffic_bounded) {
   EXPECT_FALSE(error.load());
   EXPECT_LE(cache.size(), capacity);
 }
+
+TEST(insert_keeps_what_is_already_there) {
+  sourcemeta::one::RouterLRU<int, int> cache{3};
+  [[maybe_unused]] const auto seeded{
+      cache.get_or_compute(1, [] { return 100; })};
+  const auto kept{cache.insert(1, std::make_shared<const int>(200))};
+  EXPECT_EQ(*kept, 100);
+  const auto added{cache.insert(2, std::make_shared<const int>(300))};
+  EXPECT_EQ(*added, 300);
+  EXPECT_EQ(cache.size(), 2u);
+}
+
+TEST(entries_carry_over_in_the_same_order) {
+  sourcemeta::one::RouterLRU<int, int> previous{3};
+  for (const int key : {1, 2, 3}) {
+    [[maybe_unused]] const auto entry{
+        previous.get_or_compute(key, [key] { return key * 10; })};
+  }
+
+  [[maybe_unused]] const auto touched{previous.try_get(1)};
+  const auto entries{previous.entries()};
+  EXPECT_EQ(entries.size(), 3u);
+  EXPECT_EQ(entries.front().first, 2);
+  EXPECT_EQ(entries.back().first, 1);
+
+  sourcemeta::one::RouterLRU<int, int> next{3};
+  for (const auto &[key, value] : entries) {
+    [[maybe_unused]] const auto carried{next.insert(key, value)};
+  }
+
+  EXPECT_EQ(next.try_get(3), previous.try_get(3));
+  [[maybe_unused]] const auto pushed{next.get_or_compute(4, [] { return 40; })};
+  EXPECT_EQ(next.try_get(2), nullptr);
+  EXPECT_NE(next.try_get(1), nullptr);
+}
+
+TEST(statistics_count_hits_misses_and_evictions) {
+  sourcemeta::one::RouterLRU<int, int> cache{2};
+  for (const int key : {1, 2, 1, 3}) {
+    [[maybe_unused]] const auto entry{
+        cache.get_or_compute(key, [key] { return key * 10; })};
+  }
+
+  const auto statistics{cache.statistics()};
+  EXPECT_EQ(statistics.hits, 1u);
+  EXPECT_EQ(statistics.misses, 3u);
+  EXPECT_EQ(statistics.evictions, 1u);
+}
+
+TEST(statistics_count_from_another_cache) {
+  sourcemeta::one::RouterLRU<int, int> previous{1};
+  for (const int key : {1, 2}) {
+    [[maybe_unused]] const auto entry{
+        previous.get_or_compute(key, [key] { return key; })};
+  }
+
+  sourcemeta::one::RouterLRU<int, int> next{1};
+  [[maybe_unused]] const auto missed{next.try_get(1)};
+  next.count_from(previous);
+  const auto statistics{next.statistics()};
+  EXPECT_EQ(statistics.hits, 0u);
+  EXPECT_EQ(statistics.misses, 3u);
+  EXPECT_EQ(statistics.evictions, 1u);
+}